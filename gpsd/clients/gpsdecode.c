@@ -571,13 +571,30 @@ static void pseudonmea_report(gps_mask_t changed, struct gps_device_t *device)
     }
 }
 
+#ifdef SOCKET_EXPORT_ENABLE
+// JSON report of what changed to fpout, however long it is
+static void json_report(gps_mask_t changed, struct gps_device_t *session,
+                        const struct gps_policy_t *policy, FILE *fpout)
+{
+    struct gps_chain_t chain;
+    const struct gps_segment_t *seg;
+
+    gpsd_chain_init(&chain);
+    json_data_emit(changed, session, policy, &chain);
+    for (seg = chain.head; NULL != seg; seg = seg->next) {
+        (void)fwrite(seg->buf, 1, seg->len, fpout);
+    }
+    gpsd_chain_release(&chain);
+}
+#endif  // SOCKET_EXPORT_ENABLE
+
 // sensor data on fpin to dump format on fpout
 static void decode(FILE *fpin, FILE*fpout)
 {
     struct gps_device_t session;
     struct gps_policy_t policy;
     size_t minima[PACKET_TYPES+1];
-#if defined(SOCKET_EXPORT_ENABLE) || defined(AIVDM_ENABLE)
+#ifdef AIVDM_ENABLE
     char buf[GPS_JSON_RESPONSE_MAX * 4];
 #endif
     int i;
@@ -630,8 +647,8 @@ static void decode(FILE *fpin, FILE*fpout)
             continue;
         } else if (json) {
             if (0 != (changed & PASSTHROUGH_IS)) {
+                // the driver ended it with CR-LF
                 (void)fputs((char *)session.lexer.outbuffer, fpout);
-                (void)fputs("\n", fpout);
 #ifdef SOCKET_EXPORT_ENABLE
             } else {
                 if (0 != (changed & AIS_SET)) {
@@ -641,9 +658,7 @@ static void decode(FILE *fpin, FILE*fpout)
                         continue;
                     }
                 }
-                json_data_report(changed, &session, &policy,
-                                 buf, sizeof(buf));
-                (void)fputs(buf, fpout);
+                json_report(changed, &session, &policy, fpout);
 #endif  // SOCKET_EXPORT_ENABLE
             }
 #ifdef AIVDM_ENABLE
@@ -720,9 +735,7 @@ static void encode(FILE *fpin, FILE *fpout)
                           status, json_error_string(status), lineno);
             exit(EXIT_FAILURE);
         }
-        json_data_report(session.gpsdata.set, &session, &policy,
-                         inbuf, sizeof(inbuf));
-        (void)fputs(inbuf, fpout);
+        json_report(session.gpsdata.set, &session, &policy, fpout);
     }
 }
 #endif  // SOCKET_EXPORT_ENABLE
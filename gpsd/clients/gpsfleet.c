@@ -0,0 +1,319 @@
+/*
+ * gpsfleet
+ *
+ * watch many gpsd instances from one process, and merge what they send
+ * into one stream, each line tagged with the gpsd it came from:
+ *
+ *     gpsfleet truck1=10.0.0.1 truck2=10.0.0.2:2948 ...
+ *     gpsfleet -j -c TPV -f fleet.list
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ *
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <errno.h>
+#ifdef HAVE_GETOPT_LONG
+    #include <getopt.h>   // for getopt_long()
+#endif
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gps.h"
+#include "../include/compiler.h"     // for UNUSED
+#include "../include/gpsdclient.h"
+
+#define CLASSES_MAX     16
+
+static bool json_tag = false;
+static char *classes[CLASSES_MAX];
+static int nclasses = 0;
+
+static void usage(void)
+{
+    (void)fprintf(stderr,
+                  "Usage: gpsfleet [OPTIONS] [[TAG=]server[:port] ...]\n\n"
+#ifdef HAVE_GETOPT_LONG
+                  "  --class CLASSES  Pass on only reports of CLASSES, "
+                  "comma separated.\n"
+                  "  --file FILE      Read servers from FILE, one a line.\n"
+                  "  --help           Show this help and exit.\n"
+                  "  --json           Tag JSON reports with a \"fleet\" "
+                  "member.\n"
+                  "  --retry MIN:MAX  Retry lost servers after MIN to MAX "
+                  "ms.\n"
+                  "  --seconds SEC    Exit after SEC seconds.\n"
+                  "  --stats SEC      Write fleet statistics to stderr "
+                  "every SEC seconds.\n"
+                  "  --version        Print version and exit.\n"
+                  "  --watch REQUEST  Send REQUEST to each server, "
+                  "not ?WATCH for JSON.\n"
+#endif
+                  "  -c CLASSES       Pass on only reports of CLASSES, "
+                  "comma separated.\n"
+                  "  -f FILE          Read servers from FILE, one a line.\n"
+                  "  -h               Show this help and exit.\n"
+                  "  -j               Tag JSON reports with a \"fleet\" "
+                  "member.\n"
+                  "  -r MIN:MAX       Retry lost servers after MIN to MAX "
+                  "ms.\n"
+                  "  -s SEC           Write fleet statistics to stderr "
+                  "every SEC seconds.\n"
+                  "  -V               Print version and exit.\n"
+                  "  -w REQUEST       Send REQUEST to each server, "
+                  "not ?WATCH for JSON.\n"
+                  "  -x SEC           Exit after SEC seconds.\n\n"
+                  "Each line out is the TAG, or server:port, a space, "
+                  "and a line from it;\n"
+                  "with -j, JSON reports are tagged inside instead.\n");
+}
+
+// is line a report of a class asked for?
+static bool wanted(const char *line)
+{
+    const char *tag;
+    int i;
+
+    if (0 == nclasses) {
+        return true;
+    }
+    tag = strstr(line, "\"class\":\"");
+    if (NULL == tag) {
+        return false;
+    }
+    tag += 9;
+    for (i = 0; i < nclasses; i++) {
+        size_t len = strlen(classes[i]);
+
+        if (0 == strncmp(tag, classes[i], len) &&
+            '"' == tag[len]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void emit(void *arg UNUSED, struct gps_fleet_t *fleet, int member,
+                 char *line, size_t len)
+{
+    const char *tag = gps_fleet_tag(fleet, member);
+
+    if (!wanted(line)) {
+        return;
+    }
+    if (json_tag &&
+        '{' == line[0]) {
+        (void)printf("{\"fleet\":\"%s\",", tag);
+        if (1 < len &&
+            '}' == line[1]) {
+            // an empty object
+            (void)fwrite(line + 2, 1, len - 2, stdout);
+            (void)fputs("}\n", stdout);
+            return;
+        }
+        (void)fwrite(line + 1, 1, len - 1, stdout);
+    } else {
+        (void)fputs(tag, stdout);
+        (void)putchar(' ');
+        (void)fwrite(line, 1, len, stdout);
+    }
+    (void)putchar('\n');
+}
+
+// add a [TAG=]server[:port] to the fleet
+static bool add(struct gps_fleet_t *fleet, char *spec)
+{
+    struct fixsource_t source;
+    char *tag = NULL, *eq = strchr(spec, '=');
+    bool ok;
+
+    if (NULL != eq) {
+        *eq = '\0';
+        tag = spec;
+        spec = eq + 1;
+        if (NULL != strpbrk(tag, "\"\\")) {
+            (void)fprintf(stderr, "gpsfleet: tag %s has quotes, or "
+                          "backslashes\n", tag);
+            return false;
+        }
+    }
+    gpsd_source_spec(spec, &source);
+    ok = 0 <= gps_fleet_add(fleet, source.server, source.port, tag);
+    if (!ok) {
+        (void)fprintf(stderr, "gpsfleet: %s:%s: %s\n", source.server,
+                      source.port, strerror(errno));
+    }
+    return ok;
+}
+
+// add the servers in file, one a line, # starting comments
+static int add_file(struct gps_fleet_t *fleet, const char *file)
+{
+    char line[BUFSIZ];
+    FILE *fp = fopen(file, "r");
+    int added = 0;
+
+    if (NULL == fp) {
+        (void)fprintf(stderr, "gpsfleet: %s: %s\n", file, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        char *spec = line + strspn(line, " \t");
+
+        spec[strcspn(spec, " \t\r\n#")] = '\0';
+        if ('\0' != spec[0] &&
+            add(fleet, spec)) {
+            added++;
+        }
+    }
+    (void)fclose(fp);
+    return added;
+}
+
+int main(int argc, char **argv)
+{
+    struct gps_fleet_t *fleet;
+    const char *watch = "?WATCH={\"enable\":true,\"json\":true};\n";
+    char *file = NULL;
+    char *class_list = NULL;
+    int min_ms = 1000, max_ms = 60000;
+    time_t stats_every = 0, exit_after = 0;
+    time_t start, last_stats;
+    int added = 0, i;
+    const char *optstring = "?c:f:hjr:s:Vw:x:";
+#ifdef HAVE_GETOPT_LONG
+    int option_index = 0;
+    static struct option long_options[] = {
+        {"class", required_argument, NULL, 'c'},
+        {"file", required_argument, NULL, 'f'},
+        {"help", no_argument, NULL, 'h'},
+        {"json", no_argument, NULL, 'j'},
+        {"retry", required_argument, NULL, 'r'},
+        {"seconds", required_argument, NULL, 'x'},
+        {"stats", required_argument, NULL, 's'},
+        {"version", no_argument, NULL, 'V' },
+        {"watch", required_argument, NULL, 'w'},
+        {NULL, 0, NULL, 0},
+    };
+#endif
+
+    while (1) {
+        int ch;
+#ifdef HAVE_GETOPT_LONG
+        ch = getopt_long(argc, argv, optstring, long_options, &option_index);
+#else
+        ch = getopt(argc, argv, optstring);
+#endif
+
+        if (ch == -1) {
+            break;
+        }
+
+        switch (ch) {
+        case 'c':
+            class_list = optarg;
+            break;
+        case 'f':
+            file = optarg;
+            break;
+        case 'j':
+            json_tag = true;
+            break;
+        case 'r':
+            if (2 != sscanf(optarg, "%d:%d", &min_ms, &max_ms) ||
+                0 >= min_ms ||
+                min_ms > max_ms) {
+                (void)fprintf(stderr, "gpsfleet: bad retry %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            stats_every = (time_t)strtol(optarg, 0, 0);
+            break;
+        case 'V':
+            (void)fprintf(stderr, "%s: %s (revision %s)\n",
+                          argv[0], VERSION, REVISION);
+            exit(EXIT_SUCCESS);
+        case 'w':
+            watch = optarg;
+            break;
+        case 'x':
+            exit_after = (time_t)strtol(optarg, 0, 0);
+            break;
+        case '?':
+        case 'h':
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (NULL != class_list) {
+        char *saveptr = NULL, *class;
+
+        for (class = strtok_r(class_list, ",", &saveptr);
+             NULL != class && CLASSES_MAX > nclasses;
+             class = strtok_r(NULL, ",", &saveptr)) {
+            classes[nclasses++] = class;
+        }
+    }
+
+    fleet = gps_fleet_open(watch, min_ms, max_ms, emit, NULL);
+    if (NULL == fleet) {
+        (void)fprintf(stderr, "gpsfleet: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (NULL != file) {
+        added += add_file(fleet, file);
+    }
+    for (i = optind; i < argc; i++) {
+        if (add(fleet, argv[i])) {
+            added++;
+        }
+    }
+    if (0 == added) {
+        (void)fputs("gpsfleet: no servers to watch\n", stderr);
+        gps_fleet_close(fleet);
+        exit(EXIT_FAILURE);
+    }
+
+    start = last_stats = time(NULL);
+    for (;;) {
+        time_t now;
+
+        if (0 > gps_fleet_poll(fleet, 1000)) {
+            (void)fprintf(stderr, "gpsfleet: %s\n", strerror(errno));
+            break;
+        }
+        // the lines of a poll go out together
+        (void)fflush(stdout);
+
+        now = time(NULL);
+        if (0 < stats_every &&
+            now - last_stats >= stats_every) {
+            struct gps_fleet_stats_t stats;
+
+            gps_fleet_stats(fleet, &stats);
+            (void)fprintf(stderr, "gpsfleet: %d members, %d up, %lu lines, "
+                          "%lu connects, %lu drops, %lu overflows, "
+                          "%zu bytes\n",
+                          stats.members, stats.up, stats.lines,
+                          stats.connects, stats.drops, stats.overflows,
+                          stats.bytes);
+            last_stats = now;
+        }
+        if (0 < exit_after &&
+            now - start >= exit_after) {
+            break;
+        }
+    }
+    gps_fleet_close(fleet);
+    exit(EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -14,6 +14,12 @@
  * lines such as DCD.  Suspect this especially if the cable jacket
  * looks too skinny to hold more than three leads!
  *
+ * With -l, each edge also gets its latency: how long after the kernel
+ * timestamped it, by KPPS, this process woke to see it; or, with no
+ * KPPS, how far a TIOCMIWAIT cycle strayed from a whole second.  On
+ * exit their distribution is written.  Run it with the -R, -c and -L
+ * given gpsd to see what they buy.
+ *
  * This code requires only ANSI/POSIX. If it doesn't compile and run
  * on your Unix there is something very wrong with your Unix.
  *
@@ -31,6 +37,7 @@
    #include <getopt.h>
 #endif
 #include <limits.h>          // for PATH_MAX
+#include <signal.h>
 #ifdef __linux__
    #include <linux/tty.h>             // for N_PPS
 #endif
@@ -51,8 +58,11 @@
 
 #include "../include/compiler.h"     // for FALLTHROUGH
 #include "../include/os_compat.h"    // backup for strlcpy()
+#include "../include/rtsched.h"
 #include "../include/timespec.h"
 
+#define LATENCY_MAX     200000       // edges -l keeps, over a day of both
+
 time_t exit_timer = 0;               // for -x option
 int device_fd = -1;                  // fd open device
 int pps_fd = -1;                     // fd open pps device
@@ -63,6 +73,23 @@ int pps_fd = -1;                     // fd open pps device
 int path_fd = -1;                    // fd for open("sys/X")
 DIR *sys_dir = NULL;                 // fd for opendir("sys")
 const char *sys_path = "/sys/devices/virtual/pps";
+bool latency = false;                // for -l option
+const char *latency_what = NULL;     // what the latencies are of
+long latency_ns[LATENCY_MAX];
+struct rt_latency_t latencies;
+volatile sig_atomic_t stopped = 0;   // got SIGINT or SIGTERM
+
+static void onsig(int sig)
+{
+    stopped = (sig_atomic_t)sig;
+}
+
+// note the latency of an edge, and show it
+static void edge_latency(long ns)
+{
+    rt_latency_add(&latencies, ns);
+    (void)printf("  %ld ns", ns);
+}
 
 // atexit function
 static void myexit(void)
@@ -85,6 +112,10 @@ static void myexit(void)
         time_pps_destroy(kpps_handle);
     }
 #endif  // HAVE_SYS_TIMEPPS_H
+    if (NULL != latency_what) {
+        (void)putchar('\n');
+        rt_latency_report(&latencies, stdout, latency_what);
+    }
 }
 
 struct assoc {
@@ -204,13 +235,21 @@ static void do_kpps(void)
     pps_seq_t assert_seq = -1;    // KPPS assert sequence
     cfg_kpps();        // get caps, configure KPPS
 
-    (void)puts("\n# Src   Seconds                 Signal    Sequence");
+    if (latency) {
+        latency_what = "KPPS edge to wakeup latency";
+        (void)puts("\n# Src   Seconds                 Signal    Sequence"
+                   "  Latency");
+    } else {
+        (void)puts("\n# Src   Seconds                 Signal    Sequence");
+    }
 
-    for (;;) {
+    while (0 == stopped) {
         pps_info_t pi;
         struct timespec kpps_tv;
+        struct timespec woke;
         time_t now;
         char ts_str[TIMESPEC_LEN];
+        bool new_assert, new_clear;
 
         kpps_tv.tv_sec = 3;   // 3 second timeout
         kpps_tv.tv_nsec = 0;
@@ -218,6 +257,9 @@ static void do_kpps(void)
         memset((void *)&pi, 0, sizeof(pi));    // paranoia
         // wait for an event
         if (0 > time_pps_fetch(kpps_handle, PPS_TSFMT_TSPEC, &pi, &kpps_tv)) {
+            if (0 != stopped) {
+                break;
+            }
             if (ETIMEDOUT == errno ||
                 EINTR == errno) {
                 // just a timeout
@@ -229,6 +271,7 @@ static void do_kpps(void)
                          strerror(errno), errno);
             exit(EXIT_FAILURE);
         }
+        (void)clock_gettime(CLOCK_REALTIME, &woke);  // quick, grab the time
         now = time(NULL);
         if (0 < exit_timer &&
             now >= exit_timer) {
@@ -239,18 +282,36 @@ static void do_kpps(void)
             (void)putchar('\n');
             last = now;
         }
-        if (pi.assert_sequence != assert_seq) {
-            (void)printf("  KPPS %s    assert  %lu\n",
+        /* an edge's latency is known only when it alone woke us, not
+         * on the first fetch, nor after one we slept through */
+        new_assert = pi.assert_sequence != assert_seq;
+        new_clear = pi.clear_sequence != clear_seq;
+        if (new_assert) {
+            (void)printf("  KPPS %s    assert  %lu",
                          timespec_str(&pi.assert_timestamp,
                                       ts_str, sizeof(ts_str)),
                          (unsigned long)pi.assert_sequence);
+            if (latency &&
+                !new_clear &&
+                (pps_seq_t)-1 != assert_seq) {
+                edge_latency((long)timespec_diff_ns(woke,
+                                                    pi.assert_timestamp));
+            }
+            (void)putchar('\n');
             assert_seq = pi.assert_sequence;
         }
-        if (pi.clear_sequence != clear_seq) {
-            (void)printf("  KPPS %s    clear   %lu\n",
+        if (new_clear) {
+            (void)printf("  KPPS %s    clear   %lu",
                          timespec_str(&pi.clear_timestamp,
                                       ts_str, sizeof(ts_str)),
                          (unsigned long)pi.clear_sequence);
+            if (latency &&
+                !new_assert &&
+                (pps_seq_t)-1 != clear_seq) {
+                edge_latency((long)timespec_diff_ns(woke,
+                                                    pi.clear_timestamp));
+            }
+            (void)putchar('\n');
             clear_seq = pi.clear_sequence;
         }
     }
@@ -382,13 +443,27 @@ static void do_tty(void)
     int handshakes;
     struct timespec ts;
     time_t last_sec = -1;
+    // the TTY times of the last two edges, for cycle jitter
+    struct timespec edges[2] = {{0, 0}, {0, 0}};
+    int nedges = 0;
 
     (void)puts("\n# Src   Seconds                 Signals");
-    for (;;) {
+    if (latency) {
+        latency_what = "TIOCMIWAIT cycle jitter";
+#if defined(HAVE_SYS_TIMEPPS_H)
+        if (0 <= kpps_handle) {
+            latency_what = "KPPS edge to TIOCMIWAIT wakeup latency";
+        }
+#endif  // HAVE_SYS_TIMEPPS_H
+        (void)printf("# TTY lines end with the %s\n", latency_what);
+    }
+    while (0 == stopped) {
         const struct assoc *sp;
 #if defined(HAVE_SYS_TIMEPPS_H)
         pps_info_t pi;
         struct timespec kpps_tv ;
+        // the KPPS time of the edge that woke us, if known
+        struct timespec kpps_edge = {0, 0};
 #endif  // HAVE_SYS_TIMEPPS_H
         char ts_str[TIMESPEC_LEN];
 
@@ -401,6 +476,9 @@ static void do_tty(void)
         // no way to set a timeout on this ioctl()
         if (0 != ioctl(device_fd, TIOCMIWAIT,
                        TIOCM_CD | TIOCM_DSR | TIOCM_RI | TIOCM_CTS)) {
+            if (0 != stopped) {
+                break;
+            }
             (void)printf("ERROR: ioctl(TIOCMIWAIT) failed: %.80s(%d)\n",
                          strerror(errno), errno);
             exit(EXIT_FAILURE);
@@ -439,14 +517,27 @@ static void do_tty(void)
             // print KPPS first, as its timestamp will be before
             // TIOCMIWAIT time
             if (good_pi) {
-                if (pi.assert_sequence != assert_seq) {
+                bool new_assert = pi.assert_sequence != assert_seq;
+                bool new_clear = pi.clear_sequence != clear_seq;
+
+                // which edge woke us is known only if just one is new
+                if (new_assert &&
+                    !new_clear &&
+                    (pps_seq_t)-1 != assert_seq) {
+                    kpps_edge = pi.assert_timestamp;
+                } else if (new_clear &&
+                           !new_assert &&
+                           (pps_seq_t)-1 != clear_seq) {
+                    kpps_edge = pi.clear_timestamp;
+                }
+                if (new_assert) {
                     (void)printf("  KPPS %s    assert  %lu\n",
                                  timespec_str(&pi.assert_timestamp,
                                               ts_str, sizeof(ts_str)),
                                  (unsigned long)pi.assert_sequence);
                     assert_seq = pi.assert_sequence;
                 }
-                if (pi.clear_sequence != clear_seq) {
+                if (new_clear) {
                     (void)printf("  KPPS %s    clear   %lu\n",
                                  timespec_str(&pi.clear_timestamp,
                                               ts_str, sizeof(ts_str)),
@@ -465,26 +556,94 @@ static void do_tty(void)
                 (void)printf("  %s", sp->string);
             }
         }
+        if (latency) {
+            bool by_kpps = false;
+
+#if defined(HAVE_SYS_TIMEPPS_H)
+            if (0 <= kpps_handle) {
+                by_kpps = true;
+                if (TS_NZ(&kpps_edge)) {
+                    edge_latency((long)timespec_diff_ns(ts, kpps_edge));
+                }
+            }
+#endif   // HAVE_SYS_TIMEPPS_H
+            if (!by_kpps &&
+                2 <= nedges) {
+                // from the edge before last, the same way, a whole cycle
+                int64_t cycle = timespec_diff_ns(ts, edges[0]);
+                int64_t whole = (cycle + NS_IN_SEC / 2) / NS_IN_SEC;
+
+                edge_latency((long)(cycle - whole * NS_IN_SEC));
+            }
+            edges[0] = edges[1];
+            edges[1] = ts;
+            nedges++;
+        }
         (void)putchar('\n');
     }
     exit(EXIT_SUCCESS);
 }
 
 
+// run as gpsd -c, -R and -L would run its PPS threads
+static void rt_setup(const struct rt_cpus_t *cpus, int prio, bool memlock)
+{
+    int err;
+
+    if (0 < cpus->count) {
+        err = rt_pin(cpus);
+        if (0 != err) {
+            (void)printf("WARNING: can not pin to CPUs: %s(%d)\n",
+                         strerror(err), err);
+        }
+    }
+    if (0 < prio) {
+        err = rt_fifo(prio);
+        if (0 != err) {
+            (void)printf("WARNING: can not run SCHED_FIFO at %d: %s(%d)\n",
+                         prio, strerror(err), err);
+        } else {
+            (void)printf("INFO: running SCHED_FIFO at %d\n", prio);
+        }
+    }
+    if (memlock) {
+        err = rt_memlock();
+        if (0 != err) {
+            (void)printf("WARNING: can not lock in memory: %s(%d)\n",
+                         strerror(err), err);
+        } else {
+            (void)puts("INFO: locked in memory");
+        }
+    } else if (0 < cpus->count ||
+               0 < prio) {
+        rt_prefault_stack();
+    }
+}
+
 static void usage(void)
 {
         (void)printf(
         "usage: ppscheck [OPTIONS] <device>\n\n"
 #ifdef HAVE_GETOPT_LONG
+        "  --cpus CPUS       Run on CPUS, a list such as 0,2-3.\n"
         "  --help            Show this help, then exit.\n"
+        "  --latency         Show edge latencies, and their distribution "
+        "on exit.\n"
+        "  --memlock         Lock ppscheck in memory.\n"
         "  --pps             List pps devices active.\n"
+        "  --prio PRIO       Run SCHED_FIFO at priority PRIO.\n"
         "  --seconds SEC     Exit after SEC seconds delay.\n"
         "  --version         Show version, then exit.\n"
 #endif
         "   -?               Show this help, then exit.\n"
+        "   -c CPUS          Run on CPUS, a list such as 0,2-3.\n"
         "   -h               Show this help, then exit.\n"
+        "   -L               Lock ppscheck in memory.\n"
+        "   -l               Show edge latencies, and their distribution "
+        "on exit.\n"
         "   -m               Find pps device that matches <device>\n"
         "   -p               List pps devices active.\n"
+        "   -R PRIO          Run SCHED_FIFO at priority PRIO.\n"
         "   -V               Show version, then exit.\n"
         "   -x SEC           Exit after SEC seconds delay.\n"
         "\n"
@@ -504,13 +663,21 @@ int main(int argc, char *argv[])
     char kpps_path[PATH_MAX] = "";   // full path to devined kpps device
     char *device = NULL;          // pointer to <device> name
     char device_real[PATH_MAX];   // realname() of <device>
-    const char *optstring = "?hmpVx:";
+    struct rt_cpus_t cpus = {{0}, 0};
+    int prio = 0;
+    bool memlock = false;
+    struct sigaction sa;
+    const char *optstring = "?c:hLlmpR:Vx:";
 #ifdef HAVE_GETOPT_LONG
     int option_index = 0;
     static struct option long_options[] = {
+        {"cpus", required_argument, NULL, 'c'},
         {"help", no_argument, NULL, 'h'},
+        {"latency", no_argument, NULL, 'l'},
         {"match", no_argument, NULL, 'm'},
+        {"memlock", no_argument, NULL, 'L'},
         {"pps", no_argument, NULL, 'p'},
+        {"prio", required_argument, NULL, 'R'},
         {"seconds", required_argument, NULL, 'x'},
         {"version", no_argument, NULL, 'V' },
         {NULL, 0, NULL, 0},
@@ -538,12 +705,32 @@ int main(int argc, char *argv[])
         default:
             usage();
             exit(EXIT_FAILURE);
+        case 'c':
+            if (!rt_cpus_parse(optarg, &cpus)) {
+                (void)printf("ERROR: invalid CPU list %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'L':
+            memlock = true;
+            break;
+        case 'l':
+            latency = true;
+            break;
         case 'm':
             find_kpps = true;
             break;
         case 'p':
             list_pps();
             exit(EXIT_SUCCESS);
+        case 'R':
+            prio = atoi(optarg);
+            if (!rt_prio_valid(prio)) {
+                (void)printf("ERROR: invalid SCHED_FIFO priority %s\n",
+                             optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'V':
             (void)printf("%s: %s\n", argv[0], REVISION);
             exit(EXIT_SUCCESS);
@@ -562,6 +749,14 @@ int main(int argc, char *argv[])
 
     atexit(myexit);
 
+    // no SA_RESTART, so SIGINT stops the wait for an edge, and -l reports
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onsig;
+    (void)sigemptyset(&sa.sa_mask);
+    (void)sigaction(SIGINT, &sa, NULL);
+    (void)sigaction(SIGTERM, &sa, NULL);
+    rt_latency_init(&latencies, latency_ns, LATENCY_MAX);
+
     device = realpath(argv[optind], device_real);;
     if (NULL == device) {
         (void)printf("ERROR: realpath(%s) failed: %.80s(%d)\n",
@@ -618,6 +813,8 @@ int main(int argc, char *argv[])
         is_tty = false;
     }
 
+    rt_setup(&cpus, prio, memlock);
+
 #if defined(HAVE_SYS_TIMEPPS_H)
     // aka RFC2783
     if (0 == time_pps_create(device_fd, &kpps_handle)) {
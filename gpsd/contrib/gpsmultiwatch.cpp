@@ -0,0 +1,66 @@
+/*
+ * gpsmultiwatch - watch the fixes of many gpsd instances on one thread
+ *
+ *     gpsmultiwatch host[:port] ...
+ *
+ * prints each TPV as "host[:port] time lat lon mode", reconnecting to a
+ * lost gpsd every 1 to 30 seconds.  An example of libgpsmm_async.h.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <libgpsmm_async.h>
+
+using namespace gpsmm_async;
+
+static task track(session &s, std::string name)
+{
+    for (;;) {
+        auto tpv = co_await s.next<TPV>();
+
+        if (nullptr == tpv) {
+            break;              // not reached, sessions reconnect
+        }
+        (void)printf("%s %lld.%03ld %.7f %.7f %d\n", name.c_str(),
+                     (long long)tpv->fix.time.tv_sec,
+                     tpv->fix.time.tv_nsec / 1000000,
+                     tpv->fix.latitude, tpv->fix.longitude,
+                     tpv->fix.mode);
+        (void)fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::unique_ptr<session>> sessions;
+    loop lp;
+    int i;
+
+    if (2 > argc) {
+        (void)fputs("usage: gpsmultiwatch host[:port] ...\n", stderr);
+        return 1;
+    }
+    for (i = 1; i < argc; i++) {
+        std::string host = argv[i], port = DEFAULT_GPSD_PORT;
+        size_t colon = host.rfind(':');
+
+        if (std::string::npos != colon) {
+            port = host.substr(colon + 1);
+            host.erase(colon);
+        }
+        sessions.push_back(std::make_unique<session>(lp, host.c_str(),
+                                                     port.c_str()));
+        sessions.back()->watch("?WATCH={\"enable\":true,\"json\":true};\n");
+        sessions.back()->reconnect(1000, 30000);
+        track(*sessions.back(), argv[i]);
+    }
+    lp.run();
+    return 0;
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+# This file is Copyright 2010 by the GPSD project
+# SPDX-License-Identifier: BSD-2-clause
+#
+# This code runs under Python 3.  It is a developer tool, not shipped.
+#
+"""poll_load.py -- drive many ?POLL clients against a local gpsd.
+
+Each client enables watching (without JSON streaming) and then sends
+?POLL; once per interval, with its phase spread across the interval.
+At the end the poll rate, response latency percentiles, and bytes
+received are reported.  With --pid, the CPU time gpsd used during the
+run is reported as well.
+
+The daemon must be built with max_clients at least as large as the
+number of clients, e.g. "scons max_clients=512", and should be fed
+from a test log:
+
+    gpsfake -q -c 0.1 test/daemon/ublox-neo-m8t.log &
+    devtools/poll_load.py -n 500 -d 30 --pid `pidof gpsd`
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import selectors
+import socket
+import sys
+import time
+
+WATCH = b'?WATCH={"enable":true};\n'
+POLL = b'?POLL;\n'
+
+
+class Poller(object):
+    "One polling client."
+
+    def __init__(self, sock, phase):
+        self.sock = sock
+        self.next_poll = phase
+        self.sent = None            # time of the outstanding ?POLL
+        self.buf = b''
+
+    def poll(self, now):
+        "Send a ?POLL; unless one is already outstanding."
+        if self.sent is not None:
+            return False
+        self.sock.sendall(POLL)
+        self.sent = now
+        return True
+
+
+def cpu_seconds(pid):
+    "Return user+system CPU seconds used so far by pid."
+    with open('/proc/%d/stat' % pid) as f:
+        fields = f.read().rsplit(')', 1)[1].split()
+    # utime and stime are fields 14 and 15 of stat(5)
+    return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+def percentile(values, fraction):
+    "Return the given fraction percentile of sorted values."
+    if not values:
+        return float('nan')
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def main():
+    "Run the load test."
+    parser = argparse.ArgumentParser(
+        description="Drive many ?POLL clients against a local gpsd.")
+    parser.add_argument('--host', default='127.0.0.1',
+                        help="gpsd host [default %(default)s]")
+    parser.add_argument('--port', type=int, default=2947,
+                        help="gpsd port [default %(default)s]")
+    parser.add_argument('-n', '--clients', type=int, default=500,
+                        help="number of polling clients [%(default)s]")
+    parser.add_argument('-i', '--interval', type=float, default=1.0,
+                        help="seconds between polls per client "
+                             "[%(default)s]")
+    parser.add_argument('-d', '--duration', type=float, default=30.0,
+                        help="seconds to run [%(default)s]")
+    parser.add_argument('--pid', type=int, default=None,
+                        help="gpsd pid, to report its CPU use")
+    options = parser.parse_args()
+
+    sel = selectors.DefaultSelector()
+    pollers = []
+    for i in range(options.clients):
+        try:
+            sock = socket.create_connection((options.host, options.port))
+        except socket.error as err:
+            sys.stderr.write("poll_load: connection %d failed: %s\n" %
+                             (i, err))
+            sys.exit(1)
+        sock.sendall(WATCH)
+        sock.setblocking(False)
+        poller = Poller(sock, options.interval * i / options.clients)
+        pollers.append(poller)
+        sel.register(sock, selectors.EVENT_READ, poller)
+
+    # let the banners and WATCH responses drain before timing
+    drain_until = time.time() + 1.0
+    while time.time() < drain_until:
+        for key, _ in sel.select(0.1):
+            key.data.sock.recv(65536)
+
+    latencies = []
+    nbytes = 0
+    lost = 0
+    cpu_start = cpu_seconds(options.pid) if options.pid else None
+    start = time.time()
+    for poller in pollers:
+        poller.next_poll += start
+    end = start + options.duration
+
+    while True:
+        now = time.time()
+        if now >= end:
+            break
+        timeout = end - now
+        for poller in pollers:
+            if poller.next_poll <= now:
+                if not poller.poll(now):
+                    lost += 1
+                poller.next_poll += options.interval
+            timeout = min(timeout, max(0, poller.next_poll - now))
+        for key, _ in sel.select(timeout):
+            poller = key.data
+            data = poller.sock.recv(65536)
+            if not data:
+                sys.stderr.write("poll_load: gpsd closed a connection\n")
+                sys.exit(1)
+            nbytes += len(data)
+            poller.buf += data
+            while b'\n' in poller.buf:
+                line, poller.buf = poller.buf.split(b'\n', 1)
+                if (line.startswith(b'{"class":"POLL"') and
+                        poller.sent is not None):
+                    latencies.append(time.time() - poller.sent)
+                    poller.sent = None
+    elapsed = time.time() - start
+    cpu_used = cpu_seconds(options.pid) - cpu_start if options.pid else None
+
+    latencies.sort()
+    print("%d clients, %.1f s: %d polls answered, %.1f polls/s, "
+          "%d skipped (previous poll unanswered)" %
+          (options.clients, elapsed, len(latencies),
+           len(latencies) / elapsed, lost))
+    print("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f" %
+          tuple(1000 * percentile(latencies, f)
+                for f in (0.5, 0.9, 0.99, 1.0)))
+    print("received %.1f kB/s" % (nbytes / elapsed / 1000))
+    if cpu_used is not None:
+        print("gpsd CPU %.3f s, %.1f%% of one core, %.1f us per poll" %
+              (cpu_used, 100 * cpu_used / elapsed,
+               1e6 * cpu_used / max(1, len(latencies))))
+
+    for poller in pollers:
+        poller.sock.close()
+
+
+if __name__ == '__main__':
+    main()
+
+# vim: set expandtab shiftwidth=4
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+# This file is Copyright 2010 by the GPSD project
+# SPDX-License-Identifier: BSD-2-clause
+#
+# This code runs under Python 3.  It is a developer tool, not shipped.
+#
+"""relay_bench.py -- measure a two tier gpsd chain on this host.
+
+Start an upstream gpsd reading a udp:// feed, and a downstream gpsd
+whose only device is gpsd:// pointing at the upstream one.  Play the
+sentences of a textual test log into the feed, watch the upstream
+daemon with one client and the downstream one with several, and report
+how many TPV reports per second the downstream clients got, how much later
+than the upstream client they saw each one, and the CPU time the
+downstream daemon spent per relayed report.  Run it against two builds
+to compare them:
+
+    devtools/relay_bench.py --gpsd ./gpsd/gpsd -n 20 -r 200
+    devtools/relay_bench.py --gpsd /tmp/old/gpsd -n 20 -r 200
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import selectors
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+WATCH = b'?WATCH={"enable":true,"json":true};'
+MATCH_WINDOW = 1.0          # seconds
+
+
+def sentences(logfile):
+    "Return the NMEA and AIVDM sentences of logfile."
+    with open(logfile, 'rb') as f:
+        return [line.rstrip() + b'\r\n' for line in f
+                if line[:1] in (b'$', b'!')]
+
+
+def feed(lines, port, rate, stop):
+    "Send lines to the UDP port at rate lines per second until stop."
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    while not stop.is_set():
+        for line in lines:
+            if stop.is_set():
+                break
+            sock.sendto(line, ('127.0.0.1', port))
+            time.sleep(1.0 / rate)
+    sock.close()
+
+
+def cpu_seconds(pid):
+    "Return the user plus system CPU seconds of pid."
+    with open('/proc/%d/stat' % pid) as f:
+        fields = f.read().rsplit(')', 1)[1].split()
+    # utime and stime are fields 14 and 15, counting from 1
+    return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+def watcher(port):
+    "Open a JSON watcher on a gpsd port."
+    sock = socket.create_connection(('127.0.0.1', port))
+    sock.sendall(WATCH)
+    return sock
+
+
+def reports(buf, origin=b''):
+    """Split complete report lines off buf: (lines, rest).  Take the
+    origin the downstream daemon puts in front of device names out."""
+    lines = buf.split(b'\n')
+    # TPVs carry their time, so each is told apart from the next
+    return ([line.rstrip(b'\r').replace(origin, b'') for line in lines[:-1]
+             if b'"class":"TPV"' in line],
+            lines[-1])
+
+
+def run(options, downstream_pid):
+    "Watch both tiers for the duration, print the results."
+    sel = selectors.DefaultSelector()
+    reference = watcher(options.port)
+    sel.register(reference, selectors.EVENT_READ, None)
+    origin = b'gpsd://127.0.0.1:%d#' % options.port
+    clients = []
+    for _ in range(options.clients):
+        sock = watcher(options.port + 1)
+        clients.append(sock)
+        sel.register(sock, selectors.EVENT_READ, [b''])
+    time.sleep(1.0)
+
+    seen = {}               # report -> upstream arrival
+    pending = {}            # reports a downstream client saw first
+    latencies = []
+    count = 0
+    refbuf = b''
+    cpu = cpu_seconds(downstream_pid)
+    end = time.time() + options.duration
+    while time.time() < end:
+        for key, _ in sel.select(0.1):
+            now = time.time()
+            data = key.fileobj.recv(65536)
+            if not data:
+                sys.stderr.write("relay_bench: a gpsd hung up\n")
+                sys.exit(1)
+            if key.data is None:
+                lines, refbuf = reports(refbuf + data)
+                for line in lines:
+                    seen[line] = now
+                    for early in pending.pop(line, []):
+                        latencies.append(early - now)
+                continue
+            lines, key.data[0] = reports(key.data[0] + data, origin)
+            for line in lines:
+                count += 1
+                # a looping log repeats reports, so only match recent ones
+                if line in seen and now - seen[line] < MATCH_WINDOW:
+                    latencies.append(now - seen[line])
+                else:
+                    pending.setdefault(line, []).append(now)
+    cpu = cpu_seconds(downstream_pid) - cpu
+    latencies.sort()
+
+    def percentile(fraction):
+        "Return the given fraction percentile of the latencies."
+        if not latencies:
+            return float('nan')
+        return latencies[min(len(latencies) - 1,
+                             int(fraction * len(latencies)))]
+
+    print("%d clients: %.1f reports/s, latency ms p50 %.3f p90 %.3f "
+          "p99 %.3f, downstream CPU %.1f us per report" %
+          (options.clients, count / options.duration,
+           1000 * percentile(0.5), 1000 * percentile(0.9),
+           1000 * percentile(0.99),
+           1e6 * cpu * options.clients / count if count else float('nan')))
+    for sock in clients + [reference]:
+        sock.close()
+
+
+def main():
+    "Start the two tiers and measure them."
+    parser = argparse.ArgumentParser(
+        description="Measure a two tier gpsd chain on this host.")
+    parser.add_argument('--gpsd', default='gpsd',
+                        help="gpsd binary to run [default %(default)s]")
+    parser.add_argument('-l', '--log',
+                        default=os.path.join(os.path.dirname(__file__),
+                                             '..', 'test', 'daemon',
+                                             'neo-m8n.log'),
+                        help="textual log to feed upstream "
+                             "[default %(default)s]")
+    parser.add_argument('-r', '--rate', type=float, default=100.0,
+                        help="sentences per second [default %(default)s]")
+    parser.add_argument('-n', '--clients', type=int, default=10,
+                        help="downstream clients [default %(default)s]")
+    parser.add_argument('-d', '--duration', type=float, default=10.0,
+                        help="seconds to measure [default %(default)s]")
+    parser.add_argument('--port', type=int, default=3980,
+                        help="upstream gpsd port, downstream is the next "
+                             "[default %(default)s]")
+    parser.add_argument('--udp-port', type=int, default=5590,
+                        help="UDP port of the feed [default %(default)s]")
+    options = parser.parse_args()
+
+    upstream = subprocess.Popen([options.gpsd, '-N', '-n',
+                                 '-S', str(options.port),
+                                 'udp://127.0.0.1:%d' % options.udp_port])
+    time.sleep(1.0)
+    downstream = subprocess.Popen([options.gpsd, '-N', '-n',
+                                   '-S', str(options.port + 1),
+                                   'gpsd://127.0.0.1:%d' % options.port])
+    stop = threading.Event()
+    feeder = threading.Thread(target=feed,
+                              args=(sentences(options.log),
+                                    options.udp_port, options.rate, stop))
+    try:
+        time.sleep(1.0)
+        for daemon in (upstream, downstream):
+            if daemon.poll() is not None:
+                sys.stderr.write("relay_bench: gpsd exited with %d\n" %
+                                 daemon.returncode)
+                sys.exit(1)
+        feeder.start()
+        run(options, downstream.pid)
+    finally:
+        stop.set()
+        if feeder.is_alive():
+            feeder.join()
+        for daemon in (downstream, upstream):
+            daemon.terminate()
+            daemon.wait()
+
+
+if __name__ == '__main__':
+    main()
+
+# vim: set expandtab shiftwidth=4
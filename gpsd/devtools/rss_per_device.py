@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+# This file is Copyright 2010 by the GPSD project
+# SPDX-License-Identifier: BSD-2-clause
+#
+# This code runs under Python 3.  It is a developer tool, not shipped.
+#
+"""rss_per_device.py -- measure gpsd's resident memory per device.
+
+For each device count, start a gpsd with that many udp:// devices, feed
+every one of them the sentences of a textual test log, and then read
+the daemon's VmRSS and RssAnon from /proc.  RssAnon leaves out the
+shared libraries, so its growth from one count to the next is the cost
+of a device.  Run it against two builds to compare them:
+
+    devtools/rss_per_device.py --gpsd ./gpsd/gpsd -n 1,2,4,6
+    devtools/rss_per_device.py --gpsd /tmp/old/gpsd -n 1,2,4,6
+
+The daemon must be built with max_devices at least as large as the
+largest count.
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import socket
+import subprocess
+import sys
+import time
+
+
+def rss(pid):
+    "Return (VmRSS, RssAnon) of pid, in kB."
+    values = {}
+    with open('/proc/%d/status' % pid) as f:
+        for line in f:
+            name, _, value = line.partition(':')
+            if name in ('VmRSS', 'RssAnon'):
+                values[name] = int(value.split()[0])
+    return values.get('VmRSS', 0), values.get('RssAnon', 0)
+
+
+def sentences(logfile):
+    "Return the NMEA and AIVDM sentences of logfile."
+    with open(logfile, 'rb') as f:
+        return [line.rstrip() + b'\r\n' for line in f
+                if line[:1] in (b'$', b'!')]
+
+
+def measure(options, count, lines):
+    "Run a gpsd with count devices, return its (VmRSS, RssAnon)."
+    ports = [options.udp_port + i for i in range(count)]
+    gpsd = subprocess.Popen([options.gpsd, '-N', '-n',
+                             '-S', str(options.port)] +
+                            ['udp://127.0.0.1:%d' % p for p in ports])
+    try:
+        time.sleep(options.settle)
+        if gpsd.poll() is not None:
+            sys.stderr.write("rss_per_device: gpsd exited with %d\n" %
+                             gpsd.returncode)
+            sys.exit(1)
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        for port in ports:
+            for line in lines:
+                sock.sendto(line, ('127.0.0.1', port))
+                # let gpsd keep up, a dropped datagram is a lost sentence
+                time.sleep(0.0002)
+        sock.close()
+        time.sleep(options.settle)
+        return rss(gpsd.pid)
+    finally:
+        gpsd.terminate()
+        gpsd.wait()
+
+
+def main():
+    "Measure each device count, then the cost per device."
+    parser = argparse.ArgumentParser(
+        description="Measure gpsd's resident memory per device.")
+    parser.add_argument('--gpsd', default='gpsd',
+                        help="gpsd binary to run [default %(default)s]")
+    parser.add_argument('-n', '--counts', default='1,2,4',
+                        help="comma separated device counts "
+                             "[default %(default)s]")
+    parser.add_argument('-l', '--log',
+                        default=os.path.join(os.path.dirname(__file__),
+                                             '..', 'test', 'daemon',
+                                             'neo-m8n.log'),
+                        help="textual log to feed each device "
+                             "[default %(default)s]")
+    parser.add_argument('--port', type=int, default=3960,
+                        help="gpsd control port [default %(default)s]")
+    parser.add_argument('--udp-port', type=int, default=5560,
+                        help="first device's UDP port [default %(default)s]")
+    parser.add_argument('--settle', type=float, default=1.0,
+                        help="seconds to let gpsd settle [%(default)s]")
+    options = parser.parse_args()
+
+    counts = sorted(int(n) for n in options.counts.split(','))
+    if not counts or counts[0] < 1:
+        sys.stderr.write("rss_per_device: gpsd needs at least one device\n")
+        sys.exit(1)
+    lines = sentences(options.log)
+
+    results = []
+    print("devices  VmRSS kB  RssAnon kB")
+    for count in counts:
+        vmrss, anon = measure(options, count, lines)
+        results.append((count, anon))
+        print("%7d  %8d  %10d" % (count, vmrss, anon))
+    if 1 < len(results):
+        (first, lo), (last, hi) = results[0], results[-1]
+        print("%.1f kB RssAnon per device" % ((hi - lo) / (last - first)))
+
+
+if __name__ == '__main__':
+    main()
+
+# vim: set expandtab shiftwidth=4
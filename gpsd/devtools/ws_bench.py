@@ -0,0 +1,299 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+# This file is Copyright 2010 by the GPSD project
+# SPDX-License-Identifier: BSD-2-clause
+#
+# This code runs under Python 3.  It is a developer tool, not shipped.
+#
+"""ws_bench.py -- compare gpsd's WebSocket port with a Python proxy.
+
+Browser dashboards used to reach gpsd through a proxy that WATCHes the
+daemon over TCP and re-serializes each JSON report to its WebSocket
+clients.  This opens the same number of WebSocket clients two ways:
+straight to gpsd's own WebSocket port (gpsd -W), and through such a
+proxy, which is started as a separate process.  A plain TCP watcher
+serves as the reference clock: latency is how much later than it a
+WebSocket client saw the same report.
+
+Feed gpsd fast enough to matter, e.g.:
+
+    gpsd -N -n -W 2948 udp://127.0.0.1:5555 &
+    (or gpsfake -q -c 0.01 test/daemon/ublox-neo-m8t.log, adding -W
+     to gpsd's options with gpsfake -o)
+    devtools/ws_bench.py -n 20 -d 10 --ws-port 2948
+"""
+
+from __future__ import print_function
+
+import argparse
+import base64
+import hashlib
+import json
+import os
+import selectors
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+WATCH = b'?WATCH={"enable":true,"json":true};'
+MATCH_WINDOW = 1.0          # seconds
+
+
+def ws_connect(host, port):
+    "Open a WebSocket connection, return the socket and any extra bytes."
+    sock = socket.create_connection((host, port))
+    key = base64.b64encode(os.urandom(16)).decode('ascii')
+    sock.sendall(('GET / HTTP/1.1\r\n'
+                  'Host: %s:%d\r\n'
+                  'Upgrade: websocket\r\n'
+                  'Connection: Upgrade\r\n'
+                  'Sec-WebSocket-Key: %s\r\n'
+                  'Sec-WebSocket-Version: 13\r\n\r\n' %
+                  (host, port, key)).encode('ascii'))
+    buf = b''
+    while b'\r\n\r\n' not in buf:
+        data = sock.recv(4096)
+        if not data:
+            raise IOError("connection closed during handshake")
+        buf += data
+    head, rest = buf.split(b'\r\n\r\n', 1)
+    if not head.startswith(b'HTTP/1.1 101'):
+        raise IOError("upgrade refused: %r" % head.split(b'\r\n')[0])
+    return sock, rest
+
+
+def ws_frame(payload, opcode=1, mask=True):
+    "Frame payload, masked as a client must."
+    head = bytearray([0x80 | opcode])
+    maskbit = 0x80 if mask else 0
+    if len(payload) < 126:
+        head.append(maskbit | len(payload))
+    elif len(payload) < 65536:
+        head.append(maskbit | 126)
+        head += struct.pack('>H', len(payload))
+    else:
+        head.append(maskbit | 127)
+        head += struct.pack('>Q', len(payload))
+    if not mask:
+        return bytes(head) + payload
+    key = os.urandom(4)
+    return (bytes(head) + key +
+            bytes(b ^ key[i % 4] for i, b in enumerate(payload)))
+
+
+def ws_unframe(buf):
+    "Split one unmasked server frame off buf: (opcode, payload, rest)."
+    if len(buf) < 2:
+        return None
+    opcode = buf[0] & 0x0f
+    length = buf[1] & 0x7f
+    offset = 2
+    if length == 126:
+        if len(buf) < 4:
+            return None
+        length = struct.unpack('>H', buf[2:4])[0]
+        offset = 4
+    elif length == 127:
+        if len(buf) < 10:
+            return None
+        length = struct.unpack('>Q', buf[2:10])[0]
+        offset = 10
+    if len(buf) < offset + length:
+        return None
+    return opcode, buf[offset:offset + length], buf[offset + length:]
+
+
+def canonical(text):
+    "The same report reads the same however it was serialized."
+    try:
+        return json.dumps(json.loads(text), sort_keys=True)
+    except ValueError:
+        return None
+
+
+def serve_proxy(port, host, gpsd_port):
+    """The proxy path: one gpsd TCP connection per WebSocket client,
+    every report parsed and re-serialized before it is framed."""
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(('127.0.0.1', port))
+    listener.listen(64)
+    sel = selectors.DefaultSelector()
+    sel.register(listener, selectors.EVENT_READ, None)
+    peers = {}
+    while True:
+        for key, _ in sel.select():
+            if key.data is None:
+                client, _ = listener.accept()
+                buf = b''
+                while b'\r\n\r\n' not in buf:
+                    buf += client.recv(4096)
+                wskey = [line.split(b':', 1)[1].strip()
+                         for line in buf.split(b'\r\n')
+                         if line.lower().startswith(b'sec-websocket-key:')]
+                accept = base64.b64encode(hashlib.sha1(
+                    wskey[0] + b'258EAFA5-E914-47DA-95CA-C5AB0DC85B11')
+                    .digest())
+                client.sendall(b'HTTP/1.1 101 Switching Protocols\r\n'
+                               b'Upgrade: websocket\r\n'
+                               b'Connection: Upgrade\r\n'
+                               b'Sec-WebSocket-Accept: ' + accept +
+                               b'\r\n\r\n')
+                upstream = socket.create_connection((host, gpsd_port))
+                upstream.sendall(WATCH)
+                peers[upstream] = [client, b'']
+                sel.register(upstream, selectors.EVENT_READ, 'gpsd')
+                sel.register(client, selectors.EVENT_READ, upstream)
+            elif key.data == 'gpsd':
+                upstream = key.fileobj
+                data = upstream.recv(65536)
+                if not data:
+                    sys.exit(0)
+                peer = peers[upstream]
+                peer[1] += data
+                while b'\n' in peer[1]:
+                    line, peer[1] = peer[1].split(b'\n', 1)
+                    try:
+                        report = json.loads(line)
+                    except ValueError:
+                        continue
+                    peer[0].sendall(ws_frame(json.dumps(report).encode(),
+                                             mask=False))
+            else:
+                # dashboards only send their WATCH, already sent upstream
+                try:
+                    if not key.fileobj.recv(4096):
+                        sys.exit(0)
+                except socket.error:
+                    sys.exit(0)
+
+
+class Client(object):
+    "One WebSocket dashboard."
+
+    def __init__(self, sock, rest):
+        self.sock = sock
+        self.buf = rest
+
+
+def run(reference, duration, sel):
+    "Collect reports for duration seconds, return (count, latencies)."
+    seen = {}               # canonical report -> reference arrival
+    latencies = []
+    pending = {}            # reports a client saw before the reference
+    count = 0
+    end = time.time() + duration
+    refbuf = b''
+    while time.time() < end:
+        for key, _ in sel.select(0.1):
+            now = time.time()
+            if key.data is None:
+                data = reference.recv(65536)
+                refbuf += data
+                while b'\n' in refbuf:
+                    line, refbuf = refbuf.split(b'\n', 1)
+                    report = canonical(line)
+                    if report is None:
+                        continue
+                    seen[report] = now
+                    for early in pending.pop(report, []):
+                        latencies.append(early - now)
+                continue
+            client = key.data
+            client.buf += client.sock.recv(65536)
+            while True:
+                frame = ws_unframe(client.buf)
+                if frame is None:
+                    break
+                opcode, payload, client.buf = frame
+                if opcode != 1:
+                    continue
+                report = canonical(payload)
+                if report is None or b'"class":"VERSION"' in payload:
+                    continue
+                count += 1
+                # a looping log repeats reports, so only match recent ones
+                if report in seen and now - seen[report] < MATCH_WINDOW:
+                    latencies.append(now - seen[report])
+                else:
+                    pending.setdefault(report, []).append(now)
+    latencies.sort()
+    return count, latencies
+
+
+def percentile(values, fraction):
+    "Return the given fraction percentile of sorted values."
+    if not values:
+        return float('nan')
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def bench(label, host, port, options):
+    "Open the clients on port and measure them against a TCP watcher."
+    sel = selectors.DefaultSelector()
+    reference = socket.create_connection((host, options.port))
+    reference.sendall(WATCH)
+    clients = []
+    for _ in range(options.clients):
+        sock, rest = ws_connect(host, port)
+        sock.sendall(ws_frame(WATCH))
+        client = Client(sock, rest)
+        clients.append(client)
+        sel.register(sock, selectors.EVENT_READ, client)
+    sel.register(reference, selectors.EVENT_READ, None)
+    time.sleep(0.5)
+    count, latencies = run(reference, options.duration, sel)
+    print("%-7s %d clients: %.1f messages/s, latency ms p50 %.3f "
+          "p90 %.3f p99 %.3f" %
+          (label, options.clients, count / options.duration,
+           1000 * percentile(latencies, 0.5),
+           1000 * percentile(latencies, 0.9),
+           1000 * percentile(latencies, 0.99)))
+    for client in clients:
+        client.sock.close()
+    reference.close()
+
+
+def main():
+    "Run the comparison."
+    parser = argparse.ArgumentParser(
+        description="Compare gpsd's WebSocket port with a Python proxy.")
+    parser.add_argument('--host', default='127.0.0.1',
+                        help="gpsd host [default %(default)s]")
+    parser.add_argument('--port', type=int, default=2947,
+                        help="gpsd TCP port [default %(default)s]")
+    parser.add_argument('--ws-port', type=int, default=2948,
+                        help="gpsd WebSocket port [default %(default)s]")
+    parser.add_argument('--proxy-port', type=int, default=2949,
+                        help="port for the proxy [default %(default)s]")
+    parser.add_argument('-n', '--clients', type=int, default=10,
+                        help="WebSocket clients per path [%(default)s]")
+    parser.add_argument('-d', '--duration', type=float, default=10.0,
+                        help="seconds to measure each path [%(default)s]")
+    parser.add_argument('--serve-proxy', action='store_true',
+                        help=argparse.SUPPRESS)
+    options = parser.parse_args()
+
+    if options.serve_proxy:
+        serve_proxy(options.proxy_port, options.host, options.port)
+        return
+
+    bench('direct', options.host, options.ws_port, options)
+
+    proxy = subprocess.Popen([sys.executable, __file__, '--serve-proxy',
+                              '--host', options.host,
+                              '--port', str(options.port),
+                              '--proxy-port', str(options.proxy_port)])
+    try:
+        time.sleep(0.5)
+        bench('proxy', '127.0.0.1', options.proxy_port, options)
+    finally:
+        proxy.terminate()
+
+
+if __name__ == '__main__':
+    main()
+
+# vim: set expandtab shiftwidth=4
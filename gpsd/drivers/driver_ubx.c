@@ -482,6 +482,9 @@ ubx_msg_esf_meas(struct gps_device_t *session, unsigned char *buf,
                  "UBX-ESF-MEAS: dataType %2u dataField %9ld\n",
                  dataType, dataF);
     }
+    if (0 != (mask & IMU_SET)) {
+        gpsd_imu_push(session, datap);
+    }
 
     return mask;
 }
@@ -504,6 +507,7 @@ ubx_msg_esf_raw(struct gps_device_t *session, unsigned char *buf,
     uint16_t blocks;
     gps_mask_t mask = 0;
     struct attitude_t *datap = NULL;
+    struct attitude_t past;     // samples past imu[], for the IMU ring
     int max_imu, cur_imu = -1;
     max_imu = sizeof(session->gpsdata.imu) / sizeof(struct attitude_t);
 
@@ -525,7 +529,9 @@ ubx_msg_esf_raw(struct gps_device_t *session, unsigned char *buf,
              "UBX-ESF-RAW: reserved1 x%lx, blocks %u\n",
              reserved1, blocks);
 
-    // loop over all blocks, use the next imu[] when time changes.
+    /* loop over all blocks, use the next imu[] when time changes.
+     * Each sample goes in the IMU ring as it is done, those past
+     * imu[] only there. */
     for (i = 0; i < blocks; i++) {
         unsigned long data, dataField, sTtag;
         long dataF;
@@ -534,15 +540,22 @@ ubx_msg_esf_raw(struct gps_device_t *session, unsigned char *buf,
         sTtag = getleu32(buf, 8 + (i * 8));
         if ((-1 == cur_imu) ||
             (last_sTtag != sTtag)) {
-            cur_imu++;
-            if (max_imu <= cur_imu) {
-                GPSD_LOG(LOG_WARN, &session->context->errout,
-                         "UBX-ESF-RAW message, too many imu max %d block %u\n",
-                         max_imu, i);
-                break;
+            if (NULL != datap) {
+                gpsd_imu_push(session, datap);
             }
+            cur_imu++;
             last_sTtag = sTtag;
-            datap = &session->gpsdata.imu[cur_imu];
+            if (max_imu > cur_imu) {
+                datap = &session->gpsdata.imu[cur_imu];
+            } else {
+                if (max_imu == cur_imu) {
+                    GPSD_LOG(LOG_PROG, &session->context->errout,
+                             "UBX-ESF-RAW message, over %d imu, "
+                             "the rest batched only, block %u\n",
+                             max_imu, i);
+                }
+                datap = &past;
+            }
             // do not acumulate IMU data
             gps_clear_att(datap);
             (void)strlcpy(datap->msg, "UBX-ESF-RAW", sizeof(datap->msg));
@@ -608,6 +621,9 @@ ubx_msg_esf_raw(struct gps_device_t *session, unsigned char *buf,
                  "UBX-ESF-RAW: dataType %2u dataField %9ld sTtag %lu\n",
                  dataType, dataF, datap->timeTag);
     }
+    if (NULL != datap) {
+        gpsd_imu_push(session, datap);
+    }
     return mask;
 }
 
@@ -932,6 +948,8 @@ ubx_msg_hnr_pvt(struct gps_device_t *session, unsigned char *buf,
     // 4 final bytes reserved
 
     mask |= HERR_SET | SPEEDERR_SET | VERR_SET;
+    // a whole fix, so a fast PVT watcher need not wait for the cycle
+    mask |= PVT_IS;
     // HNR-PVT interleaves with the normal cycle, so cycle end is a mess
     mask |= REPORT_IS;
 
@@ -1784,6 +1802,8 @@ ubx_msg_nav_pvt(struct gps_device_t *session, unsigned char *buf,
     /* let gpsd_error_model() do the rest */
 
     mask |= HERR_SET | SPEEDERR_SET | VERR_SET;
+    // a whole fix, so a fast PVT watcher need not wait for the cycle
+    mask |= PVT_IS;
     // if cycle ender worked, could get rid of this REPORT_IS.
     // mask |= REPORT_IS;
 
@@ -5,7 +5,6 @@
 
 #include "../include/gpsd_config.h"  /* must be before all includes */
 
-#include <assert.h>
 #include <ctype.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -21,6 +20,10 @@
 
 ssize_t generic_get(struct gps_device_t *session)
 {
+    if (SOURCE_GPSD == session->sourcetype) {
+        // another gpsd, it only ever sends whole lines
+        return packet_get_json(session->gpsdata.gps_fd, &session->lexer);
+    }
     return packet_get(session->gpsdata.gps_fd, &session->lexer);
 }
 
@@ -1296,36 +1299,100 @@ const struct gps_type_t driver_isync = {
  *
  **************************************************************************/
 
+/*
+ * Six-bit value of each armoring character, shades of FIELDATA.
+ * Characters outside the legal armor ranges are mapped the same way
+ * the old bit-at-a-time decoder mapped them: subtract 48, subtract
+ * 8 more past 'W', keep the low six bits.
+ */
+#define ARMOR1(c)  (unsigned char)((((unsigned char)((c) - 48) >= 40) ? \
+                                   (c) - 56 : (c) - 48) & 0x3f)
+#define ARMOR4(c)  ARMOR1(c), ARMOR1(c + 1), ARMOR1(c + 2), ARMOR1(c + 3)
+#define ARMOR16(c) ARMOR4(c), ARMOR4(c + 4), ARMOR4(c + 8), ARMOR4(c + 12)
+#define ARMOR64(c) ARMOR16(c), ARMOR16(c + 16), ARMOR16(c + 32), \
+                   ARMOR16(c + 48)
+static const unsigned char sixbit_armor[256] = {
+    ARMOR64(0), ARMOR64(64), ARMOR64(128), ARMOR64(192),
+};
+#undef ARMOR64
+#undef ARMOR16
+#undef ARMOR4
+#undef ARMOR1
+
+/* aivdm_dearmor()
+ *
+ * Append len armored characters from data to the bit vector bits,
+ * starting at bit offset *bitlen, and advance *bitlen past them.
+ * Four characters are converted into three bytes at a time, whatever
+ * the starting bit offset.  Bits of bits[] at or past *bitlen are
+ * assumed clear on entry and are left clear on return.
+ *
+ * Return: false, with nothing appended, if the result would not fit
+ *         in maxbits.
+ */
+bool aivdm_dearmor(unsigned char *bits, size_t *bitlen, size_t maxbits,
+                   const unsigned char *data, size_t len)
+{
+    unsigned char *out;
+    unsigned int nacc;          // bits pending in acc, always < 8 here
+    uint32_t acc;
+    size_t i;
+
+    if (maxbits < *bitlen || (maxbits - *bitlen) / 6 < len) {
+        return false;
+    }
+    if (0 == len) {
+        return true;
+    }
+
+    out = bits + *bitlen / 8;
+    nacc = (unsigned int)(*bitlen % 8);
+    // pick up the bits already in a partially filled byte
+    acc = (uint32_t)(*out >> (8 - nacc));
+
+    // 24 bits in, 3 bytes out, so nacc is unchanged by each pass
+    for (i = 0; i + 4 <= len; i += 4) {
+        acc = (acc << 24) |
+              ((uint32_t)sixbit_armor[data[i]] << 18) |
+              ((uint32_t)sixbit_armor[data[i + 1]] << 12) |
+              ((uint32_t)sixbit_armor[data[i + 2]] << 6) |
+              (uint32_t)sixbit_armor[data[i + 3]];
+        out[0] = (unsigned char)(acc >> (nacc + 16));
+        out[1] = (unsigned char)(acc >> (nacc + 8));
+        out[2] = (unsigned char)(acc >> nacc);
+        out += 3;
+        acc &= (1U << nacc) - 1;
+    }
+    // up to three leftover characters
+    for (; i < len; i++) {
+        acc = (acc << 6) | sixbit_armor[data[i]];
+        nacc += 6;
+        if (8 <= nacc) {
+            nacc -= 8;
+            *out++ = (unsigned char)(acc >> nacc);
+            acc &= (1U << nacc) - 1;
+        }
+    }
+    if (0 < nacc) {
+        *out = (unsigned char)(acc << (8 - nacc));
+    }
+    *bitlen += 6 * len;
+    return true;
+}
+
 static bool aivdm_decode(const char *buf, size_t buflen,
                   struct gps_device_t *session,
                   struct ais_t *ais,
                   int debug)
 {
-#ifdef __UNUSED_DEBUG__
-    char *sixbits[64] = {
-        "000000", "000001", "000010", "000011", "000100",
-        "000101", "000110", "000111", "001000", "001001",
-        "001010", "001011", "001100", "001101", "001110",
-        "001111", "010000", "010001", "010010", "010011",
-        "010100", "010101", "010110", "010111", "011000",
-        "011001", "011010", "011011", "011100", "011101",
-        "011110", "011111", "100000", "100001", "100010",
-        "100011", "100100", "100101", "100110", "100111",
-        "101000", "101001", "101010", "101011", "101100",
-        "101101", "101110", "101111", "110000", "110001",
-        "110010", "110011", "110100", "110101", "110110",
-        "110111", "111000", "111001", "111010", "111011",
-        "111100", "111101", "111110", "111111",
-    };
-#endif /* __UNUSED_DEBUG__ */
     int nfrags, ifrag, nfields = 0;
     unsigned char *field[NMEA_MAX*2];
     unsigned char fieldcopy[NMEA_MAX*2+1];
     unsigned char *data, *cp;
     char const *cp1;
+    size_t datalen;
     int pad;
     struct aivdm_context_t *ais_context;
-    int i;
 
     if (buflen == 0)
         return false;
@@ -1444,35 +1511,28 @@ static bool aivdm_decode(const char *buf, size_t buflen,
         ais_context->decoded_frags = 0;
     }
     if (ifrag == 1) {
-        (void)memset(ais_context->bits, '\0', sizeof(ais_context->bits));
+        /* everything past bitlen is already clear, so only the bytes
+         * the previous message occupied need wiping */
+        (void)memset(ais_context->bits, '\0',
+                     BITS_TO_BYTES(ais_context->bitlen));
         ais_context->bitlen = 0;
     }
 
-    /* wacky 6-bit encoding, shades of FIELDATA */
-    for (cp = data; cp < data + strlen((char *)data); cp++) {
-        unsigned char ch;
-        ch = *cp;
-        ch -= 48;
-        if (ch >= 40)
-            ch -= 8;
-#ifdef __UNUSED_DEBUG__
-        GPSD_LOG(LOG_RAW, &session->context->errout,
-                 "%c: %s\n", *cp, sixbits[ch]);
-#endif /* __UNUSED_DEBUG__ */
-        for (i = 5; i >= 0; i--) {
-            if ((ch >> i) & 0x01) {
-                ais_context->bits[ais_context->bitlen / 8] |=
-                    (1 << (7 - ais_context->bitlen % 8));
-            }
-            ais_context->bitlen++;
-            if (ais_context->bitlen > sizeof(ais_context->bits)) {
-                GPSD_LOG(LOG_INF, &session->context->errout,
-                         "overlong AIVDM payload truncated.\n");
-                return false;
-            }
-        }
+    datalen = strlen((char *)data);
+    if (!aivdm_dearmor(ais_context->bits, &ais_context->bitlen,
+                       sizeof(ais_context->bits) * CHAR_BIT,
+                       data, datalen)) {
+        GPSD_LOG(LOG_INF, &session->context->errout,
+                 "overlong AIVDM payload truncated.\n");
+        return false;
+    }
+    /* drop the pad bits, keeping everything past bitlen clear */
+    while (0 < pad && 0 < ais_context->bitlen) {
+        ais_context->bitlen--;
+        ais_context->bits[ais_context->bitlen / 8] &=
+            ~(1 << (7 - ais_context->bitlen % 8));
+        pad--;
     }
-    ais_context->bitlen -= pad;
 
     /* time to pass buffered-up data to where it's actually processed? */
     if (ifrag == nfrags) {
@@ -1548,81 +1608,89 @@ const struct gps_type_t driver_aivdm = {
  *
  **************************************************************************/
 
-/* prepend the session path to the value of a specified attribute */
-static void path_rewrite(struct gps_device_t *session, char *prefix)
+/* prepend the session path, and a #, to each value of attribute key
+ * in the len bytes at buf; buf has room for size bytes
+ *
+ * Return: the new length
+ */
+static size_t path_rewrite(struct gps_device_t *session, char *buf,
+                           size_t len, size_t size, const char *key)
 {
     /*
      * Hack the packet to reflect its origin.  This code is supposed
      * to insert the path naming the remote gpsd instance into the
      * beginning of the path attribute, followed by a # to separate it
-     * from the device.
+     * from the device.  Each value is moved along once, in place.
      */
-    char *prefloc;
-
-    assert(prefix != NULL && session->lexer.outbuffer != NULL);
-
-    /* possibly the rewrite has been done already, this comw up in gpsmon */
-    if (strstr((char *)session->lexer.outbuffer,
-               session->gpsdata.dev.path) != NULL)
-        return;
-
-    for (prefloc = (char *)session->lexer.outbuffer;
-         prefloc < (char *)session->lexer.outbuffer+session->lexer.outbuflen;
-         prefloc++)
-        if (str_starts_with(prefloc, prefix)) {
-            char *sfxloc;
-            char copy[sizeof(session->lexer.outbuffer)+1];
-            (void)strlcpy(copy,
-                          (char *)session->lexer.outbuffer,
-                          sizeof(copy));
-            prefloc += strlen(prefix);
-            (void)strlcpy(prefloc,
-                          session->gpsdata.dev.path,
-                          sizeof(session->gpsdata.dev.path));
-            if ((sfxloc = strchr(prefloc, '#')))
-                *sfxloc = '\0';  /* Avoid accumulating multiple device names */
-            (void)strlcat((char *)session->lexer.outbuffer, "#",
-                          sizeof(session->lexer.outbuffer));
-            (void)strlcat((char *)session->lexer.outbuffer,
-                          copy + (prefloc-(char *)session->lexer.outbuffer),
-                          sizeof(session->lexer.outbuffer));
+    const char *path = session->gpsdata.dev.path;
+    size_t pathlen = strcspn(path, "#");  // no multiple device names
+    size_t keylen = strlen(key);
+    char *p = buf;
+
+    while (NULL != (p = strstr(p, key))) {
+        p += keylen;
+        if (len + pathlen + 1 >= size) {
+            GPSD_LOG(LOG_WARN, &session->context->errout,
+                     "JSON: no room to rewrite %s\n", key);
+            break;
         }
-    session->lexer.outbuflen = strlen((char *)session->lexer.outbuffer);
+        (void)memmove(p + pathlen + 1, p, len - (p - buf) + 1);
+        (void)memcpy(p, path, pathlen);
+        p[pathlen] = '#';
+        len += pathlen + 1;
+        p += pathlen + 1;
+    }
+    return len;
 }
 
 static gps_mask_t json_pass_packet(struct gps_device_t *session)
 {
+    char *buf = (char *)session->lexer.outbuffer;
+    size_t size = sizeof(session->lexer.outbuffer);
+    size_t len = session->lexer.outbuflen;
+
+    // a relayed line keeps its CR-LF, a lexed object has none
+    while (0 < len &&
+           ('\r' == buf[len - 1] || '\n' == buf[len - 1])) {
+        len--;
+    }
+    buf[len] = '\0';
     GPSD_LOG(LOG_IO, &session->context->errout,
-             "<= GPS: %s\n", (char *)session->lexer.outbuffer);
-
-    if (strstr(session->gpsdata.dev.path, ":/") != NULL &&
-        strstr(session->gpsdata.dev.path, "localhost") == NULL)
-    {
-        /* devices and paths need to be edited */
-        if (strstr((char *)session->lexer.outbuffer, "DEVICE") != NULL)
-            path_rewrite(session, "\"path\":\"");
-        path_rewrite(session, "\"device\":\"");
-
-        /* mark certain responses without a path or device attribute */
-        if (session->gpsdata.dev.path[0] != '\0') {
-            if (strstr((char *)session->lexer.outbuffer, "VERSION") != NULL
-                || strstr((char *)session->lexer.outbuffer, "WATCH") != NULL
-                || strstr((char *)session->lexer.outbuffer, "DEVICES") != NULL) {
-                session->lexer.outbuffer[session->lexer.outbuflen-1] = '\0';
-                (void)strlcat((char *)session->lexer.outbuffer, ",\"remote\":\"",
-                              sizeof(session->lexer.outbuffer));
-                (void)strlcat((char *)session->lexer.outbuffer,
-                              session->gpsdata.dev.path,
-                              sizeof(session->lexer.outbuffer));
-                (void)strlcat((char *)session->lexer.outbuffer, "\"}",
-                              sizeof(session->lexer.outbuffer));
-            }
-            session->lexer.outbuflen = strlen((char *)session->lexer.outbuffer);
+             "<= GPS: %s\n", buf);
+
+    /* Devices and paths need to be edited only when the remote device
+     * is named, and it is not this host's.  Possibly the rewrite has
+     * been done already, this comes up in gpsmon. */
+    if (NULL != strstr(session->gpsdata.dev.path, ":/") &&
+        NULL == strstr(session->gpsdata.dev.path, "localhost") &&
+        NULL == strstr(buf, session->gpsdata.dev.path)) {
+        if (str_starts_with(buf, "{\"class\":\"DEVICE")) {
+            len = path_rewrite(session, buf, len, size, "\"path\":\"");
+        }
+        len = path_rewrite(session, buf, len, size, "\"device\":\"");
+
+        // mark certain responses without a path or device attribute
+        if ((str_starts_with(buf, "{\"class\":\"VERSION\"") ||
+             str_starts_with(buf, "{\"class\":\"WATCH\"") ||
+             str_starts_with(buf, "{\"class\":\"DEVICES\"")) &&
+            '}' == buf[len - 1]) {
+            buf[--len] = '\0';
+            (void)strlcat(buf, ",\"remote\":\"", size);
+            (void)strlcat(buf, session->gpsdata.dev.path, size);
+            (void)strlcat(buf, "\"}", size);
+            len = strnlen(buf, size);
         }
     }
     GPSD_LOG(LOG_PROG, &session->context->errout,
-             "JSON, passing through %s\n",
-             (char *)session->lexer.outbuffer);
+             "JSON, passing through %s\n", buf);
+
+    // ready to go out to each client just as it is
+    if (len + 2 < size) {
+        buf[len++] = '\r';
+        buf[len++] = '\n';
+        buf[len] = '\0';
+    }
+    session->lexer.outbuflen = len;
     return PASSTHROUGH_IS;
 }
 
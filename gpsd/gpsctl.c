@@ -747,7 +747,7 @@ int main(int argc, char **argv)
             for (hunting = true; hunting; ) {
                 fd_set efds;
                 timespec_t ts_timeout = {2, 0};   // timeout for pselect()
-                switch(gpsd_await_data(&rfds, &efds, maxfd, &all_fds,
+                switch(gpsd_await_data(&rfds, NULL, &efds, maxfd, &all_fds,
                                        &context.errout, ts_timeout)) {
                 case AWAIT_GOT_INPUT:
                     FALLTHROUGH
@@ -0,0 +1,266 @@
+/*
+ * Per-watcher AIS filters.
+ *
+ * A ?WATCH may ask for only the AIS reports inside a box or polygon,
+ * from or not from some MMSIs, or of some message types.  The daemon
+ * compiles those once, at WATCH time, and tests each report before it
+ * is dumped, so a report a watcher filters out costs it a few lookups
+ * and no JSON.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/gpsd.h"
+
+// does a watcher's policy ask for any AIS filter?
+bool gpsd_ais_filtering(const struct gps_policy_t *policy)
+{
+    return 4 == policy->ais_nbox ||
+           6 <= policy->ais_npoly ||
+           0 < policy->ais_nmmsi ||
+           0 < policy->ais_nexclude ||
+           0 < policy->ais_ntypes;
+}
+
+// is lat, lon a position on the earth?
+static bool latlon_ok(double lat, double lon)
+{
+    return 90.0 >= fabs(lat) && 180.0 >= fabs(lon);
+}
+
+/* Are a watcher's AIS areas well formed?  A box or polygon that is not
+ * would otherwise filter nothing, so the ?WATCH is refused instead.
+ *
+ * Return: NULL if they are
+ *         else what is wrong with them
+ */
+const char *gpsd_ais_filter_check(const struct gps_policy_t *policy)
+{
+    int i;
+
+    if (0 != policy->ais_nbox) {
+        if (4 != policy->ais_nbox) {
+            return "aisbox needs 4 numbers";
+        }
+        if (!latlon_ok(policy->ais_box[0], policy->ais_box[1]) ||
+            !latlon_ok(policy->ais_box[2], policy->ais_box[3]) ||
+            policy->ais_box[0] > policy->ais_box[2]) {
+            return "aisbox is not south, west, north, east";
+        }
+    }
+    if (0 != policy->ais_npoly) {
+        if (6 > policy->ais_npoly ||
+            0 != policy->ais_npoly % 2) {
+            return "aispoly needs 3 or more latitude, longitude pairs";
+        }
+        for (i = 0; i < policy->ais_npoly; i += 2) {
+            if (!latlon_ok(policy->ais_poly[i], policy->ais_poly[i + 1])) {
+                return "aispoly has a vertex off the earth";
+            }
+        }
+    }
+    return NULL;
+}
+
+// where an MMSI goes in a hashed table of slots, a power of 2
+static unsigned mmsi_slot(unsigned int mmsi, unsigned slots)
+{
+    return (unsigned)((mmsi * 2654435761U) >> 16) & (slots - 1);
+}
+
+static void mmsi_add(unsigned int *table, unsigned slots, unsigned int mmsi)
+{
+    unsigned slot = mmsi_slot(mmsi, slots);
+
+    while (0 != table[slot] &&
+           mmsi != table[slot]) {
+        slot = (slot + 1) & (slots - 1);
+    }
+    table[slot] = mmsi;
+}
+
+static bool mmsi_in(const unsigned int *table, unsigned slots,
+                    unsigned int mmsi)
+{
+    unsigned slot = mmsi_slot(mmsi, slots);
+
+    while (0 != table[slot]) {
+        if (mmsi == table[slot]) {
+            return true;
+        }
+        slot = (slot + 1) & (slots - 1);
+    }
+    return false;
+}
+
+// compile a watcher's AIS filters
+void gpsd_ais_filter_init(struct ais_filter_t *filter,
+                          const struct gps_policy_t *policy)
+{
+    int i;
+
+    (void)memset(filter, 0, sizeof(*filter));
+    for (i = 0; i < policy->ais_ntypes; i++) {
+        if (0 < policy->ais_types[i] &&
+            32 > policy->ais_types[i]) {
+            filter->types |= (uint32_t)1 << policy->ais_types[i];
+        }
+    }
+    if (0 < policy->ais_ntypes &&
+        0 == filter->types) {
+        // no type named is one there is, so none pass
+        filter->types = 1;
+    }
+    // MMSI 0 is no ship, and marks an empty slot
+    for (i = 0; i < policy->ais_nmmsi; i++) {
+        if (0 != policy->ais_mmsi[i]) {
+            mmsi_add(filter->mmsi, AIS_FILTER_SLOTS, policy->ais_mmsi[i]);
+        }
+    }
+    for (i = 0; i < policy->ais_nexclude; i++) {
+        if (0 != policy->ais_exclude[i]) {
+            mmsi_add(filter->exclude, AIS_FILTER_SLOTS,
+                     policy->ais_exclude[i]);
+        }
+    }
+}
+
+/* The position of a report, in degrees, if it has one.  Coordinates
+ * out of range are the "not available" values. */
+static bool ais_position(const struct ais_t *ais, double *lat, double *lon)
+{
+    int ilat, ilon;
+    double div = AIS_LATLON_DIV;
+
+    switch (ais->type) {
+    case 1:
+        FALLTHROUGH
+    case 2:
+        FALLTHROUGH
+    case 3:
+        ilat = ais->type1.lat;
+        ilon = ais->type1.lon;
+        break;
+    case 4:
+        FALLTHROUGH
+    case 11:
+        ilat = ais->type4.lat;
+        ilon = ais->type4.lon;
+        break;
+    case 9:
+        ilat = ais->type9.lat;
+        ilon = ais->type9.lon;
+        break;
+    case 18:
+        ilat = ais->type18.lat;
+        ilon = ais->type18.lon;
+        break;
+    case 19:
+        ilat = ais->type19.lat;
+        ilon = ais->type19.lon;
+        break;
+    case 21:
+        ilat = ais->type21.lat;
+        ilon = ais->type21.lon;
+        break;
+    case 27:
+        ilat = ais->type27.lat;
+        ilon = ais->type27.lon;
+        div = AIS_LONGRANGE_LATLON_DIV;
+        break;
+    default:
+        return false;
+    }
+    *lat = ilat / div;
+    *lon = ilon / div;
+    return latlon_ok(*lat, *lon);
+}
+
+/* Is a position in a watcher's area?  The box may cross the
+ * antimeridian, west then being east of east; the polygon may not. */
+static bool in_area(const struct gps_policy_t *policy, double lat, double lon)
+{
+    int i, j, nvert = policy->ais_npoly / 2;
+    bool inside = false;
+
+    if (4 == policy->ais_nbox) {
+        double south = policy->ais_box[0], west = policy->ais_box[1];
+        double north = policy->ais_box[2], east = policy->ais_box[3];
+
+        if (lat < south || lat > north) {
+            return false;
+        }
+        if (west <= east ? (lon < west || lon > east)
+                         : (lon < west && lon > east)) {
+            return false;
+        }
+    }
+    if (3 > nvert) {
+        return true;
+    }
+    // count the edges a ray east from the position crosses
+    for (i = 0, j = nvert - 1; i < nvert; j = i++) {
+        double lati = policy->ais_poly[2 * i];
+        double loni = policy->ais_poly[2 * i + 1];
+        double latj = policy->ais_poly[2 * j];
+        double lonj = policy->ais_poly[2 * j + 1];
+
+        if ((lati > lat) != (latj > lat) &&
+            lon < (lonj - loni) * (lat - lati) / (latj - lati) + loni) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+/* Does an AIS report pass a watcher's filters?  Every filter given
+ * must pass.  Reports with no position, such as static and voyage
+ * data, pass an area if their ship's last position was inside it. */
+bool gpsd_ais_filter(struct ais_filter_t *filter,
+                     const struct gps_policy_t *policy,
+                     const struct ais_t *ais)
+{
+    if (0 < policy->ais_nexclude &&
+        mmsi_in(filter->exclude, AIS_FILTER_SLOTS, ais->mmsi)) {
+        return false;
+    }
+    if (4 == policy->ais_nbox ||
+        6 <= policy->ais_npoly) {
+        unsigned slot = mmsi_slot(ais->mmsi, AIS_AREA_SLOTS);
+        double lat, lon;
+
+        // tracked whatever the other filters say of this report
+        if (ais_position(ais, &lat, &lon)) {
+            if (in_area(policy, lat, lon)) {
+                filter->inside[slot] = ais->mmsi;
+            } else {
+                if (ais->mmsi == filter->inside[slot]) {
+                    filter->inside[slot] = 0;
+                }
+                return false;
+            }
+        } else if (0 == ais->mmsi ||
+                   ais->mmsi != filter->inside[slot]) {
+            return false;
+        }
+    }
+    if (0 != filter->types &&
+        (32 <= ais->type ||
+         0 == (filter->types & ((uint32_t)1 << ais->type)))) {
+        return false;
+    }
+    if (0 < policy->ais_nmmsi &&
+        !mmsi_in(filter->mmsi, AIS_FILTER_SLOTS, ais->mmsi)) {
+        return false;
+    }
+    return true;
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,381 @@
+/*
+ * chain.c - output made as a chain of fixed-size segments
+ *
+ * A report is written into segments taken from a pool, a new one each
+ * time the last fills, so it has no size ceiling, and each emitter
+ * appends at the end it already knows instead of finding it with
+ * strlen().  The chain goes to a socket with one writev(), and its
+ * segments back to the pool, so that a steady flow of reports mallocs
+ * nothing.
+ *
+ * The pool is shared by every thread, behind a mutex.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+#define CHAIN_IOV       64      // segments a writev() takes at once
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct gps_segment_t *pool = NULL;
+static int pooled = 0;
+
+static struct gps_segment_t *segment_get(void)
+{
+    struct gps_segment_t *seg;
+
+    (void)pthread_mutex_lock(&pool_mutex);
+    seg = pool;
+    if (NULL != seg) {
+        pool = seg->next;
+        pooled--;
+    }
+    (void)pthread_mutex_unlock(&pool_mutex);
+    if (NULL == seg) {
+        seg = malloc(sizeof(struct gps_segment_t));
+        if (NULL == seg) {
+            return NULL;
+        }
+    }
+    seg->next = NULL;
+    seg->len = 0;
+    return seg;
+}
+
+// start a new, empty, tail segment
+static bool segment_add(struct gps_chain_t *chain)
+{
+    struct gps_segment_t *seg;
+
+    if (chain->failed) {
+        return false;
+    }
+    seg = segment_get();
+    if (NULL == seg) {
+        chain->failed = true;
+        return false;
+    }
+    if (NULL == chain->tail) {
+        chain->head = seg;
+    } else {
+        chain->tail->next = seg;
+    }
+    chain->tail = seg;
+    chain->nsegs++;
+    return true;
+}
+
+void gpsd_chain_init(struct gps_chain_t *chain)
+{
+    chain->head = NULL;
+    chain->tail = NULL;
+    chain->len = 0;
+    chain->nsegs = 0;
+    chain->failed = false;
+}
+
+/* Room for len bytes, len no more than CHAIN_SEGMENT, all in one piece
+ * at the end of the chain, NUL terminated so str_appendf() can write
+ * into it.  NULL if no segment could be had. */
+char *gpsd_chain_reserve(struct gps_chain_t *chain, size_t len)
+{
+    char *room;
+
+    if (CHAIN_SEGMENT < len) {
+        return NULL;
+    }
+    if (NULL == chain->tail ||
+        CHAIN_SEGMENT - chain->tail->len < len) {
+        if (!segment_add(chain)) {
+            return NULL;
+        }
+    }
+    room = chain->tail->buf + chain->tail->len;
+    room[0] = '\0';
+    return room;
+}
+
+// keep len bytes of what was written into the last reserve
+void gpsd_chain_commit(struct gps_chain_t *chain, size_t len)
+{
+    chain->tail->len += len;
+    chain->len += len;
+}
+
+// append len bytes of buf, across segments if need be
+void gpsd_chain_append(struct gps_chain_t *chain, const char *buf,
+                       size_t len)
+{
+    while (0 < len) {
+        size_t room;
+
+        if (NULL == chain->tail ||
+            CHAIN_SEGMENT == chain->tail->len) {
+            if (!segment_add(chain)) {
+                return;
+            }
+        }
+        room = CHAIN_SEGMENT - chain->tail->len;
+        if (room > len) {
+            room = len;
+        }
+        (void)memcpy(chain->tail->buf + chain->tail->len, buf, room);
+        chain->tail->len += room;
+        chain->len += room;
+        buf += room;
+        len -= room;
+    }
+}
+
+// append a NUL terminated string
+void gpsd_chain_puts(struct gps_chain_t *chain, const char *str)
+{
+    gpsd_chain_append(chain, str, strlen(str));
+}
+
+/* append printf() output.  It is formatted straight into the tail
+ * segment when it fits there, else into a fresh one, and only output
+ * longer than a segment goes through a bounce buffer. */
+void gpsd_chain_appendf(struct gps_chain_t *chain, const char *fmt, ...)
+{
+    va_list ap;
+    size_t room = 0;
+    int len;
+    char *big;
+
+    if (NULL != chain->tail) {
+        room = CHAIN_SEGMENT - chain->tail->len;
+    }
+    if (0 < room) {
+        va_start(ap, fmt);
+        len = vsnprintf(chain->tail->buf + chain->tail->len, room, fmt, ap);
+        va_end(ap);
+        if (0 > len) {
+            return;
+        }
+        if ((size_t)len < room) {
+            chain->tail->len += len;
+            chain->len += len;
+            return;
+        }
+    } else {
+        va_start(ap, fmt);
+        len = vsnprintf(NULL, 0, fmt, ap);
+        va_end(ap);
+        if (0 > len) {
+            return;
+        }
+    }
+    if (CHAIN_SEGMENT > (size_t)len) {
+        if (!segment_add(chain)) {
+            return;
+        }
+        va_start(ap, fmt);
+        (void)vsnprintf(chain->tail->buf, CHAIN_SEGMENT, fmt, ap);
+        va_end(ap);
+        chain->tail->len = len;
+        chain->len += len;
+        return;
+    }
+    big = malloc((size_t)len + 1);
+    if (NULL == big) {
+        chain->failed = true;
+        return;
+    }
+    va_start(ap, fmt);
+    (void)vsnprintf(big, (size_t)len + 1, fmt, ap);
+    va_end(ap);
+    gpsd_chain_append(chain, big, (size_t)len);
+    free(big);
+}
+
+// the last byte of the chain, or NUL if it is empty
+char gpsd_chain_last(const struct gps_chain_t *chain)
+{
+    if (NULL == chain->tail ||
+        0 == chain->tail->len) {
+        return '\0';
+    }
+    return chain->tail->buf[chain->tail->len - 1];
+}
+
+// drop a last byte of ch, like str_rstrip_char()
+void gpsd_chain_rstrip(struct gps_chain_t *chain, char ch)
+{
+    if (ch == gpsd_chain_last(chain) &&
+        '\0' != ch) {
+        chain->tail->len--;
+        chain->len--;
+    }
+}
+
+/* Copy the chain, NUL terminated, into buf, cut short to fit as the
+ * fixed buffers were.  Returns the bytes copied. */
+size_t gpsd_chain_copy(const struct gps_chain_t *chain, char *buf,
+                       size_t buflen)
+{
+    const struct gps_segment_t *seg;
+    size_t len = 0;
+
+    if (0 == buflen) {
+        return 0;
+    }
+    for (seg = chain->head; NULL != seg && len + 1 < buflen;
+         seg = seg->next) {
+        size_t n = seg->len;
+
+        if (n > buflen - 1 - len) {
+            n = buflen - 1 - len;
+        }
+        (void)memcpy(buf + len, seg->buf, n);
+        len += n;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/* Write hdrlen bytes of hdr, if any, then the chain, to fd with
+ * writev(), CHAIN_IOV segments at a time.  Returns the bytes written,
+ * header and all, as writev() does: short if a writev() was, or -1 if
+ * the first failed. */
+ssize_t gpsd_chain_write(const struct gps_chain_t *chain, int fd,
+                         const unsigned char *hdr, size_t hdrlen)
+{
+    const struct gps_segment_t *seg = chain->head;
+    ssize_t total = 0;
+
+    do {
+        struct iovec iov[CHAIN_IOV + 1];
+        size_t want = 0;
+        ssize_t status;
+        int n = 0;
+
+        if (0 < hdrlen) {
+            iov[n].iov_base = (void *)hdr;
+            iov[n].iov_len = hdrlen;
+            want += hdrlen;
+            n++;
+            hdrlen = 0;
+        }
+        for (; NULL != seg && CHAIN_IOV >= n; seg = seg->next) {
+            if (0 == seg->len) {
+                continue;
+            }
+            iov[n].iov_base = (void *)seg->buf;
+            iov[n].iov_len = seg->len;
+            want += seg->len;
+            n++;
+        }
+        if (0 == n) {
+            break;
+        }
+        status = writev(fd, iov, n);
+        if (0 > status) {
+            return 0 == total ? status : total;
+        }
+        total += status;
+        if ((size_t)status != want) {
+            break;
+        }
+    } while (NULL != seg);
+    return total;
+}
+
+/* Write a chain to a datagram-like socket, SOCK_SEQPACKET, one line,
+ * one JSON object, to a writev() and so to a message, so the reader
+ * never has to join or split them.  A line may span segments, up to
+ * CHAIN_IOV of them.  Returns the bytes written as gpsd_chain_write()
+ * does. */
+ssize_t gpsd_chain_write_lines(const struct gps_chain_t *chain, int fd)
+{
+    const struct gps_segment_t *seg = chain->head;
+    size_t off = 0;
+    ssize_t total = 0;
+
+    while (NULL != seg) {
+        struct iovec iov[CHAIN_IOV];
+        size_t want = 0;
+        ssize_t status;
+        int n = 0;
+        bool eol = false;
+
+        while (NULL != seg && CHAIN_IOV > n && !eol) {
+            const char *nl;
+            size_t len = seg->len - off;
+
+            if (0 == len) {
+                seg = seg->next;
+                off = 0;
+                continue;
+            }
+            nl = memchr(seg->buf + off, '\n', len);
+            if (NULL != nl) {
+                len = (size_t)(nl - (seg->buf + off)) + 1;
+                eol = true;
+            }
+            iov[n].iov_base = (void *)(seg->buf + off);
+            iov[n].iov_len = len;
+            want += len;
+            n++;
+            off += len;
+        }
+        if (0 == n) {
+            break;
+        }
+        status = writev(fd, iov, n);
+        if (0 > status) {
+            return 0 == total ? status : total;
+        }
+        total += status;
+        if ((size_t)status != want) {
+            break;
+        }
+    }
+    return total;
+}
+
+// return the chain's segments to the pool, and empty it
+void gpsd_chain_release(struct gps_chain_t *chain)
+{
+    struct gps_segment_t *seg, *next;
+
+    (void)pthread_mutex_lock(&pool_mutex);
+    for (seg = chain->head; NULL != seg; seg = next) {
+        next = seg->next;
+        if (CHAIN_POOL_MAX > pooled) {
+            seg->next = pool;
+            pool = seg;
+            pooled++;
+        } else {
+            free(seg);
+        }
+    }
+    (void)pthread_mutex_unlock(&pool_mutex);
+    gpsd_chain_init(chain);
+}
+
+// how many free segments the pool holds
+int gpsd_chain_pooled(void)
+{
+    int n;
+
+    (void)pthread_mutex_lock(&pool_mutex);
+    n = pooled;
+    (void)pthread_mutex_unlock(&pool_mutex);
+    return n;
+}
+// vim: set expandtab shiftwidth=4
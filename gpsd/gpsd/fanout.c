@@ -0,0 +1,320 @@
+/*
+ * fanout.c - deliver client output on a pool of writer threads
+ *
+ * Clients are sharded across the writer threads by index.  What a
+ * client is sent is an immutable, reference counted report: a report
+ * that many clients are owed is made once, and each of them is posted
+ * a reference to it.  Publishing wakes the shards, and each writes its
+ * clients' reports through the deliver hook and drops its references;
+ * the last one frees it.
+ *
+ * A shard has two queues, each a ring.  The urgent one, for PPS and
+ * the like, is delivered from first, ahead of whatever is waiting in
+ * the other.  When a ring is full, a post is dropped, as a write to a
+ * client with a full socket buffer is.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/gpsd.h"
+
+struct gps_report_t {
+    atomic_int refs;
+    size_t len;
+    char buf[];
+};
+
+// a report of room bytes, with one reference, else NULL
+static struct gps_report_t *report_alloc(size_t room)
+{
+    struct gps_report_t *report = malloc(sizeof(*report) + room);
+
+    if (NULL == report) {
+        return NULL;
+    }
+    atomic_init(&report->refs, 1);
+    report->len = 0;
+    return report;
+}
+
+/* A report of the hdrlen bytes of hdr, if any, then the len bytes of
+ * buf, with one reference, the caller's.  NULL if there is no memory. */
+struct gps_report_t *gpsd_report_new(const unsigned char *hdr,
+                                     size_t hdrlen,
+                                     const char *buf, size_t len)
+{
+    struct gps_report_t *report = report_alloc(hdrlen + len);
+
+    if (NULL == report) {
+        return NULL;
+    }
+    if (0 < hdrlen) {
+        (void)memcpy(report->buf, hdr, hdrlen);
+    }
+    (void)memcpy(report->buf + hdrlen, buf, len);
+    report->len = hdrlen + len;
+    return report;
+}
+
+// as gpsd_report_new(), for a chain, copied straight into the report
+struct gps_report_t *gpsd_report_chain(const unsigned char *hdr,
+                                       size_t hdrlen,
+                                       const struct gps_chain_t *chain)
+{
+    // room for the NUL gpsd_chain_copy() ends with
+    struct gps_report_t *report = report_alloc(hdrlen + chain->len + 1);
+
+    if (NULL == report) {
+        return NULL;
+    }
+    if (0 < hdrlen) {
+        (void)memcpy(report->buf, hdr, hdrlen);
+    }
+    (void)gpsd_chain_copy(chain, report->buf + hdrlen, chain->len + 1);
+    report->len = hdrlen + chain->len;
+    return report;
+}
+
+// drop a reference to report, if any; the last one frees it
+void gpsd_report_drop(struct gps_report_t *report)
+{
+    if (NULL != report &&
+        1 == atomic_fetch_sub(&report->refs, 1)) {
+        free(report);
+    }
+}
+
+// is there nothing to deliver?  The caller holds the shard's mutex.
+static bool shard_empty(const struct gps_shard_t *shard)
+{
+    int i;
+
+    for (i = 0; i < FANOUT_LANES; i++) {
+        if (shard->lane[i].head != shard->lane[i].tail) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Deliver a report at a time, the urgent lane's first, so one waits
+ * at most for the write under way. */
+static void *shard_thread(void *arg)
+{
+    struct gps_shard_t *shard = (struct gps_shard_t *)arg;
+    struct gps_fanout_t *fanout = shard->fanout;
+
+    for (;;) {
+        struct gps_lane_t *lane;
+        struct gps_delivery_t *d;
+
+        (void)pthread_mutex_lock(&shard->mutex);
+        while (!shard->stop &&
+               shard_empty(shard)) {
+            (void)pthread_cond_wait(&shard->wake, &shard->mutex);
+        }
+        if (shard_empty(shard)) {
+            // stopped, and nothing is left
+            (void)pthread_mutex_unlock(&shard->mutex);
+            return NULL;
+        }
+        lane = &shard->lane[FANOUT_URGENT];
+        if (lane->head == lane->tail) {
+            lane = &shard->lane[FANOUT_QUEUED];
+        }
+        d = &lane->ring[lane->head];
+        (void)pthread_mutex_unlock(&shard->mutex);
+
+        // only this thread moves head, posts only fill in past tail
+        fanout->deliver(fanout->arg, d->client, d->gen,
+                        d->report->buf, d->report->len);
+        gpsd_report_drop(d->report);
+
+        (void)pthread_mutex_lock(&shard->mutex);
+        lane->head = (lane->head + 1) % shard->size;
+        if (shard_empty(shard)) {
+            (void)pthread_cond_broadcast(&shard->idle);
+        }
+        (void)pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+// free what a shard's lanes were given
+static void shard_free(struct gps_shard_t *shard)
+{
+    int i;
+
+    for (i = 0; i < FANOUT_LANES; i++) {
+        free(shard->lane[i].ring);
+        shard->lane[i].ring = NULL;
+    }
+}
+
+/* Start nshards writer threads, with room to queue queue deliveries
+ * in each lane of each.  Returns 0, or an errno on failure, with none
+ * left running. */
+int gpsd_fanout_start(struct gps_fanout_t *fanout, int nshards,
+                      size_t queue, gps_deliver_t deliver, void *arg)
+{
+    int i, j, err = 0;
+
+    (void)memset(fanout, 0, sizeof(*fanout));
+    if (0 >= nshards ||
+        FANOUT_SHARDS_MAX < nshards ||
+        2 > queue) {
+        return EINVAL;
+    }
+    fanout->deliver = deliver;
+    fanout->arg = arg;
+    for (i = 0; i < nshards; i++) {
+        struct gps_shard_t *shard = &fanout->shards[i];
+
+        shard->fanout = fanout;
+        shard->size = queue;
+        for (j = 0; j < FANOUT_LANES; j++) {
+            shard->lane[j].ring = calloc(queue,
+                                         sizeof(struct gps_delivery_t));
+            if (NULL == shard->lane[j].ring) {
+                err = ENOMEM;
+            }
+        }
+        if (0 != err) {
+            shard_free(shard);
+            break;
+        }
+        (void)pthread_mutex_init(&shard->mutex, NULL);
+        (void)pthread_cond_init(&shard->wake, NULL);
+        (void)pthread_cond_init(&shard->idle, NULL);
+        err = pthread_create(&shard->thread, NULL, shard_thread, shard);
+        if (0 != err) {
+            (void)pthread_mutex_destroy(&shard->mutex);
+            (void)pthread_cond_destroy(&shard->wake);
+            (void)pthread_cond_destroy(&shard->idle);
+            shard_free(shard);
+            break;
+        }
+        fanout->nshards++;
+    }
+    if (0 != err) {
+        gpsd_fanout_stop(fanout);
+    }
+    return err;
+}
+
+/* Queue report for client, of generation gen, on its shard, with a
+ * reference of its own; the caller keeps its reference.  If urgent,
+ * it goes ahead of whatever the shard has queued.  False if that lane
+ * of the shard is full. */
+bool gpsd_fanout_share(struct gps_fanout_t *fanout, int client,
+                       unsigned long gen, struct gps_report_t *report,
+                       bool urgent)
+{
+    struct gps_shard_t *shard = &fanout->shards[client % fanout->nshards];
+    struct gps_lane_t *lane =
+        &shard->lane[urgent ? FANOUT_URGENT : FANOUT_QUEUED];
+    size_t next;
+
+    (void)pthread_mutex_lock(&shard->mutex);
+    next = (lane->tail + 1) % shard->size;
+    if (next == lane->head) {
+        (void)pthread_mutex_unlock(&shard->mutex);
+        fanout->dropped++;
+        return false;
+    }
+    atomic_fetch_add(&report->refs, 1);
+    lane->ring[lane->tail].client = client;
+    lane->ring[lane->tail].gen = gen;
+    lane->ring[lane->tail].report = report;
+    lane->tail = next;
+    shard->posted = true;
+    (void)pthread_mutex_unlock(&shard->mutex);
+    fanout->posts++;
+    if (urgent) {
+        fanout->urgent++;
+    }
+    return true;
+}
+
+/* Queue a copy of the len bytes of buf for client, of generation gen,
+ * on its shard.  False if the shard's queue is full, or there is no
+ * memory. */
+bool gpsd_fanout_post(struct gps_fanout_t *fanout, int client,
+                      unsigned long gen, const char *buf, size_t len)
+{
+    struct gps_report_t *report = gpsd_report_new(NULL, 0, buf, len);
+    bool posted;
+
+    if (NULL == report) {
+        fanout->dropped++;
+        return false;
+    }
+    posted = gpsd_fanout_share(fanout, client, gen, report, false);
+    gpsd_report_drop(report);
+    return posted;
+}
+
+// wake the shards with something posted
+void gpsd_fanout_publish(struct gps_fanout_t *fanout)
+{
+    int i;
+
+    for (i = 0; i < fanout->nshards; i++) {
+        struct gps_shard_t *shard = &fanout->shards[i];
+
+        (void)pthread_mutex_lock(&shard->mutex);
+        if (shard->posted) {
+            shard->posted = false;
+            (void)pthread_cond_signal(&shard->wake);
+        }
+        (void)pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+// publish, then wait until every delivery is made
+void gpsd_fanout_drain(struct gps_fanout_t *fanout)
+{
+    int i;
+
+    gpsd_fanout_publish(fanout);
+    for (i = 0; i < fanout->nshards; i++) {
+        struct gps_shard_t *shard = &fanout->shards[i];
+
+        (void)pthread_mutex_lock(&shard->mutex);
+        while (!shard_empty(shard)) {
+            (void)pthread_cond_wait(&shard->idle, &shard->mutex);
+        }
+        (void)pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+// make what is queued, then end the writer threads
+void gpsd_fanout_stop(struct gps_fanout_t *fanout)
+{
+    int i;
+
+    gpsd_fanout_publish(fanout);
+    for (i = 0; i < fanout->nshards; i++) {
+        struct gps_shard_t *shard = &fanout->shards[i];
+
+        (void)pthread_mutex_lock(&shard->mutex);
+        shard->stop = true;
+        (void)pthread_cond_signal(&shard->wake);
+        (void)pthread_mutex_unlock(&shard->mutex);
+        (void)pthread_join(shard->thread, NULL);
+        (void)pthread_mutex_destroy(&shard->mutex);
+        (void)pthread_cond_destroy(&shard->wake);
+        (void)pthread_cond_destroy(&shard->idle);
+        shard_free(shard);
+    }
+    fanout->nshards = 0;
+}
+// vim: set expandtab shiftwidth=4
@@ -33,6 +33,7 @@
 #include <sys/param.h>               // for setgroups()
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>                 // for writev()
 #include <sys/un.h>
 #include <time.h>
 #include <unistd.h>                  // for setgroups()
@@ -94,12 +95,17 @@
  *
  * DEVICE_RECONNECT sets interval on retries when (re)connecting to
  * a device.  In seconds.
+ *
+ * RTCM_EPOCH_GAP is how long a correction source has to go quiet
+ * before its next packet is taken to start a new epoch.  Used by the
+ * device output queue's coalesce and stale policies.  In seconds.
  */
 #define COMMAND_TIMEOUT         60*15
 #define NOREAD_TIMEOUT          60*3
 #define RELEASE_TIMEOUT         60
 #define DEVICE_REAWAKE          0.01
 #define DEVICE_RECONNECT        2
+#define RTCM_EPOCH_GAP          0.2
 
 #define QLEN                    5
 
@@ -159,12 +165,24 @@ static jmp_buf restartbuf;
 #endif
 
 static volatile sig_atomic_t signalled;
+static volatile sig_atomic_t trace_requested;
 
 // signal handler
 static void onsig(int sig)
 {
     // just set a variable, and deal with it in the main loop
-    signalled = (sig_atomic_t) sig;
+    if (SIGUSR2 == sig) {
+        trace_requested = 1;
+    } else {
+        signalled = (sig_atomic_t) sig;
+    }
+}
+
+// log one line of a trace_dump()
+static void trace_log(const char *line, void *arg)
+{
+    (void)arg;
+    GPSD_LOG(LOG_SHOUT, &context.errout, "TRACE: %s\n", line);
 }
 
 // list installed drivers and enabled features
@@ -231,11 +249,17 @@ static void usage(void)
     (void)printf("usage: gpsd [OPTIONS] device...\n\n\
   Options include: \n\
   -?, -h, --help            = help message\n\
+  -A, --arrival             = reference NTP in-band time to the arrival\n\
+                              of the packet's first byte\n\
   -b, --readonly            = bluetooth-safe: open data sources read-only\n\
+  -C, --cpus CPUS           = run the main thread, and threads it starts,\n\
+                              on CPUS, a list such as 0,2-3\n\
+  -c, --ppscpus CPUS        = run PPS threads on CPUS\n\
   -D, --debug integer       = set debug level, default 0 \n\
   -F, --sockfile sockfile   = specify control socket location, default none\n\
   -f, --framing FRAMING     = fix device framing to FRAMING (8N1, 8O1, etc.)\n\
   -G, --listenany           = make gpsd listen on INADDR_ANY\n\
+  -L, --memlock             = lock gpsd in memory once it is running\n\
   -l, --drivers             = list compiled in drivers, and exit.\n\
   -n, --nowait              = don't wait for client connects to poll GPS\n"
 #ifdef FORCE_NOWAIT
@@ -244,10 +268,20 @@ static void usage(void)
 "  -N, --foreground          = don't go into background\n\
   -P, --pidfile pidfile     = set file to record process ID\n\
   -p, --passive             = do not reconfigure the receiver automatically\n\
+  -Q, --rtcmqueue POLICY    = how to queue RTCM for slow devices, a comma\n\
+                              list of coalesce, stale and priority, or none;\n\
+                              default priority\n\
+  -R, --ppsprio PRIO        = run PPS threads SCHED_FIFO at priority PRIO\n\
   -r, --badtime             = use GPS time even if no fix\n\
   -S, --port PORT           = set port for daemon, default %s\n\
   -s, --speed SPEED         = fix device speed to SPEED, default none\n\
-  -V, --version             = emit version and exit.\n"
+  -t, --trace               = record packet path debug messages, dump them\n\
+                              on SIGUSR2\n\
+  -u, --seqpacket SOCKFILE  = also serve local clients on a SOCK_SEQPACKET\n\
+                              socket at SOCKFILE\n\
+  -V, --version             = emit version and exit.\n\
+  -W, --websocket PORT      = also serve WebSocket clients on PORT\n\
+  -w, --writers N           = write to clients on N threads, 1 to 16\n"
 "\nA device may be a local serial device for GNSS input, plus an optional\n\
 PPS device, or a URL in one of the following forms:\n\
      tcp://host[:port]\n\
@@ -266,16 +300,56 @@ The following driver types are compiled into this gpsd instance:\n",
 
 }
 
-#ifdef CONTROL_SOCKET_ENABLE
-static socket_t filesock(char *filename)
+/* Set the RTCM queue policies from a -Q argument.
+ *
+ * Return: false if it names one there is not
+ */
+static bool rtcm_policy(const char *arg)
+{
+    static const struct {
+        const char *name;
+        int policy;
+    } policies[] = {
+        {"coalesce", OUTQ_COALESCE},
+        {"stale", OUTQ_STALE},
+        {"priority", OUTQ_PRIORITY},
+        {"none", 0},
+    };
+    char buf[64];
+    char *word, *saveptr = NULL;
+    int policy = 0;
+
+    (void)strlcpy(buf, arg, sizeof(buf));
+    for (word = strtok_r(buf, ",", &saveptr); NULL != word;
+         word = strtok_r(NULL, ",", &saveptr)) {
+        int i;
+
+        for (i = 0; i < NITEMS(policies); i++) {
+            if (0 == strcmp(word, policies[i].name)) {
+                policy |= policies[i].policy;
+                break;
+            }
+        }
+        if (NITEMS(policies) == i) {
+            return false;
+        }
+    }
+    context.outq_policy = policy;
+    return true;
+}
+
+#if defined(CONTROL_SOCKET_ENABLE) || defined(SOCKET_EXPORT_ENABLE)
+/* a listening Unix-domain socket: SOCK_STREAM for the control socket,
+ * SOCK_SEQPACKET for local clients */
+static socket_t filesock(char *filename, int socktype)
 {
     struct sockaddr_un addr;
     socket_t sock;
 
-    if (BAD_SOCKET(sock = socket(AF_UNIX, SOCK_STREAM, 0))) {
+    if (BAD_SOCKET(sock = socket(AF_UNIX, socktype, 0))) {
         GPSD_LOG(LOG_ERROR, &context.errout,
-                 "Can't create device-control socket. %s(%d)\n",
-                 strerror(errno), errno);
+                 "Can't create local socket %s. %s(%d)\n",
+                 filename, strerror(errno), errno);
         return -1;
     }
     (void)strlcpy(addr.sun_path, filename, sizeof(addr.sun_path));
@@ -298,11 +372,23 @@ static socket_t filesock(char *filename)
     // coverity[leaked_handle] This is an intentional allocation
     return sock;
 }
-#endif  // CONTROL_SOCKET_ENABLE
+
+// remove what a previous run left at a local socket's path
+static void unlink_stale(const char *filename, const char *what)
+{
+    if (0 == unlink(filename)) {
+        GPSD_LOG(LOG_PROG, &context.errout,
+                 "stale %s %s removed\n", what, filename);
+    } else {
+        GPSD_LOG(LOG_WARN, &context.errout,
+                 "removing stale %s %s failed: %s(%d)\n",
+                 what, filename, strerror(errno), errno);
+    }
+}
+#endif  // CONTROL_SOCKET_ENABLE || SOCKET_EXPORT_ENABLE
 
 #define sub_index(s) (int)((s) - subscribers)
 #define allocated_device(devp)   ('\0' != (devp)->gpsdata.dev.path[0])
-#define free_device(devp)        (devp)->gpsdata.dev.path[0] = '\0'
 #define initialized_device(devp) (NULL != (devp)->context)
 
 /*
@@ -313,6 +399,15 @@ static socket_t filesock(char *filename)
  */
 static struct gps_device_t devices[MAX_DEVICES];
 
+// release a device slot
+static void free_device(struct gps_device_t *devp)
+{
+#ifdef SHM_EXPORT_ENABLE
+    shm_device(&context, (int)(devp - devices), NULL);
+#endif  // SHM_EXPORT_ENABLE
+    devp->gpsdata.dev.path[0] = '\0';
+}
+
 // track the largest fd currently in use
 static void adjust_max_fd(int fd, bool on)
 {
@@ -535,12 +630,53 @@ static int passivesocks(char *service, char *tcp_or_udp,
     return numsocks;
 }
 
+// WebSocket states of a subscriber
+#define WS_NONE         0       // plain TCP client
+#define WS_HANDSHAKE    1       // waiting for the HTTP upgrade request
+#define WS_OPEN         2       // everything sent and received is framed
+
+// a browser's upgrade request, cookies and all, must fit
+#define WS_INPUT_MAX    4096
+
 struct subscriber_t
 {
     int fd;                       // client file descriptor. -1 if unused
     time_t active;                // when subscriber last polled for data
     struct gps_policy_t policy;   // configurable bits
     pthread_mutex_t mutex;        // serialize access to fd
+    int websocket;                // WS_NONE, WS_HANDSHAKE or WS_OPEN
+    size_t wslen;                 // bytes waiting in wsbuf
+    // of them, the start of a fragmented message, gathered at the front
+    size_t wsmsg;
+    bool wsfrag;                  // the rest of its fragments are due
+    // partial request or frames, WS_INPUT_MAX long.  Only WebSocket
+    // clients get one, so idle subscriber slots stay small.
+    unsigned char *wsbuf;
+    // per device, the interval slot each decimated class last went in
+    long long decimate[MAX_DEVICES][DECIMATE_CLASSES];
+    // per device, what a SKY delta watcher was last sent, else NULL
+    struct sky_delta_t *skydelta;
+    int skylast;                  // device of the last SKY delta, or -1
+    // per device, the IMU ring count an IMU batch watcher was sent to
+    unsigned long imunext[MAX_DEVICES];
+    // the AIS filters of a watcher that has some, else NULL
+    struct ais_filter_t *aisfilter;
+    // output staged this pass of the main loop, else NULL
+    struct gps_stage_t *stage;
+    time_t moved;                 // when held output last went out
+    bool seqpacket;               // an object a message, so never staged
+    // with writer threads: bumped on detach, so a new client in this
+    // slot gets nothing queued for the old one
+    unsigned long gen;
+    // and what a short write of theirs left, else NULL
+    struct gps_stage_t *wheld;
+    time_t wmoved;                // when it last went out
+    bool wkick;                   // it is posted a delivery to retry it
+    // and the first failed delivery since the main loop looked
+    bool wfailed;
+    ssize_t wstatus;
+    size_t wlen;
+    int werrno;
 };
 
 #define subscribed(sub, devp)    (sub->policy.watcher && (sub->policy.devpath[0]=='\0' || strcmp(sub->policy.devpath, devp->gpsdata.dev.path)==0))
@@ -548,6 +684,66 @@ struct subscriber_t
 // indexed by client file descriptor
 static struct subscriber_t subscribers[MAX_CLIENTS];
 
+/* While corked, what the main thread writes to a client is staged, see
+ * stage.c, and uncork() sends it.
+ *
+ * With writer threads, see fanout.c, the main thread stages what it
+ * writes to a client alone, and uncork() posts it for them to send.
+ * A report rendered for many watchers is made once, and each is
+ * posted a reference to it, after what is staged for it.  PPS, TOFF
+ * and fast TPV messages are posted at once, in the urgent lane, ahead
+ * of anything staged or queued.
+ *
+ * A PPS thread writes to no client: it queues its PPS messages, see
+ * ppsqueue.c, and wakes the main loop to send them.
+ *
+ * What a short write to a client leaves is held, in its stage or with
+ * writer threads in its wheld, and goes ahead of anything else; the
+ * main loop waits for room for it, and drops the client if it gets none
+ * for NOREAD_TIMEOUT.
+ *
+ * Every write to a client's fd is made under its mutex.  Only the main
+ * thread detaches a client: a writer thread that fails to write to one
+ * records it, see write_failed(), and the main thread acts on it in
+ * uncork(). */
+static bool corked = false;
+static pthread_t main_thread;
+static int writers = 0;
+static struct gps_fanout_t fanout;
+// indexed like devices[]
+static struct gps_ppsq_t ppsq[MAX_DEVICES];
+static int ppswake[2] = {-1, -1};       // a pipe, to wake the main loop
+
+/*
+ * Per-device pieces of the ?POLL response.  Between packets every
+ * poller would serialize the same device state, so each piece is
+ * rendered once and reused until all_reports() sees the next packet.
+ * Indexed like devices[].
+ */
+struct poll_cache_t {
+    bool tpv_valid;             // TPV without timing info, see policy
+    bool gst_valid;
+    bool sky_valid;
+    char tpv[GPS_JSON_RESPONSE_MAX];
+    char gst[GPS_JSON_RESPONSE_MAX];
+    char sky[GPS_JSON_RESPONSE_MAX];
+};
+static struct poll_cache_t poll_cache[MAX_DEVICES];
+
+#define POLL_TPV        1
+#define POLL_GST        2
+#define POLL_SKY        4
+
+// mark the cached ?POLL pieces of a device stale
+static void poll_cache_invalidate(const struct gps_device_t *device)
+{
+    struct poll_cache_t *pc = &poll_cache[device - devices];
+
+    pc->tpv_valid = false;
+    pc->gst_valid = false;
+    pc->sky_valid = false;
+}
+
 static void lock_subscriber(struct subscriber_t *sub)
 {
     (void)pthread_mutex_lock(&sub->mutex);
@@ -604,37 +800,76 @@ static void detach_client(struct subscriber_t *sub)
     sub->policy.timing = false;
     sub->policy.split24 = false;
     sub->policy.devpath[0] = '\0';
+    sub->policy.interval = 0.0;
+    sub->policy.tpv_interval = 0.0;
+    sub->policy.sky_interval = 0.0;
+    sub->policy.gst_interval = 0.0;
+    sub->policy.fields[0] = '\0';
+    sub->policy.tpv_fields = 0;
+    sub->policy.sky_fields = 0;
+    sub->policy.sky_delta = 0;
+    free(sub->skydelta);
+    sub->skydelta = NULL;
+    sub->policy.imu_batch = 0;
+    sub->policy.fast_pvt = false;
+    sub->policy.ais_nbox = 0;
+    sub->policy.ais_npoly = 0;
+    sub->policy.ais_nmmsi = 0;
+    sub->policy.ais_nexclude = 0;
+    sub->policy.ais_ntypes = 0;
+    free(sub->aisfilter);
+    sub->aisfilter = NULL;
+    free(sub->stage);
+    sub->stage = NULL;
+    sub->seqpacket = false;
+    sub->gen++;
+    free(sub->wheld);
+    sub->wheld = NULL;
+    sub->wkick = false;
+    sub->wfailed = false;
+    sub->websocket = WS_NONE;
+    sub->wslen = 0;
+    sub->wsmsg = 0;
+    sub->wsfrag = false;
+    free(sub->wsbuf);
+    sub->wsbuf = NULL;
     sub->fd = UNALLOCATED_FD;
     unlock_subscriber(sub);
 }
 
-// write to client -- throttle if it's gone or we're close to buffer overrun
-static ssize_t throttled_write(struct subscriber_t *sub, char *buf,
-                               const size_t len)
+/* Ready a subscriber for the SKY deltas its policy asks for, or for none.
+ * Either way the next SKY it gets is a full one. */
+static void skydelta_reset(struct subscriber_t *sub)
 {
-    ssize_t status;
+    int i;
 
-    if (LOG_CLIENT <= context.errout.debug) {
-        if (isprint((unsigned char) buf[0])) {
-            GPSD_LOG(LOG_CLIENT, &context.errout,
-                     "=> client(%d) len %zu: %s\n",
-                     sub_index(sub), len, buf);
-        } else {
-            char *cp, buf2[MAX_PACKET_LENGTH * 3];
-            buf2[0] = '\0';
-            for (cp = buf; cp < buf + len; cp++)
-                str_appendf(buf2, sizeof(buf2),
-                               "%02x", (unsigned int)(*cp & 0xff));
-            GPSD_LOG(LOG_CLIENT, &context.errout,
-                     "=> client(%d) len %zu: =%s\n",
-                     sub_index(sub), len, buf2);
+    if (0 >= sub->policy.sky_delta) {
+        free(sub->skydelta);
+        sub->skydelta = NULL;
+        return;
+    }
+    if (NULL == sub->skydelta) {
+        sub->skydelta = malloc(MAX_DEVICES * sizeof(struct sky_delta_t));
+        if (NULL == sub->skydelta) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "no memory for SKY deltas, sending full SKY\n");
+            sub->policy.sky_delta = 0;
+            return;
         }
     }
+    for (i = 0; i < MAX_DEVICES; i++) {
+        sub->skydelta[i].nsats = -1;
+        sub->skydelta[i].reports = 0;
+    }
+    sub->skylast = -1;
+}
 
-    gpsd_acquire_reporting_lock();
-    status = write(sub->fd, buf, len);
-    gpsd_release_reporting_lock();
-
+/* what a write of len bytes to a client came to: drop the client if it
+ * has gone or is too far behind.  A short write gets here only when
+ * what it left would not fit in the client's stage.  Main thread only. */
+static ssize_t write_status(struct subscriber_t *sub, ssize_t status,
+                            const size_t len)
+{
     if ((ssize_t)len == status) {
         return status;
     }
@@ -650,6 +885,8 @@ static ssize_t throttled_write(struct subscriber_t *sub, char *buf,
         // no data written, and errno says to retry
         GPSD_LOG(LOG_INF, &context.errout, "client(%d) write: %s(%d)\n",
                  sub_index(sub), strerror(errno), errno);
+        // it may have missed a SKY delta, so start them over
+        skydelta_reset(sub);
         return 0;
     }
     if (EBADF == errno) {
@@ -667,6 +904,672 @@ static ssize_t throttled_write(struct subscriber_t *sub, char *buf,
     return status;
 }
 
+/* what a write of len staged bytes to a client came to.  What a short
+ * write did not send stays held, to go first next time, unless it has
+ * not moved for NOREAD_TIMEOUT.  Main thread only. */
+static ssize_t stage_status(struct subscriber_t *sub, ssize_t status,
+                            const size_t len)
+{
+    time_t now = time(NULL);
+
+    if (0 < status) {
+        sub->moved = now;
+    }
+    if (0 == sub->stage->held ||
+        (0 > status &&
+         EAGAIN != errno &&
+         EINTR != errno)) {
+        return write_status(sub, status, len);
+    }
+    if (NOREAD_TIMEOUT < (now - sub->moved)) {
+        GPSD_LOG(LOG_INF, &context.errout, "client(%d) timed out.\n",
+                 sub_index(sub));
+        detach_client(sub);
+        return -1;
+    }
+    GPSD_LOG(LOG_IO, &context.errout,
+             "client(%d) short write, %zu bytes held\n",
+             sub_index(sub), sub->stage->held);
+    return 0 > status ? 0 : status;
+}
+
+// send what is staged for a client
+static ssize_t stage_flush(struct subscriber_t *sub)
+{
+    size_t len;
+    ssize_t status;
+
+    if (NULL == sub->stage ||
+        0 == sub->stage->len) {
+        return 0;
+    }
+    len = sub->stage->len;
+    GPSD_LOG(LOG_RAW, &context.errout,
+             "client(%d) flush %zu bytes of %lu writes\n",
+             sub_index(sub), len, sub->stage->pieces);
+    lock_subscriber(sub);
+    status = gpsd_stage_flush(sub->stage, sub->fd);
+    unlock_subscriber(sub);
+    return stage_status(sub, status, len);
+}
+
+/* note a failed write to a client, made on a writer thread, for
+ * writer_failures() to act on.  The caller holds the client's mutex,
+ * and errno is the write's. */
+static void write_failed(struct subscriber_t *sub, ssize_t status,
+                         const size_t len)
+{
+    if (!sub->wfailed) {
+        sub->wfailed = true;
+        sub->wstatus = status;
+        sub->wlen = len;
+        sub->werrno = errno;
+    }
+}
+
+/* on a writer thread, hold what a short write to a client left, to go
+ * ahead of its next delivery.  False if it does not fit.  The caller
+ * holds the client's mutex. */
+static bool writer_hold(struct subscriber_t *sub, const char *buf,
+                        size_t len)
+{
+    if (NULL == sub->wheld) {
+        sub->wheld = malloc(sizeof(struct gps_stage_t));
+        if (NULL == sub->wheld) {
+            return false;
+        }
+        sub->wheld->len = 0;
+        sub->wheld->held = 0;
+        sub->wheld->pieces = 0;
+    }
+    if (!gpsd_stage_hold(sub->wheld, buf, len)) {
+        return false;
+    }
+    sub->wmoved = time(NULL);
+    GPSD_LOG(LOG_IO, &context.errout,
+             "client(%d) short write, %zu bytes held\n",
+             sub_index(sub), sub->wheld->held);
+    return true;
+}
+
+/* a writer thread's delivery to a client.  What a short write leaves is
+ * held, and goes first next time; the main loop posts an empty delivery
+ * when the client has room for it.  A delivery behind held output that
+ * will not go is held too, or if there is no room dropped.  A failure
+ * is left for the main loop, which owns the client, to act on. */
+static void deliver_client(void *arg UNUSED, int client, unsigned long gen,
+                           const char *buf, size_t len)
+{
+    struct subscriber_t *sub = &subscribers[client];
+    ssize_t status;
+
+    lock_subscriber(sub);
+    sub->wkick = false;
+    if (UNALLOCATED_FD == sub->fd ||
+        gen != sub->gen) {
+        // detached since it was posted
+        unlock_subscriber(sub);
+        return;
+    }
+    if (NULL != sub->wheld &&
+        0 < sub->wheld->held) {
+        size_t held = sub->wheld->held;
+
+        status = gpsd_stage_flush_held(sub->wheld, sub->fd);
+        if (0 < status) {
+            sub->wmoved = time(NULL);
+        }
+        if (0 > status &&
+            EAGAIN != errno &&
+            EINTR != errno) {
+            write_failed(sub, status, held);
+            unlock_subscriber(sub);
+            return;
+        }
+        if (0 < sub->wheld->held) {
+            if (NOREAD_TIMEOUT < (time(NULL) - sub->wmoved)) {
+                errno = ETIMEDOUT;
+                write_failed(sub, -1, held);
+            } else if (0 < len &&
+                       !gpsd_stage_hold(sub->wheld, buf, len)) {
+                errno = EAGAIN;
+                write_failed(sub, -1, len);
+            }
+            unlock_subscriber(sub);
+            return;
+        }
+    }
+    if (0 < len) {
+        status = write(sub->fd, buf, len);
+        if ((ssize_t)len != status &&
+            (0 > status ||
+             !writer_hold(sub, buf + status, len - (size_t)status))) {
+            write_failed(sub, status, len);
+        }
+    }
+    unlock_subscriber(sub);
+}
+
+// what posting to a writer thread came to
+static void post_status(struct subscriber_t *sub, bool posted, size_t len)
+{
+    if (!posted) {
+        GPSD_LOG(LOG_INF, &context.errout,
+                 "client(%d) writer queue full, %zu bytes dropped\n",
+                 sub_index(sub), len);
+        skydelta_reset(sub);
+    }
+}
+
+/* send what is staged for a client, or with writer threads queue it
+ * for its shard */
+static ssize_t stage_send(struct subscriber_t *sub)
+{
+    if (0 == writers) {
+        return stage_flush(sub);
+    }
+    if (NULL == sub->stage ||
+        0 == sub->stage->len) {
+        return 0;
+    }
+    post_status(sub, gpsd_fanout_post(&fanout, sub_index(sub), sub->gen,
+                                      sub->stage->buf, sub->stage->len),
+                sub->stage->len);
+    sub->stage->len = 0;
+    sub->stage->pieces = 0;
+    return 0;
+}
+
+// act on what the writer threads could not deliver
+static void writer_failures(void)
+{
+    struct subscriber_t *sub;
+
+    for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
+        bool failed;
+        ssize_t status;
+        size_t len;
+        int err;
+
+        if (UNALLOCATED_FD == sub->fd) {
+            continue;
+        }
+        lock_subscriber(sub);
+        failed = sub->wfailed;
+        status = sub->wstatus;
+        len = sub->wlen;
+        err = sub->werrno;
+        sub->wfailed = false;
+        unlock_subscriber(sub);
+        if (failed) {
+            errno = err;
+            (void)write_status(sub, status, len);
+        }
+    }
+}
+
+// start staging client output
+static void cork(void)
+{
+    corked = true;
+}
+
+// stop staging client output, and send what was staged
+static void uncork(void)
+{
+    struct subscriber_t *sub;
+
+    corked = false;
+    writer_failures();
+    for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
+        if (NULL != sub->stage &&
+            UNALLOCATED_FD != sub->fd) {
+            (void)stage_send(sub);
+        }
+    }
+    if (0 < writers) {
+        gpsd_fanout_publish(&fanout);
+    }
+}
+
+// make the client's stage, if it has none.  False if out of memory.
+static bool stage_alloc(struct subscriber_t *sub)
+{
+    if (NULL == sub->stage) {
+        sub->stage = malloc(sizeof(struct gps_stage_t));
+        if (NULL == sub->stage) {
+            return false;
+        }
+        sub->stage->len = 0;
+        sub->stage->held = 0;
+        sub->stage->pieces = 0;
+    }
+    return true;
+}
+
+// is the client's output being staged?  Makes its stage if need be.
+static bool staging(struct subscriber_t *sub)
+{
+    if ((!corked &&
+         0 == writers) ||
+        sub->seqpacket ||
+        !pthread_equal(pthread_self(), main_thread)) {
+        return false;
+    }
+    if (!stage_alloc(sub)) {
+        // with writer threads it is posted unstaged, see stage_put()
+        return 0 < writers;
+    }
+    return true;
+}
+
+// place the bytes of a piece skip bytes in, and count them off skip
+static void hold_piece(struct gps_stage_t *stage, const char *buf,
+                       const size_t len, size_t *skip)
+{
+    if (len <= *skip) {
+        *skip -= len;
+        return;
+    }
+    (void)gpsd_stage_hold(stage, buf + *skip, len - *skip);
+    *skip = 0;
+}
+
+/* hold what a write to a client of hdr, then buf or chain, left unsent
+ * skip bytes in, to go ahead of anything staged.  False if it does not
+ * fit.  Main thread, and no writer threads, only. */
+static bool hold_rest(struct subscriber_t *sub,
+                      const unsigned char *hdr, const size_t hdrlen,
+                      const char *buf, const size_t len,
+                      const struct gps_chain_t *chain, size_t skip)
+{
+    const struct gps_segment_t *seg;
+    size_t total = hdrlen + (NULL == chain ? len : chain->len);
+
+    if (0 < writers ||
+        sub->seqpacket ||
+        !stage_alloc(sub) ||
+        STAGE_SIZE - sub->stage->len < total - skip) {
+        return false;
+    }
+    hold_piece(sub->stage, (const char *)hdr, hdrlen, &skip);
+    if (NULL == chain) {
+        hold_piece(sub->stage, buf, len, &skip);
+    } else {
+        for (seg = chain->head; NULL != seg; seg = seg->next) {
+            hold_piece(sub->stage, seg->buf, seg->len, &skip);
+        }
+    }
+    sub->moved = time(NULL);
+    GPSD_LOG(LOG_IO, &context.errout,
+             "client(%d) short write, %zu bytes held\n",
+             sub_index(sub), sub->stage->held);
+    return true;
+}
+
+/* send what a short write left held for a client.  True if none is
+ * left, false if some is, or the client is gone. */
+static bool held_send(struct subscriber_t *sub)
+{
+    ssize_t status;
+    size_t held;
+
+    if (NULL == sub->stage ||
+        0 == sub->stage->held) {
+        return true;
+    }
+    held = sub->stage->held;
+    lock_subscriber(sub);
+    status = gpsd_stage_flush_held(sub->stage, sub->fd);
+    unlock_subscriber(sub);
+    (void)stage_status(sub, status, held);
+    return UNALLOCATED_FD != sub->fd &&
+           0 == sub->stage->held;
+}
+
+/* the client has room for what a short write left held: send it, or
+ * with writer threads have its writer thread send it, and the caller
+ * publishes */
+static void held_room(struct subscriber_t *sub)
+{
+    if (0 == writers) {
+        (void)held_send(sub);
+        return;
+    }
+    lock_subscriber(sub);
+    sub->wkick = true;
+    unlock_subscriber(sub);
+    (void)gpsd_fanout_post(&fanout, sub_index(sub), sub->gen, "", 0);
+}
+
+// is output held for the client, and not yet retried?
+static bool held_waiting(struct subscriber_t *sub)
+{
+    bool waiting;
+
+    if (0 == writers) {
+        return NULL != sub->stage &&
+               0 < sub->stage->held;
+    }
+    lock_subscriber(sub);
+    waiting = NULL != sub->wheld &&
+              0 < sub->wheld->held &&
+              !sub->wkick;
+    unlock_subscriber(sub);
+    return waiting;
+}
+
+/* before a write to a client that is not staged, send what a short
+ * write left held.  If some is still held, hold this behind it, or if
+ * there is no room drop it.  True if the caller is to write now. */
+static bool held_first(struct subscriber_t *sub,
+                       const unsigned char *hdr, const size_t hdrlen,
+                       const char *buf, const size_t len,
+                       const struct gps_chain_t *chain)
+{
+    if (held_send(sub)) {
+        return true;
+    }
+    if (UNALLOCATED_FD == sub->fd) {
+        return false;
+    }
+    if (!hold_rest(sub, hdr, hdrlen, buf, len, chain, 0)) {
+        GPSD_LOG(LOG_INF, &context.errout,
+                 "client(%d) behind, %zu bytes dropped\n",
+                 sub_index(sub), NULL == chain ? len : chain->len);
+        skydelta_reset(sub);
+    }
+    return false;
+}
+
+/* post a report, NULL if it could not be made, to the client's shard,
+ * ahead of what is queued there if urgent */
+static void report_share(struct subscriber_t *sub,
+                         struct gps_report_t *report, bool urgent,
+                         const size_t len)
+{
+    post_status(sub, NULL != report &&
+                     gpsd_fanout_share(&fanout, sub_index(sub), sub->gen,
+                                       report, urgent), len);
+}
+
+/* with writer threads, post a write too big to stage to the client's
+ * shard as it is, after what was staged, so that its writer thread
+ * stays the only one writing to it */
+static void post_whole(struct subscriber_t *sub,
+                       const unsigned char *hdr, const size_t hdrlen,
+                       const char *buf, const size_t len)
+{
+    struct gps_report_t *report = gpsd_report_new(hdr, hdrlen, buf, len);
+
+    report_share(sub, report, false, hdrlen + len);
+    gpsd_report_drop(report);
+}
+
+/* stage a write for the client, if it is being staged.  True if
+ * staged, or with writer threads posted, and the caller has nothing to
+ * write. */
+static bool stage_put(struct subscriber_t *sub,
+                      const unsigned char *hdr, const size_t hdrlen,
+                      char *buf, const size_t len)
+{
+    if (!staging(sub)) {
+        return false;
+    }
+    if (NULL != sub->stage) {
+        if (gpsd_stage_put(sub->stage, hdr, hdrlen, buf, len)) {
+            return true;
+        }
+        // full, so what is staged goes first, then maybe this
+        if (0 > stage_send(sub) ||
+            UNALLOCATED_FD == sub->fd) {
+            return true;                // the client is gone
+        }
+        if (gpsd_stage_put(sub->stage, hdr, hdrlen, buf, len)) {
+            return true;
+        }
+    }
+    if (0 == writers) {
+        return false;                   // too big to stage, write it now
+    }
+    post_whole(sub, hdr, hdrlen, buf, len);
+    return true;
+}
+
+// as stage_put(), for a chain
+static bool stage_put_chain(struct subscriber_t *sub,
+                            const unsigned char *hdr, const size_t hdrlen,
+                            const struct gps_chain_t *chain)
+{
+    struct gps_report_t *report;
+
+    if (!staging(sub)) {
+        return false;
+    }
+    if (NULL != sub->stage) {
+        if (gpsd_stage_put_chain(sub->stage, hdr, hdrlen, chain)) {
+            return true;
+        }
+        if (0 > stage_send(sub) ||
+            UNALLOCATED_FD == sub->fd) {
+            return true;
+        }
+        if (gpsd_stage_put_chain(sub->stage, hdr, hdrlen, chain)) {
+            return true;
+        }
+    }
+    if (0 == writers) {
+        return false;
+    }
+    report = gpsd_report_chain(hdr, hdrlen, chain);
+    report_share(sub, report, false, hdrlen + chain->len);
+    gpsd_report_drop(report);
+    return true;
+}
+
+/* write to a SOCK_SEQPACKET client, one line, one JSON object, to a
+ * message, as gpsd_chain_write_lines() does */
+static ssize_t lines_write(int fd, const char *buf, const size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        const char *nl = memchr(buf + done, '\n', len - done);
+        size_t want = NULL == nl ? len - done
+                                 : (size_t)(nl - (buf + done)) + 1;
+        ssize_t status = write(fd, buf + done, want);
+
+        if (0 > status) {
+            return 0 == done ? status : (ssize_t)done;
+        }
+        done += (size_t)status;
+        if ((size_t)status != want) {
+            break;
+        }
+    }
+    return (ssize_t)done;
+}
+
+/* write to client now -- throttle if it's gone or we're close to buffer
+ * overrun.  The hdrlen bytes of hdr, if any, go out just ahead of buf. */
+static ssize_t direct_write(struct subscriber_t *sub,
+                            const unsigned char *hdr, const size_t hdrlen,
+                            char *buf, const size_t len)
+{
+    ssize_t status;
+
+    if (!held_first(sub, hdr, hdrlen, buf, len, NULL)) {
+        return UNALLOCATED_FD == sub->fd ? -1 : (ssize_t)len;
+    }
+    lock_subscriber(sub);
+    if (sub->seqpacket) {
+        // never framed
+        status = lines_write(sub->fd, buf, len);
+    } else if (0 == hdrlen) {
+        status = write(sub->fd, buf, len);
+    } else {
+        struct iovec iov[2];
+
+        iov[0].iov_base = (void *)hdr;
+        iov[0].iov_len = hdrlen;
+        iov[1].iov_base = buf;
+        iov[1].iov_len = len;
+        status = writev(sub->fd, iov, 2);
+    }
+    unlock_subscriber(sub);
+
+    if (0 <= status &&
+        (size_t)status < hdrlen + len &&
+        hold_rest(sub, hdr, hdrlen, buf, len, NULL, (size_t)status)) {
+        // the rest goes first next time
+        return (ssize_t)len;
+    }
+    if (0 <= status &&
+        !sub->seqpacket) {
+        // callers count only their own bytes, a cut header is short
+        status = (ssize_t)hdrlen <= status ? status - (ssize_t)hdrlen : 0;
+    }
+    return write_status(sub, status, len);
+}
+
+// write to client, staged if it is being staged, else now
+static ssize_t framed_write(struct subscriber_t *sub,
+                            const unsigned char *hdr, const size_t hdrlen,
+                            char *buf, const size_t len)
+{
+    GPSD_TRACE(LOG_CLIENT, &context.errout, TRACE_CLIENT_WRITE,
+               sub_index(sub), len, 0, buf, len);
+
+    if (stage_put(sub, hdr, hdrlen, buf, len)) {
+        return (ssize_t)len;
+    }
+    return direct_write(sub, hdr, hdrlen, buf, len);
+}
+
+/* write a chain to client, staged if it is being staged, else now with
+ * one writev() */
+static ssize_t chain_write(struct subscriber_t *sub,
+                           const unsigned char *hdr, const size_t hdrlen,
+                           const struct gps_chain_t *chain)
+{
+    ssize_t status;
+
+    if (0 == chain->len) {
+        return 0;
+    }
+    if (1 == chain->nsegs) {
+        // most reports
+        return framed_write(sub, hdr, hdrlen, chain->head->buf,
+                            chain->head->len);
+    }
+    if (chain->failed) {
+        GPSD_LOG(LOG_WARN, &context.errout,
+                 "client(%d) report cut short, out of memory\n",
+                 sub_index(sub));
+    }
+    GPSD_TRACE(LOG_CLIENT, &context.errout, TRACE_CLIENT_WRITE,
+               sub_index(sub), chain->len, 0, chain->head->buf,
+               chain->head->len);
+
+    if (stage_put_chain(sub, hdr, hdrlen, chain)) {
+        return (ssize_t)chain->len;
+    }
+    if (!held_first(sub, hdr, hdrlen, NULL, 0, chain)) {
+        return UNALLOCATED_FD == sub->fd ? -1 : (ssize_t)chain->len;
+    }
+    lock_subscriber(sub);
+    if (sub->seqpacket) {
+        status = gpsd_chain_write_lines(chain, sub->fd);
+    } else {
+        status = gpsd_chain_write(chain, sub->fd, hdr, hdrlen);
+    }
+    unlock_subscriber(sub);
+    if (0 <= status &&
+        (size_t)status < hdrlen + chain->len &&
+        hold_rest(sub, hdr, hdrlen, NULL, 0, chain, (size_t)status)) {
+        return (ssize_t)chain->len;
+    }
+    if (0 <= status) {
+        status = (ssize_t)hdrlen <= status ? status - (ssize_t)hdrlen : 0;
+    }
+    return write_status(sub, status, chain->len);
+}
+
+/* write to client now, ahead of anything staged for it, framed if it
+ * is a WebSocket client.  With writer threads, its writer thread alone
+ * writes to it, so it is posted in its shard's urgent lane, ahead of
+ * what is queued, and the caller publishes it.  shared, if not NULL,
+ * keeps the reports of buf made for one client, unframed and framed,
+ * for the next; the caller drops them with urgent_done(). */
+static ssize_t urgent_write(struct subscriber_t *sub, char *buf,
+                            const size_t len, struct gps_report_t **shared)
+{
+    unsigned char hdr[WS_HEADER_MAX];
+    size_t hdrlen = 0;
+
+    GPSD_TRACE(LOG_CLIENT, &context.errout, TRACE_CLIENT_WRITE,
+               sub_index(sub), len, 0, buf, len);
+
+    if (WS_OPEN == sub->websocket) {
+        if (0 == len) {
+            return 0;
+        }
+        hdrlen = ws_frame_header(hdr, WS_OP_TEXT, len);
+    }
+    if (0 < writers &&
+        !sub->seqpacket) {
+        struct gps_report_t *own = NULL;
+        struct gps_report_t **report =
+            NULL == shared ? &own : &shared[0 < hdrlen ? 1 : 0];
+
+        if (NULL == *report) {
+            *report = gpsd_report_new(hdr, hdrlen, buf, len);
+        }
+        report_share(sub, *report, true, hdrlen + len);
+        gpsd_report_drop(own);
+        return (ssize_t)len;
+    }
+    return direct_write(sub, hdr, hdrlen, buf, len);
+}
+
+/* drop the reports urgent_write() kept in shared, and publish what the
+ * writes posted */
+static void urgent_done(struct gps_report_t **shared)
+{
+    if (0 == writers) {
+        return;
+    }
+    gpsd_report_drop(shared[0]);
+    gpsd_report_drop(shared[1]);
+    shared[0] = NULL;
+    shared[1] = NULL;
+    gpsd_fanout_publish(&fanout);
+}
+
+// write a WebSocket frame to client
+static ssize_t ws_write(struct subscriber_t *sub, int opcode,
+                        char *buf, const size_t len)
+{
+    unsigned char hdr[WS_HEADER_MAX];
+
+    return framed_write(sub, hdr, ws_frame_header(hdr, opcode, len),
+                        buf, len);
+}
+
+// write to client, framed if it is a WebSocket client
+static ssize_t throttled_write(struct subscriber_t *sub, char *buf,
+                               const size_t len)
+{
+    if (WS_OPEN == sub->websocket) {
+        if (0 == len) {
+            // an empty reply is nothing, not an empty message
+            return 0;
+        }
+        return ws_write(sub, WS_OP_TEXT, buf, len);
+    }
+    return framed_write(sub, NULL, 0, buf, len);
+}
+
 // notify all JSON-watching clients of a given device about an event
 static void notify_watchers(struct gps_device_t *device,
                             bool onjson, bool onpps,
@@ -674,6 +1577,7 @@ static void notify_watchers(struct gps_device_t *device,
 {
     va_list ap;
     char buf[BUFSIZ];
+    struct gps_report_t *shared[2] = {NULL, NULL};
     struct subscriber_t *sub;
 
     va_start(ap, sentence);
@@ -686,8 +1590,36 @@ static void notify_watchers(struct gps_device_t *device,
             if ((onjson &&
                  sub->policy.json) ||
                 (onpps && sub->policy.pps)) {
-                // codacy hates strlen()
-                (void)throttled_write(sub, buf, strnlen(buf, sizeof(buf)));
+                size_t len = strnlen(buf, sizeof(buf));
+
+                if (onpps) {
+                    // PPS and TOFF go ahead of staged reports
+                    (void)urgent_write(sub, buf, len, shared);
+                } else {
+                    (void)throttled_write(sub, buf, len);
+                }
+            }
+        }
+    }
+    if (onpps) {
+        urgent_done(shared);
+    }
+}
+
+/* send what the PPS threads queued, see ship_pps_message(), when one
+ * wakes the main loop */
+static void pps_deliver(void)
+{
+    struct gps_device_t *device;
+    char buf[PPSQ_MSG_MAX];
+
+    while (0 < read(ppswake[0], buf, sizeof(buf))) {
+        // empty the pipe, a byte a message
+    }
+    for (device = devices; device < devices + MAX_DEVICES; device++) {
+        while (gpsd_ppsq_get(&ppsq[device - devices], buf, sizeof(buf))) {
+            if (allocated_device(device)) {
+                notify_watchers(device, true, true, "%s", buf);
             }
         }
     }
@@ -698,6 +1630,7 @@ static void notify_watchers(struct gps_device_t *device,
 static void deactivate_device(struct gps_device_t *device)
 {
 #ifdef SOCKET_EXPORT_ENABLE
+    poll_cache_invalidate(device);
     notify_watchers(device, true, false,
                     "{\"class\":\"DEVICE\",\"path\":\"%s\","
                     "\"activated\":0}\r\n",
@@ -821,6 +1754,13 @@ bool gpsd_add_device(const char *device_name, bool flag_nowait)
         if (!allocated_device(devp)) {
             gpsd_init(devp, &context, device_name);
             ntpshm_session_init(devp);
+#ifdef SHM_EXPORT_ENABLE
+            shm_device(&context, (int)(devp - devices),
+                       devp->gpsdata.dev.path);
+#endif  // SHM_EXPORT_ENABLE
+#ifdef SOCKET_EXPORT_ENABLE
+            poll_cache_invalidate(devp);
+#endif  // SOCKET_EXPORT_ENABLE
             GPSD_LOG(LOG_INF, &context.errout,
                      "stashing device %s at slot %d\n",
                      device_name, (int)(devp - devices));
@@ -902,6 +1842,15 @@ static char *snarfline(char *p, char **out)
     return p;
 }
 
+// write one line of a trace_dump() to a control socket
+static void trace_write(const char *line, void *arg)
+{
+    int sfd = *(int *)arg;
+
+    ignore_return(write(sfd, line, strnlen(line, BUFSIZ)));
+    ignore_return(write(sfd, "\n", 1));
+}
+
 // handle privileged commands coming through the control socket
 // FIXME ignore_return(write()) s/b replaced by throttled_write().
 static void handle_control(int sfd, char *buf)
@@ -1018,6 +1967,10 @@ static void handle_control(int sfd, char *buf)
             ignore_return(write(sfd, "\n", 1));
         }
         ignore_return(write(sfd, OK, sizeof(OK) - 1));
+    } else if (strstr(buf, "?trace") == buf) {
+        // write back the recorded trace followed by OK
+        (void)trace_dump(trace_write, &sfd);
+        ignore_return(write(sfd, OK, sizeof(OK) - 1));
     } else {
         // unknown command
         ignore_return(write(sfd, ERROR, sizeof(ERROR) - 1));
@@ -1162,12 +2115,7 @@ static void set_serial(struct gps_device_t *device,
              * The minimum delay time is probably constant
              * across any given type of UART.
              */
-            if (0 != tcdrain(device->gpsdata.gps_fd)) {
-                GPSD_LOG(LOG_ERROR, &device->context->errout,
-                         "SER: set_serial(%d) tcdrain() failed: %s(%d)\n",
-                         device->gpsdata.gps_fd,
-                         strerror(errno), errno);
-            }
+            gpsd_outq_drain(device);
 
             // wait 50,000 uSec
             delay.tv_sec = 0;
@@ -1215,6 +2163,91 @@ static void rstrip(char *str)
     }
 }
 
+// compile the AIS filters a subscriber's policy asks for, if any
+static void aisfilter_reset(struct subscriber_t *sub)
+{
+    if (!gpsd_ais_filtering(&sub->policy)) {
+        free(sub->aisfilter);
+        sub->aisfilter = NULL;
+        return;
+    }
+    if (NULL == sub->aisfilter) {
+        sub->aisfilter = malloc(sizeof(struct ais_filter_t));
+        if (NULL == sub->aisfilter) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "no memory for AIS filters, sending all AIS\n");
+            return;
+        }
+    }
+    gpsd_ais_filter_init(sub->aisfilter, &sub->policy);
+}
+
+/* append one device's ?POLL piece, and a trailing comma, to reply.
+ * Rendered into the cache if it is not already there. */
+static void poll_append(char *reply, size_t replylen,
+                        struct gps_device_t *devp,
+                        const struct gps_policy_t *policy, int which)
+{
+    struct poll_cache_t *pc = &poll_cache[devp - devices];
+    char *piece;
+    bool *valid;
+
+    if ('\0' != policy->fields[0] ||
+        (POLL_TPV == which &&
+         policy->timing)) {
+        /* projections are the poller's own, and timing info is stamped
+         * at dump time, so never cached */
+        size_t len = strnlen(reply, replylen);
+
+        if (POLL_TPV == which) {
+            json_tpv_dump(NAVDATA_SET, devp, policy,
+                          reply + len, replylen - len);
+        } else if (POLL_GST == which) {
+            json_noise_dump(&devp->gpsdata, reply + len, replylen - len);
+        } else {
+            json_sky_dump(&devp->gpsdata, policy,
+                          reply + len, replylen - len);
+        }
+        rstrip(reply);
+        (void)strlcat(reply, ",", replylen);
+        return;
+    }
+
+    switch (which) {
+    case POLL_TPV:
+        piece = pc->tpv;
+        valid = &pc->tpv_valid;
+        break;
+    case POLL_GST:
+        piece = pc->gst;
+        valid = &pc->gst_valid;
+        break;
+    default:
+        piece = pc->sky;
+        valid = &pc->sky_valid;
+        break;
+    }
+
+    if (!*valid) {
+        switch (which) {
+        case POLL_TPV:
+            json_tpv_dump(NAVDATA_SET, devp, policy, piece,
+                          sizeof(pc->tpv));
+            break;
+        case POLL_GST:
+            json_noise_dump(&devp->gpsdata, piece, sizeof(pc->gst));
+            break;
+        default:
+            json_sky_dump(&devp->gpsdata, policy, piece, sizeof(pc->sky));
+            break;
+        }
+        rstrip(piece);
+        *valid = true;
+    }
+    (void)strlcat(reply, piece, replylen);
+    (void)strlcat(reply, ",", replylen);
+}
+
 static void handle_request(struct subscriber_t *sub,
                            const char *buf, const char **after,
                            char *reply, size_t replylen)
@@ -1238,7 +2271,17 @@ static void handle_request(struct subscriber_t *sub,
         } else {
             char *host, *port, *device;  // for parse_uri_dest()
             int status = json_watch_read(buf + 1, &sub->policy, &end);
-
+            const char *why = NULL;
+
+            // new intervals start with the next report of each class
+            (void)memset(sub->decimate, 0, sizeof(sub->decimate));
+            json_watch_fields(&sub->policy);
+            skydelta_reset(sub);
+            // IMU batches start with the next sample
+            for (devp = devices; devp < devices + MAX_DEVICES; devp++) {
+                sub->imunext[devp - devices] = devp->imu.head;
+            }
+            aisfilter_reset(sub);
             if (NULL == end) {
                 buf += strlen(buf);
             } else {
@@ -1254,6 +2297,14 @@ static void handle_request(struct subscriber_t *sub,
                                "\"Invalid WATCH: %s\"}\r\n",
                                json_error_string(status));
                 GPSD_LOG(LOG_ERROR, &context.errout, "response: %s\n", reply);
+            } else if (NULL != (why = gpsd_ais_filter_check(&sub->policy))) {
+                /* a malformed AIS area would filter nothing, so do not
+                 * send the watcher everything it meant to be spared */
+                sub->policy.watcher = false;
+                (void)snprintf(reply, replylen,
+                               "{\"class\":\"ERROR\",\"message\":"
+                               "\"Invalid WATCH: %s\"}\r\n", why);
+                GPSD_LOG(LOG_ERROR, &context.errout, "response: %s\n", reply);
             } else if (sub->policy.watcher) {
                 // enable:true
                 if (sub->policy.devpath[0] == '\0') {
@@ -1509,11 +2560,8 @@ static void handle_request(struct subscriber_t *sub,
         for (devp = devices; devp < devices + MAX_DEVICES; devp++) {
             if (allocated_device(devp) && subscribed(sub, devp)) {
                 if (0 != (devp->observed & GPS_TYPEMASK)) {
-                    json_tpv_dump(NAVDATA_SET, devp, &sub->policy,
-                                  reply + strlen(reply),
-                                  replylen - strlen(reply));
-                    rstrip(reply);
-                    (void)strlcat(reply, ",", replylen);
+                    poll_append(reply, replylen, devp, &sub->policy,
+                                POLL_TPV);
                 }
             }
         }
@@ -1522,11 +2570,8 @@ static void handle_request(struct subscriber_t *sub,
         for (devp = devices; devp < devices + MAX_DEVICES; devp++) {
             if (allocated_device(devp) && subscribed(sub, devp)) {
                 if (0 != (devp->observed & GPS_TYPEMASK)) {
-                    json_noise_dump(&devp->gpsdata,
-                                    reply + strlen(reply),
-                                    replylen - strlen(reply));
-                    rstrip(reply);
-                    (void)strlcat(reply, ",", replylen);
+                    poll_append(reply, replylen, devp, &sub->policy,
+                                POLL_GST);
                 }
             }
         }
@@ -1535,16 +2580,15 @@ static void handle_request(struct subscriber_t *sub,
         for (devp = devices; devp < devices + MAX_DEVICES; devp++) {
             if (allocated_device(devp) && subscribed(sub, devp)) {
                 if (0 != (devp->observed & GPS_TYPEMASK)) {
-                    json_sky_dump(&devp->gpsdata,
-                                  reply + strlen(reply),
-                                  replylen - strlen(reply));
-                    rstrip(reply);
-                    (void)strlcat(reply, ",", replylen);
+                    poll_append(reply, replylen, devp, &sub->policy,
+                                POLL_SKY);
                 }
             }
         }
         str_rstrip_char(reply, ',');
         (void)strlcat(reply, "]}\r\n", replylen);
+        // the poller has the whole skyview now, deltas start over
+        skydelta_reset(sub);
     } else if (str_starts_with(buf, "?VERSION;")) {
         buf += 9;
         json_version_dump(reply, replylen);
@@ -1591,9 +2635,16 @@ static void raw_report(struct subscriber_t *sub, struct gps_device_t *device)
      * super-raw mode.
      */
     if (1 < sub->policy.raw) {
-        (void)throttled_write(sub,
-                              (char *)device->lexer.outbuffer,
-                              device->lexer.outbuflen);
+        if (WS_OPEN == sub->websocket) {
+            // binary packets are not UTF-8, so not text messages
+            (void)ws_write(sub, WS_OP_BINARY,
+                           (char *)device->lexer.outbuffer,
+                           device->lexer.outbuflen);
+        } else {
+            (void)throttled_write(sub,
+                                  (char *)device->lexer.outbuffer,
+                                  device->lexer.outbuflen);
+        }
         return;
     }
 #ifdef BINARY_ENABLE
@@ -1640,35 +2691,196 @@ static void pseudonmea_report(struct subscriber_t *sub,
                      device->gpsdata.dev.path, buf);
             (void)throttled_write(sub, buf, strnlen(buf, sizeof(buf)));
         }
-
-        if (0 != (changed & SUBFRAME_SET)) {
-            nmea_subframe_dump(device, buf, sizeof(buf));
-            GPSD_LOG(LOG_IO, &context.errout,
-                     "<= GPS (binary subframe) %s: %s\n",
-                     device->gpsdata.dev.path, buf);
-            (void)throttled_write(sub, buf, strnlen(buf, sizeof(buf)));
+
+        if (0 != (changed & SUBFRAME_SET)) {
+            nmea_subframe_dump(device, buf, sizeof(buf));
+            GPSD_LOG(LOG_IO, &context.errout,
+                     "<= GPS (binary subframe) %s: %s\n",
+                     device->gpsdata.dev.path, buf);
+            (void)throttled_write(sub, buf, strnlen(buf, sizeof(buf)));
+        }
+#ifdef AIVDM_ENABLE
+        if (0 != (changed & AIS_SET)) {
+            nmea_ais_dump(device, buf, sizeof(buf));
+            GPSD_LOG(LOG_IO, &context.errout,
+                     "<= AIS (binary ais) %s: %s\n",
+                     device->gpsdata.dev.path, buf);
+            (void)throttled_write(sub, buf, strnlen(buf, sizeof(buf)));
+        }
+#endif  // AIVDM_ENABLE
+    }
+}
+#endif  // SOCKET_EXPORT_ENABLE
+
+#ifdef SOCKET_EXPORT_ENABLE
+/* The fast PVT lane, called from gpsd_poll() with a packet that is a
+ * whole fix, before it is merged into the cycle.  Each watcher that
+ * asked for fast_pvt gets it as a TPV now, ahead of anything staged
+ * for it, with writer threads in the urgent lane; the report
+ * at the end of the cycle still follows.  A watcher with a TPV
+ * interval gets it once a slot, see gpsd_decimate_pvt(). */
+static void pvt_report(struct gps_device_t *device, gps_mask_t received)
+{
+    char shared[GPS_JSON_RESPONSE_MAX];
+    size_t sharedlen = 0;
+    struct gps_report_t *reports[2] = {NULL, NULL};
+    struct subscriber_t *sub;
+
+    for (sub = subscribers; sub < (subscribers + MAX_CLIENTS); sub++) {
+        char own[GPS_JSON_RESPONSE_MAX];
+
+        if (0 == sub->active ||
+            !sub->policy.json ||
+            !sub->policy.fast_pvt ||
+            !subscribed(sub, device)) {
+            continue;
+        }
+        if ((0.0 < sub->policy.interval ||
+             0.0 < sub->policy.tpv_interval) &&
+            !gpsd_decimate_pvt(&sub->policy, device,
+                               sub->decimate[device - devices])) {
+            continue;
         }
-#ifdef AIVDM_ENABLE
-        if (0 != (changed & AIS_SET)) {
-            nmea_ais_dump(device, buf, sizeof(buf));
-            GPSD_LOG(LOG_IO, &context.errout,
-                     "<= AIS (binary ais) %s: %s\n",
-                     device->gpsdata.dev.path, buf);
-            (void)throttled_write(sub, buf, strnlen(buf, sizeof(buf)));
+        if (0 != sub->policy.tpv_fields ||
+            sub->policy.timing) {
+            // projected, or timed, for this watcher alone
+            json_pvt_dump(received, device, &sub->policy, own, sizeof(own));
+            (void)urgent_write(sub, own, strnlen(own, sizeof(own)), NULL);
+            continue;
         }
-#endif  // AIVDM_ENABLE
+        if (0 == sharedlen) {
+            json_pvt_dump(received, device, &sub->policy, shared,
+                          sizeof(shared));
+            sharedlen = strnlen(shared, sizeof(shared));
+        }
+        (void)urgent_write(sub, shared, sharedlen, reports);
     }
+    urgent_done(reports);
 }
 #endif  // SOCKET_EXPORT_ENABLE
 
 // report on the current packet from a specified device
+#ifdef SOCKET_EXPORT_ENABLE
+/* Render a report in JSON for one watcher into chain.  One that asked
+ * for SKY deltas gets its SKY last, against what it was sent before.
+ * One that asked for IMU batches gets those, when a window is full,
+ * for its IMU objects. */
+static void watcher_report(struct subscriber_t *sub, gps_mask_t report,
+                           struct gps_device_t *device,
+                           struct gps_chain_t *chain)
+{
+    gps_mask_t own = 0;
+
+    if (NULL != sub->skydelta) {
+        own |= report & (DOP_SET | SATELLITE_SET);
+    }
+    if (0 < sub->policy.imu_batch) {
+        own |= report & IMU_SET;
+    }
+    json_data_emit(report & ~own, device, &sub->policy, chain);
+    if (0 != (own & IMU_SET)) {
+        json_imubatch_emit(device, &sub->policy,
+                           &sub->imunext[device - devices], chain);
+    }
+    if (0 != (own & (DOP_SET | SATELLITE_SET))) {
+        int dev = (int)(device - devices);
+
+        if (dev != sub->skylast) {
+            // the client's skyview is of another device, send it whole
+            sub->skydelta[dev].nsats = -1;
+            sub->skylast = dev;
+        }
+        json_sky_delta_emit(&device->gpsdata, &sub->policy,
+                            &sub->skydelta[dev], chain);
+    }
+}
+
+/*
+ * A report, as rendered for JSON watchers.  The JSON depends on only
+ * the scaled and timing policy bits, so each combination is rendered,
+ * and framed for WebSocket clients, once per report and shared by every
+ * watcher that wants it.  With writer threads it is made once into a
+ * report their clients' writer threads share.  Except with a field
+ * projection, SKY deltas or IMU batches: the last one is for those,
+ * rendered anew for each.
+ */
+struct json_report_t {
+    bool valid;
+    gps_mask_t changed;         // what it reports, decimation differs
+    size_t hdrlen;
+    unsigned char hdr[WS_HEADER_MAX];
+    struct gps_chain_t chain;
+    struct gps_report_t *report;        // with writer threads, or NULL
+};
+// the last 5 are framed for WebSocket clients
+static struct json_report_t json_reports[10];
+
+/* with writer threads, post a report to the client, after what is
+ * staged for it */
+static void json_share(struct subscriber_t *sub, struct json_report_t *jr)
+{
+    size_t len = jr->hdrlen + jr->chain.len;
+
+    if (jr->chain.failed) {
+        GPSD_LOG(LOG_WARN, &context.errout,
+                 "client(%d) report cut short, out of memory\n",
+                 sub_index(sub));
+    }
+    GPSD_TRACE(LOG_CLIENT, &context.errout, TRACE_CLIENT_WRITE,
+               sub_index(sub), jr->chain.len, 0, jr->chain.head->buf,
+               jr->chain.head->len);
+    (void)stage_send(sub);
+    if (NULL == jr->report) {
+        jr->report = gpsd_report_chain(jr->hdr, jr->hdrlen, &jr->chain);
+    }
+    report_share(sub, jr->report, false, len);
+}
+
+static void json_report(struct subscriber_t *sub, gps_mask_t changed,
+                        struct gps_device_t *device)
+{
+    bool ws = WS_OPEN == sub->websocket;
+    struct json_report_t *jr = &json_reports[(ws ? 5 : 0) +
+                                             (sub->policy.scaled ? 2 : 0) +
+                                             (sub->policy.timing ? 1 : 0)];
+
+    if ('\0' != sub->policy.fields[0] ||
+        NULL != sub->skydelta ||
+        0 < sub->policy.imu_batch) {
+        jr = &json_reports[(ws ? 5 : 0) + 4];
+        jr->valid = false;
+    }
+    if (!jr->valid ||
+        jr->changed != changed) {
+        gpsd_chain_release(&jr->chain);
+        gpsd_report_drop(jr->report);
+        jr->report = NULL;
+        watcher_report(sub, changed, device, &jr->chain);
+        jr->changed = changed;
+        jr->hdrlen = ws ? ws_frame_header(jr->hdr, WS_OP_TEXT,
+                                          jr->chain.len) : 0;
+        jr->valid = true;
+    }
+    if (0 == jr->chain.len) {
+        return;
+    }
+    if (0 < writers &&
+        !sub->seqpacket) {
+        json_share(sub, jr);
+    } else {
+        (void)chain_write(sub, jr->hdr, jr->hdrlen, &jr->chain);
+    }
+}
+#endif  // SOCKET_EXPORT_ENABLE
+
 static void all_reports(struct gps_device_t *device, gps_mask_t changed)
 {
 #ifdef SOCKET_EXPORT_ENABLE
     struct subscriber_t *sub;
+    int i;
 
-    GPSD_LOG(LOG_DATA, &context.errout, "all_reports(): changed %s\n",
-             gps_maskdump(changed));
+    GPSD_TRACE(LOG_DATA, &context.errout, TRACE_ALL_REPORTS,
+               changed, 0, 0, NULL, 0);
 
     // add any just-identified device to watcher lists
     if (0 != (changed & DRIVER_IS)) {
@@ -1719,6 +2931,16 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
                      device->lexer.outbuflen);
         } else {
             struct gps_device_t *dp;
+            timespec_t arrival = device->lexer.out_time;
+            unsigned type = 0 != (changed & RTCM3_SET) ?
+                            device->gpsdata.rtcm3.type :
+                            device->gpsdata.rtcm2.type;
+
+            // a quiet gap before a packet starts another epoch
+            if (RTCM_EPOCH_GAP < TS_SUB_D(&arrival, &device->rtcm_time)) {
+                device->rtcm_epoch++;
+            }
+            device->rtcm_time = arrival;
             for (dp = devices; dp < (devices + MAX_DEVICES); dp++) {
                 if (!allocated_device(dp) ||
                     0 > device->gpsdata.gps_fd) {
@@ -1727,9 +2949,16 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
                 if (NULL != dp->device_type &&
                     NULL != dp->device_type->rtcm_writer) {
                     // FIXME: don't write back to source
-                    ssize_t ret = dp->device_type->rtcm_writer(dp,
-                                     (const char *)device->lexer.outbuffer,
-                                     device->lexer.outbuflen);
+                    ssize_t ret;
+
+                    // tag it for the output queue's RTCM policies
+                    dp->outq.kind = OUTQ_RTCM;
+                    dp->outq.type = type;
+                    dp->outq.epoch = device->rtcm_epoch;
+                    ret = dp->device_type->rtcm_writer(dp,
+                              (const char *)device->lexer.outbuffer,
+                              device->lexer.outbuflen);
+                    dp->outq.kind = OUTQ_CONFIG;
                     if (0 < ret) {
                         GPSD_LOG(LOG_IO, &context.errout,
                                  "<= DGPS/NTRIP: %zd bytes of RTCM relayed.\n",
@@ -1822,6 +3051,13 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
         changed |= REPORT_IS;
     }
 
+#ifdef SOCKET_EXPORT_ENABLE
+    /* Any packet may have changed what the ?POLL pieces show: the fix
+     * is merged sentence by sentence, and skyview and DOPs are cleared
+     * at the start of a cycle without a SATELLITE_SET. */
+    poll_cache_invalidate(device);
+#endif  // SOCKET_EXPORT_ENABLE
+
     // a few things are not per-subscriber reports
     if (0 != (changed & REPORT_IS)) {
         if (MODE_3D == device->gpsdata.fix.mode) {
@@ -1851,11 +3087,16 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
                          IMU_SET | REPORT_IS| RTCM2_SET | RTCM3_SET |
                          SATELLITE_SET | SUBFRAME_SET))) {
         // SHM clients updated more often than TCP clients.
-        shm_update(&context, &device->gpsdata);
+        shm_update(&context, (int)(device - devices), &device->gpsdata);
     }
 #endif  // SHM_EXPORT_ENABLE
 
 #ifdef SOCKET_EXPORT_ENABLE
+    // nothing is rendered yet in this cycle
+    for (i = 0; i < NITEMS(json_reports); i++) {
+        json_reports[i].valid = false;
+    }
+
     // update all subscribers associated with this device
     for (sub = subscribers; sub < (subscribers + MAX_CLIENTS); sub++) {
         if (0 == sub->active ||
@@ -1863,13 +3104,14 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
             continue;
         }
 
-        // this is for passing through JSON packets
+        /* this is for passing through JSON packets, the driver
+         * readied the one buffer every JSON watcher gets */
         if (0 != (changed & PASSTHROUGH_IS)) {
-            (void)strlcat((char *)device->lexer.outbuffer, "\r\n",
-                          sizeof(device->lexer.outbuffer));
-            (void)throttled_write(sub,
-                                  (char *)device->lexer.outbuffer,
-                                  device->lexer.outbuflen+2);
+            if (sub->policy.json) {
+                (void)throttled_write(sub,
+                                      (char *)device->lexer.outbuffer,
+                                      device->lexer.outbuflen);
+            }
             continue;
         }
 
@@ -1878,38 +3120,47 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
 
         // some listeners may be in watcher mode
         if (sub->policy.watcher) {
-            if ((changed & DATA_IS) ||
-                (changed & REPORT_IS)) {
+            gps_mask_t report = changed;
+
+            // drop what a low rate watcher does not want, unserialized
+            if (0.0 < sub->policy.interval ||
+                0.0 < sub->policy.tpv_interval ||
+                0.0 < sub->policy.sky_interval ||
+                0.0 < sub->policy.gst_interval) {
+                report = gpsd_decimate(&sub->policy, device, changed,
+                                       sub->decimate[device - devices]);
+            }
+            // likewise AIS a filtering watcher does not want
+            if (0 != (report & AIS_SET) &&
+                NULL != sub->aisfilter &&
+                !gpsd_ais_filter(sub->aisfilter, &sub->policy,
+                                 &device->gpsdata.ais)) {
+                report &= ~AIS_SET;
+            }
+            if ((report & DATA_IS) ||
+                (report & REPORT_IS)) {
                 GPSD_LOG(LOG_PROG, &context.errout,
                          "Changed mask: %s with %sreliable "
                          "cycle detection\n",
-                         gps_maskdump(changed),
+                         gps_maskdump(report),
                          device->cycle_end_reliable ? "" : "un");
-                if (0 != (changed & REPORT_IS)) {
+                if (0 != (report & REPORT_IS)) {
                     GPSD_LOG(LOG_PROG, &context.errout,
                              "time to report a fix\n");
                 }
 
                 if (sub->policy.nmea) {
-                    pseudonmea_report(sub, changed, device);
+                    pseudonmea_report(sub, report, device);
                 }
 
                 if (sub->policy.json) {
-                    char buf[GPS_JSON_RESPONSE_MAX * 4];
-
-                    if (0 != (changed & AIS_SET) &&
+                    if (0 != (report & AIS_SET) &&
                         24 == device->gpsdata.ais.type &&
                         device->gpsdata.ais.type24.part != both &&
                         !sub->policy.split24) {
                         continue;
                     }
-
-                    json_data_report(changed, device, &sub->policy,
-                                     buf, sizeof(buf));
-                    if ('\0' != buf[0]) {
-                        (void)throttled_write(sub, buf,
-                                              strnlen(buf, sizeof(buf)));
-                    }
+                    json_report(sub, report, device);
                 }
             }
         }
@@ -1941,6 +3192,219 @@ static int handle_gpsd_request(struct subscriber_t *sub, const char *buf)
     }
     return (int)throttled_write(sub, reply, strnlen(reply, sizeof(reply)));
 }
+
+// drop len bytes of a WebSocket client's input, from off
+static void ws_consume(struct subscriber_t *sub, size_t off, size_t len)
+{
+    (void)memmove(sub->wsbuf + off, sub->wsbuf + off + len,
+                  sub->wslen - off - len);
+    sub->wslen -= len;
+}
+
+// close a WebSocket client's connection with a status code
+static int ws_refuse(struct subscriber_t *sub, unsigned code,
+                     const char *why)
+{
+    char status[2];
+
+    GPSD_LOG(LOG_WARN, &context.errout,
+             "client(%d) WebSocket %s, closing\n", sub_index(sub), why);
+    status[0] = (char)(code >> 8);
+    status[1] = (char)(code & 0xff);
+    (void)ws_write(sub, WS_OP_CLOSE, status, sizeof(status));
+    return -1;
+}
+
+/* Take input from a WebSocket client: first its HTTP upgrade request,
+ * then frames carrying gpsd requests.
+ *
+ * Return: 0 = OK
+ *         -1 = drop the client
+ */
+static int ws_input(struct subscriber_t *sub, const char *buf, size_t len)
+{
+    unsigned char *payload;
+    size_t paylen;
+    ssize_t used = 0;
+    int opcode;
+    bool fin;
+
+    if (WS_INPUT_MAX - sub->wslen < len) {
+        if (WS_OPEN == sub->websocket) {
+            // 1009, message too big
+            return ws_refuse(sub, 1009, "input overflow");
+        }
+        GPSD_LOG(LOG_WARN, &context.errout,
+                 "client(%d) WebSocket input overflow\n", sub_index(sub));
+        return -1;
+    }
+    (void)memcpy(sub->wsbuf + sub->wslen, buf, len);
+    sub->wslen += len;
+
+    if (WS_HANDSHAKE == sub->websocket) {
+        char reply[GPS_JSON_RESPONSE_MAX];
+
+        used = ws_handshake((char *)sub->wsbuf, sub->wslen,
+                            reply, sizeof(reply));
+        if (0 == used) {
+            return 0;
+        }
+        (void)throttled_write(sub, reply, strnlen(reply, sizeof(reply)));
+        if (0 > used) {
+            GPSD_LOG(LOG_WARN, &context.errout,
+                     "client(%d) bad WebSocket upgrade request\n",
+                     sub_index(sub));
+            return -1;
+        }
+        ws_consume(sub, 0, (size_t)used);
+        sub->websocket = WS_OPEN;
+        GPSD_LOG(LOG_INF, &context.errout,
+                 "client(%d) upgraded to WebSocket\n", sub_index(sub));
+        json_version_dump(reply, sizeof(reply));
+        (void)throttled_write(sub, reply, strnlen(reply, sizeof(reply)));
+    }
+
+    /* Frames follow the fragments of a message gathered so far, which
+     * control frames may come between. */
+    while (WS_OPEN == sub->websocket &&
+           0 < (used = ws_unframe(sub->wsbuf + sub->wsmsg,
+                                  sub->wslen - sub->wsmsg, &opcode, &fin,
+                                  &payload, &paylen))) {
+        char cmd[WS_INPUT_MAX + 2];
+
+        if (WS_OP_CLOSE <= opcode &&
+            (!fin || 125 < paylen)) {
+            return ws_refuse(sub, 1002, "control frame fragmented");
+        }
+        switch (opcode) {
+        case WS_OP_CONT:
+        case WS_OP_TEXT:
+        case WS_OP_BINARY:
+            if ((WS_OP_CONT == opcode) != sub->wsfrag) {
+                return ws_refuse(sub, 1002, "fragment out of sequence");
+            }
+            // the payload goes after what came before it
+            (void)memmove(sub->wsbuf + sub->wsmsg, payload, paylen);
+            sub->wsmsg += paylen;
+            ws_consume(sub, sub->wsmsg, (size_t)used - paylen);
+            if (!fin) {
+                sub->wsfrag = true;
+                continue;
+            }
+            (void)memcpy(cmd, sub->wsbuf, sub->wsmsg);
+            cmd[sub->wsmsg] = '\n';
+            cmd[sub->wsmsg + 1] = '\0';
+            ws_consume(sub, 0, sub->wsmsg);
+            sub->wsmsg = 0;
+            sub->wsfrag = false;
+            GPSD_LOG(LOG_CLIENT, &context.errout,
+                     "<= client(%d): %s\n", sub_index(sub), cmd);
+            if (0 > handle_gpsd_request(sub, cmd)) {
+                return -1;
+            }
+            if (WS_OPEN != sub->websocket) {
+                // a failed write detached the client
+                return -1;
+            }
+            continue;
+        case WS_OP_PING:
+            (void)ws_write(sub, WS_OP_PONG, (char *)payload, paylen);
+            break;
+        case WS_OP_CLOSE:
+            // echo the status code, if any, then hang up
+            (void)ws_write(sub, WS_OP_CLOSE, (char *)payload,
+                           2 < paylen ? 2 : paylen);
+            return -1;
+        default:
+            // unsolicited pongs, and reserved opcodes
+            break;
+        }
+        if (WS_OPEN != sub->websocket) {
+            // a failed write detached the client
+            return -1;
+        }
+        ws_consume(sub, sub->wsmsg, (size_t)used);
+    }
+    if (0 > used) {
+        GPSD_LOG(LOG_WARN, &context.errout,
+                 "client(%d) sent a bad WebSocket frame\n", sub_index(sub));
+        return -1;
+    }
+    return 0;
+}
+
+/* accept a client connection from a listening socket.
+ * websocket is WS_HANDSHAKE for the WebSocket port, else WS_NONE */
+static void accept_client(socket_t lsock, int websocket)
+{
+    sockaddr_t fsin;
+    socklen_t alen = (socklen_t) sizeof(fsin);
+    socket_t ssock = accept(lsock, (struct sockaddr *)&fsin, &alen);
+
+    if (BAD_SOCKET(ssock)) {
+        GPSD_LOG(LOG_ERROR, &context.errout,
+                 "accept: fail: %s(%d)\n", strerror(errno), errno);
+    } else {
+        struct subscriber_t *client = NULL;
+        int opts = fcntl(ssock, F_GETFL);
+        static struct linger linger = { 1, RELEASE_TIMEOUT };
+        char *c_ip;
+
+        if (0 <= opts) {
+            (void)fcntl(ssock, F_SETFL, opts | O_NONBLOCK);
+        }
+
+        c_ip = netlib_sock2ip(ssock);
+        client = allocate_client();
+        if (NULL == client) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "Client %s connect on fd %d -"
+                     "no subscriber slots available\n", c_ip,
+                     ssock);
+            (void)close(ssock);
+        } else if (-1 == setsockopt(ssock,
+                                    SOL_SOCKET, SO_LINGER,
+                                    (char *)&linger,
+                                    (int)sizeof(struct linger))) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "Error: SETSOCKOPT SO_LINGER. %s(%d)\n",
+                     strerror(errno), errno);
+            (void)close(ssock);
+        } else if (WS_NONE != websocket &&
+                   NULL == (client->wsbuf = malloc(WS_INPUT_MAX))) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "Client %s connect on fd %d - "
+                     "no memory for WebSocket input\n", c_ip, ssock);
+            (void)close(ssock);
+            client->fd = UNALLOCATED_FD;
+        } else {
+            int socktype = 0;
+            socklen_t typelen = (socklen_t)sizeof(socktype);
+
+            FD_SET(ssock, &all_fds);
+            adjust_max_fd(ssock, true);
+            client->fd = ssock;
+            client->active = time(NULL);
+            client->websocket = websocket;
+            client->seqpacket =
+                0 == getsockopt(ssock, SOL_SOCKET, SO_TYPE,
+                                (char *)&socktype, &typelen) &&
+                SOCK_SEQPACKET == socktype;
+            GPSD_LOG(LOG_SPIN, &context.errout,
+                     "client %s (%d) connect on fd %d\n", c_ip,
+                     sub_index(client), ssock);
+            // WebSocket clients get the banner once they have upgraded
+            if (WS_NONE == websocket) {
+                char announce[GPS_JSON_RESPONSE_MAX];
+
+                json_version_dump(announce, sizeof(announce));
+                (void)throttled_write(client, announce,
+                                      strnlen(announce,
+                                              sizeof(announce)));
+            }
+        }
+    }
+}
 #endif  // SOCKET_EXPORT_ENABLE
 
 #if defined(CONTROL_SOCKET_ENABLE) && defined(SOCKET_EXPORT_ENABLE)
@@ -1980,7 +3444,11 @@ static void ship_pps_message(struct gps_device_t *session, int unit,
                     session->gpsdata.qErr);
     }
     (void)strlcat(buf, "}\r\n", sizeof(buf));
-    notify_watchers(session, true, true, buf);
+    /* this is the PPS thread, maybe SCHED_FIFO, so the main loop sends
+     * it, see pps_deliver() */
+    if (gpsd_ppsq_put(&ppsq[session - devices], buf)) {
+        ignore_return(write(ppswake[1], "", 1));
+    }
 
     /*
      * PPS receipt resets the device's timeout.  This keeps PPS-only
@@ -2098,7 +3566,12 @@ int main(int argc, char *argv[])
     // some of these statics suppress -W warnings due to longjmp()
 #ifdef SOCKET_EXPORT_ENABLE
     static char *gpsd_service = NULL;
+    static char *websocket_service = NULL;
+    static char *seqpacket_socket = NULL;
+    static socket_t seqsock = -1;
     struct subscriber_t *sub;
+    int wsocks[2] = {-1, -1};
+    bool roomy;                 // a client has room for its held output
 #endif  // SOCKET_EXPORT_ENABLE
     fd_set rfds;
 #ifdef CONTROL_SOCKET_ENABLE
@@ -2108,22 +3581,25 @@ int main(int argc, char *argv[])
     static socket_t csock;
     socket_t cfd;
     static char *control_socket = NULL;
-#endif  // CONTROL_SOCKET_ENABLE
-#if defined(SOCKET_EXPORT_ENABLE) || defined(CONTROL_SOCKET_ENABLE)
     sockaddr_t fsin;
-#endif  // SOCKET_EXPORT_ENABLE || CONTROL_SOCKET_ENABLE
+#endif  // CONTROL_SOCKET_ENABLE
     static char *pid_file = NULL;
     struct gps_device_t *device;
     int i;
     int msocks[2] = {-1, -1};
     bool device_opened = false;
     bool go_background = true;
+    bool memlock = false;
+    struct rt_cpus_t main_cpus = {{0}, 0};
     volatile bool in_restart;
     struct timespec now, delta;
     const char *sudo = getenv("SUDO_COMMAND");
     int uid;
 
     gps_context_init(&context, "gpsd");
+    // the daemon never waits on a device's writes
+    context.serial_write = gpsd_queue_write;
+    context.outq_policy = OUTQ_PRIORITY;
 
 #ifdef CONTROL_SOCKET_ENABLE
     INVALIDATE_SOCKET(csock);
@@ -2131,29 +3607,42 @@ int main(int argc, char *argv[])
     context.pps_hook = ship_pps_message;
 #  endif  // SOCKET_EXPORT_ENABLE
 #endif  // CONTROL_SOCKET_ENABLE
+#ifdef SOCKET_EXPORT_ENABLE
+    context.pvt_hook = pvt_report;
+#endif  // SOCKET_EXPORT_ENABLE
 
     while (1) {
-        const char *optstring = "?bD:F:f:GhlNnpP:rS:s:V";
+        const char *optstring = "?AbC:c:D:F:f:GhLlNnpP:Q:R:rS:s:tu:VW:w:";
         int ch;
 
 #ifdef HAVE_GETOPT_LONG
         int option_index = 0;
         static struct option long_options[] = {
+            {"arrival", no_argument, NULL, 'A'},
             {"badtime", no_argument, NULL, 'r'},
+            {"cpus", required_argument, NULL, 'C'},
             {"debug", required_argument, NULL, 'D'},
             {"drivers", no_argument, NULL, 'l'},
             {"foreground", no_argument, NULL, 'N'},
             {"framing", required_argument, NULL, 'f'},
             {"help", no_argument, NULL, 'h'},
             {"listenany", no_argument, NULL, 'G' },
+            {"memlock", no_argument, NULL, 'L'},
             {"nowait", no_argument, NULL, 'n' },
             {"readonly", no_argument, NULL, 'b'},
             {"passive", no_argument, NULL, 'p'},
             {"pidfile", required_argument, NULL, 'P'},
+            {"ppscpus", required_argument, NULL, 'c'},
+            {"ppsprio", required_argument, NULL, 'R'},
+            {"rtcmqueue", required_argument, NULL, 'Q'},
             {"port", required_argument, NULL, 'S'},
             {"sockfile", required_argument, NULL, 'F'},
             {"speed", required_argument, NULL, 's'},
+            {"trace", no_argument, NULL, 't'},
+            {"seqpacket", required_argument, NULL, 'u'},
             {"version", no_argument, NULL, 'V' },
+            {"websocket", required_argument, NULL, 'W'},
+            {"writers", required_argument, NULL, 'w'},
             {NULL, 0, NULL, 0},
         };
 
@@ -2166,9 +3655,26 @@ int main(int argc, char *argv[])
         }
 
         switch (ch) {
+        case 'A':
+            context.ntp_arrival = true;
+            break;
         case 'b':
             context.readonly = true;
             break;
+        case 'C':
+            if (!rt_cpus_parse(optarg, &main_cpus)) {
+                GPSD_LOG(LOG_ERROR, &context.errout,
+                         "-C has invalid CPU list %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            if (!rt_cpus_parse(optarg, &context.pps_cpus)) {
+                GPSD_LOG(LOG_ERROR, &context.errout,
+                         "-c has invalid CPU list %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'D':
             // accept decimal, octal and hex
             context.errout.debug = (int)strtol(optarg, 0, 0);
@@ -2199,6 +3705,9 @@ int main(int argc, char *argv[])
         case 'G':
             listen_global = true;
             break;
+        case 'L':
+            memlock = true;
+            break;
         case 'l':               // list known device types and exit
             typelist();
             break;
@@ -2214,6 +3723,21 @@ int main(int argc, char *argv[])
         case 'P':
             pid_file = optarg;
             break;
+        case 'Q':
+            if (!rtcm_policy(optarg)) {
+                GPSD_LOG(LOG_ERROR, &context.errout,
+                         "-Q has invalid policy %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'R':
+            context.pps_rtprio = atoi(optarg);
+            if (!rt_prio_valid(context.pps_rtprio)) {
+                GPSD_LOG(LOG_ERROR, &context.errout,
+                         "-R has invalid SCHED_FIFO priority %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'r':
             // -r, --badtime, remove fix checks for good time. DANGEROUS
             context.batteryRTC = true;
@@ -2221,6 +3745,31 @@ int main(int argc, char *argv[])
         case 'S':
 #ifdef SOCKET_EXPORT_ENABLE
             gpsd_service = optarg;
+#endif  // SOCKET_EXPORT_ENABLE
+            break;
+        case 't':
+            trace_defer(true);
+            break;
+        case 'u':
+#ifdef SOCKET_EXPORT_ENABLE
+            seqpacket_socket = optarg;
+#endif  // SOCKET_EXPORT_ENABLE
+            break;
+        case 'W':
+#ifdef SOCKET_EXPORT_ENABLE
+            websocket_service = optarg;
+#endif  // SOCKET_EXPORT_ENABLE
+            break;
+        case 'w':
+#ifdef SOCKET_EXPORT_ENABLE
+            writers = atoi(optarg);
+            if (1 > writers ||
+                FANOUT_SHARDS_MAX < writers) {
+                GPSD_LOG(LOG_ERROR, &context.errout,
+                         "-w needs 1 to %d writer threads, not %s\n",
+                         FANOUT_SHARDS_MAX, optarg);
+                exit(EXIT_FAILURE);
+            }
 #endif  // SOCKET_EXPORT_ENABLE
             break;
         case 's':
@@ -2320,15 +3869,8 @@ int main(int argc, char *argv[])
 #ifdef CONTROL_SOCKET_ENABLE
     if (control_socket &&
         '\0' != control_socket[0]) {
-        if(0 == unlink(control_socket)) {
-            GPSD_LOG(LOG_PROG, &context.errout,
-                     "stale control socket %s removed\n", control_socket);
-        } else {
-            GPSD_LOG(LOG_WARN, &context.errout,
-                     "removing stale control socket %s failed: %s(%d)\n",
-                     control_socket, strerror(errno), errno);
-        }
-        if (BAD_SOCKET(csock = filesock(control_socket))) {
+        unlink_stale(control_socket, "control socket");
+        if (BAD_SOCKET(csock = filesock(control_socket, SOCK_STREAM))) {
             GPSD_LOG(LOG_ERROR, &context.errout,
                      "control socket %s create failed, netlib error %d\n",
                      control_socket, csock);
@@ -2397,6 +3939,17 @@ int main(int argc, char *argv[])
         GPSD_LOG(LOG_INF, &context.errout, "Command line: %s\n", buf);
     }
 
+    // before any thread starts, so they all begin on these CPUs
+    if (0 < main_cpus.count) {
+        int err = rt_pin(&main_cpus);
+
+        if (0 != err) {
+            GPSD_LOG(LOG_WARN, &context.errout,
+                     "can't pin main thread to CPUs: %s(%d)\n",
+                     strerror(err), err);
+        }
+    }
+
 
 #ifdef SOCKET_EXPORT_ENABLE
     if (!gpsd_service) {
@@ -2414,6 +3967,35 @@ int main(int argc, char *argv[])
     }
     GPSD_LOG(LOG_INF, &context.errout, "listening on port %s\n",
                        gpsd_service);
+    if (NULL != websocket_service) {
+        if (1 > passivesocks(websocket_service, "tcp", QLEN, wsocks)) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "WebSocket sockets creation failed, "
+                     "netlib errors %d, %d\n", wsocks[0], wsocks[1]);
+            if (NULL != pid_file) {
+                (void)unlink(pid_file);
+            }
+            exit(EXIT_FAILURE);
+        }
+        GPSD_LOG(LOG_INF, &context.errout,
+                 "listening for WebSocket clients on port %s\n",
+                 websocket_service);
+    }
+    if (NULL != seqpacket_socket &&
+        '\0' != seqpacket_socket[0]) {
+        unlink_stale(seqpacket_socket, "client socket");
+        seqsock = filesock(seqpacket_socket, SOCK_SEQPACKET);
+        if (BAD_SOCKET(seqsock)) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "client socket %s create failed\n", seqpacket_socket);
+            if (NULL != pid_file) {
+                (void)unlink(pid_file);
+            }
+            exit(EXIT_FAILURE);
+        }
+        GPSD_LOG(LOG_INF, &context.errout,
+                 "listening for local clients on %s\n", seqpacket_socket);
+    }
 #endif  // SOCKET_EXPORT_ENABLE
 
     if (0 == getuid()) {
@@ -2426,6 +4008,18 @@ int main(int argc, char *argv[])
                      "PPS: o=priority setting failed. Time accuracy "
                      "will be degraded, %s(%d)\n", strerror(errno), errno);
         }
+        /* PPS threads may start, and memory be mapped, after we are
+         * no longer root */
+        if (0 < context.pps_rtprio ||
+            memlock) {
+            int err = rt_allow(context.pps_rtprio, memlock);
+
+            if (0 != err) {
+                GPSD_LOG(LOG_WARN, &context.errout,
+                         "can't raise RTPRIO or MEMLOCK limit: %s(%d)\n",
+                         strerror(err), err);
+            }
+        }
     }
     /*
      * By initializing before we drop privileges, we guarantee that even
@@ -2451,6 +4045,24 @@ int main(int argc, char *argv[])
     (void)shm_acquire(&context);
 #endif  // SHM_EXPORT_ENABLE
 
+#ifdef SOCKET_EXPORT_ENABLE
+    // before any PPS thread starts, see ship_pps_message()
+    for (i = 0; i < MAX_DEVICES; i++) {
+        gpsd_ppsq_init(&ppsq[i]);
+    }
+    if (0 != pipe(ppswake)) {
+        GPSD_LOG(LOG_ERROR, &context.errout,
+                 "can't make the PPS wakeup pipe: %s(%d)\n",
+                 strerror(errno), errno);
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < 2; i++) {
+        (void)fcntl(ppswake[i], F_SETFL,
+                    fcntl(ppswake[i], F_GETFL) | O_NONBLOCK);
+        (void)fcntl(ppswake[i], F_SETFD, FD_CLOEXEC);
+    }
+#endif  // SOCKET_EXPORT_ENABLE
+
     /*
      * We open devices specified on the command line *before* dropping
      * privileges in case one of them is a serial device with PPS support
@@ -2555,8 +4167,37 @@ int main(int argc, char *argv[])
         subscribers[i].fd = UNALLOCATED_FD;
         (void)pthread_mutex_init(&subscribers[i].mutex, NULL);
     }
+    main_thread = pthread_self();
+    if (0 < writers &&
+        0 == fanout.nshards) {
+        // room for many passes of every client in a shard
+        int err = gpsd_fanout_start(&fanout, writers,
+                                    8 * (MAX_CLIENTS / writers + 1),
+                                    deliver_client, NULL);
+
+        if (0 != err) {
+            GPSD_LOG(LOG_ERROR, &context.errout,
+                     "can't start %d writer threads: %s(%d)\n",
+                     writers, strerror(err), err);
+            exit(EXIT_FAILURE);
+        }
+        GPSD_LOG(LOG_INF, &context.errout,
+                 "%d writer threads serve clients\n", writers);
+    }
 #endif  // SOCKET_EXPORT_ENABLE
 
+    if (memlock) {
+        int err = rt_memlock();
+
+        if (0 != err) {
+            GPSD_LOG(LOG_WARN, &context.errout,
+                     "can't lock gpsd in memory: %s(%d)\n",
+                     strerror(err), err);
+        } else {
+            GPSD_LOG(LOG_INF, &context.errout, "locked in memory\n");
+        }
+    }
+
     {
         struct sigaction sa;
 
@@ -2575,6 +4216,7 @@ int main(int argc, char *argv[])
         (void)sigaction(SIGINT, &sa, NULL);
         (void)sigaction(SIGTERM, &sa, NULL);
         (void)sigaction(SIGQUIT, &sa, NULL);
+        (void)sigaction(SIGUSR2, &sa, NULL);
         (void)signal(SIGPIPE, SIG_IGN);
     }
 
@@ -2593,6 +4235,20 @@ int main(int argc, char *argv[])
             adjust_max_fd(msocks[i], true);
         }
     }
+#ifdef SOCKET_EXPORT_ENABLE
+    for (i = 0; i < AFCOUNT; i++) {
+        if (0 <= wsocks[i]) {
+            FD_SET(wsocks[i], &all_fds);
+            adjust_max_fd(wsocks[i], true);
+        }
+    }
+    if (0 <= seqsock) {
+        FD_SET(seqsock, &all_fds);
+        adjust_max_fd(seqsock, true);
+    }
+    FD_SET(ppswake[0], &all_fds);
+    adjust_max_fd(ppswake[0], true);
+#endif  // SOCKET_EXPORT_ENABLE
 #ifdef CONTROL_SOCKET_ENABLE
     FD_ZERO(&control_fds);
 #endif  // CONTROL_SOCKET_ENABLE
@@ -2617,16 +4273,39 @@ int main(int argc, char *argv[])
 
     while (0 == signalled) {
         fd_set efds;
+        fd_set wfds;
         const timespec_t ts_timeout = {2, 0};   // timeout for pselect()
         timespec_t before, after;        // time before/after gpsd_await_data()
         int await;
         bool time_warp;
 
         time_warp = false;
+        if (0 != trace_requested) {
+            trace_requested = 0;
+            (void)trace_dump(trace_log, NULL);
+        }
         GPSD_LOG(LOG_RAW1, &context.errout, "await data\n");
+        // wait for room on devices with queued output
+        FD_ZERO(&wfds);
+        for (device = devices; device < devices + MAX_DEVICES; device++) {
+            if (allocated_device(device) &&
+                0 <= device->gpsdata.gps_fd &&
+                0 < device->outq.nmsgs) {
+                FD_SET(device->gpsdata.gps_fd, &wfds);
+            }
+        }
+#ifdef SOCKET_EXPORT_ENABLE
+        // and on clients with output held from a short write
+        for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
+            if (UNALLOCATED_FD != sub->fd &&
+                held_waiting(sub)) {
+                FD_SET(sub->fd, &wfds);
+            }
+        }
+#endif  // SOCKET_EXPORT_ENABLE
         (void)clock_gettime(CLOCK_REALTIME, &before);
-        await = gpsd_await_data(&rfds, &efds, maxfd, &all_fds, &context.errout,
-                                ts_timeout);
+        await = gpsd_await_data(&rfds, &wfds, &efds, maxfd, &all_fds,
+                                &context.errout, ts_timeout);
         (void)clock_gettime(CLOCK_REALTIME, &after);
         TS_SUB(&delta, &after, &before);
         if ((1 + ts_timeout.tv_sec) <= llabs(delta.tv_sec)) {
@@ -2666,56 +4345,37 @@ int main(int argc, char *argv[])
         for (i = 0; i < AFCOUNT; i++) {
             if (0 <= msocks[i] &&
                 FD_ISSET(msocks[i], &rfds)) {
-                socklen_t alen = (socklen_t) sizeof(fsin);
-                socket_t ssock =
-                    accept(msocks[i], (struct sockaddr *)&fsin, &alen);
-
-                if (BAD_SOCKET(ssock)) {
-                    GPSD_LOG(LOG_ERROR, &context.errout,
-                             "accept: fail: %s(%d)\n", strerror(errno), errno);
-                } else {
-                    struct subscriber_t *client = NULL;
-                    int opts = fcntl(ssock, F_GETFL);
-                    static struct linger linger = { 1, RELEASE_TIMEOUT };
-                    char *c_ip;
-
-                    if (0 <= opts) {
-                        (void)fcntl(ssock, F_SETFL, opts | O_NONBLOCK);
-                    }
-
-                    c_ip = netlib_sock2ip(ssock);
-                    client = allocate_client();
-                    if (NULL == client) {
-                        GPSD_LOG(LOG_ERROR, &context.errout,
-                                 "Client %s connect on fd %d -"
-                                 "no subscriber slots available\n", c_ip,
-                                    ssock);
-                        (void)close(ssock);
-                    } else if (-1 == setsockopt(ssock,
-                                                SOL_SOCKET, SO_LINGER,
-                                                (char *)&linger,
-                                                (int)sizeof(struct linger))) {
-                        GPSD_LOG(LOG_ERROR, &context.errout,
-                                 "Error: SETSOCKOPT SO_LINGER. %s(%d)\n",
-                                 strerror(errno), errno);
-                        (void)close(ssock);
-                    } else {
-                        char announce[GPS_JSON_RESPONSE_MAX];
-                        FD_SET(ssock, &all_fds);
-                        adjust_max_fd(ssock, true);
-                        client->fd = ssock;
-                        client->active = time(NULL);
-                        GPSD_LOG(LOG_SPIN, &context.errout,
-                                 "client %s (%d) connect on fd %d\n", c_ip,
-                                 sub_index(client), ssock);
-                        json_version_dump(announce, sizeof(announce));
-                        (void)throttled_write(client, announce,
-                                              strnlen(announce,
-                                                      sizeof(announce)));
-                    }
-                }
+                accept_client(msocks[i], WS_NONE);
                 FD_CLR(msocks[i], &rfds);
             }
+            if (0 <= wsocks[i] &&
+                FD_ISSET(wsocks[i], &rfds)) {
+                accept_client(wsocks[i], WS_HANDSHAKE);
+                FD_CLR(wsocks[i], &rfds);
+            }
+        }
+        if (0 <= seqsock &&
+            FD_ISSET(seqsock, &rfds)) {
+            accept_client(seqsock, WS_NONE);
+            FD_CLR(seqsock, &rfds);
+        }
+        // held output, to clients with room for it now
+        roomy = false;
+        for (sub = subscribers; sub < subscribers + MAX_CLIENTS; sub++) {
+            if (UNALLOCATED_FD != sub->fd &&
+                FD_ISSET(sub->fd, &wfds)) {
+                held_room(sub);
+                roomy = true;
+            }
+        }
+        if (roomy &&
+            0 < writers) {
+            gpsd_fanout_publish(&fanout);
+        }
+        // PPS messages, before this pass is corked
+        if (FD_ISSET(ppswake[0], &rfds)) {
+            pps_deliver();
+            FD_CLR(ppswake[0], &rfds);
         }
 #endif  // SOCKET_EXPORT_ENABLE
 
@@ -2768,6 +4428,10 @@ int main(int argc, char *argv[])
 
         // poll all active devices
         GPSD_LOG(LOG_RAW1, &context.errout, "poll active devices\n");
+#ifdef SOCKET_EXPORT_ENABLE
+        // what this pass sends a client goes in one write
+        cork();
+#endif  // SOCKET_EXPORT_ENABLE
         for (device = devices; device < devices + MAX_DEVICES; device++) {
             int multipoll_ret;
 
@@ -2776,6 +4440,9 @@ int main(int argc, char *argv[])
                 continue;
             }
 
+            if (FD_ISSET(device->gpsdata.gps_fd, &wfds)) {
+                (void)gpsd_outq_flush(device);
+            }
             multipoll_ret = gpsd_multipoll(FD_ISSET(device->gpsdata.gps_fd,
                                            &rfds), device, all_reports,
                                            DEVICE_REAWAKE);
@@ -2848,6 +4515,10 @@ int main(int argc, char *argv[])
                 break;
             }
         }
+#ifdef SOCKET_EXPORT_ENABLE
+        // before the replies to client commands, so they come in order
+        uncork();
+#endif  // SOCKET_EXPORT_ENABLE
 
 #ifdef __UNUSED_AUTOCONNECT__
         if (0 < context.fixcnt &&
@@ -2897,6 +4568,11 @@ int main(int argc, char *argv[])
                     detach_client(sub);
                     GPSD_LOG(LOG_CLIENT, &context.errout,
                              "<= client(%d): eof read\n", sub_index(sub));
+                } else if (WS_NONE != sub->websocket) {
+                    sub->active = time(NULL);
+                    if (0 > ws_input(sub, buf, (size_t)buflen)) {
+                        detach_client(sub);
+                    }
                 } else {
                     if ('\n' != buf[buflen - 1]) {
                         buf[buflen++] = '\n';
@@ -2992,6 +4668,10 @@ int main(int argc, char *argv[])
                 }
             }
         }
+        if (0 < writers) {
+            // the writer threads get command replies, and the rest
+            uncork();
+        }
 #endif  // SOCKET_EXPORT_ENABLE
 
         /*
@@ -3049,6 +4729,12 @@ shutdown:
      * This is an attempt to avoid the sporadic race errors at the ends
      * of our regression tests.
      */
+    if (0 < fanout.nshards) {
+        // what the writer threads have queued goes first
+        uncork();
+        gpsd_fanout_stop(&fanout);
+        writers = 0;
+    }
     for (sub = subscribers; sub < (subscribers + MAX_CLIENTS); sub++) {
         if (0 != sub->active) {
             detach_client(sub);
@@ -3060,6 +4746,12 @@ shutdown:
     shm_release(&context);
 #endif  // SHM_EXPORT_ENABLE
 
+#ifdef SOCKET_EXPORT_ENABLE
+    if (0 <= seqsock) {
+        (void)unlink(seqpacket_socket);
+    }
+#endif  // SOCKET_EXPORT_ENABLE
+
 #ifdef CONTROL_SOCKET_ENABLE
     if (control_socket) {
         (void)unlink(control_socket);
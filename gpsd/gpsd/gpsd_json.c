@@ -36,6 +36,14 @@ PERMISSIONS
 /* *INDENT-OFF* */
 #define JSON_BOOL(x)    ((x)?"true":"false")
 
+/* The emitters write a report into a chain, see chain.c.  What they
+ * reserve for a piece bounded in length, a SKY's head or a satellite,
+ * and for a whole report of a class bounded in length. */
+#define JSON_PIECE_MAX  (JSON_VAL_MAX * 2)
+#if GPS_JSON_RESPONSE_MAX > CHAIN_SEGMENT
+#error GPS_JSON_RESPONSE_MAX must fit in a chain segment
+#endif
+
 /*
  * Manifest names for the gnss_type enum - must be kept synced with it.
  * Also, masks so we can tell what packet types correspond to each class.
@@ -56,6 +64,177 @@ struct classmap_t classmap[CLASSMAP_NITEMS] = {
     {"RTCM3",   SEEN_RTCM3,     PACKET_TYPEMASK(RTCM3_PACKET)},
     {"AIS",     SEEN_AIS,       PACKET_TYPEMASK(AIVDM_PACKET)},
 };
+
+/*
+ * Projection: the TPV and SKY attributes a watcher can pick in the
+ * ?WATCH "fields" list.  json_watch_fields() compiles the list to
+ * these, so the dumpers test a bit per attribute.  Attributes that
+ * only ever go out together share one.  "class" always goes out.
+ */
+#define TPVF_DEVICE             (1llu<<0)
+#define TPVF_STATUS             (1llu<<1)
+#define TPVF_MODE               (1llu<<2)
+#define TPVF_TIME               (1llu<<3)
+#define TPVF_LEAPSECONDS        (1llu<<4)
+#define TPVF_EPT                (1llu<<5)
+#define TPVF_LAT                (1llu<<6)
+#define TPVF_LON                (1llu<<7)
+#define TPVF_ALTHAE             (1llu<<8)
+#define TPVF_ALTMSL             (1llu<<9)
+#define TPVF_ALT                (1llu<<10)
+#define TPVF_EPX                (1llu<<11)
+#define TPVF_EPY                (1llu<<12)
+#define TPVF_EPV                (1llu<<13)
+#define TPVF_TRACK              (1llu<<14)
+#define TPVF_MAGTRACK           (1llu<<15)
+#define TPVF_MAGVAR             (1llu<<16)
+#define TPVF_SPEED              (1llu<<17)
+#define TPVF_CLIMB              (1llu<<18)
+#define TPVF_EPD                (1llu<<19)
+#define TPVF_EPS                (1llu<<20)
+#define TPVF_EPC                (1llu<<21)
+#define TPVF_ECEFX              (1llu<<22)
+#define TPVF_ECEFY              (1llu<<23)
+#define TPVF_ECEFZ              (1llu<<24)
+#define TPVF_ECEFVX             (1llu<<25)
+#define TPVF_ECEFVY             (1llu<<26)
+#define TPVF_ECEFVZ             (1llu<<27)
+#define TPVF_ECEFPACC           (1llu<<28)
+#define TPVF_ECEFVACC           (1llu<<29)
+#define TPVF_REL                (1llu<<30)      // relN, relE, relD...
+#define TPVF_VEL                (1llu<<31)      // velN, velE, velD
+#define TPVF_GEOIDSEP           (1llu<<32)
+#define TPVF_TIMING             (1llu<<33)      // rtime, pps, sor...
+#define TPVF_EPH                (1llu<<34)
+#define TPVF_SEP                (1llu<<35)
+#define TPVF_DATUM              (1llu<<36)
+#define TPVF_DEPTH              (1llu<<37)
+#define TPVF_DGPS               (1llu<<38)      // dgpsAge, dgpsSta
+#define TPVF_WANGLEM            (1llu<<39)
+#define TPVF_WANGLER            (1llu<<40)
+#define TPVF_WANGLET            (1llu<<41)
+#define TPVF_WSPEEDR            (1llu<<42)
+#define TPVF_WSPEEDT            (1llu<<43)
+#define TPVF_BASE               (1llu<<44)      // baseS, baseE...
+
+#define SKYF_DEVICE             (1llu<<0)
+#define SKYF_TIME               (1llu<<1)
+#define SKYF_XDOP               (1llu<<2)
+#define SKYF_YDOP               (1llu<<3)
+#define SKYF_VDOP               (1llu<<4)
+#define SKYF_TDOP               (1llu<<5)
+#define SKYF_HDOP               (1llu<<6)
+#define SKYF_GDOP               (1llu<<7)
+#define SKYF_PDOP               (1llu<<8)
+#define SKYF_NSAT               (1llu<<9)
+#define SKYF_USAT               (1llu<<10)
+#define SKYF_SATELLITES         (1llu<<11)      // PRN always, in each
+#define SKYF_SAT_EL             (1llu<<12)
+#define SKYF_SAT_AZ             (1llu<<13)
+#define SKYF_SAT_SS             (1llu<<14)
+#define SKYF_SAT_USED           (1llu<<15)
+#define SKYF_SAT_SVID           (1llu<<16)      // gnssid, svid
+#define SKYF_SAT_SIGID          (1llu<<17)
+#define SKYF_SAT_FREQID         (1llu<<18)
+#define SKYF_SAT_HEALTH         (1llu<<19)
+#define SKYF_SAT_ANY            (SKYF_SAT_EL | SKYF_SAT_AZ | SKYF_SAT_SS | \
+                                 SKYF_SAT_USED | SKYF_SAT_SVID | \
+                                 SKYF_SAT_SIGID | SKYF_SAT_FREQID | \
+                                 SKYF_SAT_HEALTH)
+
+// set in a compiled mask, so a projection that picks nothing is not 0
+#define FIELDS_PROJECTED        (1llu<<63)
+
+static const struct fieldmap_t {
+    const char *name;
+    gps_mask_t tpv;
+    gps_mask_t sky;
+} fieldmap[] = {
+    // name         TPV                 SKY
+    {"alt",         TPVF_ALT,           0},
+    {"altHAE",      TPVF_ALTHAE,        0},
+    {"altMSL",      TPVF_ALTMSL,        0},
+    {"az",          0,                  SKYF_SAT_AZ},
+    {"baseC",       TPVF_BASE,          0},
+    {"baseE",       TPVF_BASE,          0},
+    {"baseL",       TPVF_BASE,          0},
+    {"baseN",       TPVF_BASE,          0},
+    {"baseS",       TPVF_BASE,          0},
+    {"baseU",       TPVF_BASE,          0},
+    {"chars",       TPVF_TIMING,        0},
+    {"climb",       TPVF_CLIMB,         0},
+    {"datum",       TPVF_DATUM,         0},
+    {"depth",       TPVF_DEPTH,         0},
+    {"device",      TPVF_DEVICE,        SKYF_DEVICE},
+    {"dgpsAge",     TPVF_DGPS,          0},
+    {"dgpsSta",     TPVF_DGPS,          0},
+    {"ecefpAcc",    TPVF_ECEFPACC,      0},
+    {"ecefvAcc",    TPVF_ECEFVACC,      0},
+    {"ecefvx",      TPVF_ECEFVX,        0},
+    {"ecefvy",      TPVF_ECEFVY,        0},
+    {"ecefvz",      TPVF_ECEFVZ,        0},
+    {"ecefx",       TPVF_ECEFX,         0},
+    {"ecefy",       TPVF_ECEFY,         0},
+    {"ecefz",       TPVF_ECEFZ,         0},
+    {"el",          0,                  SKYF_SAT_EL},
+    {"epc",         TPVF_EPC,           0},
+    {"epd",         TPVF_EPD,           0},
+    {"eph",         TPVF_EPH,           0},
+    {"eps",         TPVF_EPS,           0},
+    {"ept",         TPVF_EPT,           0},
+    {"epv",         TPVF_EPV,           0},
+    {"epx",         TPVF_EPX,           0},
+    {"epy",         TPVF_EPY,           0},
+    {"freqid",      0,                  SKYF_SAT_FREQID},
+    {"gdop",        0,                  SKYF_GDOP},
+    {"geoidSep",    TPVF_GEOIDSEP,      0},
+    {"gnssid",      0,                  SKYF_SAT_SVID},
+    {"hdop",        0,                  SKYF_HDOP},
+    {"health",      0,                  SKYF_SAT_HEALTH},
+    {"lat",         TPVF_LAT,           0},
+    {"leapseconds", TPVF_LEAPSECONDS,   0},
+    {"lon",         TPVF_LON,           0},
+    {"magtrack",    TPVF_MAGTRACK,      0},
+    {"magvar",      TPVF_MAGVAR,        0},
+    {"mode",        TPVF_MODE,          0},
+    {"nSat",        0,                  SKYF_NSAT},
+    {"pdop",        0,                  SKYF_PDOP},
+    {"pps",         TPVF_TIMING,        0},
+    {"relD",        TPVF_REL,           0},
+    {"relE",        TPVF_REL,           0},
+    {"relH",        TPVF_REL,           0},
+    {"relL",        TPVF_REL,           0},
+    {"relN",        TPVF_REL,           0},
+    {"rollovers",   TPVF_TIMING,        0},
+    {"rtime",       TPVF_TIMING,        0},
+    {"satellites",  0,                  SKYF_SATELLITES},
+    {"sats",        TPVF_TIMING,        0},
+    {"sep",         TPVF_SEP,           0},
+    {"sigid",       0,                  SKYF_SAT_SIGID},
+    {"sor",         TPVF_TIMING,        0},
+    {"speed",       TPVF_SPEED,         0},
+    {"ss",          0,                  SKYF_SAT_SS},
+    {"status",      TPVF_STATUS,        0},
+    {"svid",        0,                  SKYF_SAT_SVID},
+    {"tdop",        0,                  SKYF_TDOP},
+    {"time",        TPVF_TIME,          SKYF_TIME},
+    {"tow",         TPVF_TIMING,        0},
+    {"track",       TPVF_TRACK,         0},
+    {"uSat",        0,                  SKYF_USAT},
+    {"used",        0,                  SKYF_SAT_USED},
+    {"vdop",        0,                  SKYF_VDOP},
+    {"velD",        TPVF_VEL,           0},
+    {"velE",        TPVF_VEL,           0},
+    {"velN",        TPVF_VEL,           0},
+    {"wanglem",     TPVF_WANGLEM,       0},
+    {"wangler",     TPVF_WANGLER,       0},
+    {"wanglet",     TPVF_WANGLET,       0},
+    {"week",        TPVF_TIMING,        0},
+    {"wspeedr",     TPVF_WSPEEDR,       0},
+    {"wspeedt",     TPVF_WSPEEDT,       0},
+    {"xdop",        0,                  SKYF_XDOP},
+    {"ydop",        0,                  SKYF_YDOP},
+};
 /* *INDENT-ON* */
 
 // prevent negative zero confusion.
@@ -251,37 +430,53 @@ static void json_base_dump(const struct baseline_t *base,
     }
 }
 
-void json_tpv_dump(const gps_mask_t changed, const struct gps_device_t *session,
-                   const struct gps_policy_t *policy,
-                   char *reply, size_t replylen)
+// a TPV of fix, the session's or one being parsed, marked if fast
+static void json_fix_dump(const gps_mask_t changed,
+                          const struct gps_device_t *session,
+                          const struct gps_fix_t *fix,
+                          const struct gps_policy_t *policy, bool fast,
+                          char *reply, size_t replylen)
 {
     const struct gps_data_t *gpsdata = &session->gpsdata;
+    // what a projecting watcher asked for, or everything
+    const gps_mask_t want = 0 != policy->tpv_fields ? policy->tpv_fields :
+                            ~(gps_mask_t)0;
 
     assert(replylen > sizeof(char *));
     (void)strlcpy(reply, "{\"class\":\"TPV\"", replylen);
-    if (gpsdata->dev.path[0] != '\0')
+    if (0 != (want & TPVF_DEVICE) &&
+        gpsdata->dev.path[0] != '\0')
         // Note: Assumes /dev paths are always plain ASCII
         str_appendf(reply, replylen, ",\"device\":\"%s\"", gpsdata->dev.path);
-    if (STATUS_DGPS <= gpsdata->fix.status) {
+    if (fast) {
+        (void)strlcat(reply, ",\"fast\":true", replylen);
+    }
+    if (0 != (want & TPVF_STATUS) &&
+        STATUS_DGPS <= fix->status) {
         // to save rebuilding all the regressions, skip UNK and GPS
-        str_appendf(reply, replylen, ",\"status\":%d", gpsdata->fix.status);
+        str_appendf(reply, replylen, ",\"status\":%d", fix->status);
+    }
+    if (0 != (want & TPVF_MODE)) {
+        str_appendf(reply, replylen, ",\"mode\":%d", fix->mode);
     }
-    str_appendf(reply, replylen, ",\"mode\":%d", gpsdata->fix.mode);
-    if (0 < gpsdata->fix.time.tv_sec) {
+    if (0 != (want & TPVF_TIME) &&
+        0 < fix->time.tv_sec) {
         char tbuf[JSON_DATE_MAX+1];
         str_appendf(reply, replylen,
                        ",\"time\":\"%s\"",
-                       timespec_to_iso8601(gpsdata->fix.time,
+                       timespec_to_iso8601(fix->time,
                                       tbuf, sizeof(tbuf)));
     }
-    if (LEAP_SECOND_VALID == (session->context->valid & LEAP_SECOND_VALID)) {
+    if (0 != (want & TPVF_LEAPSECONDS) &&
+        LEAP_SECOND_VALID == (session->context->valid & LEAP_SECOND_VALID)) {
         str_appendf(reply, replylen, ",\"leapseconds\":%d",
                     session->context->leap_seconds);
     }
-    if (0 < gpsdata->fix.time.tv_sec) {
+    if (0 != (want & TPVF_EPT) &&
+        0 < fix->time.tv_sec) {
         // do not output ept if no time.
-        if (isfinite(gpsdata->fix.ept) != 0)
-            str_appendf(reply, replylen, ",\"ept\":%.3f", gpsdata->fix.ept);
+        if (isfinite(fix->ept) != 0)
+            str_appendf(reply, replylen, ",\"ept\":%.3f", fix->ept);
     }
     /*
      * Suppressing TPV fields that would be invalid because the fix
@@ -293,142 +488,172 @@ void json_tpv_dump(const gps_mask_t changed, const struct gps_device_t *session,
      * in the regression tests.  This effect has been seen on SiRF-II
      * chips, which are quite common.
      */
-    if (MODE_2D <= gpsdata->fix.mode) {
+    if (MODE_2D <= fix->mode) {
         double altitude = NAN;
 
-        if (0 != isfinite(gpsdata->fix.latitude)) {
+        if (0 != (want & TPVF_LAT) &&
+            0 != isfinite(fix->latitude)) {
             str_appendf(reply, replylen,
-                           ",\"lat\":%.9f", gpsdata->fix.latitude);
+                           ",\"lat\":%.9f", fix->latitude);
         }
-        if (0 != isfinite(gpsdata->fix.longitude)) {
+        if (0 != (want & TPVF_LON) &&
+            0 != isfinite(fix->longitude)) {
             str_appendf(reply, replylen,
-                           ",\"lon\":%.9f", gpsdata->fix.longitude);
+                           ",\"lon\":%.9f", fix->longitude);
         }
-        if (0 != isfinite(gpsdata->fix.altHAE)) {
-            altitude = gpsdata->fix.altHAE;
-            str_appendf(reply, replylen,
-                           ",\"altHAE\":%.4f", gpsdata->fix.altHAE);
+        if (0 != isfinite(fix->altHAE)) {
+            altitude = fix->altHAE;
+            if (0 != (want & TPVF_ALTHAE)) {
+                str_appendf(reply, replylen,
+                            ",\"altHAE\":%.4f", fix->altHAE);
+            }
         }
-        if (0 != isfinite(gpsdata->fix.altMSL)) {
-            altitude = gpsdata->fix.altMSL;
-            str_appendf(reply, replylen,
-                           ",\"altMSL\":%.4f", gpsdata->fix.altMSL);
+        if (0 != isfinite(fix->altMSL)) {
+            altitude = fix->altMSL;
+            if (0 != (want & TPVF_ALTMSL)) {
+                str_appendf(reply, replylen,
+                            ",\"altMSL\":%.4f", fix->altMSL);
+            }
         }
-        if (0 != isfinite(altitude)) {
+        if (0 != (want & TPVF_ALT) &&
+            0 != isfinite(altitude)) {
             // DEPRECATED, undefined
             str_appendf(reply, replylen,
                            ",\"alt\":%.4f", altitude);
         }
 
-        if (0 != isfinite(gpsdata->fix.epx)) {
-            str_appendf(reply, replylen, ",\"epx\":%.3f", gpsdata->fix.epx);
+        if (0 != (want & TPVF_EPX) &&
+            0 != isfinite(fix->epx)) {
+            str_appendf(reply, replylen, ",\"epx\":%.3f", fix->epx);
         }
-        if (0 != isfinite(gpsdata->fix.epy)) {
-            str_appendf(reply, replylen, ",\"epy\":%.3f", gpsdata->fix.epy);
+        if (0 != (want & TPVF_EPY) &&
+            0 != isfinite(fix->epy)) {
+            str_appendf(reply, replylen, ",\"epy\":%.3f", fix->epy);
         }
-        if (0 != isfinite(gpsdata->fix.epv)) {
-            str_appendf(reply, replylen, ",\"epv\":%.3f", gpsdata->fix.epv);
+        if (0 != (want & TPVF_EPV) &&
+            0 != isfinite(fix->epv)) {
+            str_appendf(reply, replylen, ",\"epv\":%.3f", fix->epv);
         }
-        if (0 != isfinite(gpsdata->fix.track)) {
-            str_appendf(reply, replylen, ",\"track\":%.4f", gpsdata->fix.track);
+        if (0 != (want & TPVF_TRACK) &&
+            0 != isfinite(fix->track)) {
+            str_appendf(reply, replylen, ",\"track\":%.4f", fix->track);
         }
-        if (0 != isfinite(gpsdata->fix.magnetic_track)) {
+        if (0 != (want & TPVF_MAGTRACK) &&
+            0 != isfinite(fix->magnetic_track)) {
                 str_appendf(reply, replylen, ",\"magtrack\":%.4f",
-                            gpsdata->fix.magnetic_track);
+                            fix->magnetic_track);
         }
-        if (0 != isfinite(gpsdata->fix.magnetic_var)) {
+        if (0 != (want & TPVF_MAGVAR) &&
+            0 != isfinite(fix->magnetic_var)) {
                 str_appendf(reply, replylen, ",\"magvar\":%.1f",
-                            gpsdata->fix.magnetic_var);
+                            fix->magnetic_var);
         }
-        if (0 != isfinite(gpsdata->fix.speed)) {
-            str_appendf(reply, replylen, ",\"speed\":%.3f", gpsdata->fix.speed);
+        if (0 != (want & TPVF_SPEED) &&
+            0 != isfinite(fix->speed)) {
+            str_appendf(reply, replylen, ",\"speed\":%.3f", fix->speed);
         }
-        if (MODE_3D <= gpsdata->fix.mode &&
-            0 != isfinite(gpsdata->fix.climb)) {
+        if (0 != (want & TPVF_CLIMB) &&
+            MODE_3D <= fix->mode &&
+            0 != isfinite(fix->climb)) {
             str_appendf(reply, replylen, ",\"climb\":%.3f",
-                        fix_zero(gpsdata->fix.climb, 0.0005));
+                        fix_zero(fix->climb, 0.0005));
         }
-        if (0 != isfinite(gpsdata->fix.epd)) {
-            str_appendf(reply, replylen, ",\"epd\":%.4f", gpsdata->fix.epd);
+        if (0 != (want & TPVF_EPD) &&
+            0 != isfinite(fix->epd)) {
+            str_appendf(reply, replylen, ",\"epd\":%.4f", fix->epd);
         }
-        if (0 != isfinite(gpsdata->fix.eps)) {
-            str_appendf(reply, replylen, ",\"eps\":%.2f", gpsdata->fix.eps);
+        if (0 != (want & TPVF_EPS) &&
+            0 != isfinite(fix->eps)) {
+            str_appendf(reply, replylen, ",\"eps\":%.2f", fix->eps);
         }
-        if (MODE_3D <= gpsdata->fix.mode) {
-            if (0 != isfinite(gpsdata->fix.epc)) {
-                str_appendf(reply, replylen, ",\"epc\":%.2f", gpsdata->fix.epc);
+        if (MODE_3D <= fix->mode) {
+            if (0 != (want & TPVF_EPC) &&
+                0 != isfinite(fix->epc)) {
+                str_appendf(reply, replylen, ",\"epc\":%.2f", fix->epc);
             }
             // ECEF is in meters, so %.3f is millimeter resolution
-            if (0 != isfinite(gpsdata->fix.ecef.x)) {
+            if (0 != (want & TPVF_ECEFX) &&
+                0 != isfinite(fix->ecef.x)) {
                 str_appendf(reply, replylen, ",\"ecefx\":%.2f",
-                            gpsdata->fix.ecef.x);
+                            fix->ecef.x);
             }
-            if (0 != isfinite(gpsdata->fix.ecef.y)) {
+            if (0 != (want & TPVF_ECEFY) &&
+                0 != isfinite(fix->ecef.y)) {
                 str_appendf(reply, replylen, ",\"ecefy\":%.2f",
-                            gpsdata->fix.ecef.y);
+                            fix->ecef.y);
             }
-            if (0 != isfinite(gpsdata->fix.ecef.z)) {
+            if (0 != (want & TPVF_ECEFZ) &&
+                0 != isfinite(fix->ecef.z)) {
                 str_appendf(reply, replylen, ",\"ecefz\":%.2f",
-                            gpsdata->fix.ecef.z);
+                            fix->ecef.z);
             }
-            if (0 != isfinite(gpsdata->fix.ecef.vx)) {
+            if (0 != (want & TPVF_ECEFVX) &&
+                0 != isfinite(fix->ecef.vx)) {
                 str_appendf(reply, replylen, ",\"ecefvx\":%.2f",
-                            fix_zero(gpsdata->fix.ecef.vx, 0.005));
+                            fix_zero(fix->ecef.vx, 0.005));
             }
-            if (0 != isfinite(gpsdata->fix.ecef.vy)) {
+            if (0 != (want & TPVF_ECEFVY) &&
+                0 != isfinite(fix->ecef.vy)) {
                 str_appendf(reply, replylen, ",\"ecefvy\":%.2f",
-                            fix_zero(gpsdata->fix.ecef.vy, 0.005));
+                            fix_zero(fix->ecef.vy, 0.005));
             }
-            if (0 != isfinite(gpsdata->fix.ecef.vz)) {
+            if (0 != (want & TPVF_ECEFVZ) &&
+                0 != isfinite(fix->ecef.vz)) {
                 str_appendf(reply, replylen, ",\"ecefvz\":%.2f",
-                            fix_zero(gpsdata->fix.ecef.vz, 0.005));
+                            fix_zero(fix->ecef.vz, 0.005));
             }
-            if (0 != isfinite(gpsdata->fix.ecef.pAcc)) {
+            if (0 != (want & TPVF_ECEFPACC) &&
+                0 != isfinite(fix->ecef.pAcc)) {
                 str_appendf(reply, replylen, ",\"ecefpAcc\":%.2f",
-                            gpsdata->fix.ecef.pAcc);
+                            fix->ecef.pAcc);
             }
-            if (0 != isfinite(gpsdata->fix.ecef.vAcc)) {
+            if (0 != (want & TPVF_ECEFVACC) &&
+                0 != isfinite(fix->ecef.vAcc)) {
                 str_appendf(reply, replylen, ",\"ecefvAcc\":%.2f",
-                            gpsdata->fix.ecef.vAcc);
+                            fix->ecef.vAcc);
             }
             // NED is in meters, so %.3f is millimeter resolution
-            if (0 != isfinite(gpsdata->fix.NED.relPosN) &&
-                0 != isfinite(gpsdata->fix.NED.relPosE)) {
+            if (0 != (want & TPVF_REL) &&
+                0 != isfinite(fix->NED.relPosN) &&
+                0 != isfinite(fix->NED.relPosE)) {
                 // 2D fix needs relN and relE
                 str_appendf(reply, replylen, ",\"relN\":%.3f,\"relE\":%.3f",
-                            gpsdata->fix.NED.relPosN,
-                            gpsdata->fix.NED.relPosE);
-                if (0 != isfinite(gpsdata->fix.NED.relPosD)) {
+                            fix->NED.relPosN,
+                            fix->NED.relPosE);
+                if (0 != isfinite(fix->NED.relPosD)) {
                     // 3D fix add relD
                     str_appendf(reply, replylen, ",\"relD\":%.3f",
-                                gpsdata->fix.NED.relPosD);
+                                fix->NED.relPosD);
                 }
-                if (0 != isfinite(gpsdata->fix.NED.relPosH) &&
-                    0 != isfinite(gpsdata->fix.NED.relPosL)) {
+                if (0 != isfinite(fix->NED.relPosH) &&
+                    0 != isfinite(fix->NED.relPosL)) {
                     // 2D fix needs relN and relE
                     str_appendf(reply, replylen, ",\"relH\":%.3f,\"relL\":%.3f",
-                                gpsdata->fix.NED.relPosH,
-                                gpsdata->fix.NED.relPosL);
+                                fix->NED.relPosH,
+                                fix->NED.relPosL);
                 }
             }
-            if (0 != isfinite(gpsdata->fix.NED.velN) &&
-                0 != isfinite(gpsdata->fix.NED.velE)) {
+            if (0 != (want & TPVF_VEL) &&
+                0 != isfinite(fix->NED.velN) &&
+                0 != isfinite(fix->NED.velE)) {
                 // 2D fix needs velN and velE
                 str_appendf(reply, replylen,
                             ",\"velN\":%.3f,\"velE\":%.3f",
-                            fix_zero(gpsdata->fix.NED.velN, 0.0005),
-                            fix_zero(gpsdata->fix.NED.velE, 0.0005));
-                if (0 != isfinite(gpsdata->fix.NED.velD)) {
+                            fix_zero(fix->NED.velN, 0.0005),
+                            fix_zero(fix->NED.velE, 0.0005));
+                if (0 != isfinite(fix->NED.velD)) {
                     // 3D fix add velD
                     str_appendf(reply, replylen, ",\"velD\":%.3f",
-                                fix_zero(gpsdata->fix.NED.velD, 0.0005));
+                                fix_zero(fix->NED.velD, 0.0005));
                 }
             }
-            if (0 != isfinite(gpsdata->fix.geoid_sep))
+            if (0 != (want & TPVF_GEOIDSEP) &&
+                0 != isfinite(fix->geoid_sep))
                 str_appendf(reply, replylen, ",\"geoidSep\":%.3f",
-                            gpsdata->fix.geoid_sep);
+                            fix->geoid_sep);
         }
-        if (policy->timing) {
+        if (0 != (want & TPVF_TIMING) &&
+            policy->timing) {
             char rtime_str[TIMESPEC_LEN];
             char ts_buf[TIMESPEC_LEN];
             struct timespec rtime_tmp;
@@ -461,57 +686,88 @@ void json_tpv_dump(const gps_mask_t changed, const struct gps_device_t *session,
                         session->context->rollovers);
         }
         /* at the end because it is new and microjson chokes on new items */
-        if (0 != isfinite(gpsdata->fix.eph)) {
-            str_appendf(reply, replylen, ",\"eph\":%.3f", gpsdata->fix.eph);
+        if (0 != (want & TPVF_EPH) &&
+            0 != isfinite(fix->eph)) {
+            str_appendf(reply, replylen, ",\"eph\":%.3f", fix->eph);
         }
-        if (0 != isfinite(gpsdata->fix.sep)) {
-            str_appendf(reply, replylen, ",\"sep\":%.3f", gpsdata->fix.sep);
+        if (0 != (want & TPVF_SEP) &&
+            0 != isfinite(fix->sep)) {
+            str_appendf(reply, replylen, ",\"sep\":%.3f", fix->sep);
         }
-        if ('\0' != gpsdata->fix.datum[0]) {
+        if (0 != (want & TPVF_DATUM) &&
+            '\0' != fix->datum[0]) {
             str_appendf(reply, replylen, ",\"datum\":\"%.40s\"",
-                        gpsdata->fix.datum);
+                        fix->datum);
         }
-        if (0 != isfinite(gpsdata->fix.depth)) {
+        if (0 != (want & TPVF_DEPTH) &&
+            0 != isfinite(fix->depth)) {
             str_appendf(reply, replylen,
-                           ",\"depth\":%.3f", gpsdata->fix.depth);
+                           ",\"depth\":%.3f", fix->depth);
         }
-        if (0 != isfinite(gpsdata->fix.dgps_age) &&
-            0 <= gpsdata->fix.dgps_station) {
+        if (0 != (want & TPVF_DGPS) &&
+            0 != isfinite(fix->dgps_age) &&
+            0 <= fix->dgps_station) {
             /* both, or none */
             str_appendf(reply, replylen,
-                           ",\"dgpsAge\":%.1f", gpsdata->fix.dgps_age);
+                           ",\"dgpsAge\":%.1f", fix->dgps_age);
             str_appendf(reply, replylen,
-                           ",\"dgpsSta\":%d", gpsdata->fix.dgps_station);
+                           ",\"dgpsSta\":%d", fix->dgps_station);
         }
     }
     if (0 != (changed & NAVDATA_SET)) {
-        if (0 != isfinite(gpsdata->fix.wanglem)){
+        if (0 != (want & TPVF_WANGLEM) &&
+            0 != isfinite(fix->wanglem)){
             str_appendf(reply, replylen,
-                        ",\"wanglem\":%.1f", gpsdata->fix.wanglem);
+                        ",\"wanglem\":%.1f", fix->wanglem);
         }
-        if (0 != isfinite(gpsdata->fix.wangler)){
+        if (0 != (want & TPVF_WANGLER) &&
+            0 != isfinite(fix->wangler)){
             str_appendf(reply, replylen,
-                        ",\"wangler\":%.1f", gpsdata->fix.wangler);
+                        ",\"wangler\":%.1f", fix->wangler);
         }
-        if (0 != isfinite(gpsdata->fix.wanglet)){
+        if (0 != (want & TPVF_WANGLET) &&
+            0 != isfinite(fix->wanglet)){
             str_appendf(reply, replylen,
-                        ",\"wanglet\":%.1f", gpsdata->fix.wanglet);
+                        ",\"wanglet\":%.1f", fix->wanglet);
         }
-        if (0 != isfinite(gpsdata->fix.wspeedr)){
+        if (0 != (want & TPVF_WSPEEDR) &&
+            0 != isfinite(fix->wspeedr)){
             str_appendf(reply, replylen,
-                        ",\"wspeedr\":%.1f", gpsdata->fix.wspeedr);
+                        ",\"wspeedr\":%.1f", fix->wspeedr);
         }
-        if (0 != isfinite(gpsdata->fix.wspeedt)){
+        if (0 != (want & TPVF_WSPEEDT) &&
+            0 != isfinite(fix->wspeedt)){
             str_appendf(reply, replylen,
-                        ",\"wspeedt\":%.1f", gpsdata->fix.wspeedt);
+                        ",\"wspeedt\":%.1f", fix->wspeedt);
         }
     }
-    if (STATUS_UNK != gpsdata->fix.base.status) {
-        json_base_dump(&gpsdata->fix.base, reply, replylen);
+    if (0 != (want & TPVF_BASE) &&
+        STATUS_UNK != fix->base.status) {
+        json_base_dump(&fix->base, reply, replylen);
     }
     (void)strlcat(reply, "}\r\n", replylen);
 }
 
+void json_tpv_dump(const gps_mask_t changed, const struct gps_device_t *session,
+                   const struct gps_policy_t *policy,
+                   char *reply, size_t replylen)
+{
+    json_fix_dump(changed, session, &session->gpsdata.fix, policy, false,
+                  reply, replylen);
+}
+
+/* A TPV of a packet that is a whole fix, see PVT_IS, from newdata as
+ * the driver left it.  Before the merge into the cycle, so without
+ * what gpsd_error_model() would have filled in, and marked "fast" to
+ * tell it from the TPV of the cycle. */
+void json_pvt_dump(const gps_mask_t changed, const struct gps_device_t *session,
+                   const struct gps_policy_t *policy,
+                   char *reply, size_t replylen)
+{
+    json_fix_dump(changed, session, &session->newdata, policy, true,
+                  reply, replylen);
+}
+
 void json_noise_dump(const struct gps_data_t *gpsdata,
                      char *reply, size_t replylen)
 {
@@ -545,17 +801,31 @@ void json_noise_dump(const struct gps_data_t *gpsdata,
     (void)strlcat(reply, "}\r\n", replylen);
 }
 
-void json_sky_dump(const struct gps_data_t *datap,
-                   char *reply, size_t replylen)
+// the SKY attributes a watcher asked for, or everything
+static gps_mask_t sky_want(const struct gps_policy_t *policy)
 {
-    int i, reported = 0, used = 0;
+    gps_mask_t want = 0 != policy->sky_fields ? policy->sky_fields :
+                      ~(gps_mask_t)0;
+
+    if (0 == (want & SKYF_SAT_ANY)) {
+        // satellites, but none of their attributes named, is all of them
+        want |= SKYF_SAT_ANY;
+    }
+    return want;
+}
 
+// start a SKY, up to and including the DOPs
+static void json_sky_head(const struct gps_data_t *datap, gps_mask_t want,
+                          char *reply, size_t replylen)
+{
     assert(replylen > sizeof(char *));
     (void)strlcpy(reply, "{\"class\":\"SKY\"", replylen);
-    if ('\0' != datap->dev.path[0]) {
+    if (0 != (want & SKYF_DEVICE) &&
+        '\0' != datap->dev.path[0]) {
         str_appendf(reply, replylen, ",\"device\":\"%s\"", datap->dev.path);
     }
-    if (0 < datap->skyview_time.tv_sec) {
+    if (0 != (want & SKYF_TIME) &&
+        0 < datap->skyview_time.tv_sec) {
         char tbuf[JSON_DATE_MAX+1];
 
         str_appendf(reply, replylen,
@@ -563,27 +833,97 @@ void json_sky_dump(const struct gps_data_t *datap,
                        timespec_to_iso8601(datap->skyview_time,
                                       tbuf, sizeof(tbuf)));
     }
-    if (0 != isfinite(datap->dop.xdop)) {
+    if (0 != (want & SKYF_XDOP) &&
+        0 != isfinite(datap->dop.xdop)) {
         str_appendf(reply, replylen, ",\"xdop\":%.2f", datap->dop.xdop);
     }
-    if (0 != isfinite(datap->dop.ydop)) {
+    if (0 != (want & SKYF_YDOP) &&
+        0 != isfinite(datap->dop.ydop)) {
         str_appendf(reply, replylen, ",\"ydop\":%.2f", datap->dop.ydop);
     }
-    if (0 != isfinite(datap->dop.vdop)) {
+    if (0 != (want & SKYF_VDOP) &&
+        0 != isfinite(datap->dop.vdop)) {
         str_appendf(reply, replylen, ",\"vdop\":%.2f", datap->dop.vdop);
     }
-    if (0 != isfinite(datap->dop.tdop)) {
+    if (0 != (want & SKYF_TDOP) &&
+        0 != isfinite(datap->dop.tdop)) {
         str_appendf(reply, replylen, ",\"tdop\":%.2f", datap->dop.tdop);
     }
-    if (0 != isfinite(datap->dop.hdop)) {
+    if (0 != (want & SKYF_HDOP) &&
+        0 != isfinite(datap->dop.hdop)) {
         str_appendf(reply, replylen, ",\"hdop\":%.2f", datap->dop.hdop);
     }
-    if (0 != isfinite(datap->dop.gdop)) {
+    if (0 != (want & SKYF_GDOP) &&
+        0 != isfinite(datap->dop.gdop)) {
         str_appendf(reply, replylen, ",\"gdop\":%.2f", datap->dop.gdop);
     }
-    if (0 != isfinite(datap->dop.pdop)) {
+    if (0 != (want & SKYF_PDOP) &&
+        0 != isfinite(datap->dop.pdop)) {
         str_appendf(reply, replylen, ",\"pdop\":%.2f", datap->dop.pdop);
     }
+}
+
+// append one satellite of a SKY, and a trailing comma
+static void json_sat_dump(const struct satellite_t *sp, gps_mask_t want,
+                          char *reply, size_t replylen)
+{
+    str_appendf(reply, replylen, "{\"PRN\":%d", sp->PRN);
+    if (0 != (want & SKYF_SAT_EL) &&
+        0 != isfinite(sp->elevation) &&
+        90 >= fabs(sp->elevation)) {
+        str_appendf(reply, replylen, ",\"el\":%.1f", sp->elevation);
+    }
+    if (0 != (want & SKYF_SAT_AZ) &&
+        0 != isfinite(sp->azimuth) &&
+        0 <= fabs(sp->azimuth) &&
+        359 >= fabs(sp->azimuth)) {
+        str_appendf(reply, replylen, ",\"az\":%.1f", sp->azimuth);
+    }
+    if (0 != (want & SKYF_SAT_SS) &&
+        0 != isfinite(sp->ss)) {
+        str_appendf(reply, replylen, ",\"ss\":%.1f", sp->ss);
+    }
+    if (0 != (want & SKYF_SAT_USED)) {
+        str_appendf(reply, replylen,
+           ",\"used\":%s", sp->used ? "true" : "false");
+    }
+    if (0 != (want & SKYF_SAT_SVID) &&
+        0 != sp->svid) {
+        str_appendf(reply, replylen,
+           ",\"gnssid\":%d,\"svid\":%d", sp->gnssid, sp->svid);
+    }
+    if (0 != (want & SKYF_SAT_SIGID) &&
+        0 != sp->sigid) {
+        str_appendf(reply, replylen, ",\"sigid\":%d", sp->sigid);
+    }
+    if (0 != (want & SKYF_SAT_FREQID) &&
+        GNSSID_GLO == sp->gnssid &&
+        0 <= sp->freqid &&
+        16 >= sp->freqid) {
+        str_appendf(reply, replylen, ",\"freqid\":%d", sp->freqid);
+    }
+    if (0 != (want & SKYF_SAT_HEALTH) &&
+        SAT_HEALTH_UNK != sp->health) {
+        str_appendf(reply, replylen, ",\"health\":%d", sp->health);
+    }
+    (void)strlcat(reply, "},", replylen);
+}
+
+/* Emit a SKY into chain, a satellite at a time, so that a full
+ * skyview of MAXCHANNELS is never cut short. */
+void json_sky_emit(const struct gps_data_t *datap,
+                   const struct gps_policy_t *policy,
+                   struct gps_chain_t *chain)
+{
+    int i, reported = 0, used = 0;
+    gps_mask_t want = sky_want(policy);
+    char *reply = gpsd_chain_reserve(chain, JSON_PIECE_MAX);
+    const size_t replylen = JSON_PIECE_MAX;
+
+    if (NULL == reply) {
+        return;
+    }
+    json_sky_head(datap, want, reply, replylen);
     if (0 != (datap->set & SATELLITE_SET)) {
         // insurance against flaky drivers
         for (i = 0; i < datap->satellites_visible; i++)
@@ -593,60 +933,261 @@ void json_sky_dump(const struct gps_data_t *datap,
                     used++;
                 }
             }
-        str_appendf(reply, replylen, ",\"nSat\":%d,\"uSat\":%d",
-                    reported, used);
-        if (reported) {
+        if (0 != (want & SKYF_NSAT)) {
+            str_appendf(reply, replylen, ",\"nSat\":%d", reported);
+        }
+        if (0 != (want & SKYF_USAT)) {
+            str_appendf(reply, replylen, ",\"uSat\":%d", used);
+        }
+        if (0 != (want & SKYF_SATELLITES) &&
+            0 < reported) {
             (void)strlcat(reply, ",\"satellites\":[", replylen);
+            gpsd_chain_commit(chain, strnlen(reply, replylen));
             for (i = 0; i < reported; i++) {
                 if (datap->skyview[i].PRN) {
-                    str_appendf(reply, replylen, "{\"PRN\":%d",
-                                datap->skyview[i].PRN);
-                    if (0 != isfinite(datap->skyview[i].elevation) &&
-                        90 >= fabs(datap->skyview[i].elevation)) {
-                        str_appendf(reply, replylen, ",\"el\":%.1f",
-                                    datap->skyview[i].elevation);
-                    }
-                    if (0 != isfinite(datap->skyview[i].azimuth) &&
-                        0 <= fabs(datap->skyview[i].azimuth) &&
-                        359 >= fabs(datap->skyview[i].azimuth)) {
-                        str_appendf(reply, replylen, ",\"az\":%.1f",
-                                    datap->skyview[i].azimuth);
-                    }
-                    if (0 != isfinite(datap->skyview[i].ss)) {
-                        str_appendf(reply, replylen, ",\"ss\":%.1f",
-                                    datap->skyview[i].ss);
-                    }
-                    str_appendf(reply, replylen,
-                       ",\"used\":%s",
-                       datap->skyview[i].used ? "true" : "false");
-                    if (0 != datap->skyview[i].svid) {
-                        str_appendf(reply, replylen,
-                           ",\"gnssid\":%d,\"svid\":%d",
-                           datap->skyview[i].gnssid,
-                           datap->skyview[i].svid);
-                    }
-                    if (0 != datap->skyview[i].sigid) {
-                        str_appendf(reply, replylen,
-                           ",\"sigid\":%d", datap->skyview[i].sigid);
+                    reply = gpsd_chain_reserve(chain, JSON_PIECE_MAX);
+                    if (NULL == reply) {
+                        return;
                     }
-                    if (GNSSID_GLO == datap->skyview[i].gnssid &&
-                        0 <= datap->skyview[i].freqid &&
-                        16 >= datap->skyview[i].freqid) {
-                        str_appendf(reply, replylen,
-                           ",\"freqid\":%d", datap->skyview[i].freqid);
-                    }
-                    if (SAT_HEALTH_UNK != datap->skyview[i].health) {
-                        str_appendf(reply, replylen,
-                           ",\"health\":%d", datap->skyview[i].health);
-                    }
-                    (void)strlcat(reply, "},", replylen);
+                    json_sat_dump(&datap->skyview[i], want, reply, replylen);
+                    gpsd_chain_commit(chain, strnlen(reply, replylen));
                 }
             }
-            str_rstrip_char(reply, ',');
-            (void)strlcat(reply, "]", replylen);
+            gpsd_chain_rstrip(chain, ',');
+            gpsd_chain_puts(chain, "]}\r\n");
+            return;
         }
     }
     (void)strlcat(reply, "}\r\n", replylen);
+    gpsd_chain_commit(chain, strnlen(reply, replylen));
+}
+
+void json_sky_dump(const struct gps_data_t *datap,
+                   const struct gps_policy_t *policy,
+                   char *reply, size_t replylen)
+{
+    struct gps_chain_t chain;
+
+    gpsd_chain_init(&chain);
+    json_sky_emit(datap, policy, &chain);
+    (void)gpsd_chain_copy(&chain, reply, replylen);
+    gpsd_chain_release(&chain);
+}
+
+// FNV-1a, to tell if a satellite's JSON changed since it was last sent
+static uint32_t sat_hash(const char *json)
+{
+    uint32_t hash = 2166136261U;
+
+    for (; '\0' != *json; json++) {
+        hash = (hash ^ (unsigned char)*json) * 16777619U;
+    }
+    return hash;
+}
+
+/* A satellite's key packed in 32 bits, never 0, to find satellites a
+ * flaky driver listed twice */
+static uint32_t sat_key(const struct satellite_t *sp)
+{
+    if (0 == sp->svid) {
+        return (uint32_t)(unsigned short)sp->PRN;
+    }
+    return 0x1000000U | (uint32_t)sp->gnssid << 16 |
+           (uint32_t)sp->svid << 8 | sp->sigid;
+}
+
+/* Is entry j of what was last sent the satellite sp?  Satellites with
+ * a svid are keyed by gnssid, svid and sigid, the rest by PRN. */
+static bool sat_sent(const struct sky_delta_t *sent, int j,
+                     const struct satellite_t *sp)
+{
+    if (0 == sp->svid) {
+        return 0 == sent->sats[j].svid && sp->PRN == sent->sats[j].PRN;
+    }
+    return sp->svid == sent->sats[j].svid &&
+           sp->gnssid == sent->sats[j].gnssid &&
+           sp->sigid == sent->sats[j].sigid;
+}
+
+/* Dump a SKY for a watcher that asked for deltas, with sent what it
+ * was last sent of this skyview.  Every policy->sky_delta'th SKY, and
+ * the first, is a full one.  The rest have "delta":true and carry only
+ * the satellites added or changed since the last, and the keys of those
+ * gone in "removed".  DOPs and counts are always sent whole.  A SKY of
+ * just DOPs is a delta with no counts, so the client keeps its skyview.
+ * A skyview with a key twice in it cannot be merged, so goes out whole.
+ * Emitted into chain, like json_sky_emit().
+ */
+void json_sky_delta_emit(const struct gps_data_t *datap,
+                         const struct gps_policy_t *policy,
+                         struct sky_delta_t *sent,
+                         struct gps_chain_t *chain)
+{
+    // the client merges a delta only into a skyview of the same device
+    gps_mask_t want = sky_want(policy) | SKYF_DEVICE;
+    bool gone[MAXCHANNELS];
+    struct sky_delta_t now;
+    uint32_t keys[256];         // hashed by the top byte, MAXCHANNELS fit
+    char *reply;
+    const size_t replylen = JSON_PIECE_MAX;
+    const char *open;
+    int i, j = 0, used = 0;
+    bool keyframe;
+
+    if (0 == (want & SKYF_SATELLITES) ||
+        (0 == (datap->set & SATELLITE_SET) &&
+         0 > sent->nsats)) {
+        // no satellites, nothing to keep track of
+        json_sky_emit(datap, policy, chain);
+        return;
+    }
+    reply = gpsd_chain_reserve(chain, JSON_PIECE_MAX);
+    if (NULL == reply) {
+        return;
+    }
+    if (0 == (datap->set & SATELLITE_SET)) {
+        json_sky_head(datap, want, reply, replylen);
+        (void)strlcat(reply, ",\"delta\":true}\r\n", replylen);
+        gpsd_chain_commit(chain, strnlen(reply, replylen));
+        return;
+    }
+    // a client cannot merge satellites it cannot tell apart
+    want |= SKYF_SAT_SVID | SKYF_SAT_SIGID;
+    keyframe = 0 > sent->nsats || policy->sky_delta <= sent->reports;
+
+    (void)memset(keys, 0, sizeof(keys));
+    now.nsats = 0;
+    for (i = 0; i < datap->satellites_visible; i++) {
+        uint32_t key;
+        unsigned slot;
+
+        if (0 == datap->skyview[i].PRN) {
+            continue;
+        }
+        now.nsats++;
+        if (datap->skyview[i].used) {
+            used++;
+        }
+        key = sat_key(&datap->skyview[i]);
+        slot = (key * 2654435761U) >> 24;
+        while (0 != keys[slot] &&
+               key != keys[slot]) {
+            slot = (slot + 1) & 0xff;
+        }
+        if (key == keys[slot]) {
+            keyframe = true;
+        }
+        keys[slot] = key;
+    }
+
+    if (keyframe) {
+        sent->nsats = 0;
+        sent->reports = 0;
+    }
+    sent->reports++;
+    for (i = 0; i < sent->nsats; i++) {
+        gone[i] = true;
+    }
+
+    json_sky_head(datap, want, reply, replylen);
+    if (0 != (want & SKYF_NSAT)) {
+        str_appendf(reply, replylen, ",\"nSat\":%d", now.nsats);
+    }
+    if (0 != (want & SKYF_USAT)) {
+        str_appendf(reply, replylen, ",\"uSat\":%d", used);
+    }
+    if (!keyframe) {
+        (void)strlcat(reply, ",\"delta\":true", replylen);
+    }
+    gpsd_chain_commit(chain, strnlen(reply, replylen));
+
+    // the array is opened by its first member, if any
+    open = ",\"satellites\":[";
+    now.nsats = 0;
+    for (i = 0; i < datap->satellites_visible && MAXCHANNELS > now.nsats;
+         i++) {
+        const struct satellite_t *sp = &datap->skyview[i];
+        char sat[JSON_VAL_MAX * 2];
+        uint32_t hash;
+
+        if (0 == sp->PRN) {
+            continue;
+        }
+        sat[0] = '\0';
+        json_sat_dump(sp, want, sat, sizeof(sat));
+        hash = sat_hash(sat);
+        now.sats[now.nsats].PRN = sp->PRN;
+        now.sats[now.nsats].gnssid = sp->gnssid;
+        now.sats[now.nsats].svid = sp->svid;
+        now.sats[now.nsats].sigid = sp->sigid;
+        now.sats[now.nsats].hash = hash;
+        now.nsats++;
+
+        // skyviews mostly keep their order, so try the next one first
+        if (j >= sent->nsats ||
+            !sat_sent(sent, j, sp)) {
+            for (j = 0; j < sent->nsats; j++) {
+                if (sat_sent(sent, j, sp)) {
+                    break;
+                }
+            }
+        }
+        if (j < sent->nsats) {
+            gone[j] = false;
+            if (hash == sent->sats[j].hash) {
+                j++;
+                continue;
+            }
+            j++;
+        }
+        gpsd_chain_puts(chain, open);
+        open = "";
+        gpsd_chain_puts(chain, sat);
+    }
+    if ('\0' == open[0]) {
+        gpsd_chain_rstrip(chain, ',');
+        gpsd_chain_puts(chain, "]");
+    }
+
+    open = ",\"removed\":[";
+    for (j = 0; j < sent->nsats; j++) {
+        if (!gone[j]) {
+            continue;
+        }
+        gpsd_chain_puts(chain, open);
+        open = "";
+        gpsd_chain_appendf(chain, "{\"PRN\":%d", sent->sats[j].PRN);
+        if (0 != sent->sats[j].svid) {
+            gpsd_chain_appendf(chain, ",\"gnssid\":%d,\"svid\":%d",
+                               sent->sats[j].gnssid, sent->sats[j].svid);
+        }
+        if (0 != sent->sats[j].sigid) {
+            gpsd_chain_appendf(chain, ",\"sigid\":%d",
+                               sent->sats[j].sigid);
+        }
+        gpsd_chain_puts(chain, "},");
+    }
+    if ('\0' == open[0]) {
+        gpsd_chain_rstrip(chain, ',');
+        gpsd_chain_puts(chain, "]");
+    }
+    gpsd_chain_puts(chain, "}\r\n");
+
+    sent->nsats = now.nsats;
+    (void)memcpy(sent->sats, now.sats, now.nsats * sizeof(now.sats[0]));
+}
+
+void json_sky_delta_dump(const struct gps_data_t *datap,
+                         const struct gps_policy_t *policy,
+                         struct sky_delta_t *sent,
+                         char *reply, size_t replylen)
+{
+    struct gps_chain_t chain;
+
+    gpsd_chain_init(&chain);
+    json_sky_delta_emit(datap, policy, sent, &chain);
+    (void)gpsd_chain_copy(&chain, reply, replylen);
+    gpsd_chain_release(&chain);
 }
 
 void json_device_dump(const struct gps_device_t *device,
@@ -736,6 +1277,8 @@ void json_device_dump(const struct gps_device_t *device,
 void json_watch_dump(const struct gps_policy_t *ccp,
                      char *reply, size_t replylen)
 {
+    int i;
+
     (void)snprintf(reply, replylen,
                    "{\"class\":\"WATCH\",\"enable\":%s,\"json\":%s,"
                    "\"nmea\":%s,\"raw\":%d,\"scaled\":%s,\"timing\":%s,"
@@ -752,9 +1295,114 @@ void json_watch_dump(const struct gps_policy_t *ccp,
     if ('\0' != ccp->devpath[0]) {
         str_appendf(reply, replylen, ",\"device\":\"%s\"", ccp->devpath);
     }
+    if ('\0' != ccp->fields[0]) {
+        // room for every character to be a 6 character \u escape
+        char buf[GPS_FIELDS_MAX * 6];
+
+        str_appendf(reply, replylen, ",\"fields\":\"%s\"",
+                    json_stringify(buf, sizeof(buf), ccp->fields));
+    }
+    // decimation only if asked for, as older clients do not expect it
+    if (0.0 < ccp->interval) {
+        str_appendf(reply, replylen, ",\"interval\":%.3f", ccp->interval);
+    }
+    if (0.0 < ccp->tpv_interval) {
+        str_appendf(reply, replylen, ",\"tpvinterval\":%.3f",
+                    ccp->tpv_interval);
+    }
+    if (0.0 < ccp->sky_interval) {
+        str_appendf(reply, replylen, ",\"skyinterval\":%.3f",
+                    ccp->sky_interval);
+    }
+    if (0.0 < ccp->gst_interval) {
+        str_appendf(reply, replylen, ",\"gstinterval\":%.3f",
+                    ccp->gst_interval);
+    }
+    if (0 < ccp->sky_delta) {
+        str_appendf(reply, replylen, ",\"skydelta\":%d", ccp->sky_delta);
+    }
+    if (0 < ccp->imu_batch) {
+        str_appendf(reply, replylen, ",\"imubatch\":%d", ccp->imu_batch);
+    }
+    if (ccp->fast_pvt) {
+        (void)strlcat(reply, ",\"fastpvt\":true", replylen);
+    }
+    // AIS filters, likewise
+    if (0 < ccp->ais_nbox) {
+        (void)strlcat(reply, ",\"aisbox\":[", replylen);
+        for (i = 0; i < ccp->ais_nbox; i++) {
+            str_appendf(reply, replylen, "%.6f,", ccp->ais_box[i]);
+        }
+        str_rstrip_char(reply, ',');
+        (void)strlcat(reply, "]", replylen);
+    }
+    if (0 < ccp->ais_npoly) {
+        (void)strlcat(reply, ",\"aispoly\":[", replylen);
+        for (i = 0; i < ccp->ais_npoly; i++) {
+            str_appendf(reply, replylen, "%.6f,", ccp->ais_poly[i]);
+        }
+        str_rstrip_char(reply, ',');
+        (void)strlcat(reply, "]", replylen);
+    }
+    if (0 < ccp->ais_nmmsi) {
+        (void)strlcat(reply, ",\"aismmsi\":[", replylen);
+        for (i = 0; i < ccp->ais_nmmsi; i++) {
+            str_appendf(reply, replylen, "%u,", ccp->ais_mmsi[i]);
+        }
+        str_rstrip_char(reply, ',');
+        (void)strlcat(reply, "]", replylen);
+    }
+    if (0 < ccp->ais_nexclude) {
+        (void)strlcat(reply, ",\"aisexclude\":[", replylen);
+        for (i = 0; i < ccp->ais_nexclude; i++) {
+            str_appendf(reply, replylen, "%u,", ccp->ais_exclude[i]);
+        }
+        str_rstrip_char(reply, ',');
+        (void)strlcat(reply, "]", replylen);
+    }
+    if (0 < ccp->ais_ntypes) {
+        (void)strlcat(reply, ",\"aistypes\":[", replylen);
+        for (i = 0; i < ccp->ais_ntypes; i++) {
+            str_appendf(reply, replylen, "%d,", ccp->ais_types[i]);
+        }
+        str_rstrip_char(reply, ',');
+        (void)strlcat(reply, "]", replylen);
+    }
     (void)strlcat(reply, "}\r\n", replylen);
 }
 
+/* Compile the ?WATCH "fields" list of a policy to its tpv_fields and
+ * sky_fields masks.  Names that are not TPV or SKY attributes are
+ * ignored, for cross-version compatibility.  An empty list sends
+ * everything, as before there were projections.
+ */
+void json_watch_fields(struct gps_policy_t *ccp)
+{
+    char buf[GPS_FIELDS_MAX];
+    char *name, *saveptr = NULL;
+
+    ccp->tpv_fields = 0;
+    ccp->sky_fields = 0;
+    if ('\0' == ccp->fields[0]) {
+        return;
+    }
+    ccp->tpv_fields = FIELDS_PROJECTED;
+    ccp->sky_fields = FIELDS_PROJECTED;
+    (void)strlcpy(buf, ccp->fields, sizeof(buf));
+    for (name = strtok_r(buf, ", ", &saveptr); NULL != name;
+         name = strtok_r(NULL, ", ", &saveptr)) {
+        int i;
+
+        for (i = 0; i < NITEMS(fieldmap); i++) {
+            if (0 == strcmp(name, fieldmap[i].name)) {
+                ccp->tpv_fields |= fieldmap[i].tpv;
+                ccp->sky_fields |= fieldmap[i].sky;
+                break;
+            }
+        }
+    }
+}
+
 // dump the hoppity skipity orbit_t
 static void json_subframe_dump_orb(const orbit_t *orbit,
                                    const bool scaled UNUSED,
@@ -1255,78 +1903,86 @@ void json_subframe_dump(const struct gps_data_t *datap, const bool scaled,
 }
 
 // RAW dump - should be good enough to make a RINEX 3 file
-void json_raw_dump(const struct gps_data_t *gpsdata,
-                   char *reply, size_t replylen)
+/* Emit a RAW into chain, a measurement at a time, so that an epoch of
+ * MAXCHANNELS signals is never cut short. */
+void json_raw_emit(const struct gps_data_t *gpsdata,
+                   struct gps_chain_t *chain)
 {
     int i;
 
-    assert(replylen > sizeof(char *));
     if (0 == gpsdata->raw.mtime.tv_sec) {
         // no data to dump
         return;
     }
-    (void)strlcpy(reply, "{\"class\":\"RAW\"", replylen);
+    gpsd_chain_puts(chain, "{\"class\":\"RAW\"");
     if ('\0' != gpsdata->dev.path[0]) {
-        str_appendf(reply, replylen, ",\"device\":\"%s\"", gpsdata->dev.path);
+        gpsd_chain_appendf(chain, ",\"device\":\"%s\"", gpsdata->dev.path);
     }
 
-    str_appendf(reply, replylen, ",\"time\":%lld,\"nsec\":%ld,\"rawdata\":[",
-                (long long)gpsdata->raw.mtime.tv_sec,
-                gpsdata->raw.mtime.tv_nsec);
+    gpsd_chain_appendf(chain, ",\"time\":%lld,\"nsec\":%ld,\"rawdata\":[",
+                       (long long)gpsdata->raw.mtime.tv_sec,
+                       gpsdata->raw.mtime.tv_nsec);
 
     for (i = 0; i < MAXCHANNELS; i++) {
-        if (0 == gpsdata->raw.meas[i].svid ||
-            255 == gpsdata->raw.meas[i].svid) {
+        const struct meas_t *meas = &gpsdata->raw.meas[i];
+
+        if (0 == meas->svid ||
+            255 == meas->svid) {
             // skip empty and GLONASS 255
             continue;
         }
-        str_appendf(reply, replylen,
-                    "{\"gnssid\":%u,\"svid\":%u,\"snr\":%u,"
-                    "\"obs\":\"%s\",\"lli\":%1u,\"locktime\":%u",
-                    gpsdata->raw.meas[i].gnssid, gpsdata->raw.meas[i].svid,
-                    gpsdata->raw.meas[i].snr,
-                    gpsdata->raw.meas[i].obs_code, gpsdata->raw.meas[i].lli,
-                    gpsdata->raw.meas[i].locktime);
-        if (0 < gpsdata->raw.meas[i].sigid) {
-            str_appendf(reply, replylen, ",\"sigid\":%u",
-                        gpsdata->raw.meas[i].sigid);
+        gpsd_chain_appendf(chain,
+                           "{\"gnssid\":%u,\"svid\":%u,\"snr\":%u,"
+                           "\"obs\":\"%s\",\"lli\":%1u,\"locktime\":%u",
+                           meas->gnssid, meas->svid, meas->snr,
+                           meas->obs_code, meas->lli, meas->locktime);
+        if (0 < meas->sigid) {
+            gpsd_chain_appendf(chain, ",\"sigid\":%u", meas->sigid);
         }
-        if (GNSSID_GLO == gpsdata->raw.meas[i].gnssid) {
-            str_appendf(reply, replylen, ",\"freqid\":%u",
-                        gpsdata->raw.meas[i].freqid);
+        if (GNSSID_GLO == meas->gnssid) {
+            gpsd_chain_appendf(chain, ",\"freqid\":%u", meas->freqid);
         }
 
-        if (0 != isfinite(gpsdata->raw.meas[i].pseudorange) &&
-            1.0 < gpsdata->raw.meas[i].pseudorange) {
-            str_appendf(reply, replylen, ",\"pseudorange\":%f",
-                        gpsdata->raw.meas[i].pseudorange);
+        if (0 != isfinite(meas->pseudorange) &&
+            1.0 < meas->pseudorange) {
+            gpsd_chain_appendf(chain, ",\"pseudorange\":%f",
+                               meas->pseudorange);
 
-            if (0 != isfinite(gpsdata->raw.meas[i].carrierphase)) {
-                str_appendf(reply, replylen, ",\"carrierphase\":%f",
-                            gpsdata->raw.meas[i].carrierphase);
+            if (0 != isfinite(meas->carrierphase)) {
+                gpsd_chain_appendf(chain, ",\"carrierphase\":%f",
+                                   meas->carrierphase);
             }
         }
-        if (0 != isfinite(gpsdata->raw.meas[i].doppler)) {
-            str_appendf(reply, replylen, ",\"doppler\":%f",
-                        gpsdata->raw.meas[i].doppler);
+        if (0 != isfinite(meas->doppler)) {
+            gpsd_chain_appendf(chain, ",\"doppler\":%f", meas->doppler);
         }
 
         // L2 C/A pseudo range, RINEX C2C
-        if (0 != isfinite(gpsdata->raw.meas[i].c2c) &&
-            1.0 < gpsdata->raw.meas[i].c2c) {
-            str_appendf(reply, replylen, ",\"c2c\":%f",
-                        gpsdata->raw.meas[i].c2c);
+        if (0 != isfinite(meas->c2c) &&
+            1.0 < meas->c2c) {
+            gpsd_chain_appendf(chain, ",\"c2c\":%f", meas->c2c);
 
             // L2 C/A carrier phase, RINEX L2C
-            if (0 != isfinite(gpsdata->raw.meas[i].l2c)) {
-                str_appendf(reply, replylen, ",\"l2c\":%f",
-                            gpsdata->raw.meas[i].l2c);
+            if (0 != isfinite(meas->l2c)) {
+                gpsd_chain_appendf(chain, ",\"l2c\":%f", meas->l2c);
             }
         }
-        (void)strlcat(reply, "},", replylen);
+        gpsd_chain_puts(chain, "},");
     }
-    str_rstrip_char(reply, ',');
-    (void)strlcat(reply, "]}\r\n", replylen);
+    gpsd_chain_rstrip(chain, ',');
+    gpsd_chain_puts(chain, "]}\r\n");
+}
+
+void json_raw_dump(const struct gps_data_t *gpsdata,
+                   char *reply, size_t replylen)
+{
+    struct gps_chain_t chain;
+
+    assert(replylen > sizeof(char *));
+    gpsd_chain_init(&chain);
+    json_raw_emit(gpsdata, &chain);
+    (void)gpsd_chain_copy(&chain, reply, replylen);
+    gpsd_chain_release(&chain);
 }
 
 #if defined(RTCM104V2_ENABLE)
@@ -4580,6 +5236,122 @@ void json_att_dump(const struct gps_data_t *gpsdata,
     (void)strlcat(reply, "}\r\n", replylen);
 }
 
+/* Emit an IMUBATCH of the n IMU ring samples at idx[], all from one
+ * message, with the same columns. */
+static void imubatch_emit1(const struct gps_device_t *session,
+                           const unsigned idx[], int n,
+                           struct gps_chain_t *chain)
+{
+    static const struct {
+        const char *name;
+        const char *fmt;
+    } cols[IMU_COLS] = {
+        {"acc_x", "%.5f,"},
+        {"acc_y", "%.5f,"},
+        {"acc_z", "%.5f,"},
+        {"gyro_x", "%.5f,"},
+        {"gyro_y", "%.5f,"},
+        {"gyro_z", "%.5f,"},
+        {"gyro_temp", "%.2f,"},
+    };
+    const struct imu_sample_t *ring = session->imu.sample;
+    const struct imu_sample_t *sp = &ring[idx[0]];
+    int c, i;
+
+    gpsd_chain_appendf(chain, "{\"class\":\"IMUBATCH\",\"device\":\"%s\"",
+                       session->gpsdata.dev.path);
+    if (0 < sp->time.tv_sec) {
+        char tbuf[JSON_DATE_MAX+1];
+
+        gpsd_chain_appendf(chain, ",\"time\":\"%s\"",
+                           timespec_to_iso8601(sp->time, tbuf,
+                                               sizeof(tbuf)));
+    }
+    gpsd_chain_appendf(chain, ",\"msg\":\"%.15s\",\"timeTag\":%lu,"
+                       "\"count\":%d,\"dt\":[",
+                       sp->msg, sp->timeTag, n);
+    for (i = 0; i < n; i++) {
+        // time tags are 32 bits, and may wrap in a batch
+        gpsd_chain_appendf(chain, "%ld,", (long)(int32_t)(uint32_t)
+                           (ring[idx[i]].timeTag - sp->timeTag));
+    }
+    gpsd_chain_rstrip(chain, ',');
+    gpsd_chain_puts(chain, "]");
+    for (c = 0; c < IMU_COLS; c++) {
+        if (0 == (sp->cols & (1U << c))) {
+            continue;
+        }
+        gpsd_chain_appendf(chain, ",\"%s\":[", cols[c].name);
+        for (i = 0; i < n; i++) {
+            gpsd_chain_appendf(chain, cols[c].fmt, ring[idx[i]].val[c]);
+        }
+        gpsd_chain_rstrip(chain, ',');
+        gpsd_chain_puts(chain, "]");
+    }
+    gpsd_chain_puts(chain, "}\r\n");
+}
+
+/* Emit, for a watcher that takes IMU samples batched, what of the
+ * session's IMU ring it has not been sent, as IMUBATCH objects, once
+ * they span policy->imu_batch ms, or would fill one.  A receiver that
+ * interleaves messages, as u-blox does ESF-RAW and ESF-MEAS, gets a
+ * batch of each, of up to IMUBATCH_MAX samples in the order they came.
+ * next is the ring count the watcher was sent up to, and is moved on
+ * past what is sent.  Samples overwritten before they could be sent
+ * are skipped.
+ */
+void json_imubatch_emit(const struct gps_device_t *session,
+                        const struct gps_policy_t *policy,
+                        unsigned long *next, struct gps_chain_t *chain)
+{
+    const struct imu_ring_t *imu = &session->imu;
+    const struct imu_sample_t *first, *last;
+    unsigned char sent[IMU_RING / 8];
+    unsigned idx[IMUBATCH_MAX];
+    unsigned long i, j;
+
+    if (*next > imu->head) {
+        // a new device in the slot, start with what it sends next
+        *next = imu->head;
+    } else if (IMU_RING < imu->head - *next) {
+        *next = imu->head - IMU_RING;
+    }
+    if (*next == imu->head) {
+        return;
+    }
+    first = &imu->sample[*next % IMU_RING];
+    last = &imu->sample[(imu->head - 1) % IMU_RING];
+    if (IMUBATCH_MAX > imu->head - *next &&
+        (int64_t)policy->imu_batch * 1000000 >
+        timespec_diff_ns(last->time, first->time)) {
+        return;
+    }
+
+    (void)memset(sent, 0, sizeof(sent));
+    for (i = *next; i < imu->head; i++) {
+        const struct imu_sample_t *sp = &imu->sample[i % IMU_RING];
+        int n = 0;
+
+        if (0 != (sent[(i % IMU_RING) / 8] & (1 << (i % 8)))) {
+            continue;
+        }
+        for (j = i; j < imu->head && IMUBATCH_MAX > n; j++) {
+            unsigned r = (unsigned)(j % IMU_RING);
+            const struct imu_sample_t *np = &imu->sample[r];
+
+            if (0 != (sent[r / 8] & (1 << (r % 8))) ||
+                np->cols != sp->cols ||
+                0 != strcmp(np->msg, sp->msg)) {
+                continue;
+            }
+            sent[r / 8] |= 1 << (r % 8);
+            idx[n++] = r;
+        }
+        imubatch_emit1(session, idx, n, chain);
+    }
+    *next = imu->head;
+}
+
 #ifdef OSCILLATOR_ENABLE
 // dump the contents of an oscillator_t structure as JSON
 void json_oscillator_dump(const struct gps_data_t *datap,
@@ -4596,40 +5368,54 @@ void json_oscillator_dump(const struct gps_data_t *datap,
 }
 #endif  // OSCILLATOR_ENABLE
 
-// report a session state in JSON
-void json_data_report(const gps_mask_t changed,
-                      const struct gps_device_t *session,
-                      const struct gps_policy_t *policy,
-                      char *buf, size_t buflen)
+/* emit what a dumper bounded by GPS_JSON_RESPONSE_MAX renders into
+ * room, reserved at the end of chain */
+#define EMIT_BOUNDED(chain, dump) do {                                  \
+        char *room = gpsd_chain_reserve(chain, GPS_JSON_RESPONSE_MAX);  \
+        if (NULL != room) {                                             \
+            dump;                                                       \
+            gpsd_chain_commit(chain,                                    \
+                              strnlen(room, GPS_JSON_RESPONSE_MAX));    \
+        }                                                               \
+    } while (0)
+
+/* Emit a session state in JSON into chain.  Each class goes on where
+ * the last ended, and RAW and SKY a measurement or satellite at a
+ * time, so a report has no size ceiling. */
+void json_data_emit(const gps_mask_t changed,
+                    const struct gps_device_t *session,
+                    const struct gps_policy_t *policy,
+                    struct gps_chain_t *chain)
 {
     const struct gps_data_t *datap = &session->gpsdata;
-    buf[0] = '\0';
 
     if (0 != (changed & REPORT_IS)) {
-        json_tpv_dump(changed, session, policy,
-                      buf+strlen(buf), buflen-strlen(buf));
+        EMIT_BOUNDED(chain, json_tpv_dump(changed, session, policy, room,
+                                          GPS_JSON_RESPONSE_MAX));
         // attitude is syncronous to epoch, so report like TPV.
         if (0 != (changed & ATTITUDE_SET)) {
-            json_att_dump(datap, buf+strlen(buf), buflen-strlen(buf),
-                          &datap->attitude, "ATT");
+            EMIT_BOUNDED(chain, json_att_dump(datap, room,
+                                              GPS_JSON_RESPONSE_MAX,
+                                              &datap->attitude, "ATT"));
         }
     }
 
     if (0 != (changed & GST_SET)) {
-        json_noise_dump(datap, buf+strlen(buf), buflen-strlen(buf));
+        EMIT_BOUNDED(chain, json_noise_dump(datap, room,
+                                            GPS_JSON_RESPONSE_MAX));
     }
 
     if (0 != (changed & (DOP_SET | SATELLITE_SET))) {
-        json_sky_dump(datap, buf+strlen(buf), buflen-strlen(buf));
+        json_sky_emit(datap, policy, chain);
     }
 
     if (0 != (changed & SUBFRAME_SET)) {
-        json_subframe_dump(datap, policy->scaled, buf+strlen(buf),
-                           buflen-strlen(buf));
+        EMIT_BOUNDED(chain, json_subframe_dump(datap, policy->scaled, room,
+                                               GPS_JSON_RESPONSE_MAX));
     }
 
     if (0 != (changed & RAW_IS)) {
-        json_raw_dump(datap, buf+strlen(buf), buflen-strlen(buf));
+        json_raw_emit(datap, chain);
     }
 
     if (0 != (changed & IMU_SET)) {
@@ -4640,42 +5426,61 @@ void json_data_report(const gps_mask_t changed,
             if ('\0' == datap->imu[cur_imu].msg[0]) {
                 break;
             }
-            json_att_dump(datap, buf+strlen(buf), buflen-strlen(buf),
-                          &datap->imu[cur_imu], "IMU");
+            EMIT_BOUNDED(chain, json_att_dump(datap, room,
+                                              GPS_JSON_RESPONSE_MAX,
+                                              &datap->imu[cur_imu], "IMU"));
         }
     }
 
 #ifdef RTCM104V2_ENABLE
     if (0 != (changed & RTCM2_SET)) {
-        json_rtcm2_dump(&datap->rtcm2, datap->dev.path,
-                        buf + strlen(buf), buflen - strlen(buf));
+        EMIT_BOUNDED(chain, json_rtcm2_dump(&datap->rtcm2, datap->dev.path,
+                                            room, GPS_JSON_RESPONSE_MAX));
     }
 #endif  // RTCM104V2_ENABLE
 
 #ifdef RTCM104V3_ENABLE
     if (0 != (changed & RTCM3_SET)) {
-        json_rtcm3_dump(&datap->rtcm3, datap->dev.path,
-                        buf + strlen(buf), buflen - strlen(buf));
+        EMIT_BOUNDED(chain, json_rtcm3_dump(&datap->rtcm3, datap->dev.path,
+                                            room, GPS_JSON_RESPONSE_MAX));
     }
 #endif  // RTCM104V3_ENABLE
 
 #ifdef AIVDM_ENABLE
     if (0 != (changed & AIS_SET)) {
-        json_aivdm_dump(&datap->ais, datap->dev.path,
-                        policy->scaled,
-                        buf + strlen(buf), buflen - strlen(buf));
+        EMIT_BOUNDED(chain, json_aivdm_dump(&datap->ais, datap->dev.path,
+                                            policy->scaled, room,
+                                            GPS_JSON_RESPONSE_MAX));
     }
 #endif  // AIVDM_ENABLE
 
 #ifdef OSCILLATOR_ENABLE
     if (0 != (changed & OSCILLATOR_SET)) {
-        json_oscillator_dump(datap, buf + strlen(buf), buflen - strlen(buf));
+        EMIT_BOUNDED(chain, json_oscillator_dump(datap, room,
+                                                 GPS_JSON_RESPONSE_MAX));
     }
 #endif // OSCILLATOR_ENABLE
     if (0 != (changed & LOG_SET)) {
-        json_log_dump(session, buf + strlen(buf), buflen - strlen(buf));
+        EMIT_BOUNDED(chain, json_log_dump(session, room,
+                                          GPS_JSON_RESPONSE_MAX));
     }
 }
+#undef EMIT_BOUNDED
+
+/* report a session state in JSON into buf, cut short if it does not
+ * fit, for callers with a fixed buffer */
+void json_data_report(const gps_mask_t changed,
+                      const struct gps_device_t *session,
+                      const struct gps_policy_t *policy,
+                      char *buf, size_t buflen)
+{
+    struct gps_chain_t chain;
+
+    gpsd_chain_init(&chain);
+    json_data_emit(changed, session, policy, &chain);
+    (void)gpsd_chain_copy(&chain, buf, buflen);
+    gpsd_chain_release(&chain);
+}
 
 #undef JSON_BOOL
 #endif  // SOCKET_EXPORT_ENABLE
@@ -409,6 +409,10 @@ void gpsd_deactivate(struct gps_device_t *session)
     }
     // tell any PPS-watcher thread to die
     session->pps_thread.report_hook = NULL;
+    // watchers see head go back, and start again with the next sample
+    free(session->imu.sample);
+    session->imu.sample = NULL;
+    session->imu.head = 0;
     // mark it inactivated
     session->gpsdata.online.tv_sec = 0;
     session->gpsdata.online.tv_nsec = 0;
@@ -462,6 +466,11 @@ void gpsd_clear(struct gps_device_t *session)
     (void)clock_gettime(CLOCK_REALTIME, &session->gpsdata.online);
     lexer_init(&session->lexer);
     session->lexer.errout = session->context->errout;
+    if (SOURCE_UDP == session->sourcetype ||
+        SOURCE_TCP == session->sourcetype ||
+        SOURCE_GPSD == session->sourcetype) {
+        (void)packet_kernel_time(session->gpsdata.gps_fd, &session->lexer);
+    }
     // session->gpsdata.online = 0;
     gps_clear_att(&session->gpsdata.attitude);
     gps_clear_dop(&session->gpsdata.dop);
@@ -1404,11 +1413,13 @@ static void gpsd_error_model(struct gps_device_t *session)
     }
 }
 
-/* await data from any socket in the all_fds set
+/* await data from any socket in the all_fds set, or room to write
+ * on any in wfds.  wfds may be NULL; else it returns the writable ones.
  *
  * return: AWAIT_ value
  */
 int gpsd_await_data(fd_set *rfds,
+                    fd_set *wfds,
                     fd_set *efds,
                     int maxfd,
                     fd_set *all_fds,
@@ -1435,8 +1446,11 @@ int gpsd_await_data(fd_set *rfds,
      */
     errno = 0;
 
-    status = pselect(maxfd + 1, rfds, NULL, NULL, &ts_timeout, NULL);
+    status = pselect(maxfd + 1, rfds, wfds, NULL, &ts_timeout, NULL);
     if (-1 == status) {
+        if (NULL != wfds) {
+            FD_ZERO(wfds);
+        }
         if (EINTR == errno) {
             // caught a signal
             return AWAIT_NOT_READY;
@@ -1552,17 +1566,76 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
     ssize_t newlen;
     bool driver_change = false;
     timespec_t ts_now;
+    timespec_t arrival;         // of the input, or its packet
     timespec_t delta;
     char ts_buf[TIMESPEC_LEN];
 
     // Maybe only clear when we actually get a new packet?  How?
     gps_clear_fix(&session->newdata);
 
+    if (COMMENT_PACKET <= session->lexer.type) {
+        session->observed |= PACKET_TYPEMASK(session->lexer.type);
+    }
+
+    // can we get a full packet from the device/NTRIP/DGPS/tcp/etc.?
+    if (NULL != session->device_type) {
+        newlen = session->device_type->get_packet(session);
+        // coverity[deref_ptr]
+        GPSD_LOG(LOG_RAW, &session->context->errout,
+                 "CORE: %s is known to be %s\n",
+                 session->gpsdata.dev.path,
+                 session->device_type->type_name);
+    } else {
+        newlen = generic_get(session);
+    }
+
+    // update the scoreboard structure from the GPS
+    GPSD_LOG(LOG_RAW1, &session->context->errout,
+             "CORE: %s sent %zd new characters\n",
+             session->gpsdata.dev.path, newlen);
+
+    (void)clock_gettime(CLOCK_REALTIME, &ts_now);
+    TS_SUB(&delta, &ts_now, &session->gpsdata.online);
+    if (0 > newlen) {           // read error
+        GPSD_LOG(LOG_INF, &session->context->errout,
+                 "CORE: %s returned error %zd (%s sec since data)\n",
+                 session->gpsdata.dev.path, newlen,
+                 timespec_str(&delta, ts_buf, sizeof(ts_buf)));
+        session->gpsdata.online.tv_sec = 0;
+        session->gpsdata.online.tv_nsec = 0;
+        return ERROR_SET;
+    }
+    if (0 == newlen) {           // zero length read, possible EOF
+        /*
+         * Multiplier is 2 to avoid edge effects due to sampling at the exact
+         * wrong time...
+         */
+        if (0 < session->gpsdata.online.tv_sec &&
+            // FIXME: do this with integer math...
+            TSTONS(&delta) >= (TSTONS(&session->gpsdata.dev.cycle) * 2)) {
+            GPSD_LOG(LOG_INF, &session->context->errout,
+                     "CORE: %s is offline (%s sec since data)\n",
+                     session->gpsdata.dev.path,
+                     timespec_str(&delta, ts_buf, sizeof(ts_buf)));
+            session->gpsdata.online.tv_sec = 0;
+            session->gpsdata.online.tv_nsec = 0;
+        }
+        return NODATA_IS;
+    }
+    // else (0 < newlen), got a whole message, or some of one
+
+    /* Time things by when the input arrived, not by when we got to
+     * it.  Other devices, and clients, may have kept us a while. */
+    if (TS_NZ(&session->lexer.read_time)) {
+        arrival = session->lexer.read_time;
+    } else {
+        // not read by packet_get(), so no arrival times
+        arrival = ts_now;
+    }
     /*
-     * Input just became available from a sensor, but no read from the
-     * device has yet been done.
+     * Input just arrived from a sensor.
      *
-     * What we actually do here is trickier.  For latency-timing
+     * What we do with it here is trickier.  For latency-timing
      * purposes, we want to know the time at the start of the current
      * recording cycle. We rely on the fact that even at 4800bps
      * there's a quiet time perceptible to the human eye in gpsmon
@@ -1571,7 +1644,7 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
      * ships. Because the cycle time is fixed, higher baud rates will
      * make this gap larger.
      *
-     * Thus, we look for an inter-character delay much larger than an
+     * Thus, we look for a delay between arrivals much larger than an
      * average 4800bps sentence time.  How should this delay be set?  Well,
      * counting framing bits and erring on the side of caution, it's
      * about 480 characters per second or 2083 microeconds per character;
@@ -1594,22 +1667,14 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
      * with the data they transmit.
      */
 #define MINIMUM_QUIET_TIME      0.25
-    if (0 == session->lexer.outbuflen) {
-        /* beginning of a new packet, or not...
-         * 0 == lexer.outbuf just means the last read was not a full packet.
-         * that works on serial lines that dribble data.
-         * usb tends to only send complete packets.
-         * Worse, we do not know if we have a full packet this time.
-         */
-        (void)clock_gettime(CLOCK_REALTIME, &ts_now);
+    if (!TS_EQ(&arrival, &session->lexer.start_time)) {
         if (NULL != session->device_type &&
-            (0 < session->lexer.start_time.tv_sec ||
-             0 < session->lexer.start_time.tv_nsec)) {
+            TS_NZ(&session->lexer.start_time)) {
             const double min_cycle = TSTONS(&session->device_type->min_cycle);
             double quiet_time = (MINIMUM_QUIET_TIME * min_cycle);
             double gap;
 
-            gap = TS_SUB_D(&ts_now, &session->lexer.start_time);
+            gap = TS_SUB_D(&arrival, &session->lexer.start_time);
 
             // used to comare gap > min_cycle, but min_cycle is now
             // so variable as to be not helpful.  Some GPS models can
@@ -1620,64 +1685,18 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
                 GPSD_LOG(LOG_PROG, &session->context->errout,
                          "CORE: transmission pause. gap %f quiet_time %f\n",
                          gap, quiet_time);
-                session->sor = ts_now;
+                session->sor = arrival;
                 session->lexer.start_char = session->lexer.char_counter;
             }
         }
-        session->lexer.start_time = ts_now;
+        session->lexer.start_time = arrival;
     }
-
-    if (COMMENT_PACKET <= session->lexer.type) {
-        session->observed |= PACKET_TYPEMASK(session->lexer.type);
-    }
-
-    // can we get a full packet from the device/NTRIP/DGPS/tcp/etc.?
-    if (NULL != session->device_type) {
-        newlen = session->device_type->get_packet(session);
-        // coverity[deref_ptr]
-        GPSD_LOG(LOG_RAW, &session->context->errout,
-                 "CORE: %s is known to be %s\n",
-                 session->gpsdata.dev.path,
-                 session->device_type->type_name);
-    } else {
-        newlen = generic_get(session);
+    if (0 < session->lexer.outbuflen &&
+        TS_NZ(&session->lexer.out_time)) {
+        // the packet's first byte
+        arrival = session->lexer.out_time;
     }
-
-    // update the scoreboard structure from the GPS
-    GPSD_LOG(LOG_RAW1, &session->context->errout,
-             "CORE: %s sent %zd new characters\n",
-             session->gpsdata.dev.path, newlen);
-
-    (void)clock_gettime(CLOCK_REALTIME, &ts_now);
-    TS_SUB(&delta, &ts_now, &session->gpsdata.online);
-    if (0 > newlen) {           // read error
-        GPSD_LOG(LOG_INF, &session->context->errout,
-                 "CORE: %s returned error %zd (%s sec since data)\n",
-                 session->gpsdata.dev.path, newlen,
-                 timespec_str(&delta, ts_buf, sizeof(ts_buf)));
-        session->gpsdata.online.tv_sec = 0;
-        session->gpsdata.online.tv_nsec = 0;
-        return ERROR_SET;
-    }
-    if (0 == newlen) {           // zero length read, possible EOF
-        /*
-         * Multiplier is 2 to avoid edge effects due to sampling at the exact
-         * wrong time...
-         */
-        if (0 < session->gpsdata.online.tv_sec &&
-            // FIXME: do this with integer math...
-            TSTONS(&delta) >= (TSTONS(&session->gpsdata.dev.cycle) * 2)) {
-            GPSD_LOG(LOG_INF, &session->context->errout,
-                     "CORE: %s is offline (%s sec since data)\n",
-                     session->gpsdata.dev.path,
-                     timespec_str(&delta, ts_buf, sizeof(ts_buf)));
-            session->gpsdata.online.tv_sec = 0;
-            session->gpsdata.online.tv_nsec = 0;
-        }
-        return NODATA_IS;
-    }
-    // else (0 < newlen), got a whole message
-    session->lexer.pkt_time = ts_now;
+    session->lexer.pkt_time = arrival;
 
     GPSD_LOG(LOG_RAW, &session->context->errout,
              "CORE: packet sniff on %s finds type %d\n",
@@ -1769,7 +1788,7 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
 
     // we have recognized a packet
     gps_mask_t received = PACKET_SET;
-    (void)clock_gettime(CLOCK_REALTIME, &session->gpsdata.online);
+    session->gpsdata.online = arrival;
 
     GPSD_LOG(LOG_RAW1, &session->context->errout,
              "CORE: Accepted packet on %s.\n",
@@ -1828,22 +1847,28 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
         session->device_type->event_hook(session, event_configure);
     }
 
-    GPSD_LOG(LOG_RAW, &session->context->errout,
-             "CORE: raw packet of type %d, %zd:%s\n",
-             session->lexer.type,
-             session->lexer.outbuflen,
-             gpsd_prettydump(session));
+    GPSD_TRACE(LOG_RAW, &session->context->errout, TRACE_CORE_RAW,
+               session->lexer.type, session->lexer.outbuflen, 0,
+               session->lexer.outbuffer, session->lexer.outbuflen);
 
     // Get data from current packet into the fix structure
     if (COMMENT_PACKET != session->lexer.type) {
         if (NULL != session->device_type &&
             NULL != session->device_type->parse_packet) {
             received |= session->device_type->parse_packet(session);
-            GPSD_LOG(LOG_SPIN, &session->context->errout,
-                     "CORE: parse_packet() = %s\n", gps_maskdump(received));
+            GPSD_TRACE(LOG_SPIN, &session->context->errout,
+                       TRACE_CORE_PARSE, received, 0, 0, NULL, 0);
         }
     }
 
+    /* A packet that is a whole fix can go out now, as the driver left
+     * it, without waiting for the merge, the error model and the end
+     * of its cycle. */
+    if (0 != (received & PVT_IS) &&
+        NULL != session->context->pvt_hook) {
+        session->context->pvt_hook(session, received);
+    }
+
     /*
      * We may want to revert to the last driver that was marked
      * sticky.  What this accomplishes is that if we've just
@@ -1949,10 +1974,10 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
         }
     }
 
-    GPSD_LOG(LOG_DATA, &session->context->errout,
-             "CORE: gpsd_poll(%s) %s\n",
-             session->gpsdata.dev.path,
-             gps_maskdump(session->gpsdata.set));
+    GPSD_TRACE(LOG_DATA, &session->context->errout, TRACE_CORE_POLL,
+               session->gpsdata.set, 0, 0, session->gpsdata.dev.path,
+               strnlen(session->gpsdata.dev.path,
+                       sizeof(session->gpsdata.dev.path)));
     return session->gpsdata.set;
 }
 
@@ -2077,16 +2102,18 @@ int gpsd_multipoll(const bool data_ready,
 
             // conditional prevents mask dumper from eating CPU
             if (LOG_DATA <= device->context->errout.debug) {
+                size_t pathlen = strnlen(device->gpsdata.dev.path,
+                                         sizeof(device->gpsdata.dev.path));
+
                 if (BAD_PACKET == device->lexer.type) {
-                    GPSD_LOG(LOG_DATA, &device->context->errout,
-                             "CORE: packet with bad checksum from %s\n",
-                             device->gpsdata.dev.path);
+                    GPSD_TRACE(LOG_DATA, &device->context->errout,
+                               TRACE_CORE_BADSUM, 0, 0, 0,
+                               device->gpsdata.dev.path, pathlen);
                 } else {
-                    GPSD_LOG(LOG_DATA, &device->context->errout,
-                             "CORE: packet type %d from %s with %s\n",
-                             device->lexer.type,
-                             device->gpsdata.dev.path,
-                             gps_maskdump(device->gpsdata.set));
+                    GPSD_TRACE(LOG_DATA, &device->context->errout,
+                               TRACE_CORE_PACKET, device->lexer.type,
+                               device->gpsdata.set, 0,
+                               device->gpsdata.dev.path, pathlen);
                 }
             }
 
@@ -2188,6 +2215,138 @@ void gpsd_zero_satellites( struct gps_data_t *out)
 #endif
 }
 
+/* Is a report, of time ts and class interval interval, the first in
+ * its slot, recorded in *slot?  See gpsd_decimate(). */
+static bool decimate_slot(const struct gps_policy_t *policy,
+                          const struct gps_device_t *session,
+                          double interval, const timespec_t *ts,
+                          long long *slot)
+{
+    long long width, now;
+
+    if (0 == isfinite(interval) ||
+        0.0 >= interval) {
+        interval = policy->interval;
+    }
+    if (0 == isfinite(interval) ||
+        1e-6 > interval ||
+        1e6 < interval) {
+        // every report, or nonsense
+        return true;
+    }
+    // whole nanoseconds, so slots never drift off the second
+    width = (long long)(interval * 1e9 + 0.5);
+    if (!TS_NZ(ts)) {
+        ts = &session->lexer.pkt_time;
+    }
+    if (!TS_NZ(ts)) {
+        return true;
+    }
+    now = ((long long)ts->tv_sec * NS_IN_SEC + ts->tv_nsec) / width + 1;
+    if (now == *slot) {
+        return false;
+    }
+    *slot = now;
+    return true;
+}
+
+/* Take out of changed the reports a watcher has asked to get fewer of,
+ * before any of them are serialized for it.  A class with an interval
+ * goes out once per slot of that many seconds of its UTC time, the
+ * first report in the slot, so a 1 second watcher of a 10 Hz receiver
+ * gets the fix at the top of each second.  slot[DECIMATE_CLASSES] is
+ * the watcher's own, for this device: the slot each class last went
+ * out in, 0 for none yet.  A report with no time of its own is slotted
+ * by when its packet arrived.
+ *
+ * Return: changed, less what the watcher does not want yet
+ */
+gps_mask_t gpsd_decimate(const struct gps_policy_t *policy,
+                         const struct gps_device_t *session,
+                         gps_mask_t changed, long long slot[])
+{
+    const struct gps_data_t *gpsdata = &session->gpsdata;
+    struct {
+        gps_mask_t mask;
+        double interval;
+        const timespec_t *time;
+    } classes[DECIMATE_CLASSES];
+    int i;
+
+    classes[DECIMATE_TPV].mask = REPORT_IS;
+    classes[DECIMATE_TPV].interval = policy->tpv_interval;
+    classes[DECIMATE_TPV].time = &gpsdata->fix.time;
+    classes[DECIMATE_SKY].mask = DOP_SET | SATELLITE_SET;
+    classes[DECIMATE_SKY].interval = policy->sky_interval;
+    classes[DECIMATE_SKY].time = TS_NZ(&gpsdata->skyview_time) ?
+                                 &gpsdata->skyview_time : &gpsdata->fix.time;
+    classes[DECIMATE_GST].mask = GST_SET;
+    classes[DECIMATE_GST].interval = policy->gst_interval;
+    classes[DECIMATE_GST].time = &gpsdata->gst.utctime;
+
+    for (i = 0; i < DECIMATE_CLASSES; i++) {
+        if (0 != (changed & classes[i].mask) &&
+            !decimate_slot(policy, session, classes[i].interval,
+                           classes[i].time, &slot[i])) {
+            changed &= ~classes[i].mask;
+        }
+    }
+    return changed;
+}
+
+/* As gpsd_decimate(), for the TPV of a packet that is a whole fix, sent
+ * as the driver left it in newdata, before its cycle ends: true if the
+ * watcher wants it.  It takes the TPV slot, so the TPV at the end of
+ * the cycle, of the same fix and so the same slot, does not go too. */
+bool gpsd_decimate_pvt(const struct gps_policy_t *policy,
+                       const struct gps_device_t *session, long long slot[])
+{
+    return decimate_slot(policy, session, policy->tpv_interval,
+                         &session->newdata.time, &slot[DECIMATE_TPV]);
+}
+
+/* Keep an IMU sample a driver decoded, att, in the session's IMU ring
+ * for watchers that take them batched, stamped with when its packet
+ * arrived.  One with none of the batched columns is not kept.  The ring
+ * is allocated with the first sample, so a device with no IMU has none,
+ * and freed by gpsd_deactivate(). */
+void gpsd_imu_push(struct gps_device_t *session, const struct attitude_t *att)
+{
+    struct imu_sample_t *sp;
+    int i;
+
+    if (NULL == session->imu.sample) {
+        session->imu.sample = calloc(IMU_RING, sizeof(struct imu_sample_t));
+        if (NULL == session->imu.sample) {
+            GPSD_LOG(LOG_ERROR, &session->context->errout,
+                     "CORE: no memory for the IMU ring of %s\n",
+                     session->gpsdata.dev.path);
+            return;
+        }
+    }
+    sp = &session->imu.sample[session->imu.head % IMU_RING];
+    sp->val[0] = att->acc_x;
+    sp->val[1] = att->acc_y;
+    sp->val[2] = att->acc_z;
+    sp->val[3] = att->gyro_x;
+    sp->val[4] = att->gyro_y;
+    sp->val[5] = att->gyro_z;
+    sp->val[6] = att->gyro_temp;
+    sp->cols = 0;
+    for (i = 0; i < IMU_COLS; i++) {
+        if (0 != isfinite(sp->val[i])) {
+            sp->cols |= 1U << i;
+        }
+    }
+    if (0 == sp->cols) {
+        return;
+    }
+    sp->time = session->lexer.pkt_time;
+    sp->timeTag = att->timeTag;
+    (void)strlcpy(sp->msg, att->msg, sizeof(sp->msg));
+    session->imu.head++;
+}
+
 /* Latch the fact that we've saved a fix.
  * And add in the device fudge */
 void ntp_latch(struct gps_device_t *device, struct timedelta_t *td)
@@ -2198,7 +2357,13 @@ void ntp_latch(struct gps_device_t *device, struct timedelta_t *td)
         return;
     }
 
-    (void)clock_gettime(CLOCK_REALTIME, &td->clock);
+    if (device->context->ntp_arrival &&
+        TS_NZ(&device->lexer.pkt_time)) {
+        // when the packet with the time began to arrive
+        td->clock = device->lexer.pkt_time;
+    } else {
+        (void)clock_gettime(CLOCK_REALTIME, &td->clock);
+    }
     // structure copy of time from GPS
     td->real = device->newdata.time;
 
@@ -37,8 +37,10 @@ PERMISSIONS
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/socket.h>         // for recvmsg()
 #include <sys/time.h>           // for struct timeval
 #include <sys/types.h>
+#include <sys/uio.h>            // for struct iovec
 #include <unistd.h>
 
 #include "../include/bits.h"
@@ -243,19 +245,28 @@ static bool character_pushback(struct gps_lexer_t *lexer,
     return false;
 }
 
+/* n bytes are gone from the front of the input buffer, so is it now
+ * led by data of the last read, or still by something read before?
+ * Older reads are not told apart, in_time stays the first of them. */
+static void arrival_shift(struct gps_lexer_t *lexer, size_t n)
+{
+    if (n < lexer->read_start) {
+        lexer->read_start -= n;
+    } else {
+        lexer->read_start = 0;
+        lexer->in_time = lexer->read_time;
+    }
+}
+
 // shift the input buffer to discard one character and reread data
 static void character_discard(struct gps_lexer_t *lexer)
 {
+    arrival_shift(lexer, 1);
+    lexer->discard_counter++;
     memmove(lexer->inbuffer, lexer->inbuffer + 1, (size_t)-- lexer->inbuflen);
     lexer->inbufptr = lexer->inbuffer;
-    if (lexer->errout.debug >= LOG_RAW1) {
-        char scratchbuf[MAX_PACKET_LENGTH*4+1];
-        GPSD_LOG(LOG_RAW1, &lexer->errout,
-                 "Character discarded, buffer %zu chars = %s\n",
-                 lexer->inbuflen,
-                 gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
-                                 (char *)lexer->inbuffer, lexer->inbuflen));
-    }
+    GPSD_TRACE(LOG_RAW1, &lexer->errout, TRACE_CHAR_DISCARD,
+               lexer->inbuflen, 0, 0, lexer->inbuffer, lexer->inbuflen);
 }
 
 /* get 0-origin big-endian words relative to start of packet buffer
@@ -1830,19 +1841,19 @@ static bool nextstate(struct gps_lexer_t *lexer, unsigned char c)
 static void packet_accept(struct gps_lexer_t *lexer, int packet_type)
 {
     size_t packetlen = lexer->inbufptr - lexer->inbuffer;
-    char scratchbuf[MAX_PACKET_LENGTH * 4 + 1];
 
+    if (BAD_PACKET == packet_type) {
+        lexer->bad_counter++;
+    }
     if (sizeof(lexer->outbuffer) > packetlen) {
         memcpy(lexer->outbuffer, lexer->inbuffer, packetlen);
         lexer->outbuflen = packetlen;
         lexer->outbuffer[packetlen] = '\0';
+        lexer->out_time = lexer->in_time;
         lexer->type = packet_type;
-        GPSD_LOG(LOG_RAW1, &lexer->errout,
-                 "Packet type %d accepted %zu = %s\n",
-                 packet_type, packetlen,
-                 gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
-                                 (char *)lexer->outbuffer,
-                                 lexer->outbuflen));
+        GPSD_TRACE(LOG_RAW1, &lexer->errout, TRACE_PACKET_ACCEPT,
+                   packet_type, packetlen, 0,
+                   lexer->outbuffer, lexer->outbuflen);
     } else {
         GPSD_LOG(LOG_ERROR, &lexer->errout,
                  "Rejected too long packet type %d len %zu\n",
@@ -1855,16 +1866,13 @@ static void packet_discard(struct gps_lexer_t *lexer)
 {
     size_t discard = lexer->inbufptr - lexer->inbuffer;
     size_t remaining = lexer->inbuflen - discard;
-    char scratchbuf[MAX_PACKET_LENGTH * 4 + 1];
 
+    arrival_shift(lexer, discard);
     lexer->inbufptr = memmove(lexer->inbuffer, lexer->inbufptr, remaining);
     lexer->inbuflen = remaining;
 
-    GPSD_LOG(LOG_RAW1, &lexer->errout,
-             "Packet discard of %zu, chars remaining is %zu = %s\n",
-             discard, remaining,
-             gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
-                                (char *)lexer->inbuffer, lexer->inbuflen));
+    GPSD_TRACE(LOG_RAW1, &lexer->errout, TRACE_PACKET_DISCARD,
+               discard, remaining, 0, lexer->inbuffer, lexer->inbuflen);
 }
 
 #ifdef STASH_ENABLE
@@ -1872,17 +1880,12 @@ static void packet_discard(struct gps_lexer_t *lexer)
 static void packet_stash(struct gps_lexer_t *lexer)
 {
     size_t stashlen = lexer->inbufptr - lexer->inbuffer;
-    char scratchbuf[MAX_PACKET_LENGTH * 4 + 1];
 
     memcpy(lexer->stashbuffer, lexer->inbuffer, stashlen);
     lexer->stashbuflen = stashlen;
 
-    GPSD_LOG(LOG_RAW1, &lexer->errout,
-             "Packet stash of %zu = %s\n",
-             stashlen,
-             gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
-                             (char *)lexer->stashbuffer,
-                             lexer->stashbuflen));
+    GPSD_TRACE(LOG_RAW1, &lexer->errout, TRACE_PACKET_STASH,
+               stashlen, 0, 0, lexer->stashbuffer, lexer->stashbuflen);
 }
 
 // return stash to start of input buffer
@@ -1897,6 +1900,7 @@ static void packet_unstash(struct gps_lexer_t *lexer)
         memmove(lexer->inbuffer + stashlen, lexer->inbuffer, lexer->inbuflen);
         memcpy(lexer->inbuffer, lexer->stashbuffer, stashlen);
         lexer->inbuflen += stashlen;
+        lexer->read_start += stashlen;
         lexer->stashbuflen = 0;
 
         GPSD_LOG(LOG_RAW1, &lexer->errout,
@@ -2745,24 +2749,159 @@ void packet_parse(struct gps_lexer_t *lexer)
     }                           // while
 }
 
-/* grab a packet;
+/* grab a line of JSON from another gpsd instance
+ *
+ * gpsd writes whole JSON objects, one per line, so a line needs no
+ * character by character lexing: memchr() finds its end, and it is
+ * accepted as it stands, CR-LF included.  Anything else, say NMEA the
+ * remote was asked for, goes through packet_parse() as usual.
+ */
+static void json_line_parse(struct gps_lexer_t *lexer)
+{
+    unsigned char *nl;
+    size_t packetlen;
+
+    lexer->outbuflen = 0;
+    if (GROUND_STATE != lexer->state) {
+        // in the middle of some other packet
+        packet_parse(lexer);
+        if (0 < lexer->outbuflen) {
+            // done with it, the next line starts afresh
+            lexer->state = GROUND_STATE;
+        }
+        return;
+    }
+    // inbufptr marks how far a partial line has been searched
+    nl = memchr(lexer->inbufptr, '\n', packet_buffered_input(lexer));
+    if (NULL == nl) {
+        lexer->inbufptr = lexer->inbuffer + lexer->inbuflen;
+        return;
+    }
+    lexer->inbufptr = nl + 1;
+    packetlen = lexer->inbufptr - lexer->inbuffer;
+    if ('{' != lexer->inbuffer[0] ||
+        13 > packetlen) {
+        // not {"class": }CR-LF, start over with the lexer
+        lexer->inbufptr = lexer->inbuffer;
+        packet_parse(lexer);
+        if (0 < lexer->outbuflen) {
+            lexer->state = GROUND_STATE;
+        }
+        return;
+    }
+    lexer->char_counter += packetlen;
+    packet_accept(lexer, JSON_PACKET);
+    packet_discard(lexer);
+}
+
+/* Have the kernel stamp the arrival of fd's input, as SO_TIMESTAMPNS
+ * does for sockets, so that packets are timed by when they came in
+ * rather than by when gpsd got around to reading them.
+ *
+ * Return: true if it will, false if fd gets read() stamps
+ */
+bool packet_kernel_time(int fd, struct gps_lexer_t *lexer)
+{
+#ifdef SO_TIMESTAMPNS
+    int on = 1;
+
+    lexer->kernel_time = 0 == setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS,
+                                         &on, sizeof(on));
+#else
+    (void)fd;
+    lexer->kernel_time = false;
+#endif  // SO_TIMESTAMPNS
+    return lexer->kernel_time;
+}
+
+/* recvmsg() into buf, and the kernel's SO_TIMESTAMPNS stamp of the
+ * data into arrival.  arrival is left alone if there is none. */
+static ssize_t packet_recvmsg(int fd, unsigned char *buf, size_t len,
+                              timespec_t *arrival)
+{
+#ifdef SO_TIMESTAMPNS
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union {
+        char buf[CMSG_SPACE(sizeof(struct timespec))];
+        struct cmsghdr align;
+    } control;
+    ssize_t recvd;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    (void)memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    recvd = recvmsg(fd, &msg, 0);
+    if (0 >= recvd) {
+        return recvd;
+    }
+    for (cmsg = CMSG_FIRSTHDR(&msg); NULL != cmsg;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (SOL_SOCKET == cmsg->cmsg_level &&
+            SCM_TIMESTAMPNS == cmsg->cmsg_type) {
+            (void)memcpy(arrival, CMSG_DATA(cmsg), sizeof(*arrival));
+        }
+    }
+    return recvd;
+#else
+    (void)arrival;
+    return read(fd, buf, len);
+#endif  // SO_TIMESTAMPNS
+}
+
+/* read what fd has into the input buffer, noting when it arrived.
+ * With no kernel stamp, that is the time read() returned it: later
+ * than the truth, but not by whatever else gpsd did after that. */
+static ssize_t packet_read(int fd, struct gps_lexer_t *lexer)
+{
+    unsigned char *buf = lexer->inbuffer + lexer->inbuflen;
+    size_t len = sizeof(lexer->inbuffer) - lexer->inbuflen;
+    timespec_t arrival = {0, 0};
+    ssize_t recvd;
+
+    if (lexer->kernel_time) {
+        recvd = packet_recvmsg(fd, buf, len, &arrival);
+    } else {
+        recvd = read(fd, buf, len);
+    }
+    if (0 >= recvd) {
+        return recvd;
+    }
+    if (!TS_NZ(&arrival)) {
+        (void)clock_gettime(CLOCK_REALTIME, &arrival);
+    }
+    if (0 == lexer->inbuflen) {
+        lexer->in_time = arrival;
+    }
+    lexer->read_time = arrival;
+    lexer->read_start = lexer->inbuflen;
+    return recvd;
+}
+
+/* grab a packet, lexing the input with parse()
  * return: greater than zero: length
  *         0 == EOF
  *        -1 == I/O error
  */
-ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
+static ssize_t packet_get_with(int fd, struct gps_lexer_t *lexer,
+                               void (*parse)(struct gps_lexer_t *))
 {
     ssize_t recvd;
 
     errno = 0;
     /* O_NONBLOCK set, so this should not block.
      * Best not to block on an unresponsive GNSS receiver */
-    recvd = read(fd, lexer->inbuffer + lexer->inbuflen,
-                 sizeof(lexer->inbuffer) - (lexer->inbuflen));
+    recvd = packet_read(fd, lexer);
     if (-1 == recvd) {
         if (EAGAIN == errno ||
             EINTR == errno) {
-            GPSD_LOG(LOG_RAW2, &lexer->errout, "PACKET: no bytes ready\n");
+            GPSD_TRACE(LOG_RAW2, &lexer->errout, TRACE_PACKET_NOTREADY,
+                       0, 0, 0, NULL, 0);
             recvd = 0;
             // fall through, input buffer may be nonempty
         } else {
@@ -2772,17 +2911,13 @@ ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
             return -1;
         }
     } else {
-        char scratchbuf[MAX_PACKET_LENGTH * 4 + 1];
-        GPSD_LOG(LOG_RAW1, &lexer->errout,
-                 "PACKET: Read %zd chars to buffer[%zd] (total %zd): %s\n",
-                 recvd, lexer->inbuflen, lexer->inbuflen + recvd,
-                 gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
-                                 (char *)lexer->inbufptr, (size_t) recvd));
+        GPSD_TRACE(LOG_RAW1, &lexer->errout, TRACE_PACKET_READ,
+                   recvd, lexer->inbuflen, lexer->inbuflen + recvd,
+                   lexer->inbufptr, (size_t)recvd);
         lexer->inbuflen += recvd;
     }
-    GPSD_LOG(LOG_SPIN, &lexer->errout,
-             "PACKET: packet_get() fd %d -> %zd %s(%d)\n",
-             fd, recvd, strerror(errno), errno);
+    GPSD_TRACE(LOG_SPIN, &lexer->errout, TRACE_PACKET_GET,
+               fd, recvd, errno, NULL, 0);
 
     /*
      * Bail out, indicating no more input, only if we just received
@@ -2796,7 +2931,7 @@ ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
 
     // Otherwise, consume from the packet input buffer
     // coverity[tainted_data]
-    packet_parse(lexer);
+    parse(lexer);
 
     // if input buffer is full, discard
     if (sizeof(lexer->inbuffer) == (lexer->inbuflen)) {
@@ -2834,12 +2969,29 @@ ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
     return recvd;
 }
 
+/* grab a packet;
+ * return: greater than zero: length
+ *         0 == EOF
+ *        -1 == I/O error
+ */
+ssize_t packet_get(int fd, struct gps_lexer_t *lexer)
+{
+    return packet_get_with(fd, lexer, packet_parse);
+}
+
+// grab a packet from another gpsd instance, as packet_get() does
+ssize_t packet_get_json(int fd, struct gps_lexer_t *lexer)
+{
+    return packet_get_with(fd, lexer, json_line_parse);
+}
+
 // return the packet machine to the ground state
 void packet_reset(struct gps_lexer_t *lexer)
 {
     lexer->type = BAD_PACKET;
     lexer->state = GROUND_STATE;
     lexer->inbuflen = 0;
+    lexer->read_start = 0;
     lexer->inbufptr = lexer->inbuffer;
 #ifdef BINARY_ENABLE
     isgps_init(lexer);
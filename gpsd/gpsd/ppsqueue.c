@@ -0,0 +1,58 @@
+/*
+ * ppsqueue.c - hand messages from a PPS thread to the main loop
+ *
+ * A PPS thread may run SCHED_FIFO, see rtsched.c, and must not block
+ * on a lock the main thread holds, nor write to client sockets.  So it
+ * puts each PPS message into its device's queue, a ring with one
+ * producer, that thread, and one consumer, the main loop, and with no
+ * lock: each side moves only its own index.  A message that finds the
+ * ring full is dropped.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../include/gpsd.h"
+
+void gpsd_ppsq_init(struct gps_ppsq_t *q)
+{
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->dropped = 0;
+}
+
+/* Queue msg, cut to PPSQ_MSG_MAX - 1 bytes.  False, and it is dropped,
+ * if the ring is full.  The producer's side. */
+bool gpsd_ppsq_put(struct gps_ppsq_t *q, const char *msg)
+{
+    unsigned long tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if (PPSQ_SIZE <= tail - atomic_load_explicit(&q->head,
+                                                 memory_order_acquire)) {
+        q->dropped++;
+        return false;
+    }
+    (void)strlcpy(q->msg[tail % PPSQ_SIZE], msg, PPSQ_MSG_MAX);
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/* Take the oldest message into buf, of len bytes.  False if there is
+ * none.  The consumer's side. */
+bool gpsd_ppsq_get(struct gps_ppsq_t *q, char *buf, size_t len)
+{
+    unsigned long head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    if (head == atomic_load_explicit(&q->tail, memory_order_acquire)) {
+        return false;
+    }
+    (void)strlcpy(buf, q->msg[head % PPSQ_SIZE], len);
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+// vim: set expandtab shiftwidth=4
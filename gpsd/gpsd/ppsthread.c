@@ -89,6 +89,7 @@
 #include "../include/timespec.h"
 #include "../include/os_compat.h"
 #include "../include/ppsthread.h"
+#include "../include/rtsched.h"
 
 /*
  * Tell GCC that we want thread-safe behavior with _REENTRANT;
@@ -732,6 +733,40 @@ static void *gpsd_ppsmonitor(void *arg)
     // Acknowledge that we've grabbed the inner_context data
     ((volatile struct inner_context_t *)arg)->pps_thread = NULL;
 
+    // before any edge: its CPUs, its policy, and its stack faulted in
+    if (NULL != thread_context->cpus) {
+        int err = rt_pin(thread_context->cpus);
+
+        if (0 != err) {
+            char errbuf[BUFSIZ] = "unknown error";
+
+            thread_context->log_hook(thread_context, THREAD_WARN,
+                "PPS:%s can not pin thread to CPUs: %s(%d)\n",
+                thread_context->devicename,
+                pps_strerror_r(err, errbuf, sizeof(errbuf)), err);
+        }
+    }
+    if (0 < thread_context->rtprio) {
+        int err = rt_fifo(thread_context->rtprio);
+
+        if (0 != err) {
+            char errbuf[BUFSIZ] = "unknown error";
+
+            thread_context->log_hook(thread_context, THREAD_WARN,
+                "PPS:%s can not run SCHED_FIFO at %d: %s(%d)\n",
+                thread_context->devicename, thread_context->rtprio,
+                pps_strerror_r(err, errbuf, sizeof(errbuf)), err);
+        } else {
+            thread_context->log_hook(thread_context, THREAD_PROG,
+                "PPS:%s thread SCHED_FIFO at %d\n",
+                thread_context->devicename, thread_context->rtprio);
+        }
+    }
+    if (NULL != thread_context->cpus ||
+        0 < thread_context->rtprio) {
+        rt_prefault_stack();
+    }
+
     /* before the loop, figure out how we can detect edges:
      * TIOMCIWAIT, which is linux specifix
      * RFC2783, a.k.a kernel PPS (KPPS)
@@ -0,0 +1,275 @@
+/*
+ * rtsched.c - real-time scheduling, CPU pinning and memory locking
+ *
+ * A PPS thread at the default policy waits its turn behind whatever
+ * else is runnable, wanders from core to core with a cold cache, and
+ * can take a page fault between the edge and its timestamp.  On a
+ * loaded time server that is tens of microseconds of jitter.  These
+ * let gpsd, and ppscheck, put a thread under SCHED_FIFO, keep it on
+ * chosen CPUs, and lock the process in memory with its stack already
+ * faulted in.
+ *
+ * All of it is best effort: each returns an errno for its caller to
+ * log, and the thread runs on as it was.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "../include/rtsched.h"
+
+/* Parse a CPU list, "0,2-3", into cpus.  False, and cpus empty, if it
+ * is not one, or names a CPU of RT_CPUS_MAX or more. */
+bool rt_cpus_parse(const char *list, struct rt_cpus_t *cpus)
+{
+    const char *p = list;
+
+    memset(cpus, 0, sizeof(*cpus));
+    for (;;) {
+        char *end;
+        long first, last, cpu;
+
+        if ('0' > *p || '9' < *p) {
+            break;
+        }
+        first = last = strtol(p, &end, 10);
+        p = end;
+        if ('-' == *p) {
+            p++;
+            if ('0' > *p || '9' < *p) {
+                break;
+            }
+            last = strtol(p, &end, 10);
+            p = end;
+        }
+        if (first > last ||
+            RT_CPUS_MAX <= last) {
+            break;
+        }
+        for (cpu = first; cpu <= last; cpu++) {
+            if (!rt_cpus_isset(cpus, (int)cpu)) {
+                cpus->bits[cpu / 8] |= 1 << (cpu % 8);
+                cpus->count++;
+            }
+        }
+        if ('\0' == *p) {
+            return true;
+        }
+        if (',' != *p) {
+            break;
+        }
+        p++;
+    }
+    memset(cpus, 0, sizeof(*cpus));
+    return false;
+}
+
+bool rt_cpus_isset(const struct rt_cpus_t *cpus, int cpu)
+{
+    if (0 > cpu ||
+        RT_CPUS_MAX <= cpu) {
+        return false;
+    }
+    return 0 != (cpus->bits[cpu / 8] & (1 << (cpu % 8)));
+}
+
+// is prio a SCHED_FIFO priority?
+bool rt_prio_valid(int prio)
+{
+    return sched_get_priority_min(SCHED_FIFO) <= prio &&
+           sched_get_priority_max(SCHED_FIFO) >= prio;
+}
+
+// keep the calling thread on cpus.  0, or an errno.
+int rt_pin(const struct rt_cpus_t *cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    int cpu;
+
+    CPU_ZERO(&set);
+    for (cpu = 0; cpu < RT_CPUS_MAX && cpu < CPU_SETSIZE; cpu++) {
+        if (rt_cpus_isset(cpus, cpu)) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpus;
+    return ENOSYS;
+#endif  // __linux__
+}
+
+// run the calling thread SCHED_FIFO at prio.  0, or an errno.
+int rt_fifo(int prio)
+{
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = prio;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+/* Called as root, before privileges are dropped: raise the limits so
+ * threads started later, as nobody, may still go SCHED_FIFO at prio,
+ * and, if memlock, mlockall() everything they map.  0, or the errno of
+ * the last that could not be raised. */
+int rt_allow(int prio, bool memlock)
+{
+    struct rlimit lim;
+    int err = 0;
+
+#ifdef RLIMIT_RTPRIO
+    if (0 < prio) {
+        lim.rlim_cur = lim.rlim_max = (rlim_t)prio;
+        if (0 != setrlimit(RLIMIT_RTPRIO, &lim)) {
+            err = errno;
+        }
+    }
+#else
+    (void)prio;
+#endif  // RLIMIT_RTPRIO
+    if (memlock) {
+        lim.rlim_cur = lim.rlim_max = RLIM_INFINITY;
+        if (0 != setrlimit(RLIMIT_MEMLOCK, &lim)) {
+            err = errno;
+        }
+    }
+    return err;
+}
+
+/* Lock all the process has mapped, and will map, into memory, and
+ * fault in the caller's stack.  0, or an errno. */
+int rt_memlock(void)
+{
+    if (0 != mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        return errno;
+    }
+    rt_prefault_stack();
+    return 0;
+}
+
+/* Touch RT_STACK_FAULT bytes of stack below the caller, so a thread
+ * takes its stack faults now, not between an edge and its timestamp. */
+void rt_prefault_stack(void)
+{
+    volatile unsigned char stack[RT_STACK_FAULT];
+    long page = sysconf(_SC_PAGESIZE);
+    size_t i;
+
+    if (0 >= page) {
+        page = 4096;
+    }
+    for (i = 0; i < sizeof(stack); i += (size_t)page) {
+        stack[i] = 0;
+    }
+}
+
+// keep samples, up to max of them, in ns
+void rt_latency_init(struct rt_latency_t *lat, long *ns, size_t max)
+{
+    lat->ns = ns;
+    lat->n = 0;
+    lat->max = max;
+    lat->dropped = 0;
+}
+
+void rt_latency_add(struct rt_latency_t *lat, long ns)
+{
+    if (lat->n >= lat->max) {
+        lat->dropped++;
+        return;
+    }
+    lat->ns[lat->n++] = ns;
+}
+
+static int long_cmp(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* The pct percentile of the samples, by nearest rank, 0 if there are
+ * none.  Sorts them. */
+long rt_latency_percentile(struct rt_latency_t *lat, double pct)
+{
+    size_t rank;
+
+    if (0 == lat->n) {
+        return 0;
+    }
+    qsort(lat->ns, lat->n, sizeof(long), long_cmp);
+    rank = (size_t)(pct / 100.0 * (double)lat->n + 0.999999);
+    if (1 > rank) {
+        rank = 1;
+    } else if (lat->n < rank) {
+        rank = lat->n;
+    }
+    return lat->ns[rank - 1];
+}
+
+/* Write what the distribution of the samples is, percentiles then a
+ * histogram in powers of two microseconds, as # comments. */
+void rt_latency_report(struct rt_latency_t *lat, FILE *fp, const char *what)
+{
+    static const double pcts[] = {0.0, 50.0, 90.0, 99.0, 99.9, 100.0};
+    unsigned long buckets[32];
+    unsigned long negative = 0;
+    size_t i;
+
+    (void)fprintf(fp, "# %s: %zu edges", what, lat->n);
+    if (0 < lat->dropped) {
+        (void)fprintf(fp, ", %lu more not kept", lat->dropped);
+    }
+    (void)fputc('\n', fp);
+    if (0 == lat->n) {
+        return;
+    }
+    (void)fputs("#   ns      min      p50      p90      p99    p99.9"
+                "      max\n#     ", fp);
+    for (i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++) {
+        (void)fprintf(fp, " %8ld", rt_latency_percentile(lat, pcts[i]));
+    }
+    (void)fputc('\n', fp);
+
+    memset(buckets, 0, sizeof(buckets));
+    for (i = 0; i < lat->n; i++) {
+        long us = lat->ns[i] / 1000;
+        unsigned b = 0;
+
+        if (0 > lat->ns[i]) {
+            negative++;
+            continue;
+        }
+        while (0 < us &&
+               31 > b) {
+            us >>= 1;
+            b++;
+        }
+        buckets[b]++;
+    }
+    if (0 < negative) {
+        (void)fprintf(fp, "#   < %7d us %10lu\n", 0, negative);
+    }
+    for (i = 0; i < 32; i++) {
+        if (0 < buckets[i]) {
+            (void)fprintf(fp, "#   < %7ld us %10lu\n", 1L << i,
+                          buckets[i]);
+        }
+    }
+}
+// vim: set expandtab shiftwidth=4
@@ -12,9 +12,10 @@
 #ifdef HAVE_LINUX_SERIAL_H
     #include <linux/serial.h>
 #endif
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <stdlib.h>                  // for realpath()
+#include <stdlib.h>                  // for realpath(), malloc()
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/param.h>               // defines BSD
@@ -648,6 +649,8 @@ void gpsd_set_speed(struct gps_device_t *session,
                      session->gpsdata.gps_fd,
                      code2speed(cfgetispeed(&session->ttyset)), (int) rate);
         }
+        // what is still going out would be garbled at the new speed
+        gpsd_outq_drain(session);
         session->ttyset.c_iflag &= ~(PARMRK | INPCK);
         session->ttyset.c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD);
         session->ttyset.c_cflag |= (stopbits == 2 ? CS7 | CSTOPB : CS8);
@@ -996,17 +999,10 @@ ssize_t gpsd_serial_write(struct gps_device_t * session,
         return 0;
     }
 
+    /* No tcdrain() here: gpsd_set_speed() and gpsd_close() wait for
+     * the output, which is all that ever needed it to be gone. */
     status = write(session->gpsdata.gps_fd, buf, len);
     ok = (status == (ssize_t) len);
-    if (0 < gpsd_serial_isatty(session)) {
-        // do we really need to block on tcdrain?
-        if (0 != tcdrain(session->gpsdata.gps_fd)) {
-            GPSD_LOG(LOG_ERROR, &session->context->errout,
-                     "SER: gpsd_serial_write(%d) tcdrain() failed: %s(%d)\n",
-                     session->gpsdata.gps_fd,
-                     strerror(errno), errno);
-        }
-    }
 
     GPSD_LOG(LOG_IO, &session->context->errout,
              "SER: => GPS: %s%s\n",
@@ -1015,6 +1011,285 @@ ssize_t gpsd_serial_write(struct gps_device_t * session,
     return status;
 }
 
+/*
+ * Device output queues
+ *
+ * The daemon writes through gpsd_queue_write().  What the device will
+ * not take at once waits in session->outq, and the main loop calls
+ * gpsd_outq_flush() when the device is writable.  Messages are kept
+ * in order in outq.buf, msgs[0] first; outq.sent bytes of it are
+ * already out.  The buffer is allocated the first time a write has to
+ * wait, so a device that always keeps up never has one.  Only messages not yet started are ever dropped or
+ * overtaken.
+ */
+
+// bytes before message i in the queue
+static size_t outq_offset(const struct gps_outq_t *q, int i)
+{
+    size_t off = 0;
+    int n;
+
+    for (n = 0; n < i; n++) {
+        off += q->msgs[n].len;
+    }
+    return off;
+}
+
+// the first message nothing of has been written
+static int outq_unsent(const struct gps_outq_t *q)
+{
+    return 0 < q->sent ? 1 : 0;
+}
+
+static void outq_remove(struct gps_outq_t *q, int i)
+{
+    size_t off = outq_offset(q, i);
+    size_t len = q->msgs[i].len;
+
+    (void)memmove(q->buf + off, q->buf + off + len, q->len - off - len);
+    (void)memmove(&q->msgs[i], &q->msgs[i + 1],
+                  (q->nmsgs - i - 1) * sizeof(q->msgs[0]));
+    q->len -= len;
+    q->nmsgs--;
+}
+
+static void outq_insert(struct gps_outq_t *q, int i, const char *buf,
+                        size_t len)
+{
+    size_t off = outq_offset(q, i);
+
+    (void)memmove(q->buf + off + len, q->buf + off, q->len - off);
+    (void)memcpy(q->buf + off, buf, len);
+    (void)memmove(&q->msgs[i + 1], &q->msgs[i],
+                  (q->nmsgs - i) * sizeof(q->msgs[0]));
+    q->msgs[i].len = len;
+    q->msgs[i].kind = q->kind;
+    q->msgs[i].type = q->type;
+    q->msgs[i].epoch = q->epoch;
+    q->len += len;
+    q->nmsgs++;
+}
+
+// apply the RTCM policies to a new RTCM message, before queueing it
+static void outq_policy(struct gps_outq_t *q, int policy)
+{
+    int i = outq_unsent(q);
+
+    while (i < q->nmsgs) {
+        if (OUTQ_RTCM == q->msgs[i].kind &&
+            q->epoch != q->msgs[i].epoch &&
+            (0 != (policy & OUTQ_STALE) ||
+             (0 != (policy & OUTQ_COALESCE) &&
+              q->type == q->msgs[i].type))) {
+            // older epoch, or (coalescing) older of this type
+            outq_remove(q, i);
+            q->dropped++;
+        } else {
+            i++;
+        }
+    }
+}
+
+// make room for len bytes by dropping the oldest unsent RTCM
+static bool outq_room(struct gps_outq_t *q, size_t len)
+{
+    int i = outq_unsent(q);
+
+    while (OUTQ_SIZE - q->len < len ||
+           OUTQ_MSGS <= q->nmsgs) {
+        while (i < q->nmsgs &&
+               OUTQ_RTCM != q->msgs[i].kind) {
+            i++;
+        }
+        if (i >= q->nmsgs) {
+            return false;
+        }
+        outq_remove(q, i);
+        q->dropped++;
+    }
+    return true;
+}
+
+/* Write len bytes to the device without ever blocking: what it will
+ * not take now is queued, for gpsd_outq_flush().  A write tagged RTCM
+ * in session->outq is subject to context->outq_policy.
+ *
+ * Return: len if written or queued, 0 if read-only, -1 on error or
+ *         no room
+ */
+ssize_t gpsd_queue_write(struct gps_device_t *session,
+                         const char *buf, const size_t len)
+{
+    struct gps_outq_t *q;
+    char scratchbuf[MAX_PACKET_LENGTH*2+1];
+    ssize_t status = 0;
+    int i;
+
+    if (NULL == session ||
+        NULL == session->context ||
+        0 > session->gpsdata.gps_fd ||
+        session->context->readonly) {
+        return 0;
+    }
+    q = &session->outq;
+    GPSD_LOG(LOG_IO, &session->context->errout,
+             "SER: => GPS: %s\n",
+             gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
+                             (char *)buf, len));
+
+    if (0 == q->nmsgs) {
+        // nothing waiting, so straight out
+        status = write(session->gpsdata.gps_fd, buf, len);
+        if ((ssize_t)len == status) {
+            return status;
+        }
+        if (0 > status) {
+            if (EAGAIN != errno &&
+                EINTR != errno) {
+                GPSD_LOG(LOG_ERROR, &session->context->errout,
+                         "SER: gpsd_queue_write(%d) failed: %s(%d)\n",
+                         session->gpsdata.gps_fd, strerror(errno), errno);
+                return -1;
+            }
+            status = 0;
+        }
+    } else if (OUTQ_RTCM == q->kind) {
+        outq_policy(q, session->context->outq_policy);
+    }
+
+    if (NULL == q->buf &&
+        NULL == (q->buf = malloc(OUTQ_SIZE))) {
+        GPSD_LOG(LOG_ERROR, &session->context->errout,
+                 "SER: gpsd_queue_write(%d) no memory to queue %zu bytes\n",
+                 session->gpsdata.gps_fd, len);
+        return -1;
+    }
+    if (!outq_room(q, len)) {
+        GPSD_LOG(LOG_WARN, &session->context->errout,
+                 "SER: gpsd_queue_write(%d) no room for %zu bytes, "
+                 "%zu queued\n",
+                 session->gpsdata.gps_fd, len, q->len);
+        if (OUTQ_RTCM == q->kind) {
+            q->dropped++;
+        }
+        return -1;
+    }
+    i = q->nmsgs;
+    if (OUTQ_CONFIG == q->kind &&
+        0 != (session->context->outq_policy & OUTQ_PRIORITY)) {
+        // behind the other commands, ahead of the RTCM
+        for (i = outq_unsent(q); i < q->nmsgs; i++) {
+            if (OUTQ_RTCM == q->msgs[i].kind) {
+                break;
+            }
+        }
+    }
+    outq_insert(q, i, buf, len);
+    if (0 == i) {
+        // it went straight out, in part
+        q->sent = (size_t)status;
+    }
+    GPSD_LOG(LOG_IO, &session->context->errout,
+             "SER: gpsd_queue_write(%d) queued %zu bytes, %zu waiting\n",
+             session->gpsdata.gps_fd, len - (size_t)status, q->len - q->sent);
+    return (ssize_t)len;
+}
+
+// give up on what is still queued for the device
+static void outq_drop(struct gps_device_t *session, const char *why)
+{
+    struct gps_outq_t *q = &session->outq;
+
+    GPSD_LOG(LOG_WARN, &session->context->errout,
+             "SER: %s(%d) dropped %zu bytes\n",
+             why, session->gpsdata.gps_fd, q->len - q->sent);
+    q->nmsgs = 0;
+    q->len = 0;
+    q->sent = 0;
+}
+
+/* Write what the device will take of its queue, without blocking.
+ * On a write error the queue is dropped, as a direct write would be.
+ *
+ * Return: bytes written, 0 if none would go, -1 on error
+ */
+ssize_t gpsd_outq_flush(struct gps_device_t *session)
+{
+    struct gps_outq_t *q = &session->outq;
+    ssize_t status;
+    size_t done;
+    int n;
+
+    if (0 == q->nmsgs) {
+        return 0;
+    }
+    status = write(session->gpsdata.gps_fd, q->buf + q->sent,
+                   q->len - q->sent);
+    if (0 > status) {
+        if (EAGAIN == errno ||
+            EINTR == errno) {
+            return 0;
+        }
+        GPSD_LOG(LOG_ERROR, &session->context->errout,
+                 "SER: gpsd_outq_flush(%d) failed: %s(%d)\n",
+                 session->gpsdata.gps_fd, strerror(errno), errno);
+        outq_drop(session, "gpsd_outq_flush");
+        return -1;
+    }
+    // drop the messages now all out, keep the rest at the front
+    done = q->sent + (size_t)status;
+    for (n = 0; n < q->nmsgs && q->msgs[n].len <= done; n++) {
+        done -= q->msgs[n].len;
+    }
+    if (0 < n) {
+        size_t off = outq_offset(q, n);
+
+        (void)memmove(q->buf, q->buf + off, q->len - off);
+        (void)memmove(&q->msgs[0], &q->msgs[n],
+                      (q->nmsgs - n) * sizeof(q->msgs[0]));
+        q->len -= off;
+        q->nmsgs -= n;
+    }
+    q->sent = done;
+    return status;
+}
+
+/* Block until the queue is out, and with tcdrain() until the UART is
+ * empty too.  For what must not be cut off: a speed change, a close.
+ * Gives up, and drops the queue, if the device takes none of it for
+ * OUTQ_DRAIN_MS.
+ */
+#define OUTQ_DRAIN_MS   2000
+
+void gpsd_outq_drain(struct gps_device_t *session)
+{
+    struct gps_outq_t *q = &session->outq;
+
+    if (0 > session->gpsdata.gps_fd) {
+        return;
+    }
+    while (0 < q->nmsgs) {
+        struct pollfd pfd;
+
+        pfd.fd = session->gpsdata.gps_fd;
+        pfd.events = POLLOUT;
+        if (0 >= poll(&pfd, 1, OUTQ_DRAIN_MS)) {
+            outq_drop(session, "gpsd_outq_drain");
+            break;
+        }
+        if (0 > gpsd_outq_flush(session)) {
+            break;
+        }
+    }
+    if (0 < gpsd_serial_isatty(session) &&
+        0 != tcdrain(session->gpsdata.gps_fd)) {
+        GPSD_LOG(LOG_ERROR, &session->context->errout,
+                 "SER: gpsd_outq_drain(%d) tcdrain() failed: %s(%d)\n",
+                 session->gpsdata.gps_fd,
+                 strerror(errno), errno);
+    }
+}
+
 /*
  * This constant controls how many characters the packet sniffer will spend
  * looking for a packet leader before it gives up.  It *must* be larger than
@@ -1157,12 +1432,7 @@ void gpsd_close(struct gps_device_t *session)
 #endif  // TIOCNXCL
         if (!session->context->readonly) {
             // Be sure all output is sent.
-            if (0 != tcdrain(session->gpsdata.gps_fd)) {
-                GPSD_LOG(LOG_ERROR, &session->context->errout,
-                         "SER: gpsd_close(%d) tcdrain() failed: %s(%d)\n",
-                         session->gpsdata.gps_fd,
-                         strerror(errno), errno);
-            }
+            gpsd_outq_drain(session);
         }
 
         // Save current terminal parameters.  Why?
@@ -1205,6 +1475,12 @@ void gpsd_close(struct gps_device_t *session)
              "SER: gpsd_close(%s), close(%d)\n",
              session->gpsdata.dev.path,
              session->gpsdata.gps_fd);
+    // whatever did not go out goes nowhere now
+    session->outq.nmsgs = 0;
+    session->outq.len = 0;
+    session->outq.sent = 0;
+    free(session->outq.buf);
+    session->outq.buf = NULL;
     if (!BAD_SOCKET(session->gpsdata.gps_fd)) {
         (void)close(session->gpsdata.gps_fd);
         session->gpsdata.gps_fd = UNALLOCATED_FD;
@@ -5,9 +5,14 @@ NAME
 
 DESCRIPTION
    This is a very lightweight alternative to JSON-over-sockets.  Clients
-won't be able to filter by device, and won't get device activation/deactivation
-notifications.  But both client and daemon will avoid all the marshalling and
-unmarshalling overhead.
+of the main segment see every device's updates interleaved, and won't get
+device activation/deactivation notifications.  But both client and daemon
+will avoid all the marshalling and unmarshalling overhead.
+
+   So that a client can follow one device, each device also gets its
+own segment, holding only its updates.  Those are private segments; a
+directory segment, at a key next to the main one, lists the path and
+segment ID of each.
 
 PERMISSIONS
    This file is Copyright 2010 by the GPSD project
@@ -29,6 +34,110 @@ PERMISSIONS
 
 #include "../include/gpsd.h"
 #include "../include/libgps.h"    // for SHM_PSEUDO_FD
+#include "../include/strfuncs.h"
+
+/* remove the device segments, and the directory, that a gpsd which
+ * did not exit cleanly left behind */
+static void shm_directory_reap(struct gps_context_t *context, key_t dirkey)
+{
+    struct shmid_ds ds;
+    volatile struct shmdirectory_t *old;
+    int shmid = shmget(dirkey, 0, 0);
+    int i;
+
+    if (-1 == shmid) {
+        return;
+    }
+    old = (struct shmdirectory_t *)shmat(shmid, 0, SHM_RDONLY);
+    if ((void *)-1 != old) {
+        // the old gpsd may have been built with another max_devices
+        if (0 == shmctl(shmid, IPC_STAT, &ds) &&
+            offsetof(struct shmdirectory_t, device) <= ds.shm_segsz) {
+            size_t room = (ds.shm_segsz -
+                           offsetof(struct shmdirectory_t, device)) /
+                          sizeof(old->device[0]);
+
+            for (i = 0; i < old->ndevices && (size_t)i < room; i++) {
+                if (-1 != old->device[i].shmid) {
+                    GPSD_LOG(LOG_PROG, &context->errout,
+                             "SHM: removing stale segment %d of %.*s\n",
+                             old->device[i].shmid, GPS_PATH_MAX,
+                             (const char *)old->device[i].path);
+                    (void)shmctl(old->device[i].shmid, IPC_RMID, NULL);
+                }
+            }
+        }
+        (void)shmdt((const void *)old);
+    }
+    (void)shmctl(shmid, IPC_RMID, NULL);
+}
+
+// set a directory entry; path NULL leaves the slot's segment unlisted
+static void shm_directory_set(struct gps_context_t *context, int slot,
+                              const char *path, int shmid)
+{
+    volatile struct shmdirectory_t *dir =
+        (struct shmdirectory_t *)context->shmdirectory;
+    static int tick;
+
+    if (NULL == dir) {
+        return;
+    }
+    ++tick;
+    // same bookend protocol as shm_update()
+    dir->bookend2 = tick;
+    memory_barrier();
+    if (NULL == path) {
+        dir->device[slot].path[0] = '\0';
+    } else {
+        (void)strlcpy((char *)dir->device[slot].path, path, GPS_PATH_MAX);
+    }
+    dir->device[slot].shmid = shmid;
+    memory_barrier();
+    dir->bookend1 = tick;
+}
+
+/* create the directory of per-device segments, at dirkey
+ *
+ * Return: true = OK
+ *         false: failed
+ */
+static bool shm_directory_acquire(struct gps_context_t *context,
+                                  key_t dirkey)
+{
+    int shmid, i;
+
+    shm_directory_reap(context, dirkey);
+    shmid = shmget(dirkey, sizeof(struct shmdirectory_t),
+                   (int)(IPC_CREAT|0666));
+    if (-1 == shmid) {
+        GPSD_LOG(LOG_ERROR, &context->errout,
+                 "SHM: shmget(0x%lx, %zd, 0666) for SHM directory failed: "
+                 "%s(%d)\n",
+                 (long)dirkey, sizeof(struct shmdirectory_t),
+                 strerror(errno), errno);
+        return false;
+    }
+    context->shmdirectory = (void *)shmat(shmid, 0, 0);
+    if ((void *)-1 == context->shmdirectory) {
+        GPSD_LOG(LOG_ERROR, &context->errout,
+                 "SHM: shmat() of SHM directory failed: %s(%d)\n",
+                 strerror(errno), errno);
+        context->shmdirectory = NULL;
+        (void)shmctl(shmid, IPC_RMID, NULL);
+        return false;
+    }
+    context->shmdirid = shmid;
+    ((volatile struct shmdirectory_t *)context->shmdirectory)->ndevices =
+        MAX_DEVICES;
+    for (i = 0; i < MAX_DEVICES; i++) {
+        shm_directory_set(context, i, NULL, -1);
+    }
+    GPSD_LOG(LOG_PROG, &context->errout,
+             "SHM: directory of %d devices at 0x%lx, segment %d\n",
+             MAX_DEVICES, (long)dirkey, shmid);
+    return true;
+}
 
 /* initialize the shared-memory segment to be used for export
  *
@@ -39,9 +148,17 @@ bool shm_acquire(struct gps_context_t *context)
 {
     long shmkey = getenv("GPSD_SHM_KEY") ? \
                       strtol(getenv("GPSD_SHM_KEY"), NULL, 0) : GPSD_SHM_KEY;
+    int shmid, i;
 
-    int shmid = shmget((key_t)shmkey, sizeof(struct shmexport_t),
-                       (int)(IPC_CREAT|0666));
+    context->shmdirectory = NULL;
+    context->shmdirid = -1;
+    for (i = 0; i < MAX_DEVICES; i++) {
+        context->shmdevice[i] = NULL;
+        context->shmdevid[i] = -1;
+    }
+
+    shmid = shmget((key_t)shmkey, sizeof(struct shmexport_t),
+                   (int)(IPC_CREAT|0666));
     context->shmid = shmid;
     if (-1 == shmid) {
         GPSD_LOG(LOG_ERROR, &context->errout,
@@ -69,12 +186,33 @@ bool shm_acquire(struct gps_context_t *context)
 
     GPSD_LOG(LOG_PROG, &context->errout,
              "SHM: shmat() for SHM export succeeded, segment %d\n", shmid);
+    // without a directory, clients can still read the main segment
+    (void)shm_directory_acquire(context,
+                                (key_t)(shmkey + GPSD_SHM_DIRECTORY_OFFSET));
     return true;
 }
 
 // release the shared-memory segment used for export
 void shm_release(struct gps_context_t *context)
 {
+    int i;
+
+    /* Once gpsd drops privileges it can no longer remove the segments
+     * it made as root.  The directory keeps listing those; the next
+     * gpsd to start reaps them. */
+    for (i = 0; i < MAX_DEVICES; i++) {
+        if (NULL != context->shmdevice[i]) {
+            (void)shmctl(context->shmdevid[i], IPC_RMID, NULL);
+            (void)shmdt((const void *)context->shmdevice[i]);
+            context->shmdevice[i] = NULL;
+        }
+    }
+    if (NULL != context->shmdirectory) {
+        (void)shmctl(context->shmdirid, IPC_RMID, NULL);
+        (void)shmdt((const void *)context->shmdirectory);
+        context->shmdirectory = NULL;
+        context->shmdirid = -1;
+    }
 
     /* Mark shmid to go away when no longer used
      * Having it linger forever is bad, and when the size enlarges
@@ -98,41 +236,98 @@ void shm_release(struct gps_context_t *context)
     }
 }
 
-// export an update to all listeners
-void shm_update(struct gps_context_t *context, struct gps_data_t *gpsdata)
+/* give the device in slot its own segment, listed in the directory
+ * under path, or with path NULL unlist it.  A slot keeps its segment
+ * for the next device to use it, readers of the old one tell them
+ * apart by gpsdata.dev.path. */
+void shm_device(struct gps_context_t *context, int slot, const char *path)
 {
-    if (NULL != context->shmexport) {
-        static int tick;
-        volatile struct shmexport_t *shared = \
-                            (struct shmexport_t *)context->shmexport;
-
-        ++tick;
-        /*
-         * Following block of instructions must not be reordered, otherwise
-         * havoc will ensue.
-         *
-         * This is a simple optimistic-concurrency technique.  We write
-         * the second bookend first, then the data, then the first bookend.
-         * Reader copies what it sees in normal order; that way, if we
-         * start to write the segment during the read, the second bookend will
-         * get clobbered first and the data can be detected as bad.
-         *
-         * Of course many architectures, like Intel, make no guarantees
-         * about the actual memory read or write order into RAM, so this
-         * is partly wishful thinking.  Thus the need for the memory_barriers()
-         * to enforce the required order.
-         */
-        shared->bookend2 = tick;
-        memory_barrier();
-        shared->gpsdata = *gpsdata;
-        memory_barrier();
+    int shmid;
+    void *seg;
+
+    if (0 > slot || MAX_DEVICES <= slot ||
+        NULL == context->shmdirectory) {
+        return;
+    }
+    if (NULL == path) {
+        if (NULL != context->shmdevice[slot]) {
+            shm_directory_set(context, slot, NULL, context->shmdevid[slot]);
+        }
+        return;
+    }
+    if (NULL == context->shmdevice[slot]) {
+        shmid = shmget(IPC_PRIVATE, sizeof(struct shmexport_t),
+                       (int)(IPC_CREAT|0666));
+        if (-1 == shmid) {
+            GPSD_LOG(LOG_ERROR, &context->errout,
+                     "SHM: shmget() of segment for %s failed: %s(%d)\n",
+                     path, strerror(errno), errno);
+            return;
+        }
+        seg = shmat(shmid, 0, 0);
+        if ((void *)-1 == seg) {
+            GPSD_LOG(LOG_ERROR, &context->errout,
+                     "SHM: shmat() of segment for %s failed: %s(%d)\n",
+                     path, strerror(errno), errno);
+            (void)shmctl(shmid, IPC_RMID, NULL);
+            return;
+        }
+        context->shmdevice[slot] = seg;
+        context->shmdevid[slot] = shmid;
+    }
+    shm_directory_set(context, slot, path, context->shmdevid[slot]);
+    GPSD_LOG(LOG_PROG, &context->errout,
+             "SHM: %s exported in segment %d\n",
+             path, context->shmdevid[slot]);
+}
+
+// write gpsdata into a segment
+static void shm_write(volatile struct shmexport_t *shared, int tick,
+                      struct gps_data_t *gpsdata)
+{
+    /*
+     * Following block of instructions must not be reordered, otherwise
+     * havoc will ensue.
+     *
+     * This is a simple optimistic-concurrency technique.  We write
+     * the second bookend first, then the data, then the first bookend.
+     * Reader copies what it sees in normal order; that way, if we
+     * start to write the segment during the read, the second bookend will
+     * get clobbered first and the data can be detected as bad.
+     *
+     * Of course many architectures, like Intel, make no guarantees
+     * about the actual memory read or write order into RAM, so this
+     * is partly wishful thinking.  Thus the need for the memory_barriers()
+     * to enforce the required order.
+     */
+    shared->bookend2 = tick;
+    memory_barrier();
+    shared->gpsdata = *gpsdata;
+    memory_barrier();
 #ifndef USE_QT
-        shared->gpsdata.gps_fd = SHM_PSEUDO_FD;
+    shared->gpsdata.gps_fd = SHM_PSEUDO_FD;
 #else
-        shared->gpsdata.gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
+    shared->gpsdata.gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
 #endif  // USE_QT
-        memory_barrier();
-        shared->bookend1 = tick;
+    memory_barrier();
+    shared->bookend1 = tick;
+}
+
+/* export an update to all listeners, and to those of the device
+ * in slot */
+void shm_update(struct gps_context_t *context, int slot,
+                struct gps_data_t *gpsdata)
+{
+    static int tick;
+
+    ++tick;
+    if (NULL != context->shmexport) {
+        shm_write((struct shmexport_t *)context->shmexport, tick, gpsdata);
+    }
+    if (0 <= slot && MAX_DEVICES > slot &&
+        NULL != context->shmdevice[slot]) {
+        shm_write((struct shmexport_t *)context->shmdevice[slot], tick,
+                  gpsdata);
     }
 }
 
@@ -0,0 +1,121 @@
+/*
+ * stage.c - a client's output, staged while the daemon works through
+ * the packets of one pass of its main loop, then sent in one write.
+ *
+ * A receiver's burst of packets makes a report, a raw sentence, a
+ * DEVICE or TOFF notice for each watcher, each its own write() and,
+ * with TCP_NODELAY, its own TCP segment.  Staged, a watcher costs one
+ * write a pass however many of those it gets: TCP_CORK, but for all of
+ * a client's output, and with no timer.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+/* Stage hdrlen bytes of hdr, if any, then len bytes of buf.  False,
+ * and nothing staged, if they do not fit behind what already is. */
+bool gpsd_stage_put(struct gps_stage_t *stage,
+                    const unsigned char *hdr, size_t hdrlen,
+                    const char *buf, size_t len)
+{
+    if (sizeof(stage->buf) - stage->len < hdrlen + len) {
+        return false;
+    }
+    if (0 < hdrlen) {
+        (void)memcpy(stage->buf + stage->len, hdr, hdrlen);
+        stage->len += hdrlen;
+    }
+    (void)memcpy(stage->buf + stage->len, buf, len);
+    stage->len += len;
+    stage->pieces++;
+    return true;
+}
+
+// as gpsd_stage_put(), for a chain
+bool gpsd_stage_put_chain(struct gps_stage_t *stage,
+                          const unsigned char *hdr, size_t hdrlen,
+                          const struct gps_chain_t *chain)
+{
+    const struct gps_segment_t *seg;
+
+    if (sizeof(stage->buf) - stage->len < hdrlen + chain->len) {
+        return false;
+    }
+    if (0 < hdrlen) {
+        (void)memcpy(stage->buf + stage->len, hdr, hdrlen);
+        stage->len += hdrlen;
+    }
+    for (seg = chain->head; NULL != seg; seg = seg->next) {
+        (void)memcpy(stage->buf + stage->len, seg->buf, seg->len);
+        stage->len += seg->len;
+    }
+    stage->pieces++;
+    return true;
+}
+
+/* Write the first len bytes staged.  What went out leaves the stage;
+ * what did not of a write cut short is held, to go first next time.
+ * A flush of it all that fails keeps only what was already held. */
+static ssize_t stage_write(struct gps_stage_t *stage, int fd, size_t len)
+{
+    ssize_t status;
+
+    if (0 == len) {
+        return 0;
+    }
+    status = write(fd, stage->buf, len);
+    if (0 > status) {
+        if (stage->len == len) {
+            stage->len = stage->held;
+            stage->pieces = 0;
+        }
+        return status;
+    }
+    (void)memmove(stage->buf, stage->buf + status,
+                  stage->len - (size_t)status);
+    stage->len -= (size_t)status;
+    stage->held = len - (size_t)status;
+    if (0 == stage->len) {
+        stage->pieces = 0;
+    }
+    return status;
+}
+
+/* Write out what is staged.  Returns what write() does, or 0 with
+ * nothing staged. */
+ssize_t gpsd_stage_flush(struct gps_stage_t *stage, int fd)
+{
+    return stage_write(stage, fd, stage->len);
+}
+
+// write out only what a short write left held
+ssize_t gpsd_stage_flush_held(struct gps_stage_t *stage, int fd)
+{
+    return stage_write(stage, fd, stage->held);
+}
+
+/* Hold len bytes of buf, behind what is held and ahead of the rest, as
+ * the unsent end of a write cut short.  False, and nothing held, if
+ * they do not fit. */
+bool gpsd_stage_hold(struct gps_stage_t *stage, const char *buf, size_t len)
+{
+    if (sizeof(stage->buf) - stage->len < len) {
+        return false;
+    }
+    (void)memmove(stage->buf + stage->held + len, stage->buf + stage->held,
+                  stage->len - stage->held);
+    (void)memcpy(stage->buf + stage->held, buf, len);
+    stage->len += len;
+    stage->held += len;
+    return true;
+}
+// vim: set expandtab shiftwidth=4
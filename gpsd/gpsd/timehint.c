@@ -362,7 +362,8 @@ static void chrony_send(struct gps_device_t *session, struct timedelta_t *td)
              timespec_str(&td->real, real_str, sizeof(real_str)),
              timespec_str(&td->clock, clock_str, sizeof(clock_str)),
              sample.offset);
-    (void)send(session->chronyfd, &sample, sizeof (sample), 0);
+    // maybe on a SCHED_FIFO PPS thread, which must not block
+    (void)send(session->chronyfd, &sample, sizeof (sample), MSG_DONTWAIT);
 }
 
 // ship the time of a PPS event to ntpd and/or chrony
@@ -504,6 +505,10 @@ void ntpshm_link_activate(struct gps_device_t *session)
                      session->shm_pps_unit);
             init_hook(session);
             session->pps_thread.report_hook = report_hook;
+            session->pps_thread.rtprio = context->pps_rtprio;
+            if (0 < context->pps_cpus.count) {
+                session->pps_thread.cpus = &context->pps_cpus;
+            }
 #ifdef MAGIC_HAT_ENABLE
             /*
              * The HAT kludge. If we're using the HAT GPS on a
@@ -0,0 +1,333 @@
+/*
+ * trace.c - a binary flight recorder for the log sites on gpsd's hot
+ * paths: the lexer, gpsd_poll() and writes to clients.
+ *
+ * Normally a GPSD_TRACE() site formats its message on the spot, just
+ * like GPSD_LOG().  Once trace_defer() is on, it instead stores a
+ * compact event (time, event id, a few integers, and the first bytes
+ * of any packet) in a ring belonging to the calling thread.  Nothing
+ * is formatted, and no lock is taken, until the rings are dumped; so
+ * turning the debug level up no longer changes the timing of the
+ * problem being chased.
+ *
+ * Each ring has one writer, its own thread, which never waits.  A dump
+ * that races the writer sees mismatched bookends on the event being
+ * overwritten and skips it, the same way SHM export readers do.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/gpsd.h"
+#include "../include/compiler.h"     // for memory_barrier(), atomics
+#include "../include/strfuncs.h"
+
+#define TRACE_RING_SIZE 256     // events per thread, a power of 2
+#define TRACE_RINGS     4       // threads that can trace at once
+
+struct trace_event_t {
+    volatile unsigned long bookend1;
+    timespec_t ts;
+    int64_t arg[TRACE_ARGS];
+    unsigned short id;
+    unsigned short datalen;             // bytes kept in data
+    unsigned int len;                   // bytes the packet had
+    unsigned char data[TRACE_DATA_MAX];
+    volatile unsigned long bookend2;
+};
+
+struct trace_ring_t {
+    volatile bool claimed;              // a live thread writes here
+    volatile unsigned long head;        // events ever written
+    struct trace_event_t event[TRACE_RING_SIZE];
+};
+
+/* The message of each event.  Besides literal text:
+ *   %d  the next integer argument
+ *   %e  strerror() of the next integer argument, then it in parentheses
+ *   %m  gps_maskdump() of the next integer argument
+ *   %s  the data, as text
+ *   %h  the data, through gpsd_packetdump()
+ *   %p  the data as text if it starts printable, else "=" and hex
+ */
+static const char *trace_formats[TRACE_IDS] = {
+    [TRACE_CHAR_DISCARD] = "Character discarded, buffer %d chars = %h",
+    [TRACE_PACKET_ACCEPT] = "Packet type %d accepted %d = %h",
+    [TRACE_PACKET_DISCARD] =
+        "Packet discard of %d, chars remaining is %d = %h",
+    [TRACE_PACKET_STASH] = "Packet stash of %d = %h",
+    [TRACE_PACKET_NOTREADY] = "PACKET: no bytes ready",
+    [TRACE_PACKET_READ] =
+        "PACKET: Read %d chars to buffer[%d] (total %d): %h",
+    [TRACE_PACKET_GET] = "PACKET: packet_get() fd %d -> %d %e",
+    [TRACE_CORE_RAW] = "CORE: raw packet of type %d, %d:%h",
+    [TRACE_CORE_PARSE] = "CORE: parse_packet() = %m",
+    [TRACE_CORE_POLL] = "CORE: gpsd_poll(%s) %m",
+    [TRACE_CORE_BADSUM] = "CORE: packet with bad checksum from %s",
+    [TRACE_CORE_PACKET] = "CORE: packet type %d from %s with %m",
+    [TRACE_CLIENT_WRITE] = "=> client(%d) len %d: %p",
+    [TRACE_ALL_REPORTS] = "all_reports(): changed %m",
+};
+
+static struct trace_ring_t rings[TRACE_RINGS];
+static volatile bool deferred = false;
+static atomic_ulong lost;               // events of threads with no ring
+
+static pthread_key_t ring_key;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char no_ring;                    // key value of ringless threads
+
+// a thread is gone, its ring is free for the next one
+static void ring_release(void *ring)
+{
+    if (&no_ring != ring) {
+        ((struct trace_ring_t *)ring)->claimed = false;
+    }
+}
+
+static void ring_key_create(void)
+{
+    (void)pthread_key_create(&ring_key, ring_release);
+}
+
+// the calling thread's ring, NULL if all of them are taken
+static struct trace_ring_t *my_ring(void)
+{
+    void *ring;
+    int i;
+
+    (void)pthread_once(&ring_once, ring_key_create);
+    ring = pthread_getspecific(ring_key);
+    if (NULL == ring) {
+        // first event of this thread, claim a ring
+        ring = &no_ring;
+        (void)pthread_mutex_lock(&ring_mutex);
+        for (i = 0; i < TRACE_RINGS; i++) {
+            if (!rings[i].claimed) {
+                rings[i].claimed = true;
+                ring = &rings[i];
+                break;
+            }
+        }
+        (void)pthread_mutex_unlock(&ring_mutex);
+        (void)pthread_setspecific(ring_key, ring);
+    }
+    return &no_ring == ring ? NULL : ring;
+}
+
+// format an event's message into buf
+static void trace_format(char *buf, size_t buflen, unsigned id,
+                         const int64_t *arg, const unsigned char *data,
+                         size_t datalen, size_t len)
+{
+    const char *fmt;
+    int n = 0;
+
+    buf[0] = '\0';
+    if (TRACE_IDS <= id) {
+        str_appendf(buf, buflen, "unknown event %u", id);
+        return;
+    }
+    for (fmt = trace_formats[id]; '\0' != *fmt; fmt++) {
+        const char *pct = strchr(fmt, '%');
+        int64_t value = 0;
+
+        if (NULL == pct || '\0' == pct[1]) {
+            str_appendf(buf, buflen, "%s", fmt);
+            break;
+        }
+        str_appendf(buf, buflen, "%.*s", (int)(pct - fmt), fmt);
+        fmt = pct + 1;
+        if (NULL != strchr("dem", *fmt) && TRACE_ARGS > n) {
+            value = arg[n++];
+        }
+        switch (*fmt) {
+        case 'd':
+            str_appendf(buf, buflen, "%lld", (long long)value);
+            break;
+        case 'e':
+            str_appendf(buf, buflen, "%s(%d)", strerror((int)value),
+                        (int)value);
+            break;
+        case 'm':
+            str_appendf(buf, buflen, "%s", gps_maskdump((gps_mask_t)value));
+            break;
+        case 's':
+            str_appendf(buf, buflen, "%.*s", (int)datalen, (char *)data);
+            break;
+        case 'h':
+            {
+                char scratchbuf[MAX_PACKET_LENGTH * 4 + 1];
+
+                str_appendf(buf, buflen, "%s",
+                            gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
+                                            (char *)data, datalen));
+            }
+            break;
+        case 'p':
+            if (0 < datalen && isprint(data[0])) {
+                str_appendf(buf, buflen, "%.*s", (int)datalen, (char *)data);
+            } else {
+                size_t i;
+
+                str_appendf(buf, buflen, "=");
+                for (i = 0; i < datalen; i++) {
+                    str_appendf(buf, buflen, "%02x", data[i]);
+                }
+            }
+            break;
+        default:
+            str_appendf(buf, buflen, "%%%c", *fmt);
+            break;
+        }
+        if (NULL != strchr("shp", *fmt) && datalen < len) {
+            str_appendf(buf, buflen, "...");
+        }
+    }
+}
+
+/* Record, or when not deferred just log, the event id of a GPSD_TRACE()
+ * site.  Only the first TRACE_DATA_MAX bytes of data are recorded. */
+void gpsd_trace(const int errlevel, const struct gpsd_errout_t *errout,
+                const unsigned id, const int64_t a0, const int64_t a1,
+                const int64_t a2, const void *data, const size_t len)
+{
+    struct trace_ring_t *ring;
+    struct trace_event_t *ev;
+    unsigned long seq;
+
+    if (!deferred) {
+        int64_t arg[TRACE_ARGS] = {a0, a1, a2};
+        char buf[BUFSIZ];
+
+        trace_format(buf, sizeof(buf), id, arg, data, len, len);
+        gpsd_log(errlevel, errout, "%s\n", buf);
+        return;
+    }
+
+    ring = my_ring();
+    if (NULL == ring) {
+        // threads with no ring may be many, and race here
+        (void)atomic_fetch_add_explicit(&lost, 1, memory_order_relaxed);
+        return;
+    }
+    seq = ring->head + 1;
+    ev = &ring->event[ring->head % TRACE_RING_SIZE];
+    ev->bookend1 = seq;
+    memory_barrier();
+    (void)clock_gettime(CLOCK_REALTIME, &ev->ts);
+    ev->id = (unsigned short)id;
+    ev->arg[0] = a0;
+    ev->arg[1] = a1;
+    ev->arg[2] = a2;
+    ev->len = (unsigned int)len;
+    ev->datalen = (unsigned short)(TRACE_DATA_MAX < len ?
+                                   TRACE_DATA_MAX : len);
+    if (0 < ev->datalen) {
+        (void)memcpy(ev->data, data, ev->datalen);
+    }
+    memory_barrier();
+    ev->bookend2 = seq;
+    ring->head = seq;
+}
+
+// switch GPSD_TRACE() sites between logging and recording
+void trace_defer(bool on)
+{
+    deferred = on;
+}
+
+struct trace_copy_t {
+    int ring;
+    struct trace_event_t ev;
+};
+
+static int trace_cmp(const void *a, const void *b)
+{
+    const struct trace_copy_t *x = a, *y = b;
+
+    if (x->ev.ts.tv_sec != y->ev.ts.tv_sec) {
+        return x->ev.ts.tv_sec < y->ev.ts.tv_sec ? -1 : 1;
+    }
+    if (x->ev.ts.tv_nsec != y->ev.ts.tv_nsec) {
+        return x->ev.ts.tv_nsec < y->ev.ts.tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Format every recorded event, oldest first, passing each line (with
+ * no newline) to emit.  The rings keep their contents.
+ *
+ * Return: the number of events, or -1 if out of memory
+ */
+int trace_dump(void (*emit)(const char *, void *), void *arg)
+{
+    struct trace_copy_t *copy;
+    char line[BUFSIZ];
+    unsigned long nlost;
+    int count = 0;
+    int i;
+
+    copy = malloc(sizeof(struct trace_copy_t) * TRACE_RINGS *
+                  TRACE_RING_SIZE);
+    if (NULL == copy) {
+        return -1;
+    }
+    for (i = 0; i < TRACE_RINGS; i++) {
+        unsigned long head = rings[i].head;
+        unsigned long seq;
+
+        memory_barrier();
+        seq = TRACE_RING_SIZE < head ? head - TRACE_RING_SIZE : 0;
+        for (; seq < head; seq++) {
+            struct trace_event_t *ev =
+                &rings[i].event[seq % TRACE_RING_SIZE];
+            unsigned long end = ev->bookend2;
+
+            memory_barrier();
+            copy[count].ev = *ev;
+            memory_barrier();
+            // skip what the writer has moved on to, or is writing now
+            if (seq + 1 == end && end == ev->bookend1) {
+                copy[count++].ring = i;
+            }
+        }
+    }
+    qsort(copy, count, sizeof(struct trace_copy_t), trace_cmp);
+
+    for (i = 0; i < count; i++) {
+        struct trace_event_t *ev = &copy[i].ev;
+        size_t n;
+
+        (void)snprintf(line, sizeof(line), "%lld.%09ld [%d] ",
+                       (long long)ev->ts.tv_sec, (long)ev->ts.tv_nsec,
+                       copy[i].ring);
+        n = strnlen(line, sizeof(line));
+        trace_format(line + n, sizeof(line) - n, ev->id, ev->arg,
+                     ev->data, ev->datalen, ev->len);
+        emit(line, arg);
+    }
+    free(copy);
+    nlost = atomic_load(&lost);
+    if (0 < nlost) {
+        (void)snprintf(line, sizeof(line),
+                       "%lu events lost, more than %d threads traced",
+                       nlost, TRACE_RINGS);
+        emit(line, arg);
+    }
+    return count;
+}
+
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,295 @@
+/*
+ * websocket.c - the server side of RFC 6455, just enough of it for gpsd
+ * to speak its JSON protocol to browsers: the opening handshake, and
+ * frame coding.  No extensions, no fragmented sends, no TLS.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+
+#include "../include/gpsd.h"
+
+// appended to the client's key before hashing, RFC 6455 section 1.3
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+// FIPS 180-4 SHA-1.  Only ever fed the short handshake key.
+static void sha1(const unsigned char *data, size_t len,
+                 unsigned char digest[20])
+{
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe,
+                     0x10325476, 0xc3d2e1f0};
+    // message, a 0x80 byte, zeros, and a 64 bit length fill whole blocks
+    size_t total = ((len + 8) / 64 + 1) * 64;
+    uint64_t bits = (uint64_t)len * 8;
+    size_t n;
+    int i;
+
+    for (n = 0; n < total; n += 64) {
+        unsigned char block[64];
+        uint32_t w[80];
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+        for (i = 0; i < 64; i++) {
+            size_t k = n + i;
+
+            if (k < len) {
+                block[i] = data[k];
+            } else if (k == len) {
+                block[i] = 0x80;
+            } else if (k >= total - 8) {
+                block[i] = (unsigned char)(bits >> (8 * (total - 1 - k)));
+            } else {
+                block[i] = 0;
+            }
+        }
+        for (i = 0; i < 16; i++) {
+            w[i] = ((uint32_t)block[4 * i] << 24) |
+                   ((uint32_t)block[4 * i + 1] << 16) |
+                   ((uint32_t)block[4 * i + 2] << 8) |
+                   (uint32_t)block[4 * i + 3];
+        }
+        for (i = 16; i < 80; i++) {
+            w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        for (i = 0; i < 80; i++) {
+            uint32_t f, k, t;
+
+            if (20 > i) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (40 > i) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (60 > i) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            t = ROL32(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = ROL32(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (i = 0; i < 5; i++) {
+        digest[4 * i] = (unsigned char)(h[i] >> 24);
+        digest[4 * i + 1] = (unsigned char)(h[i] >> 16);
+        digest[4 * i + 2] = (unsigned char)(h[i] >> 8);
+        digest[4 * i + 3] = (unsigned char)h[i];
+    }
+}
+
+/* If line, which ends at eol, is the named header, return its value,
+ * without leading blanks.  Else NULL. */
+static const char *header_value(const char *line, const char *eol,
+                                const char *name)
+{
+    size_t namelen = strlen(name);
+
+    if ((size_t)(eol - line) <= namelen ||
+        0 != strncasecmp(line, name, namelen) ||
+        ':' != line[namelen]) {
+        return NULL;
+    }
+    for (line += namelen + 1; line < eol && ' ' == *line; line++) {
+        continue;
+    }
+    return line;
+}
+
+// does the header value from value to eol contain token, ignoring case?
+static bool has_token(const char *value, const char *eol, const char *token)
+{
+    size_t toklen = strlen(token);
+
+    for (; value + toklen <= eol; value++) {
+        if (0 == strncasecmp(value, token, toklen)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Check the client's opening handshake, req[0] to req[len - 1], which
+ * need not be NUL terminated.  Put the response to send in reply.
+ *
+ * Return: 0 if the request is not complete yet, and reply is untouched
+ *         the length of the request if it is a good upgrade request
+ *         -1 if it is not, and reply holds a 400 response
+ */
+ssize_t ws_handshake(const char *req, size_t len, char *reply,
+                     size_t replylen)
+{
+    const char *end, *line, *eol, *key = NULL;
+    bool upgrade = false, version = false;
+    size_t keylen = 0;
+
+    for (end = req; end + 4 <= req + len; end++) {
+        if (0 == memcmp(end, "\r\n\r\n", 4)) {
+            break;
+        }
+    }
+    if (end + 4 > req + len) {
+        return 0;
+    }
+
+    if (0 == strncmp(req, "GET ", 4)) {
+        // past the request line, one header per line up to the blank one
+        for (line = memchr(req, '\r', end - req);
+             NULL != line && line < end;
+             line = eol) {
+            const char *value;
+
+            line += 2;
+            eol = memchr(line, '\r', end + 1 - line);
+            if (NULL == eol) {
+                break;
+            }
+            if (NULL != (value = header_value(line, eol, "Upgrade"))) {
+                upgrade = has_token(value, eol, "websocket");
+            } else if (NULL != (value = header_value(line, eol,
+                                             "Sec-WebSocket-Version"))) {
+                version = (2 == eol - value &&
+                           0 == strncmp(value, "13", 2));
+            } else if (NULL != (value = header_value(line, eol,
+                                             "Sec-WebSocket-Key"))) {
+                key = value;
+                for (keylen = eol - value;
+                     0 < keylen && ' ' == key[keylen - 1];
+                     keylen--) {
+                    continue;
+                }
+            }
+        }
+    }
+
+    // the key is 16 random bytes, base64 encoded
+    if (upgrade && version && 24 == keylen) {
+        char buf[24 + sizeof(WS_GUID)];
+        unsigned char digest[20];
+        char accept[32];
+
+        (void)memcpy(buf, key, keylen);
+        (void)memcpy(buf + keylen, WS_GUID, sizeof(WS_GUID) - 1);
+        sha1((unsigned char *)buf, keylen + sizeof(WS_GUID) - 1, digest);
+        if (0 < b64_ntop(digest, sizeof(digest), accept, sizeof(accept))) {
+            (void)snprintf(reply, replylen,
+                           "HTTP/1.1 101 Switching Protocols\r\n"
+                           "Upgrade: websocket\r\n"
+                           "Connection: Upgrade\r\n"
+                           "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+            return (end + 4) - req;
+        }
+    }
+    (void)snprintf(reply, replylen,
+                   "HTTP/1.1 400 Bad Request\r\n"
+                   "Sec-WebSocket-Version: 13\r\n"
+                   "Content-Length: 0\r\n\r\n");
+    return -1;
+}
+
+/* Write the header of an unmasked, unfragmented frame of len bytes
+ * into hdr, which must hold WS_HEADER_MAX bytes.
+ *
+ * Return: the length of the header
+ */
+size_t ws_frame_header(unsigned char *hdr, int opcode, size_t len)
+{
+    int i;
+
+    hdr[0] = (unsigned char)(0x80 | (opcode & 0x0f));
+    if (126 > len) {
+        hdr[1] = (unsigned char)len;
+        return 2;
+    }
+    if (65536 > len) {
+        hdr[1] = 126;
+        hdr[2] = (unsigned char)(len >> 8);
+        hdr[3] = (unsigned char)len;
+        return 4;
+    }
+    hdr[1] = 127;
+    for (i = 0; i < 8; i++) {
+        hdr[2 + i] = (unsigned char)((uint64_t)len >> (8 * (7 - i)));
+    }
+    return 10;
+}
+
+/* Decode the client frame at the start of buf, unmasking its payload
+ * in place.  fin is set for the last frame of a message.
+ *
+ * Return: 0 if the frame is not all in buf yet
+ *         the length of the frame, with opcode, fin, payload and
+ *           paylen set
+ *         -1 if it is not a legal client frame
+ */
+ssize_t ws_unframe(unsigned char *buf, size_t len, int *opcode, bool *fin,
+                   unsigned char **payload, size_t *paylen)
+{
+    size_t hdrlen = 2;
+    uint64_t plen;
+    unsigned char *mask;
+    size_t n;
+
+    if (2 > len) {
+        return 0;
+    }
+    // no extensions, so no RSV bits; and clients must mask
+    if (0 != (buf[0] & 0x70) ||
+        0 == (buf[1] & 0x80)) {
+        return -1;
+    }
+    plen = buf[1] & 0x7f;
+    if (126 == plen) {
+        hdrlen = 4;
+    } else if (127 == plen) {
+        hdrlen = 10;
+    }
+    if (len < hdrlen + 4) {
+        return 0;
+    }
+    if (126 == plen) {
+        plen = ((uint64_t)buf[2] << 8) | buf[3];
+    } else if (127 == plen) {
+        plen = 0;
+        for (n = 2; n < 10; n++) {
+            plen = (plen << 8) | buf[n];
+        }
+    }
+    mask = buf + hdrlen;
+    hdrlen += 4;
+    if (plen > len - hdrlen) {
+        return 0;
+    }
+
+    *opcode = buf[0] & 0x0f;
+    *fin = 0 != (buf[0] & 0x80);
+    *payload = buf + hdrlen;
+    *paylen = (size_t)plen;
+    for (n = 0; n < *paylen; n++) {
+        (*payload)[n] ^= mask[n % 4];
+    }
+    return (ssize_t)(hdrlen + *paylen);
+}
+
+// vim: set expandtab shiftwidth=4
@@ -59,6 +59,8 @@ static struct termios cooked, rare;
 static struct fixsource_t source;
 static char hostname[HOST_NAME_MAX];
 static struct timedelta_t time_offset;
+static struct linkstats_t linkstats;
+static FILE *statsfile;
 
 /* no methods, it's all device window */
 extern const struct gps_type_t driver_json_passthrough;
@@ -381,6 +383,30 @@ static void gpsmon_hook(struct gps_device_t *device, gps_mask_t changed UNUSED)
 
     printf("gpsmon hook\n");
 
+    /* In daemon mode only the device's own packets were on its link,
+     * gpsd's JSON just says how the link is set up. */
+    if (serial) {
+        linkstats_link(&linkstats, session.gpsdata.dev.baudrate,
+                       session.gpsdata.dev.stopbits,
+                       session.gpsdata.dev.parity,
+                       &session.gpsdata.dev.cycle);
+        linkstats_packet(&linkstats, &device->lexer);
+    } else if (JSON_PACKET != device->lexer.type) {
+        linkstats_packet(&linkstats, &device->lexer);
+    } else if (str_starts_with((char *)device->lexer.outbuffer,
+                               "{\"class\":\"DEVICE\",")) {
+        struct devconfig_t devconfig;
+        const char *end = NULL;
+
+        (void)memset(&devconfig, 0, sizeof(devconfig));
+        if (0 == json_device_read((const char *)device->lexer.outbuffer,
+                                  &devconfig, &end)) {
+            linkstats_link(&linkstats, devconfig.baudrate,
+                           devconfig.stopbits, devconfig.parity,
+                           &devconfig.cycle);
+        }
+    }
+
 
 /* FIXME:  If the following condition is false, the display is screwed up. */
 #if defined(SOCKET_EXPORT_ENABLE) && defined(PPS_DISPLAY_ENABLE)
@@ -780,6 +806,7 @@ static void usage(void)
          "  --logfile FILE      Log to LOGFILE\n"
          "  --nocurses          No curses. Data only.\n"
          "  --nmea              Force NMEA mode.\n"
+         "  --stats FILE        Write link statistics to FILE, - for stdout\n"
          "  --type TYPE         Set receiver TYPE\n"
          "  --version           Show version, then exit\n"
 #endif
@@ -790,6 +817,7 @@ static void usage(void)
          "  -L                  List known device types, then exit.\n"
          "  -l FILE             Log to LOGFILE\n"
          "  -n                  Force NMEA mode.\n"
+         "  -S FILE             Write link statistics to FILE, - for stdout\n"
          "  -t TYPE             Set receiver TYPE\n"
          "  -V                  Show version, then exit\n",
          stderr);
@@ -807,7 +835,7 @@ int main(int argc, char **argv)
     char inbuf[80];
     volatile bool nocurses = false;
     int activated = -1;
-    const char *optstring = "?aD:hLl:nt:V";
+    const char *optstring = "?aD:hLl:nS:t:V";
 #ifdef HAVE_GETOPT_LONG
     int option_index = 0;
     static struct option long_options[] = {
@@ -817,6 +845,7 @@ int main(int argc, char **argv)
         {"logfile", required_argument, NULL, 'l'},
         {"nmea", no_argument, NULL, 'n' },
         {"nocurses", no_argument, NULL, 'a' },
+        {"stats", required_argument, NULL, 'S'},
         {"type", required_argument, NULL, 't'},
         {"version", no_argument, NULL, 'V' },
         {NULL, 0, NULL, 0},
@@ -895,6 +924,15 @@ int main(int argc, char **argv)
         case 'n':
             nmea = true;
             break;
+        case 'S':               // link statistics, one JSON line a second
+            if (0 == strcmp(optarg, "-")) {
+                statsfile = stdout;
+            } else if (NULL == (statsfile = fopen(optarg, "w"))) {
+                (void)fprintf(stderr,
+                              "Couldn't open statistics file for writing.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 't':
             fallback = NULL;
             for (active = monitor_objects; *active; active++) {
@@ -978,6 +1016,13 @@ int main(int argc, char **argv)
 
     printf("gpsd activated\n");
 
+    {
+        timespec_t now;
+
+        (void)clock_gettime(CLOCK_REALTIME, &now);
+        linkstats_init(&linkstats, &now);
+    }
+
 #if 0    
     if (serial) 
     {
@@ -1068,7 +1113,7 @@ int main(int argc, char **argv)
         {
             fd_set efds;
             timespec_t ts_timeout = {2, 0};   // timeout for pselect()
-            switch(gpsd_await_data(&rfds, &efds, maxfd, &all_fds,
+            switch(gpsd_await_data(&rfds, NULL, &efds, maxfd, &all_fds,
                                    &context.errout, ts_timeout)) {
             case AWAIT_GOT_INPUT:
                 FALLTHROUGH
@@ -1105,6 +1150,27 @@ int main(int argc, char **argv)
                 printf("multipol: %d\n", test);
                 break;
             }
+
+            {
+                timespec_t now;
+
+                (void)clock_gettime(CLOCK_REALTIME, &now);
+                if (linkstats_tick(&linkstats, &session.lexer, &now)) {
+                    char statbuf[BUFSIZ];
+
+                    if (!curses_active) {
+                        (void)linkstats_panel(&linkstats, statbuf,
+                                              sizeof(statbuf));
+                        (void)fputs(statbuf, stdout);
+                    }
+                    if (NULL != statsfile) {
+                        (void)linkstats_json(&linkstats, statbuf,
+                                             sizeof(statbuf));
+                        (void)fputs(statbuf, statsfile);
+                        (void)fflush(statsfile);
+                    }
+                }
+            }
 #if 0
             if (!FD_ISSET(0, &rfds)) 
             {
@@ -1158,6 +1224,10 @@ int main(int argc, char **argv)
     gpsd_close(&session);
     if (logfile) {
         (void)fclose(logfile);
+    }
+    if (NULL != statsfile &&
+        stdout != statsfile) {
+        (void)fclose(statsfile);
     }
         (void)tcsetattr(0, TCSANOW, &cooked);
 
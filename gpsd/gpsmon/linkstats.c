@@ -0,0 +1,331 @@
+/*
+ * linkstats.c - link utilization and message rate statistics for gpsmon.
+ *
+ * Everything here is kept up one packet at a time, from the lexer, so it
+ * costs the same whether the receiver sends one sentence a second or
+ * fifty.  Rates are taken over the last whole second, intervals and
+ * jitter are running means.  What it tells you is whether the messages
+ * a receiver is set up to send fit its link: how much of the baud rate
+ * they use, and how much of each cycle the receiver spends sending
+ * them.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/compiler.h"         // for FALLTHROUGH
+#include "../include/gpsd.h"
+#include "../include/gpsmon.h"
+#include "../include/strfuncs.h"
+#include "../include/timespec.h"
+
+/* weights of the newest sample in the running means, as RFC 3550
+ * takes its interarrival jitter */
+#define INTERVAL_GAIN   8
+#define JITTER_GAIN     16
+
+/* an epoch ends at a gap of a quarter cycle with nothing arriving */
+#define EPOCH_GAP(ls)   ((ls)->cycle / 4)
+
+void linkstats_init(struct linkstats_t *ls, const timespec_t *now)
+{
+    (void)memset(ls, 0, sizeof(*ls));
+    ls->charbits = 10;
+    (void)strlcpy(ls->framing, "8N1", sizeof(ls->framing));
+    ls->cycle = 1.0;
+    ls->wstart = *now;
+}
+
+/* Set the link parameters, as the serial port or a gpsd DEVICE report
+ * gives them.  A zero baud rate, or cycle, leaves the old one. */
+void linkstats_link(struct linkstats_t *ls, unsigned baudrate,
+                    unsigned stopbits, char parity, const timespec_t *cycle)
+{
+    if (0 < baudrate) {
+        ls->baudrate = baudrate;
+    }
+    if (0 < stopbits) {
+        bool parity_bit = 'O' == parity || 'E' == parity;
+
+        // start bit, 8 data bits, maybe parity, stop bits
+        ls->charbits = 1 + 8 + (parity_bit ? 1 : 0) + stopbits;
+        ls->framing[0] = '8';
+        ls->framing[1] = parity_bit ? parity : 'N';
+        ls->framing[2] = (char)('0' + stopbits % 10);
+        ls->framing[3] = '\0';
+    }
+    if (NULL != cycle &&
+        TS_GZ(cycle)) {
+        ls->cycle = TSTONS(cycle);
+    }
+}
+
+// name the message class of the packet the lexer just returned
+static void class_name(const struct gps_lexer_t *lexer, char *name,
+                       size_t len)
+{
+    static const char *names[] = {
+        [COMMENT_PACKET] = "comment",
+        [GARMINTXT_PACKET] = "GARMINTXT",
+        [SIRF_PACKET] = "SIRF",
+        [ZODIAC_PACKET] = "ZODIAC",
+        [TSIP_PACKET] = "TSIP",
+        [EVERMORE_PACKET] = "EVERMORE",
+        [ITALK_PACKET] = "ITALK",
+        [GARMIN_PACKET] = "GARMIN",
+        [NAVCOM_PACKET] = "NAVCOM",
+        [SUPERSTAR2_PACKET] = "SUPERSTAR2",
+        [ONCORE_PACKET] = "ONCORE",
+        [GEOSTAR_PACKET] = "GEOSTAR",
+        [NMEA2000_PACKET] = "NMEA2000",
+        [GREIS_PACKET] = "GREIS",
+        [RTCM2_PACKET] = "RTCM2",
+        [JSON_PACKET] = "JSON",
+    };
+    const unsigned char *buf = lexer->outbuffer;
+    size_t i;
+
+    switch (lexer->type) {
+    case NMEA_PACKET:
+        FALLTHROUGH
+    case AIVDM_PACKET:
+        // the tag, without its '$' or '!'
+        for (i = 1; i < lexer->outbuflen && i < len &&
+             ',' != buf[i] && '*' != buf[i]; i++) {
+            name[i - 1] = (char)buf[i];
+        }
+        name[i - 1] = '\0';
+        return;
+    case UBX_PACKET:
+        (void)snprintf(name, len, "UBX-%02X-%02X", buf[2], buf[3]);
+        return;
+    case RTCM3_PACKET:
+        (void)snprintf(name, len, "RTCM3-%u",
+                       ((unsigned)buf[3] << 4) | (buf[4] >> 4));
+        return;
+    default:
+        if (0 <= lexer->type &&
+            (int)(sizeof(names) / sizeof(names[0])) > lexer->type &&
+            NULL != names[lexer->type]) {
+            (void)strlcpy(name, names[lexer->type], len);
+        } else {
+            (void)snprintf(name, len, "type %d", lexer->type);
+        }
+        return;
+    }
+}
+
+static struct linkstat_class_t *class_find(struct linkstats_t *ls,
+                                           const char *name)
+{
+    struct linkstat_class_t *cls;
+    int i;
+
+    for (i = 0; i < ls->nclasses; i++) {
+        if (0 == strcmp(ls->classes[i].name, name)) {
+            return &ls->classes[i];
+        }
+    }
+    if (LINKSTAT_CLASSES - 1 > ls->nclasses) {
+        cls = &ls->classes[ls->nclasses++];
+        (void)strlcpy(cls->name, name, sizeof(cls->name));
+        return cls;
+    }
+    // the table is full, lump the rest together
+    cls = &ls->classes[LINKSTAT_CLASSES - 1];
+    if (LINKSTAT_CLASSES == ls->nclasses + 1) {
+        ls->nclasses = LINKSTAT_CLASSES;
+        (void)strlcpy(cls->name, "other", sizeof(cls->name));
+    }
+    return cls;
+}
+
+static void epoch_close(struct linkstats_t *ls)
+{
+    if (0 < ls->epoch_start.tv_sec) {
+        ls->epoch = TS_SUB_D(&ls->epoch_end, &ls->epoch_start);
+        if (ls->epoch > ls->epoch_max) {
+            ls->epoch_max = ls->epoch;
+        }
+        ls->epoch_start.tv_sec = 0;
+        ls->epoch_start.tv_nsec = 0;
+    }
+}
+
+// count the packet the lexer just returned
+void linkstats_packet(struct linkstats_t *ls,
+                      const struct gps_lexer_t *lexer)
+{
+    char name[LINKSTAT_NAMELEN];
+    struct linkstat_class_t *cls;
+    timespec_t arrival = lexer->out_time;
+    timespec_t sent;
+
+    if (0 == lexer->outbuflen) {
+        return;
+    }
+    if (0 >= arrival.tv_sec) {
+        arrival = lexer->pkt_time;
+    }
+    class_name(lexer, name, sizeof(name));
+    cls = class_find(ls, name);
+
+    if (0 < cls->count) {
+        double delta = TS_SUB_D(&arrival, &cls->last);
+
+        if (1 == cls->count) {
+            cls->interval = delta;
+        } else {
+            cls->interval += (delta - cls->interval) / INTERVAL_GAIN;
+            cls->jitter += (fabs(delta - cls->interval) - cls->jitter) /
+                           JITTER_GAIN;
+        }
+    }
+    cls->last = arrival;
+    cls->count++;
+    cls->bytes += lexer->outbuflen;
+    cls->wcount++;
+    cls->wbytes += lexer->outbuflen;
+
+    /* The epoch runs from the first byte of its first packet to the
+     * last byte of its last, which the baud rate puts a little after
+     * the first byte of that arrived. */
+    if (0 < ls->epoch_start.tv_sec &&
+        TS_SUB_D(&arrival, &ls->epoch_end) > EPOCH_GAP(ls)) {
+        epoch_close(ls);
+    }
+    if (0 >= ls->epoch_start.tv_sec) {
+        ls->epoch_start = arrival;
+    }
+    sent = arrival;
+    if (0 < ls->baudrate) {
+        sent.tv_nsec += (long)((double)lexer->outbuflen * ls->charbits *
+                               1e9 / ls->baudrate);
+        TS_NORM(&sent);
+    }
+    ls->epoch_end = sent;
+}
+
+/* Call often: once a second has gone by, take the rates over it.
+ *
+ * Return: true when there are new rates
+ */
+bool linkstats_tick(struct linkstats_t *ls, const struct gps_lexer_t *lexer,
+                    const timespec_t *now)
+{
+    double span = TS_SUB_D(now, &ls->wstart);
+    int i;
+
+    if (0 < ls->epoch_start.tv_sec &&
+        TS_SUB_D(now, &ls->epoch_end) > EPOCH_GAP(ls)) {
+        epoch_close(ls);
+    }
+    if (1.0 > span) {
+        return false;
+    }
+    for (i = 0; i < ls->nclasses; i++) {
+        struct linkstat_class_t *cls = &ls->classes[i];
+
+        cls->hz = cls->wcount / span;
+        cls->bps = cls->wbytes / span;
+        cls->wcount = 0;
+        cls->wbytes = 0;
+    }
+    // lexer_init() starts the count over
+    if (lexer->char_counter >= ls->wchars) {
+        ls->bps = (lexer->char_counter - ls->wchars) / span;
+    }
+    ls->wchars = lexer->char_counter;
+    ls->chars = lexer->char_counter;
+    ls->discards = lexer->discard_counter;
+    ls->bad = lexer->bad_counter;
+    ls->wstart = *now;
+    return true;
+}
+
+// percent of the link's capacity bps bytes per second take
+static double load(const struct linkstats_t *ls, double bps)
+{
+    return bps * ls->charbits * 100.0 / ls->baudrate;
+}
+
+// the statistics as a panel of text lines, 80 columns wide
+size_t linkstats_panel(const struct linkstats_t *ls, char *buf, size_t len)
+{
+    int i;
+
+    buf[0] = '\0';
+    if (0 < ls->baudrate) {
+        str_appendf(buf, len, "Link %u %s: %.0f B/s, %.1f%% of capacity",
+                    ls->baudrate, ls->framing, ls->bps, load(ls, ls->bps));
+    } else {
+        str_appendf(buf, len, "Link: %.0f B/s, baud rate unknown", ls->bps);
+    }
+    str_appendf(buf, len,
+                ", epoch %.3f of %.3f s cycle (max %.3f)\n"
+                "Chars %lu, discarded %lu, bad packets %lu\n"
+                "Message           Hz      B/s   Load  Interval    Jitter"
+                "     Count\n",
+                ls->epoch, ls->cycle, ls->epoch_max,
+                ls->chars, ls->discards, ls->bad);
+    for (i = 0; i < ls->nclasses; i++) {
+        const struct linkstat_class_t *cls = &ls->classes[i];
+        char pct[8] = "     -";
+
+        if (0 < ls->baudrate) {
+            (void)snprintf(pct, sizeof(pct), "%5.1f%%", load(ls, cls->bps));
+        }
+        str_appendf(buf, len, "%-12s %7.2f %8.0f %s %9.4f %9.4f %9lu\n",
+                    cls->name, cls->hz, cls->bps, pct, cls->interval,
+                    cls->jitter, cls->count);
+    }
+    return strlen(buf);
+}
+
+// the statistics as a LINKSTATS JSON object, on one line
+size_t linkstats_json(const struct linkstats_t *ls, char *buf, size_t len)
+{
+    char tbuf[JSON_DATE_MAX + 1];
+    int i;
+
+    (void)snprintf(buf, len,
+                   "{\"class\":\"LINKSTATS\",\"time\":\"%s\",\"bps\":%.1f,",
+                   timespec_to_iso8601(ls->wstart, tbuf, sizeof(tbuf)),
+                   ls->bps);
+    if (0 < ls->baudrate) {
+        str_appendf(buf, len,
+                    "\"baudrate\":%u,\"framing\":\"%s\",\"load\":%.2f,",
+                    ls->baudrate, ls->framing, load(ls, ls->bps));
+    }
+    str_appendf(buf, len,
+                "\"cycle\":%.3f,\"epoch\":%.4f,\"epoch_max\":%.4f,"
+                "\"chars\":%lu,\"discarded\":%lu,\"bad\":%lu,"
+                "\"messages\":[",
+                ls->cycle, ls->epoch, ls->epoch_max,
+                ls->chars, ls->discards, ls->bad);
+    for (i = 0; i < ls->nclasses; i++) {
+        const struct linkstat_class_t *cls = &ls->classes[i];
+
+        str_appendf(buf, len,
+                    "%s{\"name\":\"%s\",\"count\":%lu,\"bytes\":%lu,"
+                    "\"hz\":%.3f,\"bps\":%.1f,",
+                    0 < i ? "," : "", cls->name, cls->count, cls->bytes,
+                    cls->hz, cls->bps);
+        if (0 < ls->baudrate) {
+            str_appendf(buf, len, "\"load\":%.2f,", load(ls, cls->bps));
+        }
+        str_appendf(buf, len, "\"interval\":%.6f,\"jitter\":%.6f}",
+                    cls->interval, cls->jitter);
+    }
+    (void)strlcat(buf, "]}\n", len);
+    return strlen(buf);
+}
+
+// vim: set expandtab shiftwidth=4
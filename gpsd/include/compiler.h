@@ -56,6 +56,14 @@
     #define FALLTHROUGH
 #endif
 
+/* Macro for functions whose aligned vector loads may read past the
+ * end of a string, harmlessly, where AddressSanitizer would object */
+#if defined(__GNUC__) || defined(__clang__)
+    #define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+    #define NO_SANITIZE_ADDRESS
+#endif
+
 /*
  * Macro for compile-time checking if argument is an array.
  * It expands to constant expression with int value 0.
@@ -95,14 +95,32 @@ extern "C" {
  *       fix tow in never used struct rtcm3_1015_t
  *       remove never used struct rtcm3_1016_t and struct rtcm3_1017_t
  *       add struct baseline_t
+ * 13.1  Add gps_open_shm(), and SHM_NODEVICE
+ * 13.2  Add gps_snap_t records, gps_snap(), gps_arena_t, gps_ring_t
+ * 14    Add interval, tpv_interval, sky_interval, gst_interval to
+ *       gps_policy_t
+ *       Add fields, tpv_fields, sky_fields to gps_policy_t
+ *       Add sky_delta to gps_policy_t
+ *       Add ais_box, ais_poly, ais_mmsi, ais_exclude, ais_types and
+ *       their counts to gps_policy_t
+ *       Add GPSD_LOCAL_PREFIX, gps_open() of local SOCK_SEQPACKET sockets
+ *       Add gps_fleet_t, gps_fleet_stats_t, gps_fleet_*()
+ *       Add imu_batch to gps_policy_t
+ *       Add imubatch_t, imubatch to the union, and IMUBATCH_SET
+ *       Add fast_pvt to gps_policy_t
+ *       Add json_scan() and JSON_SCAN_* to json.h
+ *       Add skyview_device to gps_data_t
  *
  */
-#define GPSD_API_MAJOR_VERSION  13      // bump on incompatible changes
+#define GPSD_API_MAJOR_VERSION  14      // bump on incompatible changes
 #define GPSD_API_MINOR_VERSION  0       // bump on compatible changes
 
 #define MAXCHANNELS     140     // u-blox 9 tracks 140 signals
 #define MAXUSERDEVS     4       // max devices per user
 #define GPS_PATH_MAX    128     // for names like /dev/serial/by-id/...
+#define GPS_FIELDS_MAX  256     // for ?WATCH field lists
+#define GPS_AIS_MMSI_MAX 64     // MMSIs in a ?WATCH AIS filter list
+#define GPS_AIS_POLY_MAX 16     // vertices of a ?WATCH AIS filter area
 
 // normalize degrees to 0 to 359
 #define DEG_NORM(deg) \
@@ -2528,6 +2546,27 @@ struct attitude_t {
     struct baseline_t base;  // baseline from moving base
 };
 
+/* IMU samples batched, class IMUBATCH: those gpsd got in one window,
+ * from one message, as columns.  Sample i was tagged timeTag + dt[i]
+ * by the sensor.  A column the sensor did not send is all NaN.
+ * IMUBATCH_MAX keeps a batch no bigger than a rawdata_t, so that the
+ * union of gps_data_t, and every gps_data_t, does not grow for it. */
+#define IMUBATCH_MAX    192     // samples in a batch
+struct imubatch_t {
+    timespec_t mtime;           // when gpsd got the first sample
+    unsigned long timeTag;      // sensor time tag of the first sample
+    char msg[16];               // message the samples came in
+    int count;                  // samples in the batch
+    long dt[IMUBATCH_MAX];      // time tag less timeTag
+    double acc_x[IMUBATCH_MAX];         // m/s^2
+    double acc_y[IMUBATCH_MAX];
+    double acc_z[IMUBATCH_MAX];
+    double gyro_x[IMUBATCH_MAX];        // deg/s
+    double gyro_y[IMUBATCH_MAX];
+    double gyro_z[IMUBATCH_MAX];
+    double gyro_temp[IMUBATCH_MAX];     // deg C
+};
+
 struct dop_t {
     // Dilution of precision factors
     double xdop, ydop, pdop, hdop, vdop, tdop, gdop;
@@ -2638,6 +2677,38 @@ struct gps_policy_t {
     char devpath[GPS_PATH_MAX];         /* specific device to watch */
     // remote presently unused
     char remote[GPS_PATH_MAX];          /* ...if this was passthrough */
+    /* decimation: one report of a class per this many seconds of its
+     * UTC time, the first in each slot; 0 for every report */
+    double interval;                    /* of TPV, SKY and GST */
+    double tpv_interval;                /* of TPV, instead of interval */
+    double sky_interval;                /* of SKY, instead of interval */
+    double gst_interval;                /* of GST, instead of interval */
+    /* projection: TPV and SKY attributes to send, comma separated,
+     * empty for all of them.  The daemon compiles them to masks. */
+    char fields[GPS_FIELDS_MAX];
+    gps_mask_t tpv_fields;              /* 0 for all */
+    gps_mask_t sky_fields;              /* 0 for all */
+    /* SKY satellites as changes to the last SKY sent, with all of
+     * them in every sky_delta'th; 0 to send all of them every time */
+    int sky_delta;
+    /* IMU samples batched, class IMUBATCH, each batch the samples of
+     * this many ms; 0 to send each as class IMU */
+    int imu_batch;
+    /* TPV at once from each packet that is a whole fix, such as
+     * UBX-NAV-PVT, ahead of the report at the end of its cycle */
+    bool fast_pvt;
+    /* AIS filters: only AIS reports that pass every one given are
+     * sent.  A count of 0 for no filter. */
+    double ais_box[4];                  /* south, west, north, east */
+    int ais_nbox;
+    double ais_poly[GPS_AIS_POLY_MAX * 2];      /* lat, lon of vertices */
+    int ais_npoly;                      /* numbers in ais_poly */
+    unsigned int ais_mmsi[GPS_AIS_MMSI_MAX];    /* only these */
+    int ais_nmmsi;
+    unsigned int ais_exclude[GPS_AIS_MMSI_MAX]; /* none of these */
+    int ais_nexclude;
+    int ais_types[32];                  /* only these message types */
+    int ais_ntypes;
 };
 
 #ifndef TIMEDELTA_DEFINED
@@ -2730,7 +2801,8 @@ struct gps_data_t {
 #define VNED_SET        (1llu<<41)
 #define LOG_SET         (1llu<<42)
 #define IMU_SET         (1llu<<43)
-#define SET_HIGH_BIT    44
+#define IMUBATCH_SET    (1llu<<44)
+#define SET_HIGH_BIT    45
     timespec_t online;          /* NZ if GPS is on line, 0 if not.
                                  *
                                  * Note: gpsd clears this time when sentences
@@ -2761,6 +2833,9 @@ struct gps_data_t {
     timespec_t skyview_time;    /* skyview time */
     int satellites_visible;     /* # of satellites in view */
     struct satellite_t skyview[MAXCHANNELS];
+    /* device of the SKY the skyview came from, that SKY deltas of
+     * only the same device are merged into */
+    char skyview_device[GPS_PATH_MAX];
 
     struct devconfig_t dev;     /* device that shipped last update */
 
@@ -2775,7 +2850,8 @@ struct gps_data_t {
     /* pack things never reported together to reduce structure size */
 #define UNION_SET       (AIS_SET|ERROR_SET|GST_SET| \
                          LOGMESSAGE_SET|OSCILLATOR_SET|PPS_SET|RAW_SET| \
-                         RTCM2_SET|RTCM3_SET|SUBFRAME_SET|TOFF_SET|VERSION_SET)
+                         RTCM2_SET|RTCM3_SET|SUBFRAME_SET|TOFF_SET|VERSION_SET| \
+                         IMUBATCH_SET)
 
     union {
         /* unusual forms of sensor data that might come up the pipe */
@@ -2786,6 +2862,7 @@ struct gps_data_t {
         struct rawdata_t raw;
         struct gst_t gst;
         struct oscillator_t osc;
+        struct imubatch_t imubatch;
         /* "artificial" structures for various protocol responses */
         struct version_t version;
         char error[256];
@@ -2814,6 +2891,7 @@ struct gps_data_t {
 
 extern int gps_open(const char *, const char *,
                       struct gps_data_t *);
+extern int gps_open_shm(const char *, struct gps_data_t *);
 extern int gps_close(struct gps_data_t *);
 extern int gps_send(struct gps_data_t *, const char *, ... );
 extern int gps_read(struct gps_data_t *, char *message, int message_len);
@@ -2825,6 +2903,148 @@ extern int gps_mainloop(struct gps_data_t *, int,
 extern const char *gps_data(const struct gps_data_t *);
 extern const char *gps_errstr(const int);
 
+/*
+ * Snapshots: one report in a small record of its own, instead of merged
+ * into a gps_data_t where the next report of another class overwrites
+ * it.  A record can be handed to another thread without copying, or
+ * locking, the whole gps_data_t.  Records are built in memory the
+ * caller supplies, an arena or a ring, never in malloc()ed memory.
+ */
+struct gps_snap_t {             // every record starts with this
+    int type;                   // class of the report
+#define GPS_SNAP_TPV    1       // struct gps_snap_tpv_t
+#define GPS_SNAP_SKY    2       // struct gps_snap_sky_t
+#define GPS_SNAP_GST    3       // struct gps_snap_gst_t
+#define GPS_SNAP_ATT    4       // struct gps_snap_att_t
+#define GPS_SNAP_IMU    5       // struct gps_snap_att_t
+#define GPS_SNAP_RAW    6       // struct gps_snap_raw_t
+#define GPS_SNAP_AIS    7       // struct gps_snap_ais_t
+#define GPS_SNAP_PPS    8       // struct gps_snap_pps_t
+    unsigned size;              // bytes in the record, this included
+    char device[GPS_PATH_MAX];  // device that shipped the report
+};
+
+struct gps_snap_tpv_t {
+    struct gps_snap_t hdr;
+    struct gps_fix_t fix;
+};
+
+struct gps_snap_sky_t {
+    struct gps_snap_t hdr;
+    timespec_t time;
+    struct dop_t dop;
+    int satellites_used;
+    int satellites_visible;
+    int nsats;                  // skyview entries in the record
+    // the record ends after skyview[nsats - 1]
+    struct satellite_t skyview[MAXCHANNELS];
+};
+
+struct gps_snap_gst_t {
+    struct gps_snap_t hdr;
+    struct gst_t gst;
+};
+
+struct gps_snap_att_t {         // ATT and IMU
+    struct gps_snap_t hdr;
+    struct attitude_t att;
+};
+
+struct gps_snap_raw_t {
+    struct gps_snap_t hdr;
+    int nmeas;                  // raw.meas entries in the record
+    // the record ends after raw.meas[nmeas - 1]
+    struct rawdata_t raw;
+};
+
+struct gps_snap_ais_t {
+    struct gps_snap_t hdr;
+    struct ais_t ais;
+};
+
+struct gps_snap_pps_t {
+    struct gps_snap_t hdr;
+    struct timedelta_t pps;
+    long qErr;                  // picoseconds
+};
+
+// caller's memory that records are carved from, until reset
+struct gps_arena_t {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+};
+
+/* A ring of records with one writer and any number of readers.  The
+ * writer never waits: a reader that falls a ring behind loses the
+ * oldest records.  Each reader keeps its own cursor. */
+struct gps_ring_t {
+    unsigned char *slots;
+    size_t slotsize;            // bytes per slot
+    unsigned long nslots;
+    volatile unsigned long head;        // records ever put
+};
+
+extern size_t gps_snap_size(const struct gps_data_t *, const char *);
+extern struct gps_snap_t *gps_snap(const struct gps_data_t *, const char *,
+                                   void *, size_t);
+extern void gps_arena_init(struct gps_arena_t *, void *, size_t);
+extern void *gps_arena_alloc(struct gps_arena_t *, size_t);
+extern struct gps_snap_t *gps_snap_arena(const struct gps_data_t *,
+                                         const char *, struct gps_arena_t *);
+extern int gps_ring_init(struct gps_ring_t *, void *, size_t, size_t);
+extern struct gps_snap_t *gps_ring_put(struct gps_ring_t *,
+                                       const struct gps_data_t *,
+                                       const char *);
+extern struct gps_snap_t *gps_ring_get(struct gps_ring_t *, unsigned long *,
+                                       void *, size_t);
+
+/*
+ * Fleets: many gpsd connections watched from one thread, on one epoll
+ * instance.  A member keeps only its socket, address and any partial
+ * line; lines are read through one buffer the fleet shares and handed
+ * to the caller's hook tagged with their member, to be unpacked, if the
+ * hook wants, into the one gps_data_t the fleet has.  A lost member is
+ * reconnected after a jittered delay, doubling each failure, unless its
+ * own delays say not to.  libgpsmm_async.h is built on a fleet.
+ */
+struct gps_fleet_t;
+
+// a line from member, NUL terminated, without its line end
+typedef void (*gps_fleet_hook_t)(void *arg, struct gps_fleet_t *fleet,
+                                 int member, char *line, size_t len);
+// member connected, up, or was lost or refused
+typedef void (*gps_fleet_notice_t)(void *arg, struct gps_fleet_t *fleet,
+                                   int member, bool up);
+
+struct gps_fleet_stats_t {
+    int members;
+    int up;                     // members connected
+    unsigned long lines;        // lines handed to the hook
+    unsigned long connects;     // connections made
+    unsigned long drops;        // connections lost, or not made
+    unsigned long overflows;    // lines too long, dropped
+    size_t bytes;               // memory the fleet takes
+};
+
+extern struct gps_fleet_t *gps_fleet_open(const char *, int, int,
+                                          gps_fleet_hook_t, void *);
+extern int gps_fleet_add(struct gps_fleet_t *, const char *, const char *,
+                         const char *);
+extern int gps_fleet_adopt(struct gps_fleet_t *, int, const char *);
+extern bool gps_fleet_retry(struct gps_fleet_t *, int, int, int);
+extern void gps_fleet_notices(struct gps_fleet_t *, gps_fleet_notice_t);
+extern bool gps_fleet_send(struct gps_fleet_t *, int, const char *);
+extern void gps_fleet_remove(struct gps_fleet_t *, int);
+extern int gps_fleet_fd(const struct gps_fleet_t *);
+extern int gps_fleet_poll(struct gps_fleet_t *, int);
+extern const char *gps_fleet_tag(const struct gps_fleet_t *, int);
+extern bool gps_fleet_up(const struct gps_fleet_t *, int);
+extern struct gps_data_t *gps_fleet_unpack(struct gps_fleet_t *, char *);
+extern void gps_fleet_stats(const struct gps_fleet_t *,
+                            struct gps_fleet_stats_t *);
+extern void gps_fleet_close(struct gps_fleet_t *);
+
 int json_toff_read(const char *buf, struct gps_data_t *,
                   const char **);
 int json_pps_read(const char *buf, struct gps_data_t *,
@@ -2920,6 +3140,7 @@ extern short ubx2_to_prn(int gnssId, int svId);
 #define SHM_NOSHARED    -7      // shared-memory segment not available
 #define SHM_NOATTACH    -8      // shared-memory attach failed
 #define DBUS_FAILURE    -9      // DBUS initialization failure
+#define SHM_NODEVICE    -10     // device not in the shared-memory directory
 
 #define DEFAULT_GPSD_PORT       "2947"  /* IANA assignment */
 #define DEFAULT_RTCM_PORT       "2101"  /* IANA assignment */
@@ -2927,6 +3148,9 @@ extern short ubx2_to_prn(int gnssId, int svId);
 /* special host values for non-socket exports */
 #define GPSD_SHARED_MEMORY      "shared memory"
 #define GPSD_DBUS_EXPORT        "DBUS export"
+/* host prefix for the path of a local, SOCK_SEQPACKET, client socket,
+ * as in "unix:/run/gpsd.seqpacket" */
+#define GPSD_LOCAL_PREFIX       "unix:"
 
 #ifdef __cplusplus
 }  /* End of the 'extern "C"' block */
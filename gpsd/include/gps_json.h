@@ -15,8 +15,14 @@
 extern "C" {
 #endif
 
+struct gps_chain_t;
 struct gps_device_t;
+struct sky_delta_t;
 
+void json_data_emit(const gps_mask_t,
+                    const struct gps_device_t *,
+                    const struct gps_policy_t *,
+                    struct gps_chain_t *);
 void json_data_report(const gps_mask_t,
                       const struct gps_device_t *,
                       const struct gps_policy_t *,
@@ -24,15 +30,31 @@ void json_data_report(const gps_mask_t,
 char *json_stringify(char *, size_t, const char *);
 void json_tpv_dump(const gps_mask_t, const struct gps_device_t *,
                    const struct gps_policy_t *, char *, size_t);
+void json_pvt_dump(const gps_mask_t, const struct gps_device_t *,
+                   const struct gps_policy_t *, char *, size_t);
 void json_noise_dump(const struct gps_data_t *, char *, size_t);
+void json_raw_emit(const struct gps_data_t *, struct gps_chain_t *);
 void json_raw_dump(const struct gps_data_t *, char *, size_t);
-void json_sky_dump(const struct gps_data_t *, char *, size_t);
+void json_sky_emit(const struct gps_data_t *, const struct gps_policy_t *,
+                   struct gps_chain_t *);
+void json_sky_dump(const struct gps_data_t *, const struct gps_policy_t *,
+                   char *, size_t);
+void json_sky_delta_emit(const struct gps_data_t *,
+                         const struct gps_policy_t *,
+                         struct sky_delta_t *, struct gps_chain_t *);
+void json_sky_delta_dump(const struct gps_data_t *,
+                         const struct gps_policy_t *,
+                         struct sky_delta_t *, char *, size_t);
 void json_att_dump(const struct gps_data_t *, char *, size_t,
                    const struct attitude_t *, const char *);
+void json_imubatch_emit(const struct gps_device_t *,
+                        const struct gps_policy_t *, unsigned long *,
+                        struct gps_chain_t *);
 void json_oscillator_dump(const struct gps_data_t *, char *, size_t);
 void json_subframe_dump(const struct gps_data_t *, const bool scaled, char buf[], size_t);
 void json_device_dump(const struct gps_device_t *, char *, size_t);
 void json_watch_dump(const struct gps_policy_t *, char *, size_t);
+void json_watch_fields(struct gps_policy_t *);
 int json_watch_read(const char *, struct gps_policy_t *,
                     const char **);
 char *json_policy_to_watch(struct gps_policy_t *ccp,
@@ -17,6 +17,7 @@
 extern "C" {
 # endif
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -32,6 +33,7 @@ extern "C" {
 #include "gps.h"
 #include "os_compat.h"
 #include "ppsthread.h"
+#include "rtsched.h"
 #include "timespec.h"
 
 /*
@@ -101,6 +103,29 @@ extern "C" {
  *      add netlib_connectsock1()
  *      add nmea.gsx_more to gps_device_t
  *      add TSIPv1 stuff
+ *      add in_time, read_time, read_start, out_time, kernel_time to lexer_t
+ *      add discard_counter, bad_counter to lexer_t
+ *      add gps_outq_t, outq to gps_device_t, outq_policy to gps_context_t
+ *      add wfds to gpsd_await_data()
+ *      add gpsd_decimate()
+ *      add struct sky_delta_t
+ *      add struct ais_filter_t, gpsd_ais_filtering(), gpsd_ais_filter_init(),
+ *          gpsd_ais_filter(), gpsd_ais_filter_check()
+ *      add struct gps_stage_t, gpsd_stage_put(), gpsd_stage_flush(),
+ *          gpsd_stage_flush_held(), gpsd_stage_hold()
+ *      add struct gps_fanout_t, gpsd_fanout_start(), gpsd_fanout_post(),
+ *          gpsd_fanout_publish(), gpsd_fanout_drain(), gpsd_fanout_stop()
+ *      add struct gps_segment_t, struct gps_chain_t, gpsd_chain_*(),
+ *          gpsd_stage_put_chain(), gpsd_chain_write_lines()
+ *      add struct gps_lane_t, gpsd_report_new(), gpsd_report_chain(),
+ *          gpsd_report_drop(), gpsd_fanout_share()
+ *      add struct gps_ppsq_t, gpsd_ppsq_init(), gpsd_ppsq_put(),
+ *          gpsd_ppsq_get()
+ *      add pps_rtprio, pps_cpus to gps_context_t
+ *      add struct imu_sample_t, struct imu_ring_t, imu to gps_device_t,
+ *          gpsd_imu_push(), which allocates the ring
+ *      add PVT_IS, pvt_hook to gps_context_t, gpsd_decimate_pvt()
+ *      add ntp_arrival to gps_context_t
  */
 
 #define JSON_DATE_MAX   24      /* ISO8601 timestamp with 2 decimal places */
@@ -257,10 +282,18 @@ struct gps_lexer_t {
     size_t outbuflen;
     unsigned long char_counter;         // count characters processed
     unsigned long retry_counter;        // count sniff retries
+    unsigned long discard_counter;      // count characters thrown away
+    unsigned long bad_counter;          // count packets failing checks
     unsigned counter;                   // packets since last driver switch
     struct gpsd_errout_t errout;        // how to report errors
     timespec_t start_time;              // time of first input, sort of
     timespec_t pkt_time;                // time of last packet parsed
+    // when input arrived: kernel stamps where the fd has them, else read()
+    timespec_t in_time;                 // arrival of inbuffer[0]
+    timespec_t read_time;               // arrival of the last read's data
+    size_t read_start;                  // offset of the last read's data
+    timespec_t out_time;                // arrival of outbuffer[0]
+    bool kernel_time;                   // recvmsg() with SO_TIMESTAMPNS
     unsigned long start_char;           // char counter at first input
     /*
      * ISGPS200 decoding context.
@@ -294,6 +327,8 @@ extern void packet_reset(struct gps_lexer_t *);
 extern void packet_pushback(struct gps_lexer_t *);
 extern void packet_parse(struct gps_lexer_t *);
 extern ssize_t packet_get(int, struct gps_lexer_t *);
+extern ssize_t packet_get_json(int, struct gps_lexer_t *);
+extern bool packet_kernel_time(int, struct gps_lexer_t *);
 extern int packet_sniff(struct gps_lexer_t *);
 #define packet_buffered_input(lexer) ((lexer)->inbuffer + (lexer)->inbuflen - (lexer)->inbufptr)
 
@@ -326,8 +361,12 @@ struct gps_context_t {
     // if true, remove fix gate to time, for some RTC backed receivers.
     // DANGEROUS
     bool batteryRTC;
+    /* if true, NTP in-band time is referenced to the arrival of the
+     * packet's first byte, not to when it was decoded */
+    bool ntp_arrival;
     speed_t fixed_port_speed;           // Fixed port speed, if non-zero
     char fixed_port_framing[4];         // Fixed port framing, if non-blank
+    int outq_policy;                    // OUTQ_* RTCM policies
     /* DGPS status */
     int fixcnt;                         // count of good fixes seen
     /* timekeeping */
@@ -347,11 +386,20 @@ struct gps_context_t {
     volatile struct shmTime *shmTime[NTPSHMSEGS];
     bool shmTimeInuse[NTPSHMSEGS];
     void (*pps_hook)(struct gps_device_t *, int, int, struct timedelta_t *);
+    /* called from gpsd_poll() with a packet that is a whole fix, see
+     * PVT_IS, before it is merged into the cycle */
+    void (*pvt_hook)(struct gps_device_t *, gps_mask_t);
+    int pps_rtprio;                     // PPS threads SCHED_FIFO, if > 0
+    struct rt_cpus_t pps_cpus;          // CPUs for PPS threads, if any
 #ifdef SHM_EXPORT_ENABLE
     /* we don't want the compiler to treat writes to shmexport as dead code,
      * and we don't want them reordered either */
     volatile void *shmexport;
     int shmid;                          // ID of SHM  (for later IPC_RMID)
+    volatile void *shmdirectory;        // the per-device directory
+    int shmdirid;
+    volatile void *shmdevice[MAX_DEVICES];      // one export per device
+    int shmdevid[MAX_DEVICES];
 #endif
     ssize_t (*serial_write)(struct gps_device_t *,
                             const char *buf, const size_t len);
@@ -404,6 +452,7 @@ typedef enum {
 #define PASSTHROUGH_IS  INTERNAL_SET(9)         /* passthrough mode */
 #define EOF_IS          INTERNAL_SET(10)        /* synthetic EOF */
 #define GOODTIME_IS     INTERNAL_SET(11)      /* time good even if no pos fix */
+#define PVT_IS          INTERNAL_SET(12)        // whole fix, all in newdata
 #define DATA_IS ~(ONLINE_SET|PACKET_SET|CLEAR_IS|REPORT_IS)
 
 typedef unsigned int driver_mask_t;
@@ -539,6 +588,77 @@ struct ntrip_stream_t
     int bitrate;
 };
 
+/*
+ * Output waiting for a device that would not take it all at once.
+ * gpsd_queue_write() queues what write() leaves, and gpsd_outq_flush()
+ * sends more of it whenever the device can take it, so a slow link
+ * never stalls the daemon.  Each queued message remembers what it is,
+ * so the RTCM policies can rework what has not been started.
+ */
+#define OUTQ_SIZE       16384           // bytes queued for one device
+#define OUTQ_MSGS       64              // messages queued for one device
+
+#define OUTQ_CONFIG     0               // driver commands and such
+#define OUTQ_RTCM       1               // corrections relayed to the device
+
+// RTCM policies, context.outq_policy
+#define OUTQ_COALESCE   0x01    // newer RTCM replaces queued of its type
+#define OUTQ_STALE      0x02    // a new epoch drops unsent older RTCM
+#define OUTQ_PRIORITY   0x04    // commands go ahead of queued RTCM
+
+struct gps_outq_t {
+    size_t len;                         // bytes queued
+    size_t sent;                        // bytes of msgs[0] already written
+    int nmsgs;
+    struct {
+        size_t len;
+        int kind;                       // OUTQ_CONFIG or OUTQ_RTCM
+        unsigned type;                  // RTCM message type
+        unsigned long epoch;            // RTCM epoch, by source arrival
+    } msgs[OUTQ_MSGS];
+    // what the next gpsd_queue_write() is, all_reports() sets for RTCM
+    int kind;
+    unsigned type;
+    unsigned long epoch;
+    unsigned long dropped;              // RTCM messages policies dropped
+    // OUTQ_SIZE, from the first write that waits, freed by gpsd_close()
+    unsigned char *buf;
+};
+
+/* What a SKY delta watcher was last sent of a device's skyview: a key
+ * and a hash of the JSON of each satellite.  See json_sky_delta_dump().
+ */
+struct sky_delta_t {
+    int nsats;                          // -1 for a full SKY next
+    int reports;                        // SKY sent since the last full one
+    struct {
+        short PRN;
+        unsigned char gnssid, svid, sigid;
+        uint32_t hash;
+    } sats[MAXCHANNELS];
+};
+
+/* IMU samples as the drivers got them, for watchers that take them
+ * batched.  head counts every sample ever pushed, and the last IMU_RING
+ * of them are kept, so a watcher that keeps the count it was sent up
+ * to can tell what it has not been sent, and what it missed.  See
+ * gpsd_imu_push() and json_imubatch_emit().
+ */
+#define IMU_RING        512     // samples kept, at least 2 IMUBATCH_MAX
+#define IMU_COLS        7       // acc_x, _y, _z, gyro_x, _y, _z, gyro_temp
+struct imu_sample_t {
+    timespec_t time;                    // when gpsd got it
+    unsigned long timeTag;              // the sensor's time tag
+    unsigned cols;                      // bit i set if val[i] is
+    char msg[16];                       // the message it came in
+    double val[IMU_COLS];
+};
+
+struct imu_ring_t {
+    unsigned long head;                 // samples pushed
+    // IMU_RING of them, from the first gpsd_imu_push(), else NULL
+    struct imu_sample_t *sample;
+};
 
 struct gps_device_t {
 /* session object, encapsulates all global state */
@@ -857,6 +977,11 @@ struct gps_device_t {
     struct {
         bool reported;
     } dgpsip;
+    // RTCM this device has sent, to tell its epochs apart
+    unsigned long rtcm_epoch;
+    timespec_t rtcm_time;
+    struct imu_ring_t imu;
+    struct gps_outq_t outq;
 };
 
 /*
@@ -946,6 +1071,10 @@ extern int gpsd_serial_open(struct gps_device_t *);
 extern void gpsd_tty_init(struct gps_device_t *);
 extern ssize_t gpsd_serial_write(struct gps_device_t *,
                                  const char *, const size_t);
+extern ssize_t gpsd_queue_write(struct gps_device_t *,
+                                const char *, const size_t);
+extern ssize_t gpsd_outq_flush(struct gps_device_t *);
+extern void gpsd_outq_drain(struct gps_device_t *);
 extern bool gpsd_next_hunt_setting(struct gps_device_t *);
 extern int gpsd_switch_driver(struct gps_device_t *, char *);
 extern void gpsd_set_speed(struct gps_device_t *, speed_t, char, unsigned int);
@@ -966,6 +1095,155 @@ extern timespec_t gpsd_utc_resolve(struct gps_device_t *);
 extern void gpsd_century_update(struct gps_device_t *, int);
 
 extern void gpsd_zero_satellites(struct gps_data_t *sp);
+
+// report classes a watcher can decimate, see gpsd_decimate()
+#define DECIMATE_TPV            0
+#define DECIMATE_SKY            1
+#define DECIMATE_GST            2
+#define DECIMATE_CLASSES        3
+extern gps_mask_t gpsd_decimate(const struct gps_policy_t *,
+                                const struct gps_device_t *,
+                                gps_mask_t, long long *);
+extern bool gpsd_decimate_pvt(const struct gps_policy_t *,
+                              const struct gps_device_t *, long long *);
+extern void gpsd_imu_push(struct gps_device_t *, const struct attitude_t *);
+
+/* A watcher's ?WATCH AIS filters, compiled for gpsd_ais_filter().  The
+ * MMSI lists are hashed, open addressed, 0 for an empty slot. */
+#define AIS_FILTER_SLOTS        (GPS_AIS_MMSI_MAX * 2)  // a power of 2
+#define AIS_AREA_SLOTS          1024                    // a power of 2
+struct ais_filter_t {
+    uint32_t types;                     // bit n for type n, 0 for all
+    unsigned int mmsi[AIS_FILTER_SLOTS];
+    unsigned int exclude[AIS_FILTER_SLOTS];
+    /* direct mapped, the MMSIs last seen inside the area, so reports
+     * with no position of ships there pass too */
+    unsigned int inside[AIS_AREA_SLOTS];
+};
+extern bool gpsd_ais_filtering(const struct gps_policy_t *);
+extern const char *gpsd_ais_filter_check(const struct gps_policy_t *);
+extern void gpsd_ais_filter_init(struct ais_filter_t *,
+                                 const struct gps_policy_t *);
+extern bool gpsd_ais_filter(struct ais_filter_t *,
+                            const struct gps_policy_t *,
+                            const struct ais_t *);
+
+/* A client's output, staged over one pass of the main loop and sent
+ * with gpsd_stage_flush() in one write.  A frame too big for what is
+ * left of buf does not go in.  What a short write did not send stays,
+ * held at the front, for the next write. */
+#define STAGE_SIZE              16384
+struct gps_stage_t {
+    size_t len;                 // bytes staged
+    size_t held;                // of them, left by a short write
+    unsigned long pieces;       // writes they stand in for
+    char buf[STAGE_SIZE];
+};
+extern bool gpsd_stage_put(struct gps_stage_t *, const unsigned char *,
+                           size_t, const char *, size_t);
+extern ssize_t gpsd_stage_flush(struct gps_stage_t *, int);
+extern ssize_t gpsd_stage_flush_held(struct gps_stage_t *, int);
+extern bool gpsd_stage_hold(struct gps_stage_t *, const char *, size_t);
+
+/* Output written into a chain of fixed-size segments from a pool, with
+ * no size ceiling, and sent with one writev(), see chain.c.  A segment
+ * holds the longest piece an emitter reserves in one go. */
+#define CHAIN_SEGMENT           16384
+#define CHAIN_POOL_MAX          64      // free segments the pool keeps
+struct gps_segment_t {
+    struct gps_segment_t *next;
+    size_t len;
+    char buf[CHAIN_SEGMENT];
+};
+struct gps_chain_t {
+    struct gps_segment_t *head, *tail;
+    size_t len;                 // bytes in all segments
+    int nsegs;
+    bool failed;                // out of memory, the output is short
+};
+extern void gpsd_chain_init(struct gps_chain_t *);
+extern char *gpsd_chain_reserve(struct gps_chain_t *, size_t);
+extern void gpsd_chain_commit(struct gps_chain_t *, size_t);
+extern void gpsd_chain_append(struct gps_chain_t *, const char *, size_t);
+extern void gpsd_chain_puts(struct gps_chain_t *, const char *);
+PRINTF_FUNC(2, 3) void gpsd_chain_appendf(struct gps_chain_t *,
+                                          const char *, ...);
+extern char gpsd_chain_last(const struct gps_chain_t *);
+extern void gpsd_chain_rstrip(struct gps_chain_t *, char);
+extern size_t gpsd_chain_copy(const struct gps_chain_t *, char *, size_t);
+extern ssize_t gpsd_chain_write(const struct gps_chain_t *, int,
+                                const unsigned char *, size_t);
+extern ssize_t gpsd_chain_write_lines(const struct gps_chain_t *, int);
+extern void gpsd_chain_release(struct gps_chain_t *);
+extern int gpsd_chain_pooled(void);
+extern bool gpsd_stage_put_chain(struct gps_stage_t *, const unsigned char *,
+                                 size_t, const struct gps_chain_t *);
+
+/* Client output, delivered by a pool of writer threads, see fanout.c.
+ * The deliver hook gets the client, its generation when posted, and
+ * the bytes, on the client's shard's thread. */
+#define FANOUT_SHARDS_MAX       16
+#define FANOUT_QUEUED           0       // lanes of a shard
+#define FANOUT_URGENT           1       // delivered from first
+#define FANOUT_LANES            2
+struct gps_report_t;                    // refcounted, immutable
+typedef void (*gps_deliver_t)(void *, int, unsigned long,
+                              const char *, size_t);
+struct gps_delivery_t {
+    int client;
+    unsigned long gen;
+    struct gps_report_t *report;
+};
+struct gps_lane_t {
+    size_t head, tail;          // a ring, empty when head == tail
+    struct gps_delivery_t *ring;
+};
+struct gps_shard_t {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;        // something to deliver, or stop
+    pthread_cond_t idle;        // everything delivered
+    bool stop;
+    bool posted;                // since the last publish
+    size_t size;                // of each lane's ring
+    struct gps_lane_t lane[FANOUT_LANES];
+    struct gps_fanout_t *fanout;
+};
+struct gps_fanout_t {
+    int nshards;
+    gps_deliver_t deliver;
+    void *arg;
+    struct gps_shard_t shards[FANOUT_SHARDS_MAX];
+    unsigned long posts, urgent, dropped;
+};
+extern int gpsd_fanout_start(struct gps_fanout_t *, int, size_t,
+                             gps_deliver_t, void *);
+extern struct gps_report_t *gpsd_report_new(const unsigned char *, size_t,
+                                            const char *, size_t);
+extern struct gps_report_t *gpsd_report_chain(const unsigned char *, size_t,
+                                              const struct gps_chain_t *);
+extern void gpsd_report_drop(struct gps_report_t *);
+extern bool gpsd_fanout_share(struct gps_fanout_t *, int, unsigned long,
+                              struct gps_report_t *, bool);
+extern bool gpsd_fanout_post(struct gps_fanout_t *, int, unsigned long,
+                             const char *, size_t);
+extern void gpsd_fanout_publish(struct gps_fanout_t *);
+extern void gpsd_fanout_drain(struct gps_fanout_t *);
+extern void gpsd_fanout_stop(struct gps_fanout_t *);
+
+/* PPS messages, handed from a device's PPS thread to the main loop
+ * without a lock, see ppsqueue.c. */
+#define PPSQ_SIZE               8       // messages a device's ring holds
+#define PPSQ_MSG_MAX            512
+struct gps_ppsq_t {
+    atomic_ulong head;          // moved only by the main loop
+    atomic_ulong tail;          // moved only by the PPS thread
+    unsigned long dropped;      // the ring was full
+    char msg[PPSQ_SIZE][PPSQ_MSG_MAX];
+};
+extern void gpsd_ppsq_init(struct gps_ppsq_t *);
+extern bool gpsd_ppsq_put(struct gps_ppsq_t *, const char *);
+extern bool gpsd_ppsq_get(struct gps_ppsq_t *, char *, size_t);
 extern gps_mask_t gpsd_interpret_subframe(struct gps_device_t *,
                                           unsigned int,
                                           unsigned int,
@@ -1031,15 +1309,33 @@ extern void clear_dop(struct dop_t *);
 
 /* shmexport.c */
 #define GPSD_SHM_KEY    0x47505344      /* "GPSD" */
+/* The directory of per-device segments lives at the export key plus
+ * this, so gpsfake's keys, one per port, stay apart. */
+#define GPSD_SHM_DIRECTORY_OFFSET 0x10000
 struct shmexport_t
 {
     int bookend1;
     struct gps_data_t gpsdata;
     int bookend2;
 };
+/* Each device also gets a private segment, laid out as a shmexport_t,
+ * holding only its own data.  The directory maps paths to them. */
+struct shmdirectory_t
+{
+    int bookend1;
+    /* entries in device[].  This is MAX_DEVICES of the daemon, so
+     * clients size the directory, and find bookend2, from it. */
+    int ndevices;
+    struct {
+        char path[GPS_PATH_MAX];
+        int shmid;                      // -1 if the entry is free
+    } device[MAX_DEVICES];
+    int bookend2;
+};
 extern bool shm_acquire(struct gps_context_t *);
 extern void shm_release(struct gps_context_t *);
-extern void shm_update(struct gps_context_t *, struct gps_data_t *);
+extern void shm_device(struct gps_context_t *, int, const char *);
+extern void shm_update(struct gps_context_t *, int, struct gps_data_t *);
 
 /* dbusexport.c */
 #if defined(DBUS_EXPORT_ENABLE)
@@ -1051,6 +1347,19 @@ void send_dbus_fix (struct gps_device_t* channel);
 int b64_ntop(unsigned char const *src, size_t srclength, char *target,
     size_t targsize);
 
+/* websocket.c */
+#define WS_HEADER_MAX   10      // longest server frame header
+#define WS_OP_CONT      0x0
+#define WS_OP_TEXT      0x1
+#define WS_OP_BINARY    0x2
+#define WS_OP_CLOSE     0x8
+#define WS_OP_PING      0x9
+#define WS_OP_PONG      0xa
+extern ssize_t ws_handshake(const char *, size_t, char *, size_t);
+extern size_t ws_frame_header(unsigned char *, int, size_t);
+extern ssize_t ws_unframe(unsigned char *, size_t, int *, bool *,
+                          unsigned char **, size_t *);
+
 /* application interface */
 extern void gps_context_init(struct gps_context_t *context,
                              const char *label);
@@ -1071,6 +1380,7 @@ extern void gpsd_deactivate(struct gps_device_t *);
 #define AWAIT_NOT_READY 0
 #define AWAIT_FAILED    -1
 extern int gpsd_await_data(fd_set *,
+                           fd_set *,
                            fd_set *,
                            int,
                            fd_set *,
@@ -1097,6 +1407,8 @@ extern bool ais_binary_decode(const struct gpsd_errout_t *errout,
                               struct ais_t *ais,
                               const unsigned char *, size_t,
                               struct ais_type24_queue_t *);
+extern bool aivdm_dearmor(unsigned char *, size_t *, size_t,
+                          const unsigned char *, size_t);
 
 void gpsd_labeled_report(const int, const int,
                          const char *, const char *, va_list);
@@ -1113,15 +1425,64 @@ PRINTF_FUNC(3, 4) void gpsd_log(const int, const struct gpsd_errout_t *,
  *     GPSD_LOG(2, ("this will appear on stdout if debug >= %d\n", 2));
  *
  * This saves significant pushing, popping, hexification, etc. when
- * the debug level does not require it.
+ * the debug level does not require it.  Sites more verbose than
+ * MAX_LOG_LEVEL (the max_log_level build option) compile to nothing.
  */
+#ifndef MAX_LOG_LEVEL
+#define MAX_LOG_LEVEL   LOG_RAW2
+#endif  // MAX_LOG_LEVEL
+
 #define GPSD_LOG(lvl, eo, ...)                 \
     do {                                       \
-        if (unlikely((eo)->debug >= (lvl))) {  \
+        if ((lvl) <= MAX_LOG_LEVEL &&          \
+            unlikely((eo)->debug >= (lvl))) {  \
             gpsd_log(lvl, eo, __VA_ARGS__);    \
         }                                      \
     } while (0)
 
+/*
+ * trace.c: GPSD_TRACE() is GPSD_LOG() for the sites on the packet hot
+ * path.  Each site is one of the events below, with up to TRACE_ARGS
+ * integers and optionally a packet; trace.c holds their messages.
+ * After trace_defer(true) the events are recorded in binary, and
+ * formatted only by trace_dump().
+ */
+enum trace_id_t {
+    TRACE_CHAR_DISCARD,         // inbuflen; inbuffer
+    TRACE_PACKET_ACCEPT,        // type, length; packet
+    TRACE_PACKET_DISCARD,       // discarded, remaining; inbuffer
+    TRACE_PACKET_STASH,         // length; stashbuffer
+    TRACE_PACKET_NOTREADY,
+    TRACE_PACKET_READ,          // read, inbuflen, total; bytes read
+    TRACE_PACKET_GET,           // fd, return, errno
+    TRACE_CORE_RAW,             // type, length; packet
+    TRACE_CORE_PARSE,           // mask
+    TRACE_CORE_POLL,            // mask; device path
+    TRACE_CORE_BADSUM,          // device path
+    TRACE_CORE_PACKET,          // type, mask; device path
+    TRACE_CLIENT_WRITE,         // client, length; data written
+    TRACE_ALL_REPORTS,          // mask
+    TRACE_IDS                   // count of event ids
+};
+
+#define TRACE_ARGS      3       // integer arguments of an event
+#define TRACE_DATA_MAX  32      // packet bytes kept with an event
+
+extern void gpsd_trace(const int, const struct gpsd_errout_t *,
+                       const unsigned, const int64_t, const int64_t,
+                       const int64_t, const void *, const size_t);
+extern void trace_defer(bool);
+extern int trace_dump(void (*)(const char *, void *), void *);
+
+#define GPSD_TRACE(lvl, eo, id, a0, a1, a2, data, len)                  \
+    do {                                                                \
+        if ((lvl) <= MAX_LOG_LEVEL &&                                   \
+            unlikely((eo)->debug >= (lvl))) {                           \
+            gpsd_trace(lvl, eo, id, (int64_t)(a0), (int64_t)(a1),       \
+                       (int64_t)(a2), data, len);                       \
+        }                                                               \
+    } while (0)
+
 
 
 #define NITEMS(x) ((int) (sizeof(x) / sizeof(x[0]) + COMPILE_CHECK_IS_ARRAY(x)))
@@ -30,6 +30,46 @@ extern void monitor_complain(const char *fmt, ...);
 
 #define BUFLEN          2048
 
+/* link statistics, kept up packet by packet */
+#define LINKSTAT_CLASSES        24      /* the last one is "other" */
+#define LINKSTAT_NAMELEN        12
+
+struct linkstat_class_t {
+    char name[LINKSTAT_NAMELEN];        /* sentence tag, UBX class-id... */
+    unsigned long count;                /* packets seen */
+    unsigned long bytes;                /* bytes in them */
+    unsigned long wcount, wbytes;       /* the same, this second */
+    double hz, bps;                     /* the same, last second */
+    timespec_t last;                    /* arrival of the latest */
+    double interval;                    /* mean seconds between them */
+    double jitter;                      /* mean deviation from that */
+};
+
+struct linkstats_t {
+    struct linkstat_class_t classes[LINKSTAT_CLASSES];
+    int nclasses;
+    unsigned baudrate;                  /* 0 if not known */
+    unsigned charbits;                  /* bits on the wire per byte */
+    char framing[4];                    /* "8N1" */
+    double cycle;                       /* receiver cycle, seconds */
+    timespec_t epoch_start, epoch_end;  /* the epoch being received */
+    double epoch, epoch_max;            /* duration of the last, longest */
+    timespec_t wstart;                  /* start of this second */
+    unsigned long wchars;               /* lexer chars at its start */
+    double bps;                         /* bytes per second, last second */
+    unsigned long chars, discards, bad; /* lexer counters */
+};
+
+extern void linkstats_init(struct linkstats_t *, const timespec_t *);
+extern void linkstats_link(struct linkstats_t *, unsigned, unsigned, char,
+                           const timespec_t *);
+extern void linkstats_packet(struct linkstats_t *,
+                             const struct gps_lexer_t *);
+extern bool linkstats_tick(struct linkstats_t *, const struct gps_lexer_t *,
+                           const timespec_t *);
+extern size_t linkstats_panel(const struct linkstats_t *, char *, size_t);
+extern size_t linkstats_json(const struct linkstats_t *, char *, size_t);
+
 extern struct gps_device_t      session;
 extern bool serial;     /* True - direct mode, False - daemon mode */
 
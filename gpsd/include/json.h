@@ -134,6 +134,11 @@ struct json_attr_t {
 #define JSON_ATTR_MAX   31      /* max chars in JSON attribute name */
 #define JSON_VAL_MAX    512     /* max chars in JSON value part */
 
+/* kinds of run for json_scan(), each also ended by the NUL */
+#define JSON_SCAN_ATTR          1       /* attribute name, ends at " */
+#define JSON_SCAN_STRING        2       /* string value, ends at " or backslash */
+#define JSON_SCAN_TOKEN         4       /* token, ends at space , or } */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -142,6 +147,7 @@ int json_read_object(const char *, const struct json_attr_t *,
 int json_read_array(const char *, const struct json_array_t *,
                     const char **);
 const char *json_error_string(int);
+size_t json_scan(const char *, unsigned);
 
 void json_enable_debug(int, FILE *);
 char *json_quote(const char *, char *, size_t, size_t);
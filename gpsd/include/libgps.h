@@ -28,6 +28,7 @@ extern const char *gps_sock_data(const struct gps_data_t *);
 extern int gps_sock_mainloop(struct gps_data_t *, int,
                               void (*)(struct gps_data_t *));
 extern int gps_shm_open(struct gps_data_t *);
+extern int gps_shm_open_device(struct gps_data_t *, const char *);
 extern void gps_shm_close(struct gps_data_t *);
 extern bool gps_shm_waiting(const struct gps_data_t *, int);
 extern int gps_shm_read(struct gps_data_t *);
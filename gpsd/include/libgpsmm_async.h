@@ -0,0 +1,433 @@
+#ifndef _GPSD_GPSMM_ASYNC_H_
+#define _GPSD_GPSMM_ASYNC_H_
+
+/*
+ * libgpsmm_async.h - awaitable gpsd sessions, many on one thread
+ *
+ * gpsmm blocks in waiting() and read(), so a client of several gpsd
+ * instances needs a thread each.  Here a session is awaited instead:
+ *
+ *     gpsmm_async::task track(gpsmm_async::session &s)
+ *     {
+ *         for (;;) {
+ *             auto tpv = co_await s.next<gpsmm_async::TPV>();
+ *
+ *             if (nullptr == tpv) {
+ *                 break;          // lost, and not reconnecting
+ *             }
+ *             use(tpv->fix.latitude, tpv->fix.longitude);
+ *         }
+ *     }
+ *
+ * (g++ 12 miscompiles a co_await in a while condition, so don't.)
+ *
+ * and any number of sessions share one loop on one thread.  A loop is a
+ * gps_fleet_t, see libgps_fleet.c, and a session one of its members:
+ * the fleet connects, reads and splits lines, and reconnects a lost
+ * session after its jittered backoff, without blocking the loop, but for
+ * the name lookup as the session is made.  This is only the coroutines.
+ * A loop must outlive its sessions.
+ *
+ * A report is unpacked only if it is of the class awaited, others are
+ * skipped, and so is a report that comes while the session's coroutine
+ * awaits something else.  It is handed over as its snapshot record, see
+ * gps_snap(), not as a copy of a gps_data_t.  The record belongs to the
+ * loop and is good until the coroutine that got it next suspends.
+ * As the sessions of a loop unpack into one gps_data_t, the fleet's,
+ * they must not ask for SKY deltas, which build on the SKY before.
+ *
+ * The loop runs itself, run(), or inside another event loop: watch its
+ * fd() for input there, and call run_once(0) when there is some.
+ *
+ * Needs C++20 coroutines, and Linux epoll.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include <algorithm>
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gps.h"
+
+namespace gpsmm_async {
+
+// report classes to await, and the records they come as
+struct TPV {
+    static constexpr const char *name = "TPV";
+    typedef struct gps_snap_tpv_t record;
+};
+struct SKY {
+    static constexpr const char *name = "SKY";
+    typedef struct gps_snap_sky_t record;
+};
+struct GST {
+    static constexpr const char *name = "GST";
+    typedef struct gps_snap_gst_t record;
+};
+struct ATT {
+    static constexpr const char *name = "ATT";
+    typedef struct gps_snap_att_t record;
+};
+struct IMU {
+    static constexpr const char *name = "IMU";
+    typedef struct gps_snap_att_t record;
+};
+struct RAW {
+    static constexpr const char *name = "RAW";
+    typedef struct gps_snap_raw_t record;
+};
+struct AIS {
+    static constexpr const char *name = "AIS";
+    typedef struct gps_snap_ais_t record;
+};
+struct PPS {
+    static constexpr const char *name = "PPS";
+    typedef struct gps_snap_pps_t record;
+};
+
+/* A coroutine the loop drives.  It starts when called, and its frame
+ * goes when it returns. */
+struct task {
+    struct promise_type {
+        task get_return_object() { return task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+class session;
+
+class loop {
+  public:
+    loop() : fleet(gps_fleet_open(NULL, 1000, 60000, lines, this)),
+             waiting(0), snap(new double[SNAP_MAX / sizeof(double) + 1]) {
+        if (NULL != fleet) {
+            gps_fleet_notices(fleet, notice);
+        }
+    }
+    ~loop() { gps_fleet_close(fleet); }
+    loop(const loop &) = delete;
+    loop &operator=(const loop &) = delete;
+
+    // the fleet's epoll fd, to watch from another event loop
+    int fd() const { return NULL == fleet ? -1 : gps_fleet_fd(fleet); }
+
+    static long long now() {
+        struct timespec ts;
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    // resume h once after ms milliseconds
+    void after(int ms, std::coroutine_handle<> h) {
+        (void)timers.insert(std::make_pair(now() + ms * 1000000LL, h));
+    }
+
+    // wake what is ready, waiting up to timeout ms, -1 for ever
+    int run_once(int timeout) {
+        int woken = 0;
+
+        if (!timers.empty()) {
+            long long ms = (timers.begin()->first - now() + 999999) /
+                           1000000;
+
+            ms = std::max(0LL, ms);
+            if (0 > timeout ||
+                ms < timeout) {
+                timeout = (int)ms;
+            }
+        }
+        if (NULL != fleet) {
+            woken = std::max(0, gps_fleet_poll(fleet, timeout));
+        } else {
+            (void)poll(NULL, 0, timeout);
+        }
+        while (!timers.empty() &&
+               timers.begin()->first <= now()) {
+            std::coroutine_handle<> h = timers.begin()->second;
+
+            timers.erase(timers.begin());
+            h.resume();
+            woken++;
+        }
+        return woken;
+    }
+
+    // until nothing is awaited
+    void run() {
+        while (0 < waiting ||
+               !timers.empty()) {
+            (void)run_once(-1);
+        }
+    }
+
+    // bytes the loop takes, its fleet too
+    size_t footprint() const {
+        struct gps_fleet_stats_t stats;
+        size_t bytes = sizeof(*this) +
+                       sessions.capacity() * sizeof(session *);
+
+        if (NULL != fleet) {
+            gps_fleet_stats(fleet, &stats);
+            bytes += stats.bytes;
+        }
+        return bytes;
+    }
+
+    // co_await lp.sleep(ms)
+    struct sleeper {
+        loop &lp;
+        int ms;
+
+        bool await_ready() { return 0 >= ms; }
+        void await_suspend(std::coroutine_handle<> h) { lp.after(ms, h); }
+        void await_resume() {}
+    };
+    sleeper sleep(int ms) { return sleeper{*this, ms}; }
+
+  private:
+    friend class session;
+
+    static constexpr size_t SNAP_MAX =
+        std::max({sizeof(struct gps_snap_tpv_t),
+                  sizeof(struct gps_snap_sky_t),
+                  sizeof(struct gps_snap_ais_t),
+                  sizeof(struct gps_snap_raw_t),
+                  sizeof(struct gps_snap_pps_t)});
+
+    struct gps_fleet_t *fleet;
+    long waiting;               // coroutines on sessions, to know when to stop
+    std::multimap<long long, std::coroutine_handle<>> timers;
+    std::vector<session *> sessions;    // by member
+    // the record of what a session unpacked into the fleet
+    std::unique_ptr<double[]> snap;
+
+    session *find(int member) {
+        return (size_t)member < sessions.size() ? sessions[member] : nullptr;
+    }
+    static void lines(void *arg, struct gps_fleet_t *fleet, int member,
+                      char *line, size_t len);
+    static void notice(void *arg, struct gps_fleet_t *fleet, int member,
+                       bool up);
+};
+
+class session {
+  public:
+    session(loop &l, const char *host, const char *port = DEFAULT_GPSD_PORT)
+        : lp(l) {
+        init(NULL == lp.fleet ? -1 : gps_fleet_add(lp.fleet, host, port,
+                                                   NULL));
+    }
+    // an already connected socket, never reconnected
+    session(loop &l, int fd) : lp(l) {
+        init(NULL == lp.fleet ? -1 : gps_fleet_adopt(lp.fleet, fd, NULL));
+        if (0 > member) {
+            (void)::close(fd);
+        }
+    }
+    ~session() {
+        if (0 <= member) {
+            lp.sessions[member] = nullptr;
+            gps_fleet_remove(lp.fleet, member);
+        }
+        if (NONE != op) {
+            lp.waiting--;
+        }
+    }
+    session(const session &) = delete;
+    session &operator=(const session &) = delete;
+
+    // sent on every connect, now too if connected
+    void watch(const char *request) {
+        this->request = request;
+        if (up) {
+            (void)send(request);
+        }
+    }
+    // after a lost connection retry, min_ms doubling to max_ms apart,
+    // jittered; 0 to give up, the default.  Retries a given up one.
+    void reconnect(int min_ms, int max_ms) {
+        if (0 <= member &&
+            gps_fleet_retry(lp.fleet, member, min_ms,
+                            std::max(min_ms, max_ms))) {
+            this->min_ms = min_ms;
+            if (0 < min_ms) {
+                done = false;
+            }
+        }
+    }
+    bool send(const char *request) {
+        return 0 <= member &&
+               gps_fleet_send(lp.fleet, member, request);
+    }
+    bool is_open() const { return up; }
+    unsigned long reports() const { return nreports; }
+    unsigned long skipped() const { return nskipped; }
+    // bytes the session takes, not its part of the loop's fleet
+    size_t footprint() const { return sizeof(*this) + request.capacity(); }
+
+    // co_await s.connect(), true once connected
+    struct connector {
+        session &s;
+
+        bool await_ready() { return s.up || s.given_up(); }
+        void await_suspend(std::coroutine_handle<> h) {
+            s.suspend(h, CONNECT, NULL);
+        }
+        bool await_resume() { return s.up; }
+    };
+    connector connect() { return connector{*this}; }
+
+    /* co_await s.next<C>(), the next report of class C as a record, or
+     * NULL once the connection is lost for good. */
+    template <class C> struct nexter {
+        session &s;
+
+        bool await_ready() {
+            s.result = NULL;
+            return s.given_up();
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            s.suspend(h, NEXT, C::name);
+        }
+        const typename C::record *await_resume() {
+            return reinterpret_cast<const typename C::record *>(s.result);
+        }
+    };
+    template <class C> nexter<C> next() { return nexter<C>{*this}; }
+
+  private:
+    friend class loop;
+
+    enum op_t { NONE, CONNECT, NEXT };
+
+    loop &lp;
+    int member;                 // in the loop's fleet, -1 for none
+    std::string request;
+    int min_ms;
+    bool up, done;              // done: lost, and not to be retried
+    unsigned long nreports, nskipped;
+    // the coroutine suspended on this session
+    op_t op;
+    const char *want;
+    std::coroutine_handle<> waiter;
+    const struct gps_snap_t *result;
+
+    void init(int m) {
+        member = m;
+        min_ms = 0;
+        up = 0 <= member && gps_fleet_up(lp.fleet, member);
+        done = false;
+        nreports = nskipped = 0;
+        op = NONE;
+        want = NULL;
+        result = NULL;
+        if (0 <= member) {
+            if (lp.sessions.size() <= (size_t)member) {
+                lp.sessions.resize(member + 1, nullptr);
+            }
+            lp.sessions[member] = this;
+            (void)gps_fleet_retry(lp.fleet, member, 0, 0);
+        }
+    }
+
+    bool given_up() const { return 0 > member || done; }
+
+    void suspend(std::coroutine_handle<> h, op_t what, const char *cls) {
+        op = what;
+        want = cls;
+        waiter = h;
+        result = NULL;
+        lp.waiting++;
+    }
+
+    // hand the waiting coroutine its result, last thing a caller does
+    void finish(const struct gps_snap_t *r) {
+        std::coroutine_handle<> h = waiter;
+
+        op = NONE;
+        result = r;
+        waiter = nullptr;
+        lp.waiting--;
+        h.resume();
+    }
+
+    // a line the fleet read, unpacked only if it is of the class awaited
+    void line(char *line) {
+        const char *tag;
+        size_t n;
+
+        if (NEXT != op) {
+            nskipped++;
+            return;
+        }
+        n = strlen(want);
+        tag = strstr(line, "\"class\":\"");
+        if (NULL == tag ||
+            0 != strncmp(tag + 9, want, n) ||
+            '"' != tag[9 + n]) {
+            nskipped++;
+            return;
+        }
+        nreports++;
+        finish(gps_snap(gps_fleet_unpack(lp.fleet, line), line,
+                        lp.snap.get(), loop::SNAP_MAX));
+    }
+
+    void notice(bool is_up) {
+        up = is_up;
+        if (up) {
+            if (!request.empty()) {
+                (void)send(request.c_str());
+            }
+            if (CONNECT == op) {
+                finish(NULL);
+            }
+        } else if (0 == min_ms) {
+            // the fleet lets it be
+            done = true;
+            if (NONE != op) {
+                finish(NULL);
+            }
+        }
+    }
+};
+
+inline void loop::lines(void *arg, struct gps_fleet_t *, int member,
+                        char *line, size_t)
+{
+    session *s = static_cast<loop *>(arg)->find(member);
+
+    if (nullptr != s) {
+        s->line(line);
+    }
+}
+
+inline void loop::notice(void *arg, struct gps_fleet_t *, int member,
+                         bool up)
+{
+    session *s = static_cast<loop *>(arg)->find(member);
+
+    if (nullptr != s) {
+        s->notice(up);
+    }
+}
+
+}  // namespace gpsmm_async
+
+#endif  // _GPSD_GPSMM_ASYNC_H_
+// vim: set expandtab shiftwidth=4
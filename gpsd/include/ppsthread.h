@@ -3,6 +3,7 @@
  * SPDX-License-Identifier: BSD-2-clause
  *
  * Oct 2019: Added qErr* to ppsthread_t
+ * 3.23.2~dev: Added rtprio and cpus to ppsthread_t
  */
 
 #ifndef PPSTHREAD_H
@@ -10,6 +11,8 @@
 
 #include <time.h>
 
+struct rt_cpus_t;
+
 #ifndef TIMEDELTA_DEFINED
 #define TIMEDELTA_DEFINED
 struct timedelta_t {
@@ -29,6 +32,9 @@ struct timedelta_t {
  *
  * The report hook is called when each PPS event is recognized.  The log
  * hook is called to log error and status indications from the thread.
+ *
+ * Set rtprio, non-zero, to run the thread SCHED_FIFO at that priority,
+ * and cpus to keep it on them; leave them zero and NULL for neither.
  */
 struct pps_thread_t {
     void *context;              // PPS thread code leaves this alone
@@ -45,6 +51,8 @@ struct pps_thread_t {
     long qErr;                  /* offset in picoseconds (ps) */
     /* time of PPS pulse that qErr applies to */
     struct timespec qErr_time;
+    int rtprio;                 // SCHED_FIFO priority, 0 for default policy
+    const struct rt_cpus_t *cpus;       // CPUs to run on, NULL for any
 };
 
 #define THREAD_ERROR    0
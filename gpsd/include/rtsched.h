@@ -0,0 +1,49 @@
+/*
+ * rtsched.h - real-time scheduling, CPU pinning and memory locking
+ * for timing critical threads, and the edge latency distribution
+ * that shows what they buy.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#ifndef _GPSD_RTSCHED_H_
+#define _GPSD_RTSCHED_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define RT_CPUS_MAX     1024    // highest CPU number a list may name, + 1
+#define RT_STACK_FAULT  65536   // bytes of stack rt_prefault_stack() touches
+
+// a set of CPUs, as "0,2-3" names them
+struct rt_cpus_t {
+    unsigned char bits[RT_CPUS_MAX / 8];
+    int count;                  // CPUs in the set, 0 for none given
+};
+
+extern bool rt_cpus_parse(const char *, struct rt_cpus_t *);
+extern bool rt_cpus_isset(const struct rt_cpus_t *, int);
+extern bool rt_prio_valid(int);
+extern int rt_pin(const struct rt_cpus_t *);
+extern int rt_fifo(int);
+extern int rt_allow(int, bool);
+extern int rt_memlock(void);
+extern void rt_prefault_stack(void);
+
+// edge latencies, in nanoseconds, kept to report their distribution
+struct rt_latency_t {
+    long *ns;                   // the samples, caller's storage
+    size_t n;                   // samples kept
+    size_t max;                 // room in ns
+    unsigned long dropped;      // samples that found no room
+};
+
+extern void rt_latency_init(struct rt_latency_t *, long *, size_t);
+extern void rt_latency_add(struct rt_latency_t *, long);
+extern long rt_latency_percentile(struct rt_latency_t *, double);
+extern void rt_latency_report(struct rt_latency_t *, FILE *, const char *);
+
+#endif  // _GPSD_RTSCHED_H_
+// vim: set expandtab shiftwidth=4
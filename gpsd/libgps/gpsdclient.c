@@ -220,7 +220,8 @@ enum unit gpsd_units(void)
     return unspecified;
 }
 
-// standard parsing of a GPS data source spec
+/* standard parsing of a GPS data source spec,
+ * [server[:port[:device]]], or unix:path[:device] for a local socket */
 void gpsd_source_spec(const char *arg, struct fixsource_t *source)
 {
     // the casts attempt to head off a -Wwrite-strings warning
@@ -234,6 +235,19 @@ void gpsd_source_spec(const char *arg, struct fixsource_t *source)
         assert(source->spec != NULL);
 
         skipto = source->spec;
+        if (0 == strncmp(skipto, GPSD_LOCAL_PREFIX,
+                         sizeof(GPSD_LOCAL_PREFIX) - 1)) {
+            // the server is the prefixed path, there is no port
+            source->server = source->spec;
+            colon1 = strchr(skipto + sizeof(GPSD_LOCAL_PREFIX) - 1, ':');
+            if (NULL != colon1) {
+                *colon1 = '\0';
+                if ('\0' != colon1[1]) {
+                    source->device = colon1 + 1;
+                }
+            }
+            return;
+        }
         if (*skipto == '[' && (rbrk = strchr(skipto, ']')) != NULL) {
             skipto = rbrk;
         }
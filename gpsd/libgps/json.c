@@ -68,6 +68,7 @@ PERMISSIONS
 #include <math.h>       /* for HUGE_VAL */
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>     /* for uintptr_t */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -80,6 +81,15 @@ PERMISSIONS
 #include "../include/strfuncs.h"
 #include "../include/timespec.h"
 
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#define JSON_VEC_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__) && \
+      (defined(__GNUC__) || defined(__clang__))
+#include <arm_neon.h>
+#define JSON_VEC_NEON
+#endif
+
 static int debuglevel = 0;
 static FILE *debugfp;
 
@@ -106,7 +116,116 @@ static void json_trace(int errlevel, const char *fmt, ...)
     }
 }
 
-#define json_debug_trace(args) (void) json_trace args
+/* test the level here, so per-character traces cost no call */
+#define json_debug_trace(args) \
+    do { if (0 < debuglevel) (void) json_trace args; } while (0)
+
+/*
+ * Structural scanning.  Runs of ordinary characters inside attribute
+ * names, strings and tokens are found 16 bytes at a time with SSE2 or
+ * NEON, a byte at a time elsewhere, and copied whole.  The vector loads
+ * are 16-byte aligned, so they may read past the terminating NUL, but
+ * never off the page holding it.
+ */
+#if defined(JSON_VEC_SSE2)
+typedef __m128i json_vec_t;
+#define vec_load(p)     _mm_load_si128((const __m128i *)(p))
+#define vec_is(v, c)    _mm_cmpeq_epi8((v), _mm_set1_epi8(c))
+#define vec_or(a, b)    _mm_or_si128((a), (b))
+// 9 to 13, \t to \r; bytes over 127 are negative, so less than 14
+#define vec_ctrlspace(v) _mm_and_si128(_mm_cmpgt_epi8((v), _mm_set1_epi8(8)), \
+                                      _mm_cmplt_epi8((v), _mm_set1_epi8(14)))
+#define vec_mask(v)     ((unsigned)_mm_movemask_epi8(v))
+#elif defined(JSON_VEC_NEON)
+typedef uint8x16_t json_vec_t;
+#define vec_load(p)     vld1q_u8((const uint8_t *)(p))
+#define vec_is(v, c)    vceqq_u8((v), vdupq_n_u8((uint8_t)(c)))
+#define vec_or(a, b)    vorrq_u8((a), (b))
+#define vec_ctrlspace(v) vandq_u8(vcgtq_u8((v), vdupq_n_u8(8)), \
+                                  vcltq_u8((v), vdupq_n_u8(14)))
+
+// one bit a byte, as SSE2's movemask
+static inline unsigned vec_mask(uint8x16_t v)
+{
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                     1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t m = vandq_u8(v, vld1q_u8(bits));
+
+    return (unsigned)vaddv_u8(vget_low_u8(m)) |
+           ((unsigned)vaddv_u8(vget_high_u8(m)) << 8);
+}
+#endif
+
+#if defined(JSON_VEC_SSE2) || defined(JSON_VEC_NEON)
+// bit i set where p[i] stops a run of the given kinds
+NO_SANITIZE_ADDRESS
+static inline unsigned json_stop_mask(const char *p, unsigned kinds)
+{
+    json_vec_t v = vec_load(p);
+    json_vec_t m = vec_is(v, '\0');
+
+    if (0 != (kinds & (JSON_SCAN_ATTR | JSON_SCAN_STRING))) {
+        m = vec_or(m, vec_is(v, '"'));
+    }
+    if (0 != (kinds & JSON_SCAN_STRING)) {
+        m = vec_or(m, vec_is(v, '\\'));
+    }
+    if (0 != (kinds & JSON_SCAN_TOKEN)) {
+        m = vec_or(m, vec_or(vec_or(vec_is(v, ' '), vec_is(v, ',')),
+                             vec_or(vec_is(v, '}'), vec_ctrlspace(v))));
+    }
+    return vec_mask(m);
+}
+
+NO_SANITIZE_ADDRESS
+static inline size_t json_run(const char *cp, unsigned kinds)
+{
+    const char *p = (const char *)((uintptr_t)cp & ~(uintptr_t)15);
+    unsigned mask = json_stop_mask(p, kinds) >> (cp - p);
+
+    if (0 != mask) {
+        return (size_t)__builtin_ctz(mask);
+    }
+    for (;;) {
+        p += 16;
+        mask = json_stop_mask(p, kinds);
+        if (0 != mask) {
+            return (size_t)(p - cp) + (size_t)__builtin_ctz(mask);
+        }
+    }
+}
+#else
+static const unsigned char json_stops[256] = {
+    ['\0'] = JSON_SCAN_ATTR | JSON_SCAN_STRING | JSON_SCAN_TOKEN,
+    ['"'] = JSON_SCAN_ATTR | JSON_SCAN_STRING,
+    ['\\'] = JSON_SCAN_STRING,
+    ['\t'] = JSON_SCAN_TOKEN,
+    ['\n'] = JSON_SCAN_TOKEN,
+    ['\v'] = JSON_SCAN_TOKEN,
+    ['\f'] = JSON_SCAN_TOKEN,
+    ['\r'] = JSON_SCAN_TOKEN,
+    [' '] = JSON_SCAN_TOKEN,
+    [','] = JSON_SCAN_TOKEN,
+    ['}'] = JSON_SCAN_TOKEN,
+};
+
+static inline size_t json_run(const char *cp, unsigned kinds)
+{
+    const char *p = cp;
+
+    while (0 == (json_stops[(unsigned char)*p] & kinds)) {
+        p++;
+    }
+    return (size_t)(p - cp);
+}
+#endif
+
+/* length of the run at cp before a character that ends one of the
+ * given kinds, or the NUL */
+size_t json_scan(const char *cp, unsigned kinds)
+{
+    return json_run(cp, kinds);
+}
 
 static char *json_target_address(const struct json_attr_t *cursor,
                                              const struct json_array_t
@@ -314,10 +433,12 @@ static int json_internal_read_object(const char *cp,
                 for (cursor = attrs; cursor->attribute != NULL; cursor++) {
                     json_debug_trace((2, "Checking against %s\n",
                                       cursor->attribute));
-                    if (strcmp(cursor->attribute, attrbuf) == 0)
+                    // the first character rules out most before strcmp()
+                    if (cursor->attribute[0] == attrbuf[0] &&
+                        strcmp(cursor->attribute, attrbuf) == 0)
                         break;
                     if (cursor->type == t_ignore &&
-                        strncmp(cursor->attribute, "", 1) == 0) {
+                        cursor->attribute[0] == '\0') {
                         break;
                     }
                 }
@@ -339,12 +460,19 @@ static int json_internal_read_object(const char *cp,
                 else if (cursor->map != NULL)
                     maxlen = (int)sizeof(valbuf) - 1;
                 pval = valbuf;
-            } else if (pattr >= attrbuf + JSON_ATTR_MAX - 1) {
-                json_debug_trace((1, "Attribute name too long.\n"));
-                /* don't update end here, leave at attribute start */
-                return JSON_ERR_ATTRLEN;
-            } else
-                *pattr++ = *cp;
+            } else {
+                /* take the whole run up to the closing quote */
+                size_t run = json_run(cp, JSON_SCAN_ATTR);
+
+                if ((size_t)(pattr - attrbuf) + run > JSON_ATTR_MAX - 1) {
+                    json_debug_trace((1, "Attribute name too long.\n"));
+                    /* don't update end here, leave at attribute start */
+                    return JSON_ERR_ATTRLEN;
+                }
+                memcpy(pattr, cp, run);
+                pattr += run;
+                cp += run - 1;
+            }
             break;
         case await_value:
             if (isspace((unsigned char) *cp) || *cp == ':')
@@ -388,13 +516,20 @@ static int json_internal_read_object(const char *cp,
                 *pval++ = '\0';
                 json_debug_trace((1, "Collected string value %s\n", valbuf));
                 state = post_val;
-            } else if (pval > valbuf + JSON_VAL_MAX - 1
-                       || pval > valbuf + maxlen - 1) {
-                json_debug_trace((1, "String value too long.\n"));
-                /* don't update end here, leave at value start */
-                return JSON_ERR_STRLONG;        /*  */
-            } else
-                *pval++ = *cp;
+            } else {
+                /* take the whole run up to a quote or backslash */
+                size_t run = json_run(cp, JSON_SCAN_STRING);
+                int room = maxlen < JSON_VAL_MAX ? maxlen : JSON_VAL_MAX;
+
+                if ((long)(pval - valbuf) + (long)run > (long)room) {
+                    json_debug_trace((1, "String value too long.\n"));
+                    /* don't update end here, leave at value start */
+                    return JSON_ERR_STRLONG;        /*  */
+                }
+                memcpy(pval, cp, run);
+                pval += run;
+                cp += run - 1;
+            }
             break;
         case in_escape:
             if (pval == NULL)
@@ -456,12 +591,19 @@ static int json_internal_read_object(const char *cp,
                 state = post_val;
                 if (*cp == '}' || *cp == ',')
                     --cp;
-            } else if (pval > valbuf + JSON_VAL_MAX - 1) {
-                json_debug_trace((1, "Token value too long.\n"));
-                /* don't update end here, leave at value start */
-                return JSON_ERR_TOKLONG;
-            } else
-                *pval++ = *cp;
+            } else {
+                /* take the whole run up to white space, comma or } */
+                size_t run = json_run(cp, JSON_SCAN_TOKEN);
+
+                if ((size_t)(pval - valbuf) + run > JSON_VAL_MAX) {
+                    json_debug_trace((1, "Token value too long.\n"));
+                    /* don't update end here, leave at value start */
+                    return JSON_ERR_TOKLONG;
+                }
+                memcpy(pval, cp, run);
+                pval += run;
+                cp += run - 1;
+            }
             break;
             /* coverity[unterminated_case] */
         case post_val:
@@ -485,8 +627,8 @@ static int json_internal_read_object(const char *cp,
                 if (value_quoted && (cursor->type == t_string
                     || cursor->type == t_time))
                     break;
-                if ((strcmp(valbuf, "true")==0 || strcmp(valbuf, "false")==0)
-                        && seeking == t_boolean)
+                if (seeking == t_boolean &&
+                    (strcmp(valbuf, "true")==0 || strcmp(valbuf, "false")==0))
                     break;
                 if (isdigit((unsigned char) valbuf[0])) {
                     bool decimal = strchr(valbuf, '.') != NULL;
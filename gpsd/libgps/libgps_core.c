@@ -113,6 +113,42 @@ int gps_open(const char *host,
     return status;
 }
 
+/* open the shared-memory export of just one device, or with device NULL
+ * the one of them all that gps_open(GPSD_SHARED_MEMORY, ...) opens */
+int gps_open_shm(const char *device CONDITIONALLY_UNUSED,
+                 struct gps_data_t *gpsdata)
+{
+    int status = SHM_NOSHARED;
+
+    if (!gpsdata) {
+        return -1;
+    }
+
+#ifdef SHM_EXPORT_ENABLE
+    if (NULL == device) {
+        status = gps_shm_open(gpsdata);
+    } else {
+        status = gps_shm_open_device(gpsdata, device);
+    }
+    if (status == -1) {
+        status = SHM_NOSHARED;
+    } else if (status == -2) {
+        status = SHM_NOATTACH;
+    } else if (status == -3) {
+        status = SHM_NODEVICE;
+    }
+#endif  // SHM_EXPORT_ENABLE
+
+    gpsdata->set = 0;
+    gpsdata->satellites_used = 0;
+    gps_clear_att(&(gpsdata->attitude));
+    gps_clear_dop(&(gpsdata->dop));
+    gps_clear_fix(&(gpsdata->fix));
+    gps_clear_log(&(gpsdata->log));
+
+    return status;
+}
+
 // close a gpsd connection
 int gps_close(struct gps_data_t *gpsdata CONDITIONALLY_UNUSED)
 {
@@ -310,6 +346,9 @@ extern const char *gps_errstr(const int err)
     if (SHM_NOATTACH == err) {
         return "attach failed for unknown reason";
     }
+    if (SHM_NODEVICE == err) {
+        return "device has no shared-memory segment";
+    }
 #endif  // SHM_EXPORT_ENABLE
 #ifdef DBUS_EXPORT_ENABLE
     if (DBUS_FAILURE == err) {
@@ -0,0 +1,828 @@
+/****************************************************************************
+
+NAME
+   libgps_fleet.c - many gpsd connections, watched from one thread
+
+DESCRIPTION
+   gps_open() and gps_read() take a gps_data_t, and a line buffer, a
+connection, so a client watching a fleet of vehicles, each with its own
+gpsd, needs some 40 kB a vehicle, and usually a process or a thread
+too.  A fleet holds its members on one epoll instance instead.  A member
+is a socket, an address, and whatever part of a line its last read left
+over, usually nothing: reads go into one buffer the fleet shares, and
+the complete lines in it are handed to the caller's hook there.  The
+hook may unpack a line into the fleet's one gps_data_t, or pass it on
+as it is.
+
+   Connections are made without blocking.  A member that is lost, or
+cannot connect, is retried after its delay, which starts at the
+fleet's least and doubles each failure up to its most.  The delay is
+jittered to between half and all of that, so that a fleet of vehicles
+dropped at once, by a network or a server going away, does not come
+back at once.
+
+   A member may instead be a socket the caller connected, which is not
+retried, and a member's own delays, or none, may replace the fleet's.
+An optional second hook is told as members connect and are lost.
+
+   Needs epoll(7).  Elsewhere gps_fleet_open() fails with ENOSYS.
+
+PERMISSIONS
+   This file is Copyright 2010 by the GPSD project
+   SPDX-License-Identifier: BSD-2-clause
+
+***************************************************************************/
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>             // for uintptr_t
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+    #include <netdb.h>
+    #include <sys/epoll.h>
+    #include <sys/socket.h>
+#endif  // HAVE_SYS_EPOLL_H
+
+#include "../include/gps.h"
+#include "../include/compiler.h"     // for UNUSED
+#include "../include/gps_json.h"     // for GPS_JSON_RESPONSE_MAX
+#include "../include/timespec.h"     // for NS_IN_MS
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#define FLEET_READ      65536           // bytes in the shared read buffer
+#define FLEET_EVENTS    256             // events taken a wait
+
+enum member_state {
+    MEMBER_DOWN,
+    MEMBER_CONNECTING,
+    MEMBER_UP,
+    MEMBER_DONE,                // lost, and not to be retried
+    MEMBER_FREE,                // removed, its slot to be reused
+};
+
+struct fleet_member_t {
+    int fd;
+    enum member_state state;
+    unsigned serial;            // bumped as the slot is freed
+    int min_ms, max_ms;         // retry delays, min_ms 0 for none
+    int delay;                  // ms, before jitter, of the next retry
+    long long due;              // when a down member is retried, ns
+    char *tag;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    char *partial;              // a line not yet ended
+    size_t len, size;
+    bool skipping;              // dropping a line too long, to its end
+};
+
+struct gps_fleet_t {
+    int epfd;
+    char *watch;                // sent on every connect
+    int min_ms, max_ms;
+    gps_fleet_hook_t hook;
+    gps_fleet_notice_t notice;
+    void *arg;
+    struct fleet_member_t *members;
+    int nmembers, capacity;
+    int nfree;                  // members removed, slots to reuse
+    long long next_due;         // the soonest retry, 0 for none
+    unsigned long long rand;
+    struct gps_fleet_stats_t stats;
+    char buf[FLEET_READ + 1];
+    struct gps_data_t data;
+};
+
+static long long fleet_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * NS_IN_SEC + ts.tv_nsec;
+}
+
+// xorshift64*, good enough to spread retries
+static unsigned long long fleet_rand(struct gps_fleet_t *fleet)
+{
+    fleet->rand ^= fleet->rand >> 12;
+    fleet->rand ^= fleet->rand << 25;
+    fleet->rand ^= fleet->rand >> 27;
+    return fleet->rand * 0x2545F4914F6CDD1DULL;
+}
+
+// what epoll hands back for member i, so a reused slot is told apart
+static uint64_t member_key(const struct fleet_member_t *m, int i)
+{
+    return (uint64_t)m->serial << 32 | (uint32_t)i;
+}
+
+// retry member i at due, ns
+static void member_due(struct gps_fleet_t *fleet, int i, long long due)
+{
+    fleet->members[i].due = due;
+    if (0 == fleet->next_due ||
+        due < fleet->next_due) {
+        fleet->next_due = due;
+    }
+}
+
+// last thing a caller does, as the hook may add or remove members
+static void member_notice(struct gps_fleet_t *fleet, int i, bool up)
+{
+    if (NULL != fleet->notice) {
+        fleet->notice(fleet->arg, fleet, i, up);
+    }
+}
+
+// lost, or never made: retry after the jittered delay, if at all
+static void member_drop(struct gps_fleet_t *fleet, int i)
+{
+    struct fleet_member_t *m = &fleet->members[i];
+    long long wait;
+
+    if (0 <= m->fd) {
+        // closing removes it from the epoll set
+        (void)close(m->fd);
+        m->fd = -1;
+    }
+    if (MEMBER_UP == m->state) {
+        fleet->stats.up--;
+    }
+    m->len = 0;
+    m->skipping = false;
+    fleet->stats.drops++;
+
+    if (0 == m->min_ms) {
+        m->state = MEMBER_DONE;
+    } else {
+        m->state = MEMBER_DOWN;
+        wait = m->delay / 2 + (long long)(fleet_rand(fleet) %
+                                          (unsigned)(m->delay / 2 + 1));
+        member_due(fleet, i, fleet_now() + wait * NS_IN_MS);
+        m->delay = m->delay < m->max_ms / 2 ? 2 * m->delay : m->max_ms;
+    }
+    member_notice(fleet, i, false);
+}
+
+static void member_up(struct gps_fleet_t *fleet, int i)
+{
+    struct fleet_member_t *m = &fleet->members[i];
+    struct epoll_event ev;
+    size_t len = strlen(fleet->watch);
+
+    if (0 < len &&
+        (ssize_t)len != write(m->fd, fleet->watch, len)) {
+        member_drop(fleet, i);
+        return;
+    }
+    (void)memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = member_key(m, i);
+    if (0 != epoll_ctl(fleet->epfd, EPOLL_CTL_MOD, m->fd, &ev)) {
+        member_drop(fleet, i);
+        return;
+    }
+    m->state = MEMBER_UP;
+    m->delay = m->min_ms;
+    fleet->stats.up++;
+    fleet->stats.connects++;
+    member_notice(fleet, i, true);
+}
+
+static void member_connect(struct gps_fleet_t *fleet, int i)
+{
+    struct fleet_member_t *m = &fleet->members[i];
+    struct epoll_event ev;
+
+    m->fd = socket(m->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK |
+                   SOCK_CLOEXEC, 0);
+    if (0 > m->fd) {
+        member_drop(fleet, i);
+        return;
+    }
+    (void)memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.u64 = member_key(m, i);
+    if (0 != epoll_ctl(fleet->epfd, EPOLL_CTL_ADD, m->fd, &ev)) {
+        member_drop(fleet, i);
+        return;
+    }
+    if (0 == connect(m->fd, (struct sockaddr *)&m->addr, m->addrlen)) {
+        member_up(fleet, i);
+    } else if (EINPROGRESS == errno) {
+        m->state = MEMBER_CONNECTING;
+    } else {
+        member_drop(fleet, i);
+    }
+}
+
+/* Hand on the ended lines of member i in buf, keep what is left.  A
+ * line too long to keep is dropped whole, up to its end in later reads,
+ * not handed on as the tail of it. */
+static void member_lines(struct gps_fleet_t *fleet, int i, char *buf,
+                         size_t len)
+{
+    struct fleet_member_t *m = &fleet->members[i];
+    unsigned serial = m->serial;
+    char *line = buf, *end = buf + len;
+
+    if (m->skipping) {
+        char *nl = memchr(line, '\n', len);
+
+        if (NULL == nl) {
+            return;             // m->len is still 0
+        }
+        m->skipping = false;
+        line = nl + 1;
+    }
+    for (;;) {
+        char *nl = memchr(line, '\n', (size_t)(end - line));
+        size_t linelen;
+
+        if (NULL == nl) {
+            break;
+        }
+        linelen = (size_t)(nl - line);
+        if (0 < linelen &&
+            '\r' == line[linelen - 1]) {
+            linelen--;
+        }
+        line[linelen] = '\0';
+        fleet->stats.lines++;
+        fleet->hook(fleet->arg, fleet, i, line, linelen);
+        if (serial != fleet->members[i].serial) {
+            return;             // the hook removed it
+        }
+        line = nl + 1;
+    }
+
+    // the hook may have added members, and moved them
+    m = &fleet->members[i];
+    len = (size_t)(end - line);
+    if (GPS_JSON_RESPONSE_MAX < len) {
+        // no report is that long
+        fleet->stats.overflows++;
+        m->skipping = true;
+        len = 0;
+    }
+    if (m->size < len) {
+        size_t size = (len + 255) & ~(size_t)255;
+        char *partial = realloc(m->partial, size);
+
+        if (NULL == partial) {
+            m->skipping = true;
+            len = 0;
+        } else {
+            m->partial = partial;
+            m->size = size;
+        }
+    }
+    if (0 < len) {
+        (void)memcpy(m->partial, line, len);
+    }
+    m->len = len;
+}
+
+static void member_read(struct gps_fleet_t *fleet, int i)
+{
+    struct fleet_member_t *m = &fleet->members[i];
+    ssize_t got;
+
+    // a line the last read left goes ahead of this one
+    if (0 < m->len) {
+        (void)memcpy(fleet->buf, m->partial, m->len);
+    }
+    got = read(m->fd, fleet->buf + m->len, FLEET_READ - m->len);
+    if (0 >= got) {
+        if (0 == got ||
+            (EAGAIN != errno &&
+             EINTR != errno)) {
+            member_drop(fleet, i);
+        }
+        return;
+    }
+    member_lines(fleet, i, fleet->buf, m->len + (size_t)got);
+}
+
+/* Open an empty fleet.  watch is sent on every connect, a lost member
+ * retried after min_ms, doubling to max_ms.  hook gets every line.
+ *
+ * Return: the fleet, or NULL with errno set
+ */
+struct gps_fleet_t *gps_fleet_open(const char *watch, int min_ms,
+                                   int max_ms, gps_fleet_hook_t hook,
+                                   void *arg)
+{
+    struct gps_fleet_t *fleet;
+
+    if (NULL == hook ||
+        0 >= min_ms ||
+        min_ms > max_ms) {
+        errno = EINVAL;
+        return NULL;
+    }
+    fleet = calloc(1, sizeof(*fleet));
+    if (NULL == fleet) {
+        return NULL;
+    }
+    fleet->epfd = epoll_create1(EPOLL_CLOEXEC);
+    fleet->watch = strdup(NULL == watch ? "" : watch);
+    if (0 > fleet->epfd ||
+        NULL == fleet->watch) {
+        gps_fleet_close(fleet);
+        return NULL;
+    }
+    fleet->min_ms = min_ms;
+    fleet->max_ms = max_ms;
+    fleet->hook = hook;
+    fleet->arg = arg;
+    fleet->rand = (unsigned long long)fleet_now() ^
+                  ((unsigned long long)getpid() << 32) ^
+                  (unsigned long long)(uintptr_t)fleet;
+    if (0 == fleet->rand) {
+        fleet->rand = 1;
+    }
+    return fleet;
+}
+
+/* A slot for a new member, a removed one's if there is one, cleared
+ * but for its serial, and not yet counted.
+ *
+ * Return: the slot, or -1 with errno set
+ */
+static int member_slot(struct gps_fleet_t *fleet)
+{
+    struct fleet_member_t *m;
+    unsigned serial = 0;
+    int i = fleet->nmembers;
+
+    if (0 < fleet->nfree) {
+        for (i = 0; MEMBER_FREE != fleet->members[i].state; i++) {
+            continue;           // there is one
+        }
+    }
+    if (i == fleet->nmembers &&
+        fleet->nmembers == fleet->capacity) {
+        int capacity = 0 == fleet->capacity ? 16 : 2 * fleet->capacity;
+        struct fleet_member_t *members;
+
+        members = realloc(fleet->members, capacity * sizeof(*members));
+        if (NULL == members) {
+            return -1;
+        }
+        fleet->members = members;
+        fleet->capacity = capacity;
+    }
+    m = &fleet->members[i];
+    if (i < fleet->nmembers) {
+        serial = m->serial;
+    }
+    (void)memset(m, 0, sizeof(*m));
+    m->serial = serial;
+    m->fd = -1;
+    m->state = MEMBER_FREE;
+    return i;
+}
+
+// count the member in slot i, state set
+static void member_take(struct gps_fleet_t *fleet, int i)
+{
+    if (i == fleet->nmembers) {
+        fleet->nmembers++;
+    } else {
+        fleet->nfree--;
+    }
+    fleet->stats.members++;
+}
+
+/* Add the gpsd at host and port, tagged tag, or "host:port" if NULL,
+ * to be connected on the next gps_fleet_poll(), and retried with the
+ * fleet's delays.
+ *
+ * Return: the member, numbered from 0, or -1 with errno set
+ */
+int gps_fleet_add(struct gps_fleet_t *fleet, const char *host,
+                  const char *port, const char *tag)
+{
+    struct addrinfo hints, *res;
+    struct fleet_member_t *m;
+    int i, status;
+
+    if (NULL == port) {
+        port = DEFAULT_GPSD_PORT;
+    }
+    i = member_slot(fleet);
+    if (0 > i) {
+        return -1;
+    }
+
+    // resolved once, not on every retry
+    (void)memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    status = getaddrinfo(host, port, &hints, &res);
+    if (0 != status) {
+        errno = EAI_SYSTEM == status ? errno : EHOSTUNREACH;
+        return -1;
+    }
+    m = &fleet->members[i];
+    (void)memcpy(&m->addr, res->ai_addr, res->ai_addrlen);
+    m->addrlen = res->ai_addrlen;
+    freeaddrinfo(res);
+    if (NULL != tag) {
+        m->tag = strdup(tag);
+    } else {
+        size_t len = strlen(host) + strlen(port) + 2;
+
+        m->tag = malloc(len);
+        if (NULL != m->tag) {
+            (void)snprintf(m->tag, len, "%s:%s", host, port);
+        }
+    }
+    if (NULL == m->tag) {
+        return -1;
+    }
+    m->state = MEMBER_DOWN;
+    m->min_ms = fleet->min_ms;
+    m->max_ms = fleet->max_ms;
+    m->delay = fleet->min_ms;
+    member_take(fleet, i);
+
+    // not now, so the hooks never run before the caller has the number
+    member_due(fleet, i, fleet_now());
+    return i;
+}
+
+/* Add fd, a stream socket already connected to a gpsd, tagged tag, or
+ * "fd:N" if NULL.  It is sent nothing, and not retried once lost.
+ *
+ * Return: the member, numbered from 0, or -1 with errno set
+ */
+int gps_fleet_adopt(struct gps_fleet_t *fleet, int fd, const char *tag)
+{
+    struct fleet_member_t *m;
+    struct epoll_event ev;
+    char name[24];
+    int i = member_slot(fleet);
+
+    if (0 > i) {
+        return -1;
+    }
+    m = &fleet->members[i];
+    if (NULL == tag) {
+        (void)snprintf(name, sizeof(name), "fd:%d", fd);
+        tag = name;
+    }
+    m->tag = strdup(tag);
+    if (NULL == m->tag) {
+        return -1;
+    }
+    (void)fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    (void)memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = member_key(m, i);
+    if (0 != epoll_ctl(fleet->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+        free(m->tag);
+        m->tag = NULL;
+        return -1;
+    }
+    m->fd = fd;
+    m->state = MEMBER_UP;
+    member_take(fleet, i);
+    fleet->stats.up++;
+    return i;
+}
+
+/* Retry member, once lost, after min_ms doubling to max_ms, or not at
+ * all if min_ms is 0.  A member that was lost and not retried is
+ * connected again if min_ms is above 0.
+ *
+ * Return: false, with errno EINVAL, for a bad member or delays, or a
+ *         member adopted that is to be retried
+ */
+bool gps_fleet_retry(struct gps_fleet_t *fleet, int member, int min_ms,
+                     int max_ms)
+{
+    struct fleet_member_t *m;
+
+    if (0 > member ||
+        fleet->nmembers <= member ||
+        MEMBER_FREE == fleet->members[member].state ||
+        0 > min_ms) {
+        errno = EINVAL;
+        return false;
+    }
+    m = &fleet->members[member];
+    if (0 < min_ms &&
+        (min_ms > max_ms ||
+         0 == m->addrlen)) {
+        errno = EINVAL;
+        return false;
+    }
+    m->min_ms = min_ms;
+    m->max_ms = max_ms;
+    m->delay = min_ms;
+    if (MEMBER_DONE == m->state &&
+        0 < min_ms) {
+        m->state = MEMBER_DOWN;
+        member_due(fleet, member, fleet_now());
+    }
+    return true;
+}
+
+/* Tell notice, with the fleet's arg, as each member connects, and as
+ * it is lost or refused.  NULL for nothing, the default. */
+void gps_fleet_notices(struct gps_fleet_t *fleet, gps_fleet_notice_t notice)
+{
+    fleet->notice = notice;
+}
+
+/* Send request to member, if connected.  A failure is not a loss, the
+ * next read finds that.
+ *
+ * Return: true if it was all written
+ */
+bool gps_fleet_send(struct gps_fleet_t *fleet, int member,
+                    const char *request)
+{
+    size_t len = strlen(request);
+
+    return gps_fleet_up(fleet, member) &&
+           (ssize_t)len == write(fleet->members[member].fd, request, len);
+}
+
+/* Close member, and forget it.  Its number may be reused.  Safe in the
+ * hooks, for that member too. */
+void gps_fleet_remove(struct gps_fleet_t *fleet, int member)
+{
+    struct fleet_member_t *m;
+
+    if (0 > member ||
+        fleet->nmembers <= member ||
+        MEMBER_FREE == fleet->members[member].state) {
+        return;
+    }
+    m = &fleet->members[member];
+    if (0 <= m->fd) {
+        (void)close(m->fd);
+        m->fd = -1;
+    }
+    if (MEMBER_UP == m->state) {
+        fleet->stats.up--;
+    }
+    free(m->tag);
+    free(m->partial);
+    m->tag = NULL;
+    m->partial = NULL;
+    m->len = m->size = 0;
+    m->state = MEMBER_FREE;
+    m->serial++;
+    fleet->nfree++;
+    fleet->stats.members--;
+}
+
+// the epoll fd, to watch from another event loop
+int gps_fleet_fd(const struct gps_fleet_t *fleet)
+{
+    return fleet->epfd;
+}
+
+/* Wait up to timeout ms, -1 for ever, for the members, handing their
+ * lines to the hook, and retry those due.
+ *
+ * Return: the members that had something to do, or -1 with errno set
+ */
+int gps_fleet_poll(struct gps_fleet_t *fleet, int timeout)
+{
+    struct epoll_event ev[FLEET_EVENTS];
+    long long now;
+    int i, n;
+
+    if (0 != fleet->next_due) {
+        long long ms = (fleet->next_due - fleet_now() + NS_IN_MS - 1) /
+                       NS_IN_MS;
+
+        if (0 > ms) {
+            ms = 0;
+        }
+        if (0 > timeout ||
+            ms < timeout) {
+            timeout = (int)ms;
+        }
+    }
+    n = epoll_wait(fleet->epfd, ev, FLEET_EVENTS, timeout);
+    if (0 > n) {
+        return EINTR == errno ? 0 : -1;
+    }
+    for (i = 0; i < n; i++) {
+        int member = (int)(ev[i].data.u64 & 0xffffffffU);
+        struct fleet_member_t *m = &fleet->members[member];
+
+        if (member_key(m, member) != ev[i].data.u64) {
+            continue;           // removed since the wait, by a hook
+        }
+        if (MEMBER_CONNECTING == m->state) {
+            int err = 0;
+            socklen_t errlen = sizeof(err);
+
+            if (0 != (ev[i].events & (EPOLLERR | EPOLLHUP)) ||
+                0 != getsockopt(m->fd, SOL_SOCKET, SO_ERROR, &err,
+                                &errlen) ||
+                0 != err) {
+                member_drop(fleet, member);
+            } else {
+                member_up(fleet, member);
+            }
+        } else if (MEMBER_UP == m->state) {
+            member_read(fleet, member);
+        }
+    }
+
+    now = fleet_now();
+    if (0 != fleet->next_due &&
+        fleet->next_due <= now) {
+        // rare enough, a fleet losing members, to just look at them all
+        fleet->next_due = 0;
+        for (i = 0; i < fleet->nmembers; i++) {
+            struct fleet_member_t *m = &fleet->members[i];
+
+            if (MEMBER_DOWN != m->state) {
+                continue;
+            }
+            if (m->due <= now) {
+                n++;
+                member_connect(fleet, i);
+            } else if (0 == fleet->next_due ||
+                       m->due < fleet->next_due) {
+                fleet->next_due = m->due;
+            }
+        }
+    }
+    return n;
+}
+
+const char *gps_fleet_tag(const struct gps_fleet_t *fleet, int member)
+{
+    if (0 > member ||
+        fleet->nmembers <= member) {
+        return NULL;
+    }
+    return fleet->members[member].tag;
+}
+
+bool gps_fleet_up(const struct gps_fleet_t *fleet, int member)
+{
+    return 0 <= member &&
+           fleet->nmembers > member &&
+           MEMBER_UP == fleet->members[member].state;
+}
+
+/* Unpack a JSON line the hook got into the fleet's gps_data_t.  That
+ * is shared by every member, so a SKY delta of one builds on the SKY of
+ * another: members should not ask for them.
+ *
+ * Return: the gps_data_t
+ */
+struct gps_data_t *gps_fleet_unpack(struct gps_fleet_t *fleet, char *line)
+{
+    // not every report names its device
+    fleet->data.dev.path[0] = '\0';
+    fleet->data.set = 0;
+    (void)gps_unpack(line, &fleet->data);
+    return &fleet->data;
+}
+
+void gps_fleet_stats(const struct gps_fleet_t *fleet,
+                     struct gps_fleet_stats_t *stats)
+{
+    int i;
+
+    *stats = fleet->stats;
+    stats->bytes = sizeof(*fleet) +
+                   fleet->capacity * sizeof(struct fleet_member_t);
+    for (i = 0; i < fleet->nmembers; i++) {
+        if (MEMBER_FREE != fleet->members[i].state) {
+            stats->bytes += fleet->members[i].size +
+                            strlen(fleet->members[i].tag) + 1;
+        }
+    }
+}
+
+void gps_fleet_close(struct gps_fleet_t *fleet)
+{
+    int i;
+
+    if (NULL == fleet) {
+        return;
+    }
+    for (i = 0; i < fleet->nmembers; i++) {
+        if (0 <= fleet->members[i].fd) {
+            (void)close(fleet->members[i].fd);
+        }
+        free(fleet->members[i].tag);
+        free(fleet->members[i].partial);
+    }
+    if (0 <= fleet->epfd) {
+        (void)close(fleet->epfd);
+    }
+    free(fleet->members);
+    free(fleet->watch);
+    free(fleet);
+}
+
+#else   // HAVE_SYS_EPOLL_H
+
+struct gps_fleet_t *gps_fleet_open(const char *watch UNUSED,
+                                   int min_ms UNUSED, int max_ms UNUSED,
+                                   gps_fleet_hook_t hook UNUSED,
+                                   void *arg UNUSED)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+
+// no fleet can be opened, so none of these is ever called
+
+int gps_fleet_add(struct gps_fleet_t *fleet UNUSED, const char *host UNUSED,
+                  const char *port UNUSED, const char *tag UNUSED)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+int gps_fleet_adopt(struct gps_fleet_t *fleet UNUSED, int fd UNUSED,
+                    const char *tag UNUSED)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+bool gps_fleet_retry(struct gps_fleet_t *fleet UNUSED, int member UNUSED,
+                     int min_ms UNUSED, int max_ms UNUSED)
+{
+    errno = ENOSYS;
+    return false;
+}
+
+void gps_fleet_notices(struct gps_fleet_t *fleet UNUSED,
+                       gps_fleet_notice_t notice UNUSED)
+{
+}
+
+bool gps_fleet_send(struct gps_fleet_t *fleet UNUSED, int member UNUSED,
+                    const char *request UNUSED)
+{
+    return false;
+}
+
+void gps_fleet_remove(struct gps_fleet_t *fleet UNUSED, int member UNUSED)
+{
+}
+
+int gps_fleet_fd(const struct gps_fleet_t *fleet UNUSED)
+{
+    return -1;
+}
+
+int gps_fleet_poll(struct gps_fleet_t *fleet UNUSED, int timeout UNUSED)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+const char *gps_fleet_tag(const struct gps_fleet_t *fleet UNUSED,
+                          int member UNUSED)
+{
+    return NULL;
+}
+
+bool gps_fleet_up(const struct gps_fleet_t *fleet UNUSED, int member UNUSED)
+{
+    return false;
+}
+
+struct gps_data_t *gps_fleet_unpack(struct gps_fleet_t *fleet UNUSED,
+                                    char *line UNUSED)
+{
+    return NULL;
+}
+
+void gps_fleet_stats(const struct gps_fleet_t *fleet UNUSED,
+                     struct gps_fleet_stats_t *stats)
+{
+    (void)memset(stats, 0, sizeof(*stats));
+}
+
+void gps_fleet_close(struct gps_fleet_t *fleet UNUSED)
+{
+}
+
+#endif  // HAVE_SYS_EPOLL_H
+// vim: set expandtab shiftwidth=4
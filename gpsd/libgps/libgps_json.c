@@ -257,9 +257,84 @@ static int json_raw_read(const char *buf, struct gps_data_t *gpsdata,
     return 0;
 }
 
+// a satellite that a SKY delta says is gone
+struct sky_key_t {
+    short PRN;
+    unsigned char gnssid;
+    unsigned char svid;
+    unsigned char sigid;
+};
+
+/* Is sp the satellite with key k, as SKY deltas key them?  By gnssid,
+ * svid and sigid, or by PRN if there is no svid. */
+static bool sky_same(const struct satellite_t *sp,
+                     const struct sky_key_t *k)
+{
+    if (0 == k->svid) {
+        return 0 == sp->svid && k->PRN == sp->PRN;
+    }
+    return k->svid == sp->svid &&
+           k->gnssid == sp->gnssid &&
+           k->sigid == sp->sigid;
+}
+
+/* merge the satellites of a SKY delta into the skyview.  Flaky drivers
+ * list some satellites twice, so every entry of a key is merged. */
+static void sky_merge(struct gps_data_t *gpsdata,
+                      const struct satellite_t *sats, int nsats,
+                      const struct sky_key_t *removed, int nremoved)
+{
+    int visible = 0;
+    int i, j;
+
+    for (i = 0; i < MAXCHANNELS; i++) {
+        if (0 < gpsdata->skyview[i].PRN) {
+            gpsdata->skyview[visible++] = gpsdata->skyview[i];
+        }
+    }
+    for (i = 0; i < nremoved; i++) {
+        for (j = 0; j < visible; ) {
+            if (sky_same(&gpsdata->skyview[j], &removed[i])) {
+                visible--;
+                memmove(&gpsdata->skyview[j], &gpsdata->skyview[j + 1],
+                        (size_t)(visible - j) * sizeof(gpsdata->skyview[0]));
+            } else {
+                j++;
+            }
+        }
+    }
+    for (i = 0; i < nsats; i++) {
+        struct sky_key_t key = {sats[i].PRN, sats[i].gnssid, sats[i].svid,
+                                sats[i].sigid};
+        bool found = false;
+
+        for (j = 0; j < visible; j++) {
+            if (sky_same(&gpsdata->skyview[j], &key)) {
+                gpsdata->skyview[j] = sats[i];
+                found = true;
+            }
+        }
+        if (!found &&
+            MAXCHANNELS > visible) {
+            gpsdata->skyview[visible++] = sats[i];
+        }
+    }
+    if (MAXCHANNELS > visible) {
+        memset(&gpsdata->skyview[visible], 0,
+               (size_t)(MAXCHANNELS - visible) *
+               sizeof(gpsdata->skyview[0]));
+    }
+}
+
 static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
                          const char **endptr)
 {
+    /* the satellites, and of a delta, the keys of those gone.  Merged
+     * into the skyview, or replacing it, once the whole SKY is read */
+    struct satellite_t sats[MAXCHANNELS];
+    struct sky_key_t removed[MAXCHANNELS];
+    int nsats = 0, nremoved = 0;
+    bool delta = false;
 
     const struct json_attr_t json_attrs_satellites[] = {
         // *INDENT-OFF*
@@ -284,6 +359,17 @@ static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
         {NULL},
     };
 
+    const struct json_attr_t json_attrs_removed[] = {
+        // *INDENT-OFF*
+        {"PRN",    t_short,   STRUCTOBJECT(struct sky_key_t, PRN)},
+        {"gnssid", t_ubyte,   STRUCTOBJECT(struct sky_key_t, gnssid)},
+        {"svid",   t_ubyte,   STRUCTOBJECT(struct sky_key_t, svid)},
+        {"sigid",  t_ubyte,   STRUCTOBJECT(struct sky_key_t, sigid)},
+        {"", t_ignore},
+        // *INDENT-ON*
+        {NULL},
+    };
+
     int nSat = -1;  // Use nSat only to know if sats are in SKY
 
     const struct json_attr_t json_attrs_2[] = {
@@ -309,10 +395,11 @@ static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
                                      .dflt.real = NAN},
         {"nSat",       t_integer, .addr.integer = &nSat,
                                      .dflt.integer = -1},
-        {"satellites", t_array,
-                                   STRUCTARRAY(gpsdata->skyview,
-                                         json_attrs_satellites,
-                                         &gpsdata->satellites_visible)},
+        {"delta",      t_boolean, .addr.boolean = &delta},
+        {"removed",    t_array,   STRUCTARRAY(removed, json_attrs_removed,
+                                              &nremoved)},
+        {"satellites", t_array,   STRUCTARRAY(sats, json_attrs_satellites,
+                                              &nsats)},
         // ignore unknown keys, for cross-version compatibility
         {"", t_ignore},
         {NULL},
@@ -320,7 +407,8 @@ static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
     };
     int status, i;
 
-    memset(&gpsdata->skyview, 0, sizeof(gpsdata->skyview));
+    memset(sats, 0, sizeof(sats));
+    memset(removed, 0, sizeof(removed));
 
     status = json_read_object(buf, json_attrs_2, endptr);
     if (0 != status) {
@@ -338,15 +426,40 @@ static int json_sky_read(const char *buf, struct gps_data_t *gpsdata,
         gpsdata->set |= DOP_SET;
     }
 
-    gpsdata->satellites_used = 0;
-    gpsdata->satellites_visible = 0;
-
     if (-1 == nSat) {
-        // no sats in the SKY, likely just dops.
+        // no sats in the SKY, likely just dops.  A delta keeps the skyview.
+        if (!delta) {
+            memset(&gpsdata->skyview, 0, sizeof(gpsdata->skyview));
+            (void)strlcpy(gpsdata->skyview_device, gpsdata->dev.path,
+                          sizeof(gpsdata->skyview_device));
+            gpsdata->satellites_used = 0;
+            gpsdata->satellites_visible = 0;
+        }
         gpsdata->set &= ~SATELLITE_SET;
         return 0;
     }
 
+    if (delta &&
+        ('\0' == gpsdata->dev.path[0] ||
+         0 != strcmp(gpsdata->dev.path, gpsdata->skyview_device))) {
+        /* A delta is of the last SKY of its device.  With the skyview
+         * of another, or of none named, there is nothing to merge it
+         * into, so it is dropped.  The next full SKY starts over. */
+        gpsdata->set &= ~SATELLITE_SET;
+        return 0;
+    }
+
+    gpsdata->satellites_used = 0;
+    gpsdata->satellites_visible = 0;
+
+    if (delta) {
+        // changes to the skyview of the last SKY
+        sky_merge(gpsdata, sats, nsats, removed, nremoved);
+    } else {
+        memcpy(gpsdata->skyview, sats, sizeof(gpsdata->skyview));
+        (void)strlcpy(gpsdata->skyview_device, gpsdata->dev.path,
+                      sizeof(gpsdata->skyview_device));
+    }
     gpsdata->set |= SATELLITE_SET;
     // recalculate used and visible, do not use nSat, uSat
     for (i = 0; i < MAXCHANNELS; i++) {
@@ -508,6 +621,67 @@ static int json_imu_read(const char *buf, struct gps_data_t *gpsdata,
     return json_read_object(buf, json_attrs_1, endptr);
 }
 
+// decode class IMUBATCH, a column not sent is all NaN
+static int json_imubatch_read(const char *buf, struct gps_data_t *gpsdata,
+                              const char **endptr)
+{
+    struct imubatch_t *datap = &gpsdata->imubatch;
+    double *cols[] = {datap->acc_x, datap->acc_y, datap->acc_z,
+                      datap->gyro_x, datap->gyro_y, datap->gyro_z,
+                      datap->gyro_temp};
+    int ndt = 0, n[7] = {0};
+    int status, c, i;
+
+#define IMUB_COLUMN(name, c) \
+        {name,        t_array,     .addr.array.element_type = t_real, \
+         .addr.array.arr.reals.store = cols[c], \
+         .addr.array.count = &n[c], .addr.array.maxlen = IMUBATCH_MAX}
+    const struct json_attr_t json_attrs_1[] = {
+        // *INDENT-OFF*
+        {"class",     t_check,     .dflt.check = "IMUBATCH"},
+        {"device",    t_string,    .addr.string = gpsdata->dev.path,
+         .len = sizeof(gpsdata->dev.path)},
+        IMUB_COLUMN("acc_x", 0),
+        IMUB_COLUMN("acc_y", 1),
+        IMUB_COLUMN("acc_z", 2),
+        {"count",     t_integer,   .addr.integer = &datap->count,
+         .dflt.integer = 0},
+        {"dt",        t_array,     .addr.array.element_type = t_longint,
+         .addr.array.arr.longint.store = datap->dt,
+         .addr.array.count = &ndt, .addr.array.maxlen = IMUBATCH_MAX},
+        IMUB_COLUMN("gyro_temp", 6),
+        IMUB_COLUMN("gyro_x", 3),
+        IMUB_COLUMN("gyro_y", 4),
+        IMUB_COLUMN("gyro_z", 5),
+        {"msg",       t_string,    .addr.string = datap->msg,
+         .len = sizeof(datap->msg)},
+        {"time",      t_time,      .addr.ts = &datap->mtime, .dflt.ts = {0, 0}},
+        {"timeTag",   t_ulongint,  .addr.ulongint = &datap->timeTag,
+         .dflt.ulongint = 0},
+
+        // ignore unknown keys, for cross-version compatibility
+        {"", t_ignore},
+        {NULL},
+        // *INDENT-ON*
+    };
+#undef IMUB_COLUMN
+
+    status = json_read_object(buf, json_attrs_1, endptr);
+    if (0 != status) {
+        return status;
+    }
+    // trust the arrays, not the count
+    datap->count = ndt;
+    for (c = 0; c < 7; c++) {
+        if (n[c] != ndt) {
+            for (i = 0; i < ndt; i++) {
+                cols[c][i] = NAN;
+            }
+        }
+    }
+    return 0;
+}
+
 static int json_devicelist_read(const char *buf, struct gps_data_t *gpsdata,
                                 const char **endptr)
 {
@@ -743,18 +917,47 @@ int json_oscillator_read(const char *buf, struct gps_data_t *gpsdata,
 #define PASS(n) (((n) == 0) || ((n) == JSON_ERR_BADATTR))
 #define FILTER(n) ((n) == JSON_ERR_BADATTR ? 0 : n)
 
+/* the value of the first "class" attribute, which gpsd always sends
+ * first in an object, found with the structural scanner.  NULL if
+ * there is none, or it is not a string. */
+static const char *json_class(const char *buf, size_t *len)
+{
+    const char *tag;
+
+    if (str_starts_with(buf, "{\"class\":\"")) {
+        tag = buf + 10;
+    } else {
+        tag = strstr(buf, "\"class\":");
+        if (NULL == tag ||
+            '"' != tag[8]) {
+            return NULL;
+        }
+        tag += 9;
+    }
+    *len = json_scan(tag, JSON_SCAN_ATTR);
+    if ('"' != tag[*len]) {
+        return NULL;
+    }
+    return tag;
+}
+
+// is the class tag this name?
+#define IS_CLASS(name) \
+    (sizeof(name) - 1 == taglen && 0 == memcmp(classtag, name, taglen))
+
 // the only entry point - unpack a JSON object into gpsdata_t substructures
 int libgps_json_unpack(const char *buf,
                        struct gps_data_t *gpsdata, const char **end)
 {
     int status;
-    char *classtag = strstr(buf, "\"class\":");
+    size_t taglen = 0;
+    const char *classtag = json_class(buf, &taglen);
 
     if (NULL == classtag) {
         return -1;
     }
 
-    if (str_starts_with(classtag, "\"class\":\"TPV\"")) {
+    if (IS_CLASS("TPV")) {
         status = json_tpv_read(buf, gpsdata, end);
         gpsdata->set = STATUS_SET;
         if (0 != gpsdata->fix.time.tv_sec) {
@@ -823,7 +1026,7 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"GST\"")) {
+    if (IS_CLASS("GST")) {
         status = json_noise_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -831,25 +1034,33 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"SKY\"")) {
+    if (IS_CLASS("SKY")) {
         status = json_sky_read(buf, gpsdata, end);
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"ATT\"")) {
+    if (IS_CLASS("ATT")) {
         status = json_att_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set |= ATTITUDE_SET;
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"IMU\"")) {
+    if (IS_CLASS("IMU")) {
         status = json_imu_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set |= IMU_SET;
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"DEVICES\"")) {
+    if (IS_CLASS("IMUBATCH")) {
+        status = json_imubatch_read(buf, gpsdata, end);
+        if (PASS(status)) {
+            gpsdata->set &= ~UNION_SET;
+            gpsdata->set |= IMUBATCH_SET;
+        }
+        return FILTER(status);
+    }
+    if (IS_CLASS("DEVICES")) {
         status = json_devicelist_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -857,13 +1068,13 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"DEVICE\"")) {
+    if (IS_CLASS("DEVICE")) {
         status = json_device_read(buf, &gpsdata->dev, end);
         if (PASS(status))
             gpsdata->set |= DEVICE_SET;
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"WATCH\"")) {
+    if (IS_CLASS("WATCH")) {
         status = json_watch_read(buf, &gpsdata->policy, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -871,7 +1082,7 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"VERSION\"")) {
+    if (IS_CLASS("VERSION")) {
         status = json_version_read(buf, gpsdata, end);
         if (status ==  0) {
             gpsdata->set &= ~UNION_SET;
@@ -880,7 +1091,7 @@ int libgps_json_unpack(const char *buf,
         return FILTER(status);
     }
 #ifdef RTCM104V2_ENABLE
-    if (str_starts_with(classtag, "\"class\":\"RTCM2\"")) {
+    if (IS_CLASS("RTCM2")) {
         status = json_rtcm2_read(buf,
                                  gpsdata->dev.path, sizeof(gpsdata->dev.path),
                                  &gpsdata->rtcm2, end);
@@ -892,7 +1103,7 @@ int libgps_json_unpack(const char *buf,
     }
 #endif  // RTCM104V2_ENABLE
 #ifdef RTCM104V3_ENABLE
-    if (str_starts_with(classtag, "\"class\":\"RTCM3\"")) {
+    if (IS_CLASS("RTCM3")) {
         status = json_rtcm3_read(buf,
                                  gpsdata->dev.path, sizeof(gpsdata->dev.path),
                                  &gpsdata->rtcm3, end);
@@ -904,7 +1115,7 @@ int libgps_json_unpack(const char *buf,
     }
 #endif  // RTCM104V3_ENABLE
 #ifdef AIVDM_ENABLE
-    if (str_starts_with(classtag, "\"class\":\"AIS\"")) {
+    if (IS_CLASS("AIS")) {
         status = json_ais_read(buf,
                                gpsdata->dev.path, sizeof(gpsdata->dev.path),
                                &gpsdata->ais, end);
@@ -915,7 +1126,7 @@ int libgps_json_unpack(const char *buf,
         return FILTER(status);
     }
 #endif  // AIVDM_ENABLE
-    if (str_starts_with(classtag, "\"class\":\"ERROR\"")) {
+    if (IS_CLASS("ERROR")) {
         status = json_error_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -923,7 +1134,7 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"TOFF\"")) {
+    if (IS_CLASS("TOFF")) {
         status = json_pps_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -931,7 +1142,7 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"PPS\"")) {
+    if (IS_CLASS("PPS")) {
         status = json_pps_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -939,7 +1150,7 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"OSC\"")) {
+    if (IS_CLASS("OSC")) {
         status = json_oscillator_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -947,7 +1158,7 @@ int libgps_json_unpack(const char *buf,
         }
         return FILTER(status);
     }
-    if (str_starts_with(classtag, "\"class\":\"RAW\"")) {
+    if (IS_CLASS("RAW")) {
         status = json_raw_read(buf, gpsdata, end);
         if (PASS(status)) {
             gpsdata->set &= ~UNION_SET;
@@ -5,8 +5,9 @@ NAME
 
 DESCRIPTION
    This is a very lightweight alternative to JSON-over-sockets.  Clients
-won't be able to filter by device, and won't get device activation/deactivation
-notifications.  But both client and daemon will avoid all the marshalling and
+won't get device activation/deactivation notifications, and can follow
+either all devices at once or, through gps_shm_open_device(), just one.
+But both client and daemon will avoid all the marshalling and
 unmarshalling overhead.
 
 PERMISSIONS
@@ -29,14 +30,45 @@ PERMISSIONS
 
 #include "../include/gpsd.h"
 #include "../include/libgps.h"
+#include "../include/strfuncs.h"
 
 struct privdata_t
 {
     void *shmseg;
     int tick;
+    char device[GPS_PATH_MAX];          // empty when reading all devices
 };
 
 
+/* attach the session to export segment shmid
+ *
+ * Returns: 0 on success
+ *         -1 out of memory
+ *         -2 attach failed
+ */
+static int gps_shm_attach(struct gps_data_t *gpsdata, int shmid)
+{
+    gpsdata->privdata = (void *)malloc(sizeof(struct privdata_t));
+    if (gpsdata->privdata == NULL)
+        return -1;
+
+    PRIVATE(gpsdata)->tick = 0;
+    PRIVATE(gpsdata)->device[0] = '\0';
+    PRIVATE(gpsdata)->shmseg = shmat(shmid, 0, 0);
+    if (PRIVATE(gpsdata)->shmseg == (void *) -1) {
+        /* attach failed for sume unknown reason */
+        free(gpsdata->privdata);
+        gpsdata->privdata = NULL;
+        return -2;
+    }
+#ifndef USE_QT
+    gpsdata->gps_fd = SHM_PSEUDO_FD;
+#else
+    gpsdata->gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
+#endif /* USE_QT */
+    return 0;
+}
+
 /* open a shared-memory connection to the daemon */
 int gps_shm_open(struct gps_data_t *gpsdata)
 {
@@ -53,23 +85,90 @@ int gps_shm_open(struct gps_data_t *gpsdata)
         /* daemon isn't running or failed to create shared segment */
         return -1;
     }
-    gpsdata->privdata = (void *)malloc(sizeof(struct privdata_t));
-    if (gpsdata->privdata == NULL)
+    return gps_shm_attach(gpsdata, shmid);
+}
+
+/* open a shared-memory connection to the daemon, seeing only the
+ * updates of device
+ *
+ * Returns: 0 on success
+ *         -1 no directory, daemon not running
+ *         -2 attach failed
+ *         -3 device not in the directory
+ */
+int gps_shm_open_device(struct gps_data_t *gpsdata, const char *device)
+{
+    volatile struct shmdirectory_t *dir;
+    volatile int *bookend2;
+    struct shmid_ds ds;
+    size_t room;
+    int dirid, shmid = -1;
+    int tries, i, ndevices;
+
+    long shmkey = getenv("GPSD_SHM_KEY") ?
+                     strtol(getenv("GPSD_SHM_KEY"), NULL, 0) : GPSD_SHM_KEY;
+
+    libgps_debug_trace((DEBUG_CALLS, "gps_shm_open_device(%s)\n", device));
+
+    gpsdata->privdata = NULL;
+    // size 0: the daemon may have been built with another max_devices
+    dirid = shmget((key_t)(shmkey + GPSD_SHM_DIRECTORY_OFFSET), 0, 0);
+    if (dirid == -1) {
         return -1;
+    }
+    dir = (struct shmdirectory_t *)shmat(dirid, 0, SHM_RDONLY);
+    if (dir == (void *) -1) {
+        return -2;
+    }
+    /* so take the number of entries from the header, not MAX_DEVICES,
+     * and check the segment really holds them.  bookend2 follows the
+     * last of them. */
+    ndevices = dir->ndevices;
+    if (shmctl(dirid, IPC_STAT, &ds) != 0 ||
+        ds.shm_segsz < offsetof(struct shmdirectory_t, device) +
+                       sizeof(int)) {
+        (void)shmdt((const void *)dir);
+        return -2;
+    }
+    room = (ds.shm_segsz - offsetof(struct shmdirectory_t, device) -
+            sizeof(int)) / sizeof(dir->device[0]);
+    if (ndevices < 0 || (size_t)ndevices > room) {
+        (void)shmdt((const void *)dir);
+        return -2;
+    }
+    bookend2 = (volatile int *)((volatile char *)dir +
+                                offsetof(struct shmdirectory_t, device) +
+                                ndevices * sizeof(dir->device[0]));
+    /* the daemon rewrites the directory only when a device comes or
+     * goes, so a torn read (same bookend check as gps_shm_read()) is
+     * rare; try again until a clean one */
+    for (tries = 0; tries < 1000; tries++) {
+        int before, after;
 
-    PRIVATE(gpsdata)->tick = 0;
-    PRIVATE(gpsdata)->shmseg = shmat(shmid, 0, 0);
-    if (PRIVATE(gpsdata)->shmseg == (void *) -1) {
-        /* attach failed for sume unknown reason */
-        free(gpsdata->privdata);
-        gpsdata->privdata = NULL;
+        shmid = -1;
+        before = dir->bookend1;
+        memory_barrier();
+        // past device[MAX_DEVICES] when the daemon has more
+        for (i = 0; i < ndevices; i++) {
+            if (strncmp((const char *)(dir->device + i)->path, device,
+                        GPS_PATH_MAX) == 0) {
+                shmid = (dir->device + i)->shmid;
+                break;
+            }
+        }
+        memory_barrier();
+        after = *bookend2;
+        if (before == after)
+            break;
+    }
+    (void)shmdt((const void *)dir);
+    if (shmid == -1) {
+        return -3;
+    }
+    if (gps_shm_attach(gpsdata, shmid) != 0) {
         return -2;
     }
-#ifndef USE_QT
-    gpsdata->gps_fd = SHM_PSEUDO_FD;
-#else
-    gpsdata->gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
-#endif /* USE_QT */
+    (void)strlcpy(PRIVATE(gpsdata)->device, device, GPS_PATH_MAX);
     return 0;
 }
 
@@ -144,7 +243,14 @@ int gps_shm_read(struct gps_data_t *gpsdata)
 
         if (before != after)
             return 0;
-        else {
+        else if (PRIVATE(gpsdata)->device[0] != '\0' &&
+                 strncmp(noclobber.dev.path, PRIVATE(gpsdata)->device,
+                         GPS_PATH_MAX) != 0) {
+            /* the device went away, and its segment now carries
+             * another one */
+            PRIVATE(gpsdata)->tick = after;
+            return 0;
+        } else {
             (void)memcpy((void *)gpsdata,
                          (void *)&noclobber,
                          sizeof(struct gps_data_t));
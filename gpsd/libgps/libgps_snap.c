@@ -0,0 +1,356 @@
+/****************************************************************************
+
+NAME
+   libgps_snap.c - reports as small typed records, and rings of them
+
+DESCRIPTION
+   gps_read() and gps_unpack() merge every report into one gps_data_t,
+where each class overwrites what the last left in the shared union.  A
+client that wants to pass a TPV to another thread has to copy the
+whole structure, under a lock, before the next read.  These functions
+copy just the report that was last unpacked into a record of its own
+class, sized to what it holds, in memory the caller supplies: a
+buffer, an arena, or a slot of a ring that several threads read.
+
+   The ring has one writer and any number of readers, and no locks.
+Each slot carries bookends, the way the SHM export segment does, so a
+reader that copies a slot as it is being rewritten sees them differ
+and moves on instead of returning a torn record.
+
+PERMISSIONS
+   This file is Copyright 2010 by the GPSD project
+   SPDX-License-Identifier: BSD-2-clause
+
+***************************************************************************/
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>             // for uintptr_t
+#include <string.h>
+
+#include "../include/gps.h"
+#include "../include/compiler.h"     // for memory_barrier()
+#include "../include/os_compat.h"    // for strlcpy()
+#include "../include/strfuncs.h"
+
+// records are aligned to this, enough for anything in them
+#define SNAP_ALIGN      16
+#define SNAP_ROUND(n)   (((n) + SNAP_ALIGN - 1) & ~(size_t)(SNAP_ALIGN - 1))
+
+struct ring_slot_t {
+    volatile unsigned long bookend1;
+    volatile unsigned long bookend2;
+};
+
+#define SLOT_HEAD       SNAP_ROUND(sizeof(struct ring_slot_t))
+
+// the record type for the class of a JSON report, 0 if none
+static int snap_type(const char *message)
+{
+    static const struct {
+        const char *tag;
+        int type;
+    } classes[] = {
+        {"\"class\":\"TPV\"", GPS_SNAP_TPV},
+        {"\"class\":\"SKY\"", GPS_SNAP_SKY},
+        {"\"class\":\"GST\"", GPS_SNAP_GST},
+        {"\"class\":\"ATT\"", GPS_SNAP_ATT},
+        {"\"class\":\"IMU\"", GPS_SNAP_IMU},
+        {"\"class\":\"RAW\"", GPS_SNAP_RAW},
+        {"\"class\":\"AIS\"", GPS_SNAP_AIS},
+        {"\"class\":\"PPS\"", GPS_SNAP_PPS},
+    };
+    const char *classtag;
+    size_t i;
+
+    if (NULL == message ||
+        NULL == (classtag = strstr(message, "\"class\":"))) {
+        return 0;
+    }
+    for (i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        if (str_starts_with(classtag, classes[i].tag)) {
+            return classes[i].type;
+        }
+    }
+    return 0;
+}
+
+// skyview entries in use, json_sky_read() fills them from the front
+static int sky_count(const struct gps_data_t *gpsdata)
+{
+    int n;
+
+    for (n = MAXCHANNELS; 0 < n; n--) {
+        if (0 != gpsdata->skyview[n - 1].PRN) {
+            break;
+        }
+    }
+    return n;
+}
+
+// raw.meas entries in use, a real one never has svid 0
+static int meas_count(const struct gps_data_t *gpsdata)
+{
+    int n;
+
+    for (n = MAXCHANNELS; 0 < n; n--) {
+        if (0 != gpsdata->raw.meas[n - 1].svid) {
+            break;
+        }
+    }
+    return n;
+}
+
+/* How many bytes the record of message, just unpacked into gpsdata,
+ * takes.
+ *
+ * Return: the size, or 0 if message is not of a class with records
+ */
+size_t gps_snap_size(const struct gps_data_t *gpsdata, const char *message)
+{
+    switch (snap_type(message)) {
+    case GPS_SNAP_TPV:
+        return sizeof(struct gps_snap_tpv_t);
+    case GPS_SNAP_SKY:
+        return offsetof(struct gps_snap_sky_t, skyview) +
+               sky_count(gpsdata) * sizeof(struct satellite_t);
+    case GPS_SNAP_GST:
+        return sizeof(struct gps_snap_gst_t);
+    case GPS_SNAP_ATT:
+    case GPS_SNAP_IMU:
+        return sizeof(struct gps_snap_att_t);
+    case GPS_SNAP_RAW:
+        return offsetof(struct gps_snap_raw_t, raw) +
+               offsetof(struct rawdata_t, meas) +
+               meas_count(gpsdata) * sizeof(gpsdata->raw.meas[0]);
+    case GPS_SNAP_AIS:
+        return sizeof(struct gps_snap_ais_t);
+    case GPS_SNAP_PPS:
+        return sizeof(struct gps_snap_pps_t);
+    default:
+        return 0;
+    }
+}
+
+/* Copy the report last unpacked into gpsdata, from the JSON message,
+ * into a record at buf.  buf must be aligned for a double.
+ *
+ * Return: the record, or NULL if message is not of a class with
+ *         records or the record would not fit in len bytes
+ */
+struct gps_snap_t *gps_snap(const struct gps_data_t *gpsdata,
+                            const char *message, void *buf, size_t len)
+{
+    struct gps_snap_t *snap = (struct gps_snap_t *)buf;
+    size_t size = gps_snap_size(gpsdata, message);
+
+    if (0 == size ||
+        len < size) {
+        return NULL;
+    }
+    snap->type = snap_type(message);
+    snap->size = (unsigned)size;
+    (void)strlcpy(snap->device, gpsdata->dev.path, sizeof(snap->device));
+
+    switch (snap->type) {
+    case GPS_SNAP_TPV:
+        ((struct gps_snap_tpv_t *)snap)->fix = gpsdata->fix;
+        break;
+    case GPS_SNAP_SKY:
+        {
+            struct gps_snap_sky_t *sky = (struct gps_snap_sky_t *)snap;
+
+            sky->time = gpsdata->skyview_time;
+            sky->dop = gpsdata->dop;
+            sky->satellites_used = gpsdata->satellites_used;
+            sky->satellites_visible = gpsdata->satellites_visible;
+            sky->nsats = sky_count(gpsdata);
+            (void)memcpy(sky->skyview, gpsdata->skyview,
+                         sky->nsats * sizeof(struct satellite_t));
+        }
+        break;
+    case GPS_SNAP_GST:
+        ((struct gps_snap_gst_t *)snap)->gst = gpsdata->gst;
+        break;
+    case GPS_SNAP_ATT:
+        ((struct gps_snap_att_t *)snap)->att = gpsdata->attitude;
+        break;
+    case GPS_SNAP_IMU:
+        ((struct gps_snap_att_t *)snap)->att = gpsdata->imu[0];
+        break;
+    case GPS_SNAP_RAW:
+        {
+            struct gps_snap_raw_t *raw = (struct gps_snap_raw_t *)snap;
+
+            raw->nmeas = meas_count(gpsdata);
+            raw->raw.mtime = gpsdata->raw.mtime;
+            (void)memcpy(raw->raw.meas, gpsdata->raw.meas,
+                         raw->nmeas * sizeof(gpsdata->raw.meas[0]));
+        }
+        break;
+    case GPS_SNAP_AIS:
+        ((struct gps_snap_ais_t *)snap)->ais = gpsdata->ais;
+        break;
+    case GPS_SNAP_PPS:
+        ((struct gps_snap_pps_t *)snap)->pps = gpsdata->pps;
+        ((struct gps_snap_pps_t *)snap)->qErr = gpsdata->qErr;
+        break;
+    default:
+        // gps_snap_size() knows no others
+        break;
+    }
+    return snap;
+}
+
+// carve records out of size bytes at base
+void gps_arena_init(struct gps_arena_t *arena, void *base, size_t size)
+{
+    arena->base = (unsigned char *)base;
+    arena->size = size;
+    arena->used = 0;
+}
+
+/* size bytes from the arena, aligned for any record, or NULL if it is
+ * full.  Nothing is given back until the arena is initialized again. */
+void *gps_arena_alloc(struct gps_arena_t *arena, size_t size)
+{
+    unsigned char *start = arena->base + arena->used;
+    size_t pad = (SNAP_ALIGN - ((uintptr_t)start % SNAP_ALIGN)) % SNAP_ALIGN;
+
+    if (arena->size - arena->used < pad ||
+        arena->size - arena->used - pad < size) {
+        return NULL;
+    }
+    arena->used += pad + size;
+    return start + pad;
+}
+
+// gps_snap() into a record from the arena
+struct gps_snap_t *gps_snap_arena(const struct gps_data_t *gpsdata,
+                                  const char *message,
+                                  struct gps_arena_t *arena)
+{
+    size_t size = gps_snap_size(gpsdata, message);
+    void *buf;
+
+    if (0 == size ||
+        NULL == (buf = gps_arena_alloc(arena, size))) {
+        return NULL;
+    }
+    return gps_snap(gpsdata, message, buf, size);
+}
+
+/* Lay a ring of slotsize byte slots over size bytes at base, which
+ * must be aligned for a double.  A slot holds one record, and its
+ * bookends; records that do not fit are not put.
+ *
+ * Return: the number of slots, or -1 if not even one fits
+ */
+int gps_ring_init(struct gps_ring_t *ring, void *base, size_t size,
+                  size_t slotsize)
+{
+    slotsize = SNAP_ROUND(SLOT_HEAD + slotsize);
+    ring->slots = (unsigned char *)base;
+    ring->slotsize = slotsize;
+    ring->nslots = size / slotsize;
+    ring->head = 0;
+    (void)memset(base, 0, size);
+    return 0 < ring->nslots ? (int)ring->nslots : -1;
+}
+
+/* The writer: put the report last unpacked into gpsdata, from the
+ * JSON message, into the next slot.  The record is built in place.
+ *
+ * Return: the record, or NULL if there is none, or it does not fit
+ */
+struct gps_snap_t *gps_ring_put(struct gps_ring_t *ring,
+                                const struct gps_data_t *gpsdata,
+                                const char *message)
+{
+    unsigned long seq = ring->head + 1;
+    unsigned char *slotp = ring->slots +
+                           (ring->head % ring->nslots) * ring->slotsize;
+    struct ring_slot_t *slot = (struct ring_slot_t *)slotp;
+    size_t size = gps_snap_size(gpsdata, message);
+    struct gps_snap_t *snap;
+
+    if (0 == size ||
+        ring->slotsize - SLOT_HEAD < size) {
+        return NULL;
+    }
+    slot->bookend1 = seq;
+    memory_barrier();
+    snap = gps_snap(gpsdata, message, slotp + SLOT_HEAD,
+                    ring->slotsize - SLOT_HEAD);
+    memory_barrier();
+    slot->bookend2 = seq;
+    memory_barrier();
+    ring->head = seq;
+    return snap;
+}
+
+/* A reader: copy the record after *cursor into buf, and advance
+ * *cursor past it.  Start a cursor at 0 for every record still in the
+ * ring, or at ring->head for just the ones to come.  A reader that
+ * has fallen more than a ring behind skips to the oldest record kept;
+ * the jump in *cursor says how many it lost.  A buf of the ring's
+ * slotsize always fits.
+ *
+ * Return: the record in buf, or NULL with errno EAGAIN if there is no
+ *         new one, or E2BIG if it would not fit in len bytes, and
+ *         *cursor is left on it
+ */
+struct gps_snap_t *gps_ring_get(struct gps_ring_t *ring,
+                                unsigned long *cursor,
+                                void *buf, size_t len)
+{
+    for (;;) {
+        unsigned long head = ring->head;
+        unsigned long seq;
+        struct ring_slot_t *slot;
+        unsigned char *slotp;
+        struct gps_snap_t *snap;
+        unsigned long end;
+        size_t size;
+
+        memory_barrier();
+        if (*cursor >= head) {
+            errno = EAGAIN;
+            return NULL;
+        }
+        if (head - *cursor > ring->nslots) {
+            *cursor = head - ring->nslots;
+        }
+        seq = *cursor + 1;
+        slotp = ring->slots + (*cursor % ring->nslots) * ring->slotsize;
+        slot = (struct ring_slot_t *)slotp;
+        snap = (struct gps_snap_t *)(slotp + SLOT_HEAD);
+
+        end = slot->bookend2;
+        memory_barrier();
+        size = snap->size;
+        if (seq == end &&
+            len >= size &&
+            ring->slotsize - SLOT_HEAD >= size) {
+            (void)memcpy(buf, snap, size);
+        }
+        memory_barrier();
+        if (seq != end ||
+            seq != slot->bookend1) {
+            // the writer has lapped us, start again from the oldest
+            *cursor = seq;
+            continue;
+        }
+        if (len < size) {
+            // left for a bigger buf, not lost
+            errno = E2BIG;
+            return NULL;
+        }
+        *cursor = seq;
+        return (struct gps_snap_t *)buf;
+    }
+}
+
+// vim: set expandtab shiftwidth=4
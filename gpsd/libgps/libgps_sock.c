@@ -42,8 +42,13 @@
 struct privdata_t
 {
     bool newstyle;
-    // data buffered from the last read
+    // a local SOCK_SEQPACKET socket, so every read is whole messages
+    bool seqpacket;
+    // data buffered from the last read, from buffer[start]
     ssize_t waiting;
+    ssize_t start;
+    // how much of it is known to hold no \n
+    ssize_t scanned;
     char buffer[GPS_JSON_RESPONSE_MAX * 2];
     int waitcount;
 };
@@ -113,7 +118,20 @@ int gps_sock_open(const char *host, const char *port,
           need_init != windows_init();
         }
 #endif  // HAVE_WINSOCK2_H
-        sock = netlib_connectsock(AF_UNSPEC, host, port, "tcp");
+        if (0 == strncmp(host, GPSD_LOCAL_PREFIX,
+                         sizeof(GPSD_LOCAL_PREFIX) - 1)) {
+            sock = netlib_localsocket(host + sizeof(GPSD_LOCAL_PREFIX) - 1,
+                                      SOCK_SEQPACKET);
+            if (0 > sock) {
+                gpsdata->gps_fd = PLACEHOLDING_FD;
+                libgps_debug_trace((DEBUG_CALLS,
+                                   "netlib_localsocket() returns error "
+                                   "%s(%d)\n", strerror(errno), errno));
+                return -1;
+            }
+        } else {
+            sock = netlib_connectsock(AF_UNSPEC, host, port, "tcp");
+        }
         if (0 > sock) {
             gpsdata->gps_fd = PLACEHOLDING_FD;
             errno = sock;
@@ -134,7 +152,15 @@ int gps_sock_open(const char *host, const char *port,
         return -1;
     }
     PRIVATE(gpsdata)->newstyle = false;
+#ifdef USE_QT
+    PRIVATE(gpsdata)->seqpacket = false;
+#else
+    PRIVATE(gpsdata)->seqpacket = 0 == strncmp(host, GPSD_LOCAL_PREFIX,
+                                               sizeof(GPSD_LOCAL_PREFIX) - 1);
+#endif  // USE_QT
     PRIVATE(gpsdata)->waiting = 0;
+    PRIVATE(gpsdata)->start = 0;
+    PRIVATE(gpsdata)->scanned = 0;
     PRIVATE(gpsdata)->buffer[0] = 0;
 
     PRIVATE(gpsdata)->waitcount = 0;
@@ -194,21 +220,28 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
     char *eol;
     ssize_t response_length;
     int status = -1;
-    char *eptr;
+    char *base;
 
     errno = 0;
     gpsdata->set &= ~PACKET_SET;
 
-    // scan to find end of message (\n), or end of buffer
-    eol = PRIVATE(gpsdata)->buffer;
-    eptr = eol + PRIVATE(gpsdata)->waiting;
-
-    while ((eol < eptr) && (*eol != '\n')) {
-        eol++;
-    }
+    /* find the end of message (\n), with memchr(), vectorized in most
+     * C libraries, and only over bytes not already scanned */
+    base = PRIVATE(gpsdata)->buffer + PRIVATE(gpsdata)->start;
+    eol = (char *)memchr(base + PRIVATE(gpsdata)->scanned, '\n',
+                         PRIVATE(gpsdata)->waiting -
+                         PRIVATE(gpsdata)->scanned);
 
-    if (eol >= eptr) {
+    if (NULL == eol) {
         // no full message found, try to fill buffer
+        PRIVATE(gpsdata)->scanned = PRIVATE(gpsdata)->waiting;
+        if (0 < PRIVATE(gpsdata)->start) {
+            // move the partial message down, once a fill, not a message
+            memmove(PRIVATE(gpsdata)->buffer, base,
+                    PRIVATE(gpsdata)->waiting);
+            PRIVATE(gpsdata)->start = 0;
+            base = PRIVATE(gpsdata)->buffer;
+        }
         if ((ssize_t)sizeof(PRIVATE(gpsdata)->buffer) <=
             PRIVATE(gpsdata)->waiting) {
             // buffer is full but still didn't get a message
@@ -221,10 +254,37 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
                  PRIVATE(gpsdata)->waiting,
                  sizeof(PRIVATE(gpsdata)->buffer) - PRIVATE(gpsdata)->waiting);
 #else   // USE_QT
-        // read data: return -1 if no data waiting or buffered, 0 otherwise
-        status = (int)recv(gpsdata->gps_fd,
-               PRIVATE(gpsdata)->buffer + PRIVATE(gpsdata)->waiting,
-               sizeof(PRIVATE(gpsdata)->buffer) - PRIVATE(gpsdata)->waiting, 0);
+#ifndef HAVE_WINSOCK2_H
+        if (PRIVATE(gpsdata)->seqpacket) {
+            /* One whole message, of whole lines, so nothing is left
+             * waiting to be completed by the next.  One too long for
+             * the buffer is cut short, and an error. */
+            struct iovec iov;
+            struct msghdr msg;
+
+            iov.iov_base = PRIVATE(gpsdata)->buffer +
+                           PRIVATE(gpsdata)->waiting;
+            iov.iov_len = sizeof(PRIVATE(gpsdata)->buffer) -
+                          PRIVATE(gpsdata)->waiting;
+            (void)memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            status = (int)recvmsg(gpsdata->gps_fd, &msg, 0);
+            if (0 != (msg.msg_flags & MSG_TRUNC)) {
+                PRIVATE(gpsdata)->waiting = 0;
+                PRIVATE(gpsdata)->scanned = 0;
+                errno = EMSGSIZE;
+                return -1;
+            }
+        } else
+#endif  // HAVE_WINSOCK2_H
+        {
+            // read data: return -1 if no data waiting or buffered, 0 otherwise
+            status = (int)recv(gpsdata->gps_fd,
+                   PRIVATE(gpsdata)->buffer + PRIVATE(gpsdata)->waiting,
+                   sizeof(PRIVATE(gpsdata)->buffer) -
+                   PRIVATE(gpsdata)->waiting, 0);
+        }
 #endif  // USE_QT
 
 #ifdef HAVE_WINSOCK2_H
@@ -332,16 +392,14 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
         // if we just received data from the socket, it's in the buffer
         PRIVATE(gpsdata)->waiting += status;
 
-        // there's new buffered data waiting, check for full message
-        eol = PRIVATE(gpsdata)->buffer;
-        eptr = eol + PRIVATE(gpsdata)->waiting;
-
-        while ((eol < eptr) && ('\n' != *eol)) {
-            eol++;
-        }
+        // there's new buffered data waiting, check it for full message
+        eol = (char *)memchr(base + PRIVATE(gpsdata)->scanned, '\n',
+                             PRIVATE(gpsdata)->waiting -
+                             PRIVATE(gpsdata)->scanned);
 
-        if (eol >= eptr) {
+        if (NULL == eol) {
             // still no full message, give up for now
+            PRIVATE(gpsdata)->scanned = PRIVATE(gpsdata)->waiting;
             return 0;
         }
     }
@@ -349,11 +407,11 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
     // eol now points to trailing \n in a full message
     *eol = '\0';
     if (NULL != message) {
-        strlcpy(message, PRIVATE(gpsdata)->buffer, message_len);
+        strlcpy(message, base, message_len);
     }
     (void)clock_gettime(CLOCK_REALTIME, &gpsdata->online);
     // unpack the JSON message
-    status = gps_unpack(PRIVATE(gpsdata)->buffer, gpsdata);
+    status = gps_unpack(base, gpsdata);
 
     /*
         why the 1?
@@ -371,19 +429,21 @@ int gps_sock_read(struct gps_data_t *gpsdata, char *message, int message_len)
 
     */
 
-    response_length = eol - PRIVATE(gpsdata)->buffer + 1;
+    response_length = eol - base + 1;
 
     // calculate length of good data still in buffer
     PRIVATE(gpsdata)->waiting -= response_length;
+    // none of which has been scanned
+    PRIVATE(gpsdata)->scanned = 0;
 
     if (0 >= PRIVATE(gpsdata)->waiting) {
         // no waiting data, or overflow, clear the buffer, just in case
         *PRIVATE(gpsdata)->buffer = '\0';
         PRIVATE(gpsdata)->waiting = 0;
+        PRIVATE(gpsdata)->start = 0;
     } else {
-        memmove(PRIVATE(gpsdata)->buffer,
-                PRIVATE(gpsdata)->buffer + response_length,
-                PRIVATE(gpsdata)->waiting);
+        // the rest stays put until the next fill
+        PRIVATE(gpsdata)->start += response_length;
     }
     gpsdata->set |= PACKET_SET;
 
@@ -430,7 +490,7 @@ int gps_unpack(char *buf, struct gps_data_t *gpsdata)
 const char *gps_sock_data(const struct gps_data_t *gpsdata)
 {
     // no length data, so pretty useless...
-    return PRIVATE(gpsdata)->buffer;
+    return PRIVATE(gpsdata)->buffer + PRIVATE(gpsdata)->start;
 }
 
 /* send a command to the gpsd instance
@@ -265,7 +265,7 @@ socket_t netlib_localsocket(const char *sockfile, int socktype)
         saddr.sun_family = AF_UNIX;
         (void)strlcpy(saddr.sun_path, sockfile, sizeof(saddr.sun_path));
 
-        if (0 < connect(sock, (struct sockaddr *)&saddr, SUN_LEN(&saddr))) {
+        if (0 > connect(sock, (struct sockaddr *)&saddr, SUN_LEN(&saddr))) {
             (void)close(sock);
             return -2;
         }
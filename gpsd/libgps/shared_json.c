@@ -98,10 +98,41 @@ int json_watch_read(const char *buf,
     struct json_attr_t chanconfig_attrs[] = {
         {"class",          t_check,    .dflt.check = "WATCH"},
 
+        {"aisbox",         t_array,
+            .addr.array.element_type = t_real,
+            .addr.array.arr.reals.store = ccp->ais_box,
+            .addr.array.count = &ccp->ais_nbox,
+            .addr.array.maxlen = NITEMS(ccp->ais_box)},
+        {"aisexclude",     t_array,
+            .addr.array.element_type = t_uinteger,
+            .addr.array.arr.uintegers.store = ccp->ais_exclude,
+            .addr.array.count = &ccp->ais_nexclude,
+            .addr.array.maxlen = NITEMS(ccp->ais_exclude)},
+        {"aismmsi",        t_array,
+            .addr.array.element_type = t_uinteger,
+            .addr.array.arr.uintegers.store = ccp->ais_mmsi,
+            .addr.array.count = &ccp->ais_nmmsi,
+            .addr.array.maxlen = NITEMS(ccp->ais_mmsi)},
+        {"aispoly",        t_array,
+            .addr.array.element_type = t_real,
+            .addr.array.arr.reals.store = ccp->ais_poly,
+            .addr.array.count = &ccp->ais_npoly,
+            .addr.array.maxlen = NITEMS(ccp->ais_poly)},
+        {"aistypes",       t_array,
+            .addr.array.element_type = t_integer,
+            .addr.array.arr.integers.store = ccp->ais_types,
+            .addr.array.count = &ccp->ais_ntypes,
+            .addr.array.maxlen = NITEMS(ccp->ais_types)},
         {"device",         t_string,   .addr.string = ccp->devpath,
                                           .len = sizeof(ccp->devpath)},
         {"enable",         t_boolean,  .addr.boolean = &ccp->watcher,
                                           .dflt.boolean = true},
+        {"fastpvt",        t_boolean,  .addr.boolean = &ccp->fast_pvt},
+        {"fields",         t_string,   .addr.string = ccp->fields,
+                                          .len = sizeof(ccp->fields)},
+        {"gstinterval",    t_real,     .addr.real = &ccp->gst_interval},
+        {"imubatch",       t_integer,  .addr.integer = &ccp->imu_batch},
+        {"interval",       t_real,     .addr.real = &ccp->interval},
         {"json",           t_boolean,  .addr.boolean = &ccp->json,
                                           .nodefault = true},
         {"nmea",           t_boolean,  .addr.boolean = &ccp->nmea,
@@ -112,8 +143,11 @@ int json_watch_read(const char *buf,
         {"remote",         t_string,   .addr.string = ccp->remote,
                                           .len = sizeof(ccp->remote)},
         {"scaled",         t_boolean,  .addr.boolean = &ccp->scaled},
+        {"skydelta",       t_integer,  .addr.integer = &ccp->sky_delta},
+        {"skyinterval",    t_real,     .addr.real = &ccp->sky_interval},
         {"split24",        t_boolean,  .addr.boolean = &ccp->split24},
         {"timing",         t_boolean,  .addr.boolean = &ccp->timing},
+        {"tpvinterval",    t_real,     .addr.real = &ccp->tpv_interval},
         // ignore unknown keys, for cross-version compatibility
         {"", t_ignore},
         {NULL},
@@ -121,6 +155,12 @@ int json_watch_read(const char *buf,
     /* *INDENT-ON* */
     int status;
 
+    // arrays have no defaults, an AIS filter not given is none
+    ccp->ais_nbox = 0;
+    ccp->ais_npoly = 0;
+    ccp->ais_nmmsi = 0;
+    ccp->ais_nexclude = 0;
+    ccp->ais_ntypes = 0;
     status = json_read_object(buf, chanconfig_attrs, endptr);
     return status;
 }
@@ -0,0 +1,399 @@
+/* test harness for ?WATCH AIS filters
+ *
+ * AIS reports are run past filters by area, MMSI and message type, to
+ * check each passes just what it asks for, and that static data
+ * follows its ship into and out of an area.  Then a synthetic feed is
+ * fanned out to 100 watchers, each with its own part of the sea, for
+ * the time that costs with and without filters.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/gps_json.h"
+#include "../include/strfuncs.h"
+
+#define GRID            10              // GRID * GRID watchers
+#define REPORTS         20000           // in the synthetic feed
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// read a ?WATCH and compile its AIS filters
+static void watch(struct gps_policy_t *policy, struct ais_filter_t *filter,
+                  const char *request)
+{
+    const char *end;
+
+    (void)memset(policy, 0, sizeof(*policy));
+    if (0 != json_watch_read(request, policy, &end)) {
+        (void)printf("    unparsed: %s\n", request);
+    }
+    gpsd_ais_filter_init(filter, policy);
+}
+
+// a type 1 position report, in degrees
+static void position(struct ais_t *ais, unsigned int mmsi,
+                     double lat, double lon)
+{
+    (void)memset(ais, 0, sizeof(*ais));
+    ais->type = 1;
+    ais->mmsi = mmsi;
+    ais->type1.lat = (int)(lat * AIS_LATLON_DIV);
+    ais->type1.lon = (int)(lon * AIS_LATLON_DIV);
+    ais->type1.speed = AIS_SPEED_NOT_AVAILABLE;
+    ais->type1.course = AIS_COURSE_NOT_AVAILABLE;
+    ais->type1.heading = AIS_HEADING_NOT_AVAILABLE;
+}
+
+// a type 5 static and voyage report, with no position
+static void voyage(struct ais_t *ais, unsigned int mmsi)
+{
+    (void)memset(ais, 0, sizeof(*ais));
+    ais->type = 5;
+    ais->mmsi = mmsi;
+    (void)strlcpy(ais->type5.shipname, "TEST SHIP",
+                  sizeof(ais->type5.shipname));
+}
+
+static void area_test(void)
+{
+    struct gps_policy_t policy;
+    struct ais_filter_t filter;
+    struct ais_t ais;
+
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aisbox\":[40.0,-75.0,41.0,-73.0]}");
+    check(gpsd_ais_filtering(&policy), "?WATCH asks for a box");
+    position(&ais, 366000001, 40.5, -74.0);
+    check(gpsd_ais_filter(&filter, &policy, &ais), "a ship in the box passes");
+    voyage(&ais, 366000001);
+    check(gpsd_ais_filter(&filter, &policy, &ais),
+          "and so does its static data");
+    voyage(&ais, 366000002);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "but not that of a ship not seen there");
+    position(&ais, 366000001, 42.0, -74.0);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "a ship out of the box does not");
+    voyage(&ais, 366000001);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "nor, once it has left, its static data");
+    position(&ais, 366000001, AIS_LAT_NOT_AVAILABLE / AIS_LATLON_DIV,
+             AIS_LON_NOT_AVAILABLE / AIS_LATLON_DIV);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "nor one with no position");
+
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aisbox\":[-20.0,170.0,-10.0,-170.0]}");
+    position(&ais, 512000001, -15.0, 179.5);
+    check(gpsd_ais_filter(&filter, &policy, &ais),
+          "a box may cross the antimeridian");
+    position(&ais, 512000001, -15.0, -175.0);
+    check(gpsd_ais_filter(&filter, &policy, &ais), "on either side");
+    position(&ais, 512000001, -15.0, 160.0);
+    check(!gpsd_ais_filter(&filter, &policy, &ais), "but not beyond it");
+
+    // a triangle over the mouth of a harbour
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aispoly\":[51.0,1.0,52.0,1.0,51.0,2.0]}");
+    check(gpsd_ais_filtering(&policy), "?WATCH asks for a polygon");
+    position(&ais, 235000001, 51.2, 1.2);
+    check(gpsd_ais_filter(&filter, &policy, &ais),
+          "a ship in the polygon passes");
+    position(&ais, 235000001, 51.8, 1.8);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "one in its box, but not in it, does not");
+    memset(&ais, 0, sizeof(ais));
+    ais.type = 27;
+    ais.mmsi = 235000002;
+    ais.type27.lat = (int)(51.2 * AIS_LONGRANGE_LATLON_DIV);
+    ais.type27.lon = (int)(1.2 * AIS_LONGRANGE_LATLON_DIV);
+    check(gpsd_ais_filter(&filter, &policy, &ais),
+          "long range positions are scaled as such");
+
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aispoly\":[51.0,1.0,52.0,1.0]}");
+    check(!gpsd_ais_filtering(&policy), "two vertices are no area");
+    check(NULL != gpsd_ais_filter_check(&policy), "and are refused");
+}
+
+// areas that would filter nothing are refused
+static void check_test(void)
+{
+    static const char *bad[] = {
+        "\"aisbox\":[51.0,1.0,52.0]",
+        "\"aisbox\":[52.0,1.0,51.0,2.0]",
+        "\"aisbox\":[51.0,1.0,92.0,2.0]",
+        "\"aispoly\":[51.0,1.0,52.0,1.0,52.0]",
+        "\"aispoly\":[51.0,1.0,52.0,1.0,52.0,2.0,51.0]",
+        "\"aispoly\":[51.0,1.0,52.0,1.0,52.0,200.0]",
+    };
+    struct gps_policy_t policy;
+    char buf[GPS_JSON_RESPONSE_MAX];
+    const char *end;
+    size_t i;
+    bool refused = true;
+
+    for (i = 0; i < (size_t)NITEMS(bad); i++) {
+        (void)snprintf(buf, sizeof(buf),
+                       "{\"class\":\"WATCH\",\"json\":true,%s}", bad[i]);
+        (void)memset(&policy, 0, sizeof(policy));
+        if (0 != json_watch_read(buf, &policy, &end) ||
+            NULL == gpsd_ais_filter_check(&policy)) {
+            (void)printf("    not refused: %s\n", buf);
+            refused = false;
+        }
+    }
+    check(refused, "malformed aisbox and aispoly are refused");
+
+    (void)memset(&policy, 0, sizeof(policy));
+    (void)json_watch_read("{\"class\":\"WATCH\",\"json\":true,"
+                          "\"aisbox\":[51.0,179.0,52.0,-179.0],"
+                          "\"aispoly\":[51.0,1.0,52.0,1.0,52.0,2.0]}",
+                          &policy, &end);
+    check(NULL == gpsd_ais_filter_check(&policy),
+          "well formed ones are not, a box across 180 degrees too");
+}
+
+static void mmsi_test(void)
+{
+    struct gps_policy_t policy;
+    struct ais_filter_t filter;
+    struct ais_t ais;
+    char request[GPS_JSON_RESPONSE_MAX];
+    unsigned int mmsi;
+    bool all = true, none = false;
+
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aismmsi\":[244000001,244000002]}");
+    position(&ais, 244000002, 52.0, 4.0);
+    check(gpsd_ais_filter(&filter, &policy, &ais),
+          "an MMSI listed passes");
+    position(&ais, 244000003, 52.0, 4.0);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "one not listed does not");
+
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aisexclude\":[244000001]}");
+    position(&ais, 244000001, 52.0, 4.0);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "an MMSI excluded does not pass");
+    position(&ais, 244000002, 52.0, 4.0);
+    check(gpsd_ais_filter(&filter, &policy, &ais), "others do");
+
+    // a full list, probed with MMSIs that hash alike
+    (void)strlcpy(request, "{\"class\":\"WATCH\",\"aismmsi\":[",
+                  sizeof(request));
+    for (mmsi = 0; mmsi < GPS_AIS_MMSI_MAX; mmsi++) {
+        str_appendf(request, sizeof(request), "%u,",
+                    200000000 + mmsi * 65536);
+    }
+    str_rstrip_char(request, ',');
+    (void)strlcat(request, "]}", sizeof(request));
+    watch(&policy, &filter, request);
+    check(GPS_AIS_MMSI_MAX == policy.ais_nmmsi, "a full MMSI list is read");
+    for (mmsi = 0; mmsi < GPS_AIS_MMSI_MAX * 2; mmsi++) {
+        position(&ais, 200000000 + mmsi * 65536, 0.0, 0.0);
+        if (mmsi < GPS_AIS_MMSI_MAX) {
+            all = all && gpsd_ais_filter(&filter, &policy, &ais);
+        } else {
+            none = none || gpsd_ais_filter(&filter, &policy, &ais);
+        }
+    }
+    check(all && !none, "and passes every MMSI in it, and no others");
+}
+
+static void type_test(void)
+{
+    struct gps_policy_t policy;
+    struct ais_filter_t filter;
+    struct ais_t ais;
+
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aistypes\":[5,24]}");
+    voyage(&ais, 244000001);
+    check(gpsd_ais_filter(&filter, &policy, &ais), "a type listed passes");
+    position(&ais, 244000001, 52.0, 4.0);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "one not listed does not");
+
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aistypes\":[0,40]}");
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "types that are none pass nothing");
+
+    // all of them at once
+    watch(&policy, &filter, "{\"class\":\"WATCH\",\"json\":true,"
+                            "\"aisbox\":[50.0,3.0,54.0,5.0],"
+                            "\"aisexclude\":[244000009],"
+                            "\"aistypes\":[1,2,3]}");
+    position(&ais, 244000001, 52.0, 4.0);
+    check(gpsd_ais_filter(&filter, &policy, &ais),
+          "a report passing every filter passes");
+    position(&ais, 244000009, 52.0, 4.0);
+    check(!gpsd_ais_filter(&filter, &policy, &ais),
+          "one failing any does not");
+}
+
+static void watch_test(void)
+{
+    struct gps_policy_t ccp;
+    char buf[GPS_JSON_RESPONSE_MAX];
+    const char *end;
+    int status;
+
+    (void)memset(&ccp, 0, sizeof(ccp));
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true,"
+                             "\"aisbox\":[40.5,-74.5,41.0,-73.5],"
+                             "\"aismmsi\":[366000001],"
+                             "\"aistypes\":[1,5]}", &ccp, &end);
+    check(0 == status && 4 == ccp.ais_nbox && 1 == ccp.ais_nmmsi &&
+          2 == ccp.ais_ntypes, "?WATCH reads AIS filters");
+    json_watch_dump(&ccp, buf, sizeof(buf));
+    check(NULL != strstr(buf, ",\"aisbox\":[40.500000,-74.500000,"
+                              "41.000000,-73.500000],"
+                              "\"aismmsi\":[366000001],"
+                              "\"aistypes\":[1,5]}"),
+          "WATCH reports them");
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true}",
+                             &ccp, &end);
+    json_watch_dump(&ccp, buf, sizeof(buf));
+    check(0 == status && !gpsd_ais_filtering(&ccp) &&
+          NULL == strstr(buf, "ais"),
+          "and resets them like the other options");
+}
+
+/* a feed of ships spread over GRID * GRID cells, fanned out to a
+ * watcher per cell, and to as many with no filters */
+static void fanout_test(void)
+{
+    static struct gps_policy_t policy[GRID * GRID];
+    static struct ais_filter_t filter[GRID * GRID];
+    static struct ais_t feed[REPORTS];
+    char request[GPS_JSON_RESPONSE_MAX];
+    char buf[GPS_JSON_RESPONSE_MAX];
+    unsigned long all_bytes = 0, filtered_bytes = 0;
+    timespec_t start, stop;
+    double all_us, filtered_us;
+    int missed = 0;
+    bool one = true;
+    int i, w;
+
+    for (w = 0; w < GRID * GRID; w++) {
+        (void)snprintf(request, sizeof(request),
+                       "{\"class\":\"WATCH\",\"json\":true,"
+                       "\"aisbox\":[%d.0,%d.0,%d.0,%d.0]}",
+                       50 + w / GRID, w % GRID, 51 + w / GRID, 1 + w % GRID);
+        watch(&policy[w], &filter[w], request);
+    }
+    srand(2947);
+    for (i = 0; i < REPORTS; i++) {
+        unsigned int mmsi = 200000000 + (unsigned)(i % 1000);
+
+        if (0 == i % 5 &&
+            1000 <= i) {
+            voyage(&feed[i], mmsi);
+        } else {
+            // each ship stays in the cell it starts in
+            position(&feed[i], mmsi,
+                     50.0 + mmsi % GRID + rand() / (RAND_MAX + 1.0),
+                     mmsi / GRID % GRID + rand() / (RAND_MAX + 1.0));
+        }
+    }
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < REPORTS; i++) {
+        for (w = 0; w < GRID * GRID; w++) {
+            json_aivdm_dump(&feed[i], "/dev/test", false, buf, sizeof(buf));
+            all_bytes += strlen(buf);
+        }
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+    all_us = TS_SUB_D(&stop, &start) * 1e6 / REPORTS;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < REPORTS; i++) {
+        int passed = 0;
+
+        for (w = 0; w < GRID * GRID; w++) {
+            if (gpsd_ais_filter(&filter[w], &policy[w], &feed[i])) {
+                json_aivdm_dump(&feed[i], "/dev/test", false,
+                                buf, sizeof(buf));
+                filtered_bytes += strlen(buf);
+                passed++;
+            }
+        }
+        if (1 != feed[i].type &&
+            0 == passed) {
+            /* the static data of a ship whose slot in its watcher's
+             * table another ship there has taken */
+            missed++;
+        }
+        one = one && (1 == feed[i].type ? 1 == passed : 1 >= passed);
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+    filtered_us = TS_SUB_D(&stop, &start) * 1e6 / REPORTS;
+
+    if (!quiet) {
+        (void)printf("    %d watchers a report: unfiltered %lu bytes "
+                     "%.1f us, filtered %lu bytes %.1f us, "
+                     "%d static reports missed\n",
+                     GRID * GRID, all_bytes / REPORTS, all_us,
+                     filtered_bytes / REPORTS, filtered_us, missed);
+    }
+    check(one, "each report goes to the one watcher of its cell, if any");
+    check(missed * 100 < REPORTS / 5,
+          "and no more than 1% of static reports to none");
+    check(filtered_us * 5 < all_us,
+          "watchers a report is not for cost next to nothing");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_aisfilter [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    area_test();
+    check_test();
+    mmsi_test();
+    type_test();
+    watch_test();
+    fanout_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("aisfilter: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
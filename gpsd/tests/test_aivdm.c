@@ -0,0 +1,305 @@
+/* test harness and throughput benchmark for AIVDM de-armoring
+ *
+ * Without arguments, check aivdm_dearmor() against a bit-at-a-time
+ * reference decoder at every starting bit offset.
+ *
+ * With -b, time de-armoring and full AIVDM decoding over the named
+ * files, e.g.:
+ *     tests/test_aivdm -b test/sample.aivdm \
+ *         contrib/ais-samples/ais-nmea-sample.log
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/bits.h"
+#include "../include/gpsd.h"
+#include "../include/strfuncs.h"
+#include "../include/timespec.h"
+
+#define MAXBITS 2048
+
+static bool quiet = false;
+
+// the old bit-serial de-armoring loop, kept as the reference
+static bool dearmor_reference(unsigned char *bits, size_t *bitlen,
+                              size_t maxbits, const unsigned char *data,
+                              size_t len)
+{
+    size_t n;
+    int i;
+
+    if (*bitlen + 6 * len > maxbits) {
+        return false;
+    }
+    for (n = 0; n < len; n++) {
+        unsigned char ch = data[n] - 48;
+
+        if (ch >= 40) {
+            ch -= 8;
+        }
+        for (i = 5; i >= 0; i--) {
+            if ((ch >> i) & 0x01) {
+                bits[*bitlen / 8] |= (1 << (7 - *bitlen % 8));
+            }
+            (*bitlen)++;
+        }
+    }
+    return true;
+}
+
+static int dearmor_test(void)
+{
+    // every legal armoring character, plus a few illegal ones
+    static const char armor[] =
+        "0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVW`abcdefghijklmnopqrstuvw"
+        "XYZ ~";
+    unsigned char data[100];
+    unsigned char got[BITS_TO_BYTES(MAXBITS)];
+    unsigned char want[BITS_TO_BYTES(MAXBITS)];
+    size_t offset, len, n;
+    int failures = 0;
+
+    for (n = 0; n < sizeof(data); n++) {
+        data[n] = (unsigned char)armor[(n * 7) % (sizeof(armor) - 1)];
+    }
+
+    for (offset = 0; offset < 24; offset++) {
+        for (len = 0; len <= sizeof(data); len++) {
+            size_t gotlen = offset, wantlen = offset;
+
+            memset(got, 0, sizeof(got));
+            memset(want, 0, sizeof(want));
+            // leading bits that must survive the append
+            for (n = 0; n < offset; n += 2) {
+                got[n / 8] |= 1 << (7 - n % 8);
+                want[n / 8] |= 1 << (7 - n % 8);
+            }
+            if (!aivdm_dearmor(got, &gotlen, MAXBITS, data, len) ||
+                !dearmor_reference(want, &wantlen, MAXBITS, data, len)) {
+                (void)printf("offset %zu, %zu chars: append refused\n",
+                             offset, len);
+                failures++;
+            } else if (gotlen != wantlen ||
+                       0 != memcmp(got, want, sizeof(got))) {
+                (void)printf("offset %zu, %zu chars: mismatch\n",
+                             offset, len);
+                failures++;
+            }
+        }
+    }
+
+    // refuse, and leave untouched, a payload that would overflow
+    {
+        size_t gotlen = MAXBITS - 5;
+
+        memset(got, 0, sizeof(got));
+        if (aivdm_dearmor(got, &gotlen, MAXBITS, data, 1) ||
+            MAXBITS - 5 != gotlen) {
+            (void)printf("overflow not refused\n");
+            failures++;
+        }
+    }
+
+    if (!quiet) {
+        (void)printf("AIVDM de-armoring: %d failures\n", failures);
+    }
+    return failures;
+}
+
+static double elapsed(const struct timespec *start)
+{
+    struct timespec now, delta;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    TS_SUB(&delta, &now, start);
+    return TSTONS(&delta);
+}
+
+// de-armor just the payload fields of every AIVDM/AIVDO sentence
+static void bench_dearmor(const char *path, char *text, int passes)
+{
+    static unsigned char bits[BITS_TO_BYTES(MAXBITS)];
+    static const unsigned char *payload[200000];
+    static size_t paylen[200000];
+    size_t npayloads = 0, nchars = 0, n;
+    struct timespec start;
+    double secs;
+    char *line, *saveptr = NULL;
+    int pass;
+
+    for (line = strtok_r(text, "\n", &saveptr);
+         NULL != line && npayloads < sizeof(paylen) / sizeof(paylen[0]);
+         line = strtok_r(NULL, "\n", &saveptr)) {
+        char *field = line;
+        int commas;
+
+        if (!str_starts_with(line, "!AIVD")) {
+            continue;
+        }
+        for (commas = 0; commas < 5 && NULL != field; commas++) {
+            field = strchr(field, ',');
+            if (NULL != field) {
+                field++;
+            }
+        }
+        if (NULL == field) {
+            continue;
+        }
+        payload[npayloads] = (unsigned char *)field;
+        paylen[npayloads] = strcspn(field, ",*");
+        nchars += paylen[npayloads];
+        npayloads++;
+    }
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (pass = 0; pass < passes; pass++) {
+        for (n = 0; n < npayloads; n++) {
+            size_t bitlen = 0;
+
+            // as aivdm_decode() does, wipe only what was used
+            (void)aivdm_dearmor(bits, &bitlen, MAXBITS,
+                                payload[n], paylen[n]);
+            memset(bits, 0, BITS_TO_BYTES(bitlen));
+        }
+    }
+    secs = elapsed(&start);
+    (void)printf("%s: de-armor %zu payloads, %zu chars x %d: "
+                 "%.0f payloads/s, %.1f Mchars/s\n",
+                 path, npayloads, nchars, passes,
+                 npayloads * (double)passes / secs,
+                 nchars * (double)passes / secs / 1e6);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (pass = 0; pass < passes; pass++) {
+        for (n = 0; n < npayloads; n++) {
+            size_t bitlen = 0;
+
+            (void)dearmor_reference(bits, &bitlen, MAXBITS,
+                                    payload[n], paylen[n]);
+            memset(bits, 0, sizeof(bits));
+        }
+    }
+    secs = elapsed(&start);
+    (void)printf("%s: bit-serial reference: "
+                 "%.0f payloads/s, %.1f Mchars/s\n",
+                 path, npayloads * (double)passes / secs,
+                 nchars * (double)passes / secs / 1e6);
+}
+
+// the whole lexer and driver path, as gpsdecode runs it
+static void bench_decode(const char *path, int fd, int passes)
+{
+    static struct gps_context_t context;
+    static struct gps_device_t session;
+    unsigned long sentences = 0, reports = 0;
+    struct timespec start;
+    double secs;
+    int pass;
+
+    gpsd_time_init(&context, time(NULL));
+    context.readonly = true;
+    context.errout.debug = LOG_ERROR;
+    gpsd_init(&session, &context, NULL);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (pass = 0; pass < passes; pass++) {
+        (void)lseek(fd, 0, SEEK_SET);
+        gpsd_clear(&session);
+        session.gpsdata.gps_fd = fd;
+        for (;;) {
+            gps_mask_t changed = gpsd_poll(&session);
+
+            if (ERROR_SET == changed ||
+                NODATA_IS == changed) {
+                break;
+            }
+            if (AIVDM_PACKET == session.lexer.type) {
+                sentences++;
+            }
+            if (0 != (changed & AIS_SET)) {
+                reports++;
+            }
+        }
+    }
+    secs = elapsed(&start);
+    (void)printf("%s: decode %lu sentences, %lu AIS reports: "
+                 "%.0f sentences/s\n",
+                 path, sentences, reports, sentences / secs);
+}
+
+static int benchmark(int passes, int nfiles, char *files[])
+{
+    int i;
+
+    for (i = 0; i < nfiles; i++) {
+        struct stat sb;
+        char *text;
+        int fd = open(files[i], O_RDONLY);
+
+        if (0 > fd ||
+            0 != fstat(fd, &sb)) {
+            (void)fprintf(stderr, "test_aivdm: %s: %s\n",
+                          files[i], strerror(errno));
+            return EXIT_FAILURE;
+        }
+        text = malloc((size_t)sb.st_size + 1);
+        if (NULL == text ||
+            sb.st_size != read(fd, text, (size_t)sb.st_size)) {
+            (void)fprintf(stderr, "test_aivdm: %s: read failed\n",
+                          files[i]);
+            free(text);
+            (void)close(fd);
+            return EXIT_FAILURE;
+        }
+        text[sb.st_size] = '\0';
+
+        bench_dearmor(files[i], text, passes);
+        bench_decode(files[i], fd, passes);
+        free(text);
+        (void)close(fd);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    int option, passes = 10;
+    bool bench = false;
+
+    while ((option = getopt(argc, argv, "bn:q")) != -1) {
+        switch (option) {
+        case 'b':
+            bench = true;
+            break;
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_aivdm [-q] [-b [-n passes] file...]\n",
+                        stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (bench) {
+        exit(benchmark(passes, argc - optind, argv + optind));
+    }
+    exit(0 < dearmor_test() ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
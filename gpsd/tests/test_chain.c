@@ -0,0 +1,452 @@
+/* test harness for chain.c, and the JSON emitters that write into it
+ *
+ * Checks what the segment chains take and give back, then emits a
+ * maximal RAW epoch, MAXCHANNELS signals with every field, and a full
+ * skyview, sees them whole where a fixed buffer cut them short, sent
+ * with writev() and read back by libgps, sent to a SOCK_SEQPACKET
+ * socket a JSON object to a message, and times them.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/gps_json.h"
+
+#define EPOCHS          2000            // maximal epochs to time
+
+static bool quiet = false;
+static int failures = 0;
+
+static struct gps_context_t context;
+static struct gps_device_t session;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// the bytes of chain, flattened, in a buffer to be freed
+static char *flatten(const struct gps_chain_t *chain)
+{
+    char *buf = malloc(chain->len + 1);
+
+    if (NULL != buf) {
+        (void)gpsd_chain_copy(chain, buf, chain->len + 1);
+    }
+    return buf;
+}
+
+// times needle is in haystack
+static int count(const char *haystack, const char *needle)
+{
+    int n = 0;
+
+    while (NULL != (haystack = strstr(haystack, needle))) {
+        n++;
+        haystack++;
+    }
+    return n;
+}
+
+static void chain_test(void)
+{
+    static char big[CHAIN_SEGMENT * 2 + 100];
+    struct gps_chain_t chain;
+    char buf[64], *room, *flat;
+    int pooled;
+
+    gpsd_chain_init(&chain);
+    check(0 == chain.len && 0 == chain.nsegs &&
+          '\0' == gpsd_chain_last(&chain),
+          "a new chain is empty");
+    gpsd_chain_puts(&chain, "{\"a\":");
+    gpsd_chain_appendf(&chain, "%d,", 42);
+    gpsd_chain_rstrip(&chain, ',');
+    gpsd_chain_rstrip(&chain, ',');
+    gpsd_chain_puts(&chain, "}");
+    check(8 == chain.len && 1 == chain.nsegs, "pieces append, one segment");
+    check(8 == gpsd_chain_copy(&chain, buf, sizeof(buf)) &&
+          0 == strcmp(buf, "{\"a\":42}"),
+          "and copy out in order, one trailing comma stripped");
+    check(3 == gpsd_chain_copy(&chain, buf, 4) &&
+          0 == strcmp(buf, "{\"a"),
+          "a copy to a small buffer is cut short, as the fixed ones were");
+
+    room = gpsd_chain_reserve(&chain, CHAIN_SEGMENT - 4);
+    check(NULL != room && '\0' == room[0] && 2 == chain.nsegs,
+          "a reserve that does not fit the tail starts a segment");
+    (void)strlcpy(room, "[1]", CHAIN_SEGMENT - 4);
+    gpsd_chain_commit(&chain, 3);
+    check(11 == chain.len, "and what is committed of it is kept");
+    check(NULL == gpsd_chain_reserve(&chain, CHAIN_SEGMENT + 1),
+          "no reserve is bigger than a segment");
+
+    (void)memset(big, 'x', sizeof(big) - 1);
+    gpsd_chain_appendf(&chain, "<%s>", big);
+    check(11 + sizeof(big) + 1 == chain.len && 4 == chain.nsegs,
+          "printf output longer than a segment spans segments");
+    flat = flatten(&chain);
+    check(NULL != flat &&
+          0 == strncmp(flat, "{\"a\":42}[1]<xxx", 15) &&
+          '>' == flat[chain.len - 1] &&
+          'x' == flat[chain.len - 2],
+          "whole, and in order");
+    free(flat);
+
+    pooled = gpsd_chain_pooled();
+    gpsd_chain_release(&chain);
+    check(0 == chain.len && NULL == chain.head &&
+          gpsd_chain_pooled() > pooled,
+          "a released chain is empty, its segments pooled");
+    pooled = gpsd_chain_pooled();
+    gpsd_chain_appendf(&chain, "%s", big);
+    check(gpsd_chain_pooled() < pooled, "and taken again from the pool");
+    gpsd_chain_release(&chain);
+}
+
+// a RAW epoch as long as one can be: every signal, every field
+static void maximal_raw(struct gps_data_t *gpsdata)
+{
+    int i;
+
+    gpsdata->raw.mtime.tv_sec = 1634567890;
+    gpsdata->raw.mtime.tv_nsec = 999000000;
+    for (i = 0; i < MAXCHANNELS; i++) {
+        struct meas_t *meas = &gpsdata->raw.meas[i];
+
+        meas->gnssid = i % 2 ? GNSSID_GLO : GNSSID_GAL;
+        meas->svid = 100 + i % 100;
+        meas->sigid = 1 + i % 7;
+        meas->freqid = 13;
+        meas->snr = 255;
+        (void)strlcpy(meas->obs_code, "L2C", sizeof(meas->obs_code));
+        meas->lli = 3;
+        meas->locktime = LOCKMAX;
+        meas->pseudorange = 25999999.987654 + i;
+        meas->carrierphase = -136999999.987654 - i;
+        meas->doppler = -9999.987654;
+        meas->c2c = 25999999.987654 + i;
+        meas->l2c = -106999999.987654 - i;
+    }
+}
+
+// and a skyview as full as one can be
+static void maximal_sky(struct gps_data_t *gpsdata)
+{
+    int i;
+
+    gpsdata->skyview_time.tv_sec = 1634567890;
+    gpsdata->satellites_visible = MAXCHANNELS;
+    for (i = 0; i < MAXCHANNELS; i++) {
+        struct satellite_t *sp = &gpsdata->skyview[i];
+
+        sp->PRN = 1 + i;
+        sp->elevation = -89.9;
+        sp->azimuth = 359.0;
+        sp->ss = 99.9;
+        sp->used = true;
+        sp->gnssid = GNSSID_GLO;
+        sp->svid = 1 + i;
+        sp->sigid = 1 + i % 7;
+        sp->freqid = 13;
+        sp->health = SAT_HEALTH_BAD;
+    }
+    gpsdata->set |= SATELLITE_SET;
+}
+
+static void raw_test(void)
+{
+    static struct gps_data_t back;
+    static char fixed[GPS_JSON_RESPONSE_MAX];
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    char *flat, *line;
+    int sv[2], i, status;
+    ssize_t sent, got = 0;
+    bool same = true;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    maximal_raw(&session.gpsdata);
+    gpsd_chain_init(&chain);
+    json_data_emit(RAW_IS, &session, &policy, &chain);
+    flat = flatten(&chain);
+    if (NULL == flat) {
+        (void)printf("FAILED: out of memory\n");
+        failures++;
+        return;
+    }
+    if (!quiet) {
+        (void)printf("    a maximal RAW epoch is %zu bytes, in %d segments\n",
+                     chain.len, chain.nsegs);
+    }
+    check(sizeof(fixed) < chain.len,
+          "a maximal RAW epoch is longer than GPS_JSON_RESPONSE_MAX");
+    check(MAXCHANNELS == count(flat, "{\"gnssid\":") &&
+          MAXCHANNELS == count(flat, "\"l2c\":") &&
+          0 == strncmp(flat, "{\"class\":\"RAW\"", 14) &&
+          0 == strcmp(flat + chain.len - 4, "]}\r\n") &&
+          1 == count(flat, "\n"),
+          "and is emitted whole, every signal, one line");
+    json_raw_dump(&session.gpsdata, fixed, sizeof(fixed));
+    check(sizeof(fixed) - 1 == strlen(fixed) &&
+          0 == strncmp(flat, fixed, sizeof(fixed) - 1),
+          "a fixed buffer gets it cut short, as before");
+
+    if (0 > socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+        (void)printf("FAILED: socketpair: %s\n", strerror(errno));
+        failures++;
+        free(flat);
+        gpsd_chain_release(&chain);
+        return;
+    }
+    i = (int)(chain.len * 2);
+    (void)setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &i, sizeof(i));
+    (void)setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &i, sizeof(i));
+    sent = gpsd_chain_write(&chain, sv[0], (const unsigned char *)"> ", 2);
+    check((ssize_t)chain.len + 2 == sent,
+          "it goes out in one writev(), header and all");
+    line = malloc(chain.len + 3);
+    while (NULL != line &&
+           got < sent) {
+        ssize_t n = read(sv[1], line + got, (size_t)(sent - got));
+
+        if (0 >= n) {
+            break;
+        }
+        got += n;
+    }
+    check(NULL != line && sent == got &&
+          0 == memcmp(line, "> ", 2) &&
+          0 == memcmp(line + 2, flat, chain.len),
+          "and is read back byte for byte");
+    (void)close(sv[0]);
+    (void)close(sv[1]);
+
+    status = libgps_json_unpack(flat, &back, NULL);
+    for (i = 0; i < MAXCHANNELS; i++) {
+        const struct meas_t *want = &session.gpsdata.raw.meas[i];
+        const struct meas_t *have = &back.raw.meas[i];
+
+        same &= want->svid == have->svid &&
+                want->sigid == have->sigid &&
+                1e-6 > fabs(want->pseudorange - have->pseudorange) &&
+                1e-6 > fabs(want->l2c - have->l2c);
+    }
+    check(0 == status && 0 != (back.set & RAW_SET) && same,
+          "libgps reads back every measurement");
+    free(line);
+    free(flat);
+    gpsd_chain_release(&chain);
+}
+
+static void sky_test(void)
+{
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    char *flat;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    maximal_sky(&session.gpsdata);
+    gpsd_chain_init(&chain);
+    json_data_emit(SATELLITE_SET, &session, &policy, &chain);
+    flat = flatten(&chain);
+    check(NULL != flat &&
+          GPS_JSON_RESPONSE_MAX < chain.len &&
+          MAXCHANNELS == count(flat, "{\"PRN\":") &&
+          NULL != strstr(flat, "\"nSat\":140,\"uSat\":140,") &&
+          0 == strcmp(flat + chain.len - 5, "}]}\r\n"),
+          "a full skyview is longer than GPS_JSON_RESPONSE_MAX, and "
+          "emitted whole");
+    free(flat);
+    gpsd_chain_release(&chain);
+}
+
+/* a RAW epoch, a skyview and another epoch, in one chain, go to a
+ * SOCK_SEQPACKET socket a JSON object to a message, each whole where
+ * it spans segments */
+static void seqpacket_test(void)
+{
+    static struct gps_data_t back;
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    char *flat, *msg;
+    size_t off = 0;
+    ssize_t sent, n;
+    int sv[2], e, msgs = 0;
+    bool whole = true;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    maximal_raw(&session.gpsdata);
+    maximal_sky(&session.gpsdata);
+    gpsd_chain_init(&chain);
+    json_data_emit(RAW_IS, &session, &policy, &chain);
+    json_data_emit(SATELLITE_SET, &session, &policy, &chain);
+    json_data_emit(RAW_IS, &session, &policy, &chain);
+    flat = flatten(&chain);
+    msg = malloc(chain.len + 1);
+    if (NULL == flat ||
+        NULL == msg) {
+        (void)printf("FAILED: out of memory\n");
+        failures++;
+        free(flat);
+        free(msg);
+        gpsd_chain_release(&chain);
+        return;
+    }
+    check(3 == count(flat, "\n") &&
+          GPS_JSON_RESPONSE_MAX * 2 < chain.len &&
+          2 < chain.nsegs,
+          "three reports, longer than a libgps buffer, over segments");
+
+    if (0 > socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv)) {
+        (void)printf("FAILED: socketpair: %s\n", strerror(errno));
+        failures++;
+        free(flat);
+        free(msg);
+        gpsd_chain_release(&chain);
+        return;
+    }
+    e = (int)(chain.len * 4);
+    (void)setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &e, sizeof(e));
+    (void)setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &e, sizeof(e));
+    sent = gpsd_chain_write_lines(&chain, sv[0]);
+    check((ssize_t)chain.len == sent, "it all goes out");
+    (void)close(sv[0]);
+
+    while (0 < (n = recv(sv[1], msg, chain.len + 1, MSG_TRUNC))) {
+        msgs++;
+        if ((size_t)n > chain.len - off ||
+            '\n' != msg[n - 1] ||
+            NULL != memchr(msg, '\n', (size_t)n - 1) ||
+            0 != memcmp(msg, flat + off, (size_t)n)) {
+            whole = false;
+            break;
+        }
+        msg[n] = '\0';
+        if (0 != libgps_json_unpack(msg, &back, NULL)) {
+            whole = false;
+        }
+        off += (size_t)n;
+    }
+    (void)close(sv[1]);
+    check(3 == msgs && whole && chain.len == off,
+          "read back one whole JSON object a message");
+
+    free(msg);
+    free(flat);
+    gpsd_chain_release(&chain);
+}
+
+/* emit maximal epochs, RAW, SKY and TPV, and write them to a socket
+ * drained as it goes; time it and count mallocs the pool saved */
+static void bench(void)
+{
+    struct gps_policy_t policy;
+    timespec_t start, stop;
+    unsigned long bytes = 0;
+    double cpu;
+    char sink[65536];
+    int sv[2], e, pooled;
+    bool ok = true;
+
+    if (0 > socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+        (void)printf("FAILED: socketpair: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    e = 1 << 20;
+    (void)setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &e, sizeof(e));
+    (void)setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &e, sizeof(e));
+    (void)memset(&policy, 0, sizeof(policy));
+    session.gpsdata.fix.mode = MODE_3D;
+    session.gpsdata.fix.latitude = 44.068978;
+    session.gpsdata.fix.longitude = -121.314237;
+
+    pooled = gpsd_chain_pooled();
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (e = 0; e < EPOCHS; e++) {
+        struct gps_chain_t chain;
+        ssize_t sent;
+
+        gpsd_chain_init(&chain);
+        json_data_emit(REPORT_IS | SATELLITE_SET | RAW_IS, &session,
+                       &policy, &chain);
+        sent = gpsd_chain_write(&chain, sv[0], NULL, 0);
+        ok &= (ssize_t)chain.len == sent &&
+              GPS_JSON_RESPONSE_MAX * 4 < chain.len;
+        bytes += chain.len;
+        gpsd_chain_release(&chain);
+        while (0 < sent) {
+            ssize_t n = read(sv[1], sink, sizeof(sink));
+
+            if (0 >= n) {
+                break;
+            }
+            sent -= n;
+        }
+    }
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    cpu = TS_SUB_D(&stop, &start);
+    check(ok, "maximal epochs, longer than the old 4 * "
+          "GPS_JSON_RESPONSE_MAX buffer, are written whole");
+    check(gpsd_chain_pooled() == pooled,
+          "and its segments come back to the pool, none left behind");
+    if (!quiet) {
+        (void)printf("    maximal epochs: %lu bytes each, CPU %.1f us an "
+                     "epoch, emit and writev(), %.0f MB/s\n",
+                     bytes / EPOCHS, cpu * 1e6 / EPOCHS,
+                     bytes / cpu / 1e6);
+    }
+    (void)close(sv[0]);
+    (void)close(sv[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_chain [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    gps_context_init(&context, "test_chain");
+    gpsd_init(&session, &context, "/dev/ttyACM0");
+    gpsd_clear(&session);
+
+    chain_test();
+    raw_test();
+    sky_test();
+    seqpacket_test();
+    bench();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("chain: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,292 @@
+/* test harness for per-watcher decimation
+ *
+ * A 20 Hz receiver is played through gpsd_decimate() for watchers
+ * asking for fewer reports, to check each gets one per interval, and
+ * that it is the one at the top of the interval, sent by the fast PVT
+ * lane or at the end of the cycle.  Then the bytes
+ * serialized for a mixed population of watchers are counted, with and
+ * without decimation.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/gps_json.h"
+
+#define START           1632218400      // 2021-09-21T10:00:00Z
+#define HZ              20              // epochs a second
+#define EPOCH_NS        (NS_IN_SEC / HZ)
+
+static bool quiet = false;
+static int failures = 0;
+
+static struct gps_context_t context;
+static struct gps_device_t session;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// set up the receiver's report for epoch n, counted from START
+static void epoch(long n)
+{
+    timespec_t ts;
+
+    ts.tv_sec = START + n / HZ;
+    ts.tv_nsec = (n % HZ) * EPOCH_NS;
+    session.gpsdata.fix.time = ts;
+    session.gpsdata.skyview_time = ts;
+    session.gpsdata.gst.utctime = ts;
+    session.gpsdata.fix.mode = MODE_3D;
+    session.lexer.pkt_time = ts;
+}
+
+static void rate_test(void)
+{
+    struct gps_policy_t policy;
+    long long slot[DECIMATE_CLASSES];
+    int tpv = 0, sky = 0, gst = 0;
+    bool tops = true;
+    long n;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    (void)memset(slot, 0, sizeof(slot));
+    policy.tpv_interval = 1.0;
+    policy.sky_interval = 10.0;
+    // 30 seconds of 20 Hz
+    for (n = 0; n < 30 * HZ; n++) {
+        gps_mask_t report;
+
+        epoch(n);
+        report = gpsd_decimate(&policy, &session,
+                               REPORT_IS | SATELLITE_SET | GST_SET, slot);
+        if (0 != (report & REPORT_IS)) {
+            tpv++;
+            tops &= 0 == session.gpsdata.fix.time.tv_nsec;
+        }
+        if (0 != (report & SATELLITE_SET)) {
+            sky++;
+            tops &= 0 == session.gpsdata.skyview_time.tv_sec % 10;
+        }
+        if (0 != (report & GST_SET)) {
+            gst++;
+        }
+    }
+    check(30 == tpv, "TPV at 1 Hz");
+    check(3 == sky, "SKY every 10 s");
+    check(30 * HZ == gst, "GST, with no interval, every time");
+    check(tops, "each the report at the top of its interval");
+}
+
+static void align_test(void)
+{
+    struct gps_policy_t policy;
+    long long slot[DECIMATE_CLASSES];
+    long sent[4];
+    int nsent = 0;
+    long n;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    (void)memset(slot, 0, sizeof(slot));
+    policy.interval = 1.0;
+    // a watcher arriving at 0.35 s
+    for (n = 7; n < 3 * HZ + 7 && 4 > nsent; n++) {
+        epoch(n);
+        if (0 != (gpsd_decimate(&policy, &session, REPORT_IS, slot) &
+                  REPORT_IS)) {
+            sent[nsent++] = n;
+        }
+    }
+    check(4 == nsent && 7 == sent[0] && HZ == sent[1] &&
+          2 * HZ == sent[2] && 3 * HZ == sent[3],
+          "a late joiner gets a fix now, then the top of each second");
+
+    // a receiver time step backwards starts a new slot
+    epoch(HZ);
+    check(0 != (gpsd_decimate(&policy, &session, REPORT_IS, slot) &
+                REPORT_IS),
+          "time stepping back is a new slot");
+}
+
+/* the fast PVT lane's TPV, from newdata ahead of the cycle, takes the
+ * slot, so the cycle's TPV of the same fix does not go too */
+static void pvt_test(void)
+{
+    struct gps_policy_t policy;
+    long long slot[DECIMATE_CLASSES];
+    int fast = 0, late = 0;
+    bool tops = true;
+    long n;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    (void)memset(slot, 0, sizeof(slot));
+    policy.tpv_interval = 1.0;
+    for (n = 0; n < 30 * HZ; n++) {
+        epoch(n);
+        session.newdata.time = session.gpsdata.fix.time;
+        if (gpsd_decimate_pvt(&policy, &session, slot)) {
+            fast++;
+            tops &= 0 == session.newdata.time.tv_nsec;
+        }
+        if (0 != (gpsd_decimate(&policy, &session, REPORT_IS, slot) &
+                  REPORT_IS)) {
+            late++;
+        }
+    }
+    check(30 == fast && tops, "fast PVT TPV at 1 Hz, at the top");
+    check(0 == late, "and the cycle's TPV of the same fix is not sent");
+}
+
+static void policy_test(void)
+{
+    struct gps_policy_t policy;
+    long long slot[DECIMATE_CLASSES];
+    gps_mask_t report;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    (void)memset(slot, 0, sizeof(slot));
+    epoch(0);
+    check(REPORT_IS == gpsd_decimate(&policy, &session, REPORT_IS, slot),
+          "no interval, no decimation");
+
+    policy.interval = 5.0;
+    policy.gst_interval = 0.5;
+    (void)gpsd_decimate(&policy, &session, REPORT_IS | GST_SET, slot);
+    epoch(HZ);
+    report = gpsd_decimate(&policy, &session,
+                           REPORT_IS | GST_SET | AIS_SET | PPS_SET, slot);
+    check((GST_SET | AIS_SET | PPS_SET) == report,
+          "a class interval overrides interval, other classes pass");
+
+    // no time in the reports, so by arrival
+    (void)memset(slot, 0, sizeof(slot));
+    policy.gst_interval = 0.0;
+    epoch(0);
+    session.gpsdata.gst.utctime.tv_sec = 0;
+    session.gpsdata.gst.utctime.tv_nsec = 0;
+    (void)gpsd_decimate(&policy, &session, GST_SET, slot);
+    session.lexer.pkt_time.tv_sec += 6;
+    check(GST_SET == gpsd_decimate(&policy, &session, GST_SET, slot),
+          "reports with no time go by packet arrival");
+
+    policy.interval = -1.0;
+    check(GST_SET == gpsd_decimate(&policy, &session, GST_SET, slot) &&
+          GST_SET == gpsd_decimate(&policy, &session, GST_SET, slot),
+          "nonsense intervals are ignored");
+}
+
+static void watch_test(void)
+{
+    struct gps_policy_t policy;
+    char buf[GPS_JSON_RESPONSE_MAX];
+    const char *end;
+    int status;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true,"
+                             "\"interval\":1,\"skyinterval\":10}",
+                             &policy, &end);
+    check(0 == status && 1.0 == policy.interval &&
+          10.0 == policy.sky_interval && 0.0 == policy.tpv_interval,
+          "?WATCH sets intervals");
+    json_watch_dump(&policy, buf, sizeof(buf));
+    check(NULL != strstr(buf, ",\"interval\":1.000,") &&
+          NULL != strstr(buf, ",\"skyinterval\":10.000}") &&
+          NULL == strstr(buf, "tpvinterval"),
+          "WATCH reports the intervals set");
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true}",
+                             &policy, &end);
+    json_watch_dump(&policy, buf, sizeof(buf));
+    check(0 == status && 0.0 == policy.interval &&
+          NULL == strstr(buf, "interval"),
+          "and they reset like the other options");
+}
+
+/* 10 watchers of a 20 Hz receiver for a minute, 2 at full rate, 8 at
+ * 1 Hz TPV and 10 s SKY: bytes serialized for them */
+static void load_test(void)
+{
+    struct gps_policy_t policy[10];
+    long long slot[10][DECIMATE_CLASSES];
+    char buf[GPS_JSON_RESPONSE_MAX * 4];
+    unsigned long full = 0, decimated = 0;
+    long n;
+    int i;
+
+    (void)memset(policy, 0, sizeof(policy));
+    (void)memset(slot, 0, sizeof(slot));
+    for (i = 2; i < 10; i++) {
+        policy[i].tpv_interval = 1.0;
+        policy[i].sky_interval = 10.0;
+    }
+    session.gpsdata.satellites_visible = 12;
+    session.gpsdata.fix.latitude = 44.068978;
+    session.gpsdata.fix.longitude = -121.314225;
+    session.gpsdata.fix.altHAE = 1128.5;
+    for (n = 0; n < 60 * HZ; n++) {
+        epoch(n);
+        for (i = 0; i < 10; i++) {
+            gps_mask_t report = gpsd_decimate(&policy[i], &session,
+                                              REPORT_IS | SATELLITE_SET,
+                                              slot[i]);
+
+            json_data_report(REPORT_IS | SATELLITE_SET, &session,
+                             &policy[i], buf, sizeof(buf));
+            full += strlen(buf);
+            json_data_report(report, &session, &policy[i], buf, sizeof(buf));
+            decimated += strlen(buf);
+        }
+    }
+    if (!quiet) {
+        (void)printf("    %lu bytes a second for all, %lu decimated\n",
+                     full / 60, decimated / 60);
+    }
+    check(0 < decimated && decimated < full * 3 / 10,
+          "decimated watchers cost a fraction of full rate ones");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_decimate [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    gps_context_init(&context, "test_decimate");
+    gpsd_init(&session, &context, "/dev/test");
+    rate_test();
+    align_test();
+    pvt_test();
+    policy_test();
+    watch_test();
+    load_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("decimate: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,382 @@
+/* test harness for fanout.c, client output on writer threads
+ *
+ * Checks that each client gets what was posted for it, in order, that
+ * a shared report is delivered to each without a copy, that an urgent
+ * post goes ahead of what is queued, that a full queue drops, and that
+ * a framed chain posts whole.  Then times a reporting cycle out to 2000
+ * clients written by the main thread, as gpsd does without -w, and by
+ * 1 to 16 writers.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+#define CLIENTS         2000            // clients in the fan-out
+#define CYCLES          200             // reporting cycles to time
+#define POLICIES        4               // different reports a cycle
+#define REPORT          1500            // bytes in each
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// what the functional test's clients were delivered
+#define TCLIENTS        10
+static char got[TCLIENTS][64];
+static const char *gotbuf[TCLIENTS];    // where the last came from
+static bool badgen = false;
+static pthread_mutex_t gate = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int entered;              // deliveries begun
+
+static void record(void *arg, int client, unsigned long gen,
+                   const char *buf, size_t len)
+{
+    size_t have = strlen(got[client]);
+
+    atomic_fetch_add(&entered, 1);
+    (void)pthread_mutex_lock(&gate);
+    (void)pthread_mutex_unlock(&gate);
+    if (*(unsigned long *)arg != gen) {
+        badgen = true;
+    }
+    if (have + len < sizeof(got[client])) {
+        (void)memcpy(got[client] + have, buf, len);
+        got[client][have + len] = '\0';
+    }
+    gotbuf[client] = buf;
+}
+
+static void fanout_test(void)
+{
+    static struct gps_fanout_t fanout;
+    unsigned long gen = 7;
+    char want[TCLIENTS][64];
+    struct gps_report_t *report;
+    bool ok = true, same = true;
+    int i;
+
+    check(EINVAL == gpsd_fanout_start(&fanout, 0, 16, record, &gen) &&
+          EINVAL == gpsd_fanout_start(&fanout, FANOUT_SHARDS_MAX + 1, 16,
+                                      record, &gen),
+          "0 writers, or too many, is an error");
+    check(0 == gpsd_fanout_start(&fanout, 3, 16, record, &gen) &&
+          3 == fanout.nshards,
+          "3 writers start");
+
+    // a pass everyone gets the same, then one each gets their own
+    report = gpsd_report_new(NULL, 0, "TPV,", 4);
+    ok = NULL != report;
+    for (i = 0; ok && i < TCLIENTS; i++) {
+        ok &= gpsd_fanout_share(&fanout, i, gen, report, false);
+    }
+    gpsd_report_drop(report);
+    gpsd_fanout_drain(&fanout);
+    for (i = 1; i < TCLIENTS; i++) {
+        same &= NULL != gotbuf[i] && gotbuf[0] == gotbuf[i];
+    }
+    for (i = 0; i < TCLIENTS; i++) {
+        char buf[8];
+
+        (void)snprintf(buf, sizeof(buf), "SKY%d,", i);
+        ok &= gpsd_fanout_post(&fanout, i, gen, buf, strlen(buf));
+        (void)snprintf(want[i], sizeof(want[i]), "TPV,%s", buf);
+    }
+    gpsd_fanout_drain(&fanout);
+    check(ok, "every post queues");
+    ok = !badgen;
+    for (i = 0; i < TCLIENTS; i++) {
+        ok &= 0 == strcmp(got[i], want[i]);
+    }
+    check(ok, "each client gets its own, in order");
+    check(same && 2 * TCLIENTS == fanout.posts,
+          "a shared report is delivered, not copied, to each");
+    gpsd_fanout_stop(&fanout);
+    check(0 == fanout.nshards, "the writers stop");
+
+    // held up delivering A, with B and C queued, U is posted urgent
+    (void)memset(got, 0, sizeof(got));
+    atomic_store(&entered, 0);
+    (void)pthread_mutex_lock(&gate);
+    (void)gpsd_fanout_start(&fanout, 1, 8, record, &gen);
+    ok = gpsd_fanout_post(&fanout, 0, gen, "A", 1);
+    gpsd_fanout_publish(&fanout);
+    while (0 == atomic_load(&entered)) {
+        (void)usleep(1000);
+    }
+    ok &= gpsd_fanout_post(&fanout, 0, gen, "B", 1);
+    ok &= gpsd_fanout_post(&fanout, 0, gen, "C", 1);
+    report = gpsd_report_new(NULL, 0, "U", 1);
+    ok &= NULL != report &&
+          gpsd_fanout_share(&fanout, 0, gen, report, true);
+    gpsd_report_drop(report);
+    gpsd_fanout_publish(&fanout);
+    (void)pthread_mutex_unlock(&gate);
+    gpsd_fanout_drain(&fanout);
+    check(ok && 0 == strcmp("AUBC", got[0]) && 1 == fanout.urgent,
+          "an urgent post goes ahead of what is queued");
+    gpsd_fanout_stop(&fanout);
+
+    // room for one delivery, held up in the hook
+    (void)pthread_mutex_lock(&gate);
+    (void)gpsd_fanout_start(&fanout, 1, 2, record, &gen);
+    ok = gpsd_fanout_post(&fanout, 0, gen, "A", 1);
+    gpsd_fanout_publish(&fanout);
+    ok &= !gpsd_fanout_post(&fanout, 0, gen, "B", 1);
+    (void)pthread_mutex_unlock(&gate);
+    gpsd_fanout_drain(&fanout);
+    check(ok && 1 == fanout.dropped &&
+          'A' == got[0][strlen(got[0]) - 1],
+          "a full queue drops");
+    gpsd_fanout_stop(&fanout);
+}
+
+// what the chain test's clients should get, and if they did
+static char *chained;
+static size_t chainedlen;
+static int chainedok;
+
+static void compare(void *arg UNUSED, int client UNUSED,
+                    unsigned long gen UNUSED, const char *buf, size_t len)
+{
+    if (chainedlen == len &&
+        0 == memcmp(chained, buf, len)) {
+        chainedok++;
+    }
+}
+
+static void chain_test(void)
+{
+    static struct gps_fanout_t fanout;
+    static const unsigned char hdr[] = {0x81, 0x7f};
+    struct gps_chain_t chain;
+    struct gps_report_t *report;
+    size_t i;
+    int c;
+    bool ok = true;
+
+    gpsd_chain_init(&chain);
+    for (i = 0; i < CHAIN_SEGMENT / 4; i++) {
+        gpsd_chain_appendf(&chain, "%07zu,", i);
+    }
+    chainedlen = sizeof(hdr) + chain.len;
+    chained = malloc(chainedlen + 1);
+    if (NULL == chained) {
+        (void)printf("FAILED: out of memory\n");
+        failures++;
+        gpsd_chain_release(&chain);
+        return;
+    }
+    (void)memcpy(chained, hdr, sizeof(hdr));
+    (void)gpsd_chain_copy(&chain, chained + sizeof(hdr), chain.len + 1);
+
+    (void)gpsd_fanout_start(&fanout, 2, 16, compare, NULL);
+    report = gpsd_report_chain(hdr, sizeof(hdr), &chain);
+    ok = NULL != report;
+    for (c = 0; ok && c < 3; c++) {
+        ok &= gpsd_fanout_share(&fanout, c, 0, report, false);
+    }
+    gpsd_report_drop(report);
+    gpsd_fanout_drain(&fanout);
+    check(ok && 1 < chain.nsegs && 3 == chainedok,
+          "a framed chain over segments posts whole, and is shared");
+    gpsd_fanout_stop(&fanout);
+    free(chained);
+    gpsd_chain_release(&chain);
+}
+
+static int wfds[CLIENTS], rfds[CLIENTS];
+static int clients;
+
+static void deliver(void *arg, int client, unsigned long gen UNUSED,
+                    const char *buf, size_t len)
+{
+    if ((ssize_t)len != write(wfds[client], buf, len)) {
+        *(bool *)arg = false;
+    }
+}
+
+// empty what the clients were sent, untimed
+static void drain(void)
+{
+    char buf[BUFSIZ];
+    int i;
+
+    for (i = 0; i < clients; i++) {
+        while (0 < read(rfds[i], buf, sizeof(buf))) {
+            continue;
+        }
+    }
+}
+
+static double cpu_now(void)
+{
+    timespec_t ts;
+
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return TSTONS(&ts);
+}
+
+static double wall_now(void)
+{
+    timespec_t ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return TSTONS(&ts);
+}
+
+/* CYCLES reporting cycles to every client, by nwriters threads, or the
+ * main thread if none; the main thread's time, the time until all is
+ * written, and the CPU of every thread, a cycle */
+static void bench(int nwriters, const char (*reports)[REPORT])
+{
+    static struct gps_fanout_t fanout;
+    double main_s = 0.0, wall = 0.0, cpu = 0.0;
+    bool ok = true;
+    int c, i;
+    char name[40];
+
+    if (0 < nwriters &&
+        0 != gpsd_fanout_start(&fanout, nwriters,
+                               8 * (clients / nwriters + 1),
+                               deliver, &ok)) {
+        (void)printf("FAILED: %d writers do not start\n", nwriters);
+        failures++;
+        return;
+    }
+    for (c = 0; c < CYCLES; c++) {
+        double start = wall_now(), cpu_start = cpu_now(), posted;
+        struct gps_report_t *made[POLICIES];
+
+        // as gpsd makes a report a policy a cycle, with writers
+        for (i = 0; i < POLICIES; i++) {
+            made[i] = 0 == nwriters ? NULL
+                                    : gpsd_report_new(NULL, 0, reports[i],
+                                                      REPORT);
+        }
+        for (i = 0; i < clients; i++) {
+            if (0 == nwriters) {
+                ok &= REPORT == write(wfds[i], reports[i % POLICIES],
+                                      REPORT);
+            } else {
+                ok &= NULL != made[i % POLICIES] &&
+                      gpsd_fanout_share(&fanout, i, 0, made[i % POLICIES],
+                                        false);
+            }
+        }
+        for (i = 0; i < POLICIES; i++) {
+            gpsd_report_drop(made[i]);
+        }
+        if (0 < nwriters) {
+            gpsd_fanout_publish(&fanout);
+        }
+        posted = wall_now();
+        if (0 < nwriters) {
+            gpsd_fanout_drain(&fanout);
+        }
+        wall += wall_now() - start;
+        main_s += posted - start;
+        cpu += cpu_now() - cpu_start;
+        drain();
+    }
+    if (0 < nwriters) {
+        check(ok && (unsigned long)CYCLES * clients == fanout.posts,
+              "a shared report a policy a cycle, every client written");
+        gpsd_fanout_stop(&fanout);
+        (void)snprintf(name, sizeof(name), "%2d writers", nwriters);
+    } else {
+        check(ok, "every client written");
+        (void)strlcpy(name, "main thread", sizeof(name));
+    }
+    if (!quiet) {
+        (void)printf("    %s: main loop %7.1f us, written %7.1f us, "
+                     "CPU %7.1f us a cycle\n", name,
+                     main_s * 1e6 / CYCLES, wall * 1e6 / CYCLES,
+                     cpu * 1e6 / CYCLES);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static char reports[POLICIES][REPORT];
+    struct rlimit rl;
+    int option, i;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_fanout [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fanout_test();
+    chain_test();
+
+    // two descriptors a client, and some to spare
+    if (0 == getrlimit(RLIMIT_NOFILE, &rl) &&
+        rl.rlim_cur < 2 * CLIENTS + 16 &&
+        rl.rlim_max > rl.rlim_cur) {
+        rl.rlim_cur = rl.rlim_max < 2 * CLIENTS + 16 ? rl.rlim_max
+                                                     : 2 * CLIENTS + 16;
+        (void)setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    for (clients = 0; clients < CLIENTS; clients++) {
+        int sv[2];
+
+        if (0 > socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+            break;
+        }
+        wfds[clients] = sv[0];
+        rfds[clients] = sv[1];
+        (void)fcntl(rfds[clients], F_SETFL, O_NONBLOCK);
+    }
+    if (!quiet) {
+        (void)printf("    %d clients, %ld CPUs\n", clients,
+                     sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    for (i = 0; i < POLICIES; i++) {
+        (void)memset(reports[i], 'a' + i, REPORT);
+    }
+    bench(0, (const char (*)[REPORT])reports);
+    for (i = 1; i <= FANOUT_SHARDS_MAX; i *= 2) {
+        bench(i, (const char (*)[REPORT])reports);
+    }
+    for (i = 0; i < clients; i++) {
+        (void)close(wfds[i]);
+        (void)close(rfds[i]);
+    }
+
+    if (!quiet || 0 < failures) {
+        (void)printf("fanout: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
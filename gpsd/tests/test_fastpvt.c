@@ -0,0 +1,505 @@
+/* test harness for the fast PVT lane, PVT_IS and the pvt_hook
+ *
+ * Feeds u-blox epochs, NAV-PVT, NAV-DOP, NAV-SAT and NAV-EOE, through
+ * a pty into the lexer and driver as gpsd reads them.  Checks that
+ * each NAV-PVT, and nothing else, goes to the hook ahead of the merge
+ * and of its cycle's report, what its TPV holds, and which TPVs, fast
+ * or of the cycle, a watcher gets.  Then paces 25 Hz
+ * epochs at 460800 baud and reports how long after the last byte of
+ * each NAV-PVT its TPV is out, by the fast lane and by the report at
+ * the end of its cycle.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/bits.h"
+#include "../include/gpsd.h"
+#include "../include/gps_json.h"
+#include "../include/rtsched.h"
+
+#define ITOW0           345600000       // GPS time of week, ms
+#define RATE            25              // epochs a second
+#define BAUD            460800
+#define EPOCHS          250             // of them to time
+#define NSATS           24              // in each NAV-SAT
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void watch_test(void)
+{
+    struct gps_policy_t watch;
+    char buf[GPS_JSON_RESPONSE_MAX];
+
+    memset(&watch, 0, sizeof(watch));
+    check(0 == json_watch_read("{\"class\":\"WATCH\",\"enable\":true,"
+                               "\"json\":true,\"fastpvt\":true}",
+                               &watch, NULL) &&
+          watch.fast_pvt,
+          "?WATCH fastpvt is read");
+    json_watch_dump(&watch, buf, sizeof(buf));
+    check(NULL != strstr(buf, ",\"fastpvt\":true"), "and echoed");
+    watch.fast_pvt = false;
+    json_watch_dump(&watch, buf, sizeof(buf));
+    check(NULL == strstr(buf, "fastpvt"), "and left out when off");
+}
+
+#ifdef UBLOX_ENABLE
+// the lane is fed u-blox packets
+static struct gps_context_t context;
+static struct gps_device_t session;
+static int master = -1;
+
+// what the hook saw
+static int pvts;                        // calls
+static bool others;                     // called on other than NAV-PVT
+static bool merged;                     // fix was already merged
+static char tpv[GPS_JSON_RESPONSE_MAX];
+static struct gps_policy_t policy;
+
+// the benchmark's clocks, in ns of CLOCK_MONOTONIC
+static volatile long long pvt_sent[EPOCHS];
+static long fast_ns[EPOCHS], cycle_ns[EPOCHS];
+static struct rt_latency_t fast, cycle;
+static int sink[2] = {-1, -1};          // stands in for a client socket
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// frame a UBX payload into buf, return its length
+static size_t ubx_frame(unsigned char *buf, unsigned char class,
+                        unsigned char id, const unsigned char *payload,
+                        size_t len)
+{
+    unsigned char ck_a = 0, ck_b = 0;
+    size_t i;
+
+    buf[0] = 0xb5;
+    buf[1] = 0x62;
+    buf[2] = class;
+    buf[3] = id;
+    putle16(buf, 4, (uint16_t)len);
+    memcpy(buf + 6, payload, len);
+    for (i = 2; i < len + 6; i++) {
+        ck_a += buf[i];
+        ck_b += ck_a;
+    }
+    buf[len + 6] = ck_a;
+    buf[len + 7] = ck_b;
+    return len + 8;
+}
+
+/* The packets of epoch e, one after another in buf, with where each
+ * ends in ends[].  Returns how many. */
+static int epoch(int e, unsigned char *buf, size_t ends[4])
+{
+    unsigned char p[8 + 12 * NSATS];
+    uint32_t iTOW = ITOW0 + (uint32_t)(e * (1000 / RATE));
+    size_t len = 0;
+    int i;
+
+    // NAV-PVT, 3D fix, 2021-10-17T00:00:00 plus e epochs
+    memset(p, 0, 92);
+    putle32(p, 0, iTOW);
+    putle16(p, 4, 2021);
+    p[6] = 10;
+    p[7] = 17;
+    p[10] = (unsigned char)(e * (1000 / RATE) / 1000 % 60);
+    p[11] = 0x07;                       // date, time, fully resolved
+    putle32(p, 16, e * (1000 / RATE) % 1000 * 1000000);
+    p[20] = 3;                          // 3D
+    p[21] = 0x01;                       // gnssFixOK
+    p[23] = 18;                         // numSV
+    putle32(p, 24, 1234567890 + e);     // lon, 1e-7 deg
+    putle32(p, 28, 456789012);          // lat
+    putle32(p, 32, 123456);             // height, mm
+    putle32(p, 36, 98765);              // hMSL
+    putle32(p, 40, 1500);               // hAcc
+    putle32(p, 44, 2500);               // vAcc
+    putle32(p, 60, 12345);              // gSpeed, mm/s
+    putle32(p, 64, 9000000);            // headMot, 1e-5 deg
+    putle32(p, 68, 300);                // sAcc
+    len += ubx_frame(buf + len, 0x01, 0x07, p, 92);
+    ends[0] = len;
+
+    // NAV-DOP
+    memset(p, 0, 18);
+    putle32(p, 0, iTOW);
+    for (i = 0; i < 7; i++) {
+        putle16(p, 4 + 2 * i, 120 + i);
+    }
+    len += ubx_frame(buf + len, 0x01, 0x04, p, 18);
+    ends[1] = len;
+
+    // NAV-SAT
+    memset(p, 0, sizeof(p));
+    putle32(p, 0, iTOW);
+    p[4] = 1;                           // version
+    p[5] = NSATS;
+    for (i = 0; i < NSATS; i++) {
+        unsigned char *sv = p + 8 + 12 * i;
+
+        sv[0] = 0;                      // GPS
+        sv[1] = (unsigned char)(i + 1);
+        sv[2] = (unsigned char)(30 + i);        // cno
+        sv[3] = (unsigned char)(10 + i * 3);    // elev
+        putle16(sv, 4, (uint16_t)(i * 15));     // azim
+        putle32(sv, 8, 0x0000000f);     // quality, used
+    }
+    len += ubx_frame(buf + len, 0x01, 0x35, p, sizeof(p));
+    ends[2] = len;
+
+    // NAV-EOE
+    putle32(p, 0, iTOW);
+    len += ubx_frame(buf + len, 0x01, 0x61, p, 4);
+    ends[3] = len;
+    return 4;
+}
+
+// epoch of the packet just parsed, from its iTOW
+static int epoch_of(void)
+{
+    return (int)((session.driver.ubx.iTOW - ITOW0) / (1000 / RATE));
+}
+
+// the pvt_hook, as gpsd's, renders the TPV and sends it
+static void on_pvt(struct gps_device_t *device, gps_mask_t received)
+{
+    int e = epoch_of();
+
+    pvts++;
+    if (0x01 != device->lexer.outbuffer[2] ||
+        0x07 != device->lexer.outbuffer[3]) {
+        others = true;
+    }
+    if (0 != (received & PVT_IS) &&
+        device->gpsdata.fix.time.tv_sec == device->newdata.time.tv_sec &&
+        device->gpsdata.fix.time.tv_nsec == device->newdata.time.tv_nsec) {
+        merged = true;
+    }
+    json_pvt_dump(received, device, &policy, tpv, sizeof(tpv));
+    if (0 <= sink[1]) {
+        (void)write(sink[1], tpv, strnlen(tpv, sizeof(tpv)));
+        if (0 <= e && EPOCHS > e) {
+            rt_latency_add(&fast, (long)(now_ns() - pvt_sent[e]));
+        }
+    }
+}
+
+// the multipoll handler, as gpsd's all_reports() for a TPV watcher
+static int reports;
+static int report_pvts;                 // hook calls before the last report
+static void on_report(struct gps_device_t *device, gps_mask_t changed)
+{
+    char buf[GPS_JSON_RESPONSE_MAX * 4];
+    int e;
+
+    if (0 == (changed & REPORT_IS)) {
+        return;
+    }
+    reports++;
+    report_pvts = pvts;
+    e = epoch_of();
+    json_data_report(changed, device, &policy, buf, sizeof(buf));
+    if (0 <= sink[1]) {
+        (void)write(sink[1], buf, strnlen(buf, sizeof(buf)));
+        if (0 <= e && EPOCHS > e) {
+            rt_latency_add(&cycle, (long)(now_ns() - pvt_sent[e]));
+        }
+    }
+}
+
+// read what is waiting on the pty, as gpsd's main loop does
+static void poll_pty(int ms)
+{
+    for (;;) {
+        fd_set rfds;
+        struct timeval tv = {0, ms * 1000};
+
+        FD_ZERO(&rfds);
+        FD_SET(session.gpsdata.gps_fd, &rfds);
+        if (0 >= select(session.gpsdata.gps_fd + 1, &rfds, NULL, NULL,
+                        &tv)) {
+            return;
+        }
+        (void)gpsd_multipoll(true, &session, on_report, 0);
+        if (0 <= sink[0]) {
+            char drain[BUFSIZ];
+
+            while (0 < read(sink[0], drain, sizeof(drain))) {
+                continue;
+            }
+        }
+    }
+}
+
+static bool open_pty(void)
+{
+    struct termios t;
+    int slave;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (0 > master ||
+        0 != grantpt(master) ||
+        0 != unlockpt(master)) {
+        return false;
+    }
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (0 > slave ||
+        0 != tcgetattr(slave, &t)) {
+        return false;
+    }
+    cfmakeraw(&t);
+    (void)tcsetattr(slave, TCSANOW, &t);
+    gps_context_init(&context, "test_fastpvt");
+    gpsd_time_init(&context, time(NULL));
+    context.readonly = true;
+    context.errout.debug = LOG_ERROR;
+    context.pvt_hook = on_pvt;
+    gpsd_init(&session, &context, ptsname(master));
+    session.gpsdata.gps_fd = slave;
+    return true;
+}
+
+static void write_all(const unsigned char *buf, size_t len)
+{
+    while (0 < len) {
+        ssize_t n = write(master, buf, len);
+
+        if (0 >= n) {
+            if (EINTR == errno ||
+                EAGAIN == errno) {
+                continue;
+            }
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+static void lane_test(void)
+{
+    unsigned char buf[2048];
+    size_t ends[4];
+    int e;
+
+    for (e = 0; e < 4; e++) {
+        (void)epoch(e, buf, ends);
+        write_all(buf, ends[3]);
+        poll_pty(50);
+    }
+    check(4 == pvts && !others,
+          "each NAV-PVT, and nothing else, goes to the hook");
+    check(!merged, "ahead of its merge into the cycle");
+    check(0 < reports && report_pvts == pvts,
+          "and ahead of the report at the end of its cycle");
+    check(NULL != strstr(tpv, "{\"class\":\"TPV\",\"device\":\"/dev/") &&
+          NULL != strstr(tpv, "\",\"fast\":true,\"mode\":3,") &&
+          NULL != strstr(tpv, ",\"mode\":3,\"time\":"
+                              "\"2021-10-17T00:00:00.120Z\",") &&
+          NULL != strstr(tpv, ",\"lat\":45.678901200,"
+                              "\"lon\":123.456789300,") &&
+          NULL != strstr(tpv, ",\"altHAE\":123.4560,"
+                              "\"altMSL\":98.7650,") &&
+          NULL != strstr(tpv, ",\"epv\":2.500,\"track\":90.0000,") &&
+          NULL != strstr(tpv, ",\"speed\":12.345,") &&
+          NULL != strstr(tpv, ",\"eps\":0.30,") &&
+          NULL != strstr(tpv, ",\"eph\":1.500") &&
+          0 == strcmp(tpv + strlen(tpv) - 3, "}\r\n"),
+          "a whole TPV, from the packet alone");
+
+    (void)strlcpy(policy.fields, "time,lat,lon", sizeof(policy.fields));
+    json_watch_fields(&policy);
+    (void)epoch(4, buf, ends);
+    write_all(buf, ends[3]);
+    poll_pty(50);
+    check(0 == strcmp(tpv, "{\"class\":\"TPV\",\"fast\":true,"
+                           "\"time\":\"2021-10-17T00:00:00.160Z\","
+                           "\"lat\":45.678901200,\"lon\":123.456789400}\r\n"),
+          "projected as a watcher asked");
+    policy.fields[0] = '\0';
+    json_watch_fields(&policy);
+}
+
+/* what a fastpvt watcher with no interval gets of each epoch: its fast
+ * TPV, marked, then the TPV of its cycle, not */
+static void received_test(void)
+{
+    static char out[GPS_JSON_RESPONSE_MAX * 16];
+    unsigned char buf[2048];
+    size_t ends[4], len = 0;
+    const char *line;
+    char order[16];
+    int e, n = 0, rx[2];
+    ssize_t got;
+
+    if (0 != pipe(rx) ||
+        0 != fcntl(rx[0], F_SETFL, O_NONBLOCK)) {
+        check(false, "pipe");
+        return;
+    }
+    // written to, but left for this to read, not poll_pty()
+    sink[1] = rx[1];
+    for (e = 5; e < 8; e++) {
+        (void)epoch(e, buf, ends);
+        write_all(buf, ends[3]);
+        poll_pty(50);
+        while (0 < (got = read(rx[0], out + len, sizeof(out) - 1 - len))) {
+            len += (size_t)got;
+        }
+    }
+    out[len] = '\0';
+    for (line = out; NULL != (line = strstr(line, "{\"class\":\"TPV\""));
+         line++) {
+        const char *end = strchr(line, '\n');
+
+        if (NULL != end &&
+            (int)sizeof(order) - 1 > n) {
+            char *fast = strstr(line, ",\"fast\":true");
+
+            order[n++] = NULL != fast && fast < end ? 'f' : 'c';
+        }
+    }
+    order[n] = '\0';
+    check(0 == strcmp("fcfcfc", order),
+          "a fastpvt watcher gets a fast TPV, then its cycle's TPV");
+    (void)close(rx[0]);
+    (void)close(rx[1]);
+    sink[1] = -1;
+}
+
+// write epochs at RATE, each packet when its last byte would be in
+static void *feeder(void *arg UNUSED)
+{
+    static unsigned char buf[2048];
+    long long start = now_ns() + 10000000LL;
+    long long byte_ns = 10 * 1000000000LL / BAUD;
+    int e;
+
+    for (e = 0; e < EPOCHS; e++) {
+        size_t ends[4], from = 0;
+        long long t0 = start + (long long)e * 1000000000LL / RATE;
+        int n = epoch(e, buf, ends), i;
+
+        for (i = 0; i < n; i++) {
+            struct timespec at;
+            long long t = t0 + (long long)ends[i] * byte_ns;
+
+            at.tv_sec = (time_t)(t / 1000000000LL);
+            at.tv_nsec = (long)(t % 1000000000LL);
+            (void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL);
+            if (0 == i) {
+                pvt_sent[e] = now_ns();
+            }
+            write_all(buf + from, ends[i] - from);
+            from = ends[i];
+        }
+    }
+    return NULL;
+}
+
+static void latency_line(const char *what, struct rt_latency_t *lat)
+{
+    (void)printf("    %-30s %4zu  %8.1f %8.1f %8.1f %8.1f\n", what, lat->n,
+                 rt_latency_percentile(lat, 0.0) / 1000.0,
+                 rt_latency_percentile(lat, 50.0) / 1000.0,
+                 rt_latency_percentile(lat, 99.0) / 1000.0,
+                 rt_latency_percentile(lat, 100.0) / 1000.0);
+}
+
+static void bench(void)
+{
+    pthread_t tid;
+
+    if (0 != pipe(sink) ||
+        0 != fcntl(sink[0], F_SETFL, O_NONBLOCK)) {
+        (void)printf("    no pipe for the benchmark\n");
+        return;
+    }
+    rt_latency_init(&fast, fast_ns, EPOCHS);
+    rt_latency_init(&cycle, cycle_ns, EPOCHS);
+    if (0 != pthread_create(&tid, NULL, feeder, NULL)) {
+        return;
+    }
+    poll_pty(500);
+    (void)pthread_join(tid, NULL);
+
+    (void)printf("    %d epochs at %d Hz, %d baud, NAV-PVT last byte to "
+                 "TPV written, us\n", EPOCHS, RATE, BAUD);
+    (void)printf("    %-30s %4s  %8s %8s %8s %8s\n", "", "n", "min", "p50",
+                 "p99", "max");
+    latency_line("fast PVT lane", &fast);
+    latency_line("report at the end of the cycle", &cycle);
+}
+
+#endif  // UBLOX_ENABLE
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fprintf(stderr, "usage: %s [-q]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+#ifdef UBLOX_ENABLE
+    if (!open_pty()) {
+        (void)printf("FAILED: no pty: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    memset(&policy, 0, sizeof(policy));
+    lane_test();
+    received_test();
+#endif  // UBLOX_ENABLE
+    watch_test();
+#ifdef UBLOX_ENABLE
+    if (!quiet) {
+        bench();
+    }
+#endif  // UBLOX_ENABLE
+
+    if (!quiet ||
+        0 < failures) {
+        (void)printf("test_fastpvt: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,280 @@
+/* test harness for ?WATCH field projections
+ *
+ * A well populated fix and skyview are dumped with and without field
+ * lists, to check a projection sends just what it names, and that no
+ * list sends everything, as before.  Then the bytes and the time to
+ * format a minimal projection are compared with full output.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/gps_json.h"
+
+#define START           1632218400      // 2021-09-21T10:00:00Z
+#define SATS            24
+#define LOOPS           5000            // dumps to time
+
+static bool quiet = false;
+static int failures = 0;
+
+static struct gps_context_t context;
+static struct gps_device_t session;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// a 3D fix with most of the trimmings, and a sky full of satellites
+static void populate(void)
+{
+    struct gps_data_t *gpsdata = &session.gpsdata;
+    struct gps_fix_t *fix = &gpsdata->fix;
+    int i;
+
+    fix->mode = MODE_3D;
+    fix->status = STATUS_DGPS;
+    fix->time.tv_sec = START;
+    fix->ept = 0.005;
+    fix->latitude = 44.068978;
+    fix->longitude = -121.314225;
+    fix->altHAE = 1128.5;
+    fix->altMSL = 1149.3;
+    fix->epx = 1.2;
+    fix->epy = 1.6;
+    fix->epv = 3.1;
+    fix->track = 99.43;
+    fix->speed = 12.3;
+    fix->climb = 0.2;
+    fix->eps = 0.3;
+    fix->epc = 0.5;
+    fix->ecef.x = -2456839.12;
+    fix->ecef.y = -3966042.85;
+    fix->ecef.z = 4412233.41;
+    fix->ecef.vx = 0.12;
+    fix->ecef.vy = -0.03;
+    fix->ecef.vz = 0.01;
+    fix->ecef.pAcc = 2.5;
+    fix->NED.velN = 1.5;
+    fix->NED.velE = 12.2;
+    fix->NED.velD = -0.2;
+    fix->geoid_sep = -20.8;
+    fix->eph = 2.0;
+    fix->sep = 3.7;
+
+    gpsdata->skyview_time.tv_sec = START;
+    gpsdata->dop.hdop = 0.9;
+    gpsdata->dop.vdop = 1.4;
+    gpsdata->dop.pdop = 1.7;
+    gpsdata->set |= SATELLITE_SET;
+    gpsdata->satellites_visible = SATS;
+    for (i = 0; i < SATS; i++) {
+        gpsdata->skyview[i].PRN = (short)(i + 1);
+        gpsdata->skyview[i].elevation = 10.0 + i * 3;
+        gpsdata->skyview[i].azimuth = 15.0 * i;
+        gpsdata->skyview[i].ss = 30.0 + i % 15;
+        gpsdata->skyview[i].used = 0 == i % 2;
+        gpsdata->skyview[i].gnssid = GNSSID_GPS;
+        gpsdata->skyview[i].svid = (unsigned char)(i + 1);
+        gpsdata->skyview[i].health = SAT_HEALTH_OK;
+    }
+}
+
+static void project(struct gps_policy_t *policy, const char *fields)
+{
+    (void)memset(policy, 0, sizeof(*policy));
+    (void)strlcpy(policy->fields, fields, sizeof(policy->fields));
+    json_watch_fields(policy);
+}
+
+static void tpv_test(void)
+{
+    struct gps_policy_t policy;
+    char full[GPS_JSON_RESPONSE_MAX];
+    char buf[GPS_JSON_RESPONSE_MAX];
+
+    project(&policy, "");
+    json_tpv_dump(REPORT_IS, &session, &policy, full, sizeof(full));
+    check(0 == policy.tpv_fields &&
+          NULL != strstr(full, "\"device\":\"/dev/ttyS0\"") &&
+          NULL != strstr(full, "\"ecefx\":") &&
+          NULL != strstr(full, "\"velD\":") &&
+          NULL != strstr(full, "\"sep\":"),
+          "no field list, everything");
+
+    project(&policy, "time,lat,lon,alt,mode");
+    json_tpv_dump(REPORT_IS, &session, &policy, buf, sizeof(buf));
+    check(0 == strcmp("{\"class\":\"TPV\",\"mode\":3,"
+                      "\"time\":\"2021-09-21T10:00:00.000Z\","
+                      "\"lat\":44.068978000,\"lon\":-121.314225000,"
+                      "\"alt\":1149.3000}\r\n", buf),
+          "just the fields named");
+    if (!quiet) {
+        (void)printf("    %s", buf);
+    }
+
+    project(&policy, "mode, velN, nonesuch");
+    json_tpv_dump(REPORT_IS, &session, &policy, buf, sizeof(buf));
+    check(0 == strcmp("{\"class\":\"TPV\",\"mode\":3,"
+                      "\"velN\":1.500,\"velE\":12.200,\"velD\":-0.200}\r\n",
+                      buf),
+          "grouped fields together, unknown names ignored");
+}
+
+static void sky_test(void)
+{
+    struct gps_policy_t policy;
+    char buf[GPS_JSON_RESPONSE_MAX];
+
+    project(&policy, "");
+    json_sky_dump(&session.gpsdata, &policy, buf, sizeof(buf));
+    check(NULL != strstr(buf, "\"hdop\":0.90") &&
+          NULL != strstr(buf, "{\"PRN\":1,\"el\":10.0,\"az\":0.0,\"ss\":30.0,"
+                              "\"used\":true,\"gnssid\":0,\"svid\":1,"
+                              "\"health\":1}"),
+          "SKY in full");
+
+    project(&policy, "time,lat,lon,alt,mode");
+    json_sky_dump(&session.gpsdata, &policy, buf, sizeof(buf));
+    check(0 == strcmp("{\"class\":\"SKY\","
+                      "\"time\":\"2021-09-21T10:00:00.000Z\"}\r\n", buf),
+          "a TPV projection leaves SKY little");
+
+    project(&policy, "uSat,satellites,used");
+    json_sky_dump(&session.gpsdata, &policy, buf, sizeof(buf));
+    check(NULL != strstr(buf, "{\"class\":\"SKY\",\"uSat\":12,"
+                              "\"satellites\":[{\"PRN\":1,\"used\":true},"
+                              "{\"PRN\":2,\"used\":false},") &&
+          NULL == strstr(buf, "nSat"),
+          "satellites with the attributes named");
+
+    project(&policy, "satellites");
+    json_sky_dump(&session.gpsdata, &policy, buf, sizeof(buf));
+    check(NULL != strstr(buf, "{\"PRN\":1,\"el\":10.0,\"az\":0.0,"),
+          "satellites alone have all their attributes");
+}
+
+static void watch_test(void)
+{
+    struct gps_policy_t policy;
+    char buf[GPS_JSON_RESPONSE_MAX];
+    const char *end;
+    int status;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true,"
+                             "\"fields\":\"time,lat,lon\"}",
+                             &policy, &end);
+    json_watch_fields(&policy);
+    check(0 == status && 0 != policy.tpv_fields && 0 != policy.sky_fields,
+          "?WATCH compiles a field list");
+    json_watch_dump(&policy, buf, sizeof(buf));
+    check(NULL != strstr(buf, ",\"fields\":\"time,lat,lon\""),
+          "WATCH reports it");
+    (void)memset(policy.fields, '\x01', sizeof(policy.fields) - 1);
+    policy.fields[sizeof(policy.fields) - 1] = '\0';
+    (void)memcpy(policy.fields, "time,\"}\\", 8);
+    json_watch_dump(&policy, buf, sizeof(buf));
+    check(NULL != strstr(buf, ",\"fields\":\"time,\\\"}\\\\\\u0001") &&
+          NULL != strstr(buf, "\\u0001\"") &&
+          // 247 escapes, the last 246 after the first
+          246 * 6 == strstr(buf, "\\u0001\"") - strstr(buf, "\\u0001"),
+          "and escapes it, all of it");
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true}",
+                             &policy, &end);
+    json_watch_fields(&policy);
+    json_watch_dump(&policy, buf, sizeof(buf));
+    check(0 == status && 0 == policy.tpv_fields &&
+          NULL == strstr(buf, "fields"),
+          "and resets it like the other options");
+}
+
+// bytes and microseconds an epoch, minimal projection against full
+static void cost_test(void)
+{
+    struct gps_policy_t full, minimal;
+    char buf[GPS_JSON_RESPONSE_MAX * 4];
+    size_t full_len, minimal_len;
+    timespec_t start, stop;
+    double full_us, minimal_us;
+    int i;
+
+    project(&full, "");
+    project(&minimal, "time,lat,lon,alt,mode");
+
+    json_data_report(REPORT_IS | SATELLITE_SET, &session, &full,
+                     buf, sizeof(buf));
+    full_len = strlen(buf);
+    json_data_report(REPORT_IS | SATELLITE_SET, &session, &minimal,
+                     buf, sizeof(buf));
+    minimal_len = strlen(buf);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < LOOPS; i++) {
+        json_data_report(REPORT_IS | SATELLITE_SET, &session, &full,
+                         buf, sizeof(buf));
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+    full_us = TS_SUB_D(&stop, &start) * 1e6 / LOOPS;
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < LOOPS; i++) {
+        json_data_report(REPORT_IS | SATELLITE_SET, &session, &minimal,
+                         buf, sizeof(buf));
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+    minimal_us = TS_SUB_D(&stop, &start) * 1e6 / LOOPS;
+
+    if (!quiet) {
+        (void)printf("    TPV and SKY an epoch: full %zu bytes %.1f us, "
+                     "minimal %zu bytes %.1f us\n",
+                     full_len, full_us, minimal_len, minimal_us);
+    }
+    check(minimal_len * 10 < full_len,
+          "a minimal projection is a fraction of the bytes");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_fields [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    gps_context_init(&context, "test_fields");
+    gpsd_init(&session, &context, "/dev/ttyS0");
+    populate();
+    tpv_test();
+    sky_test();
+    watch_test();
+    cost_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("fields: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
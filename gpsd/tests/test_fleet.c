@@ -0,0 +1,562 @@
+/* test harness for libgps_fleet.c, many gpsd connections on one thread
+ *
+ * Against a fake gpsd: members connect, ask to watch, get their lines
+ * whole and tagged, come back after a jittered wait when lost, and are
+ * retried when refused, and a line too long is dropped whole.  Sockets
+ * already connected are adopted, told of, written to and removed.  Then
+ * connects 1500 members to a fake gpsd and
+ * times their lines, passed on as they are and unpacked, and counts the
+ * memory a member takes.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gps.h"
+#include "../include/compiler.h"     // for UNUSED
+#include "../include/gps_json.h"     // for GPS_JSON_RESPONSE_MAX
+#include "../include/timespec.h"
+
+#define MEMBERS         1500            // members in the timed fleet
+#define ROUNDS          50              // TPVs each is sent, a pass
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static double cpu_now(void)
+{
+    timespec_t ts;
+
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return TSTONS(&ts);
+}
+
+static double wall_now(void)
+{
+    timespec_t ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return TSTONS(&ts);
+}
+
+// a TCP listener on the loopback, its port in port
+static int listener(char *port, size_t len, int backlog)
+{
+    struct sockaddr_in sin;
+    socklen_t sinlen = sizeof(sin);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    (void)memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 > fd ||
+        0 != bind(fd, (struct sockaddr *)&sin, sizeof(sin)) ||
+        0 != listen(fd, backlog) ||
+        0 != getsockname(fd, (struct sockaddr *)&sin, &sinlen)) {
+        (void)printf("FAILED: listener: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    (void)snprintf(port, len, "%u", ntohs(sin.sin_port));
+    return fd;
+}
+
+static int tpv(char *buf, size_t len, int lat)
+{
+    return snprintf(buf, len,
+                    "{\"class\":\"TPV\",\"device\":\"/dev/ttyS0\",\"mode\":3,"
+                    "\"time\":\"2026-10-17T12:00:00.000Z\",\"lat\":%d.5,"
+                    "\"lon\":-123.25,\"altHAE\":100.0,\"speed\":0.1}\r\n",
+                    lat);
+}
+
+/* The fake gpsd of the functional test.  Each connection that asks to
+ * watch is sent two TPVs, with its number as latitude, the second in
+ * two pieces.  The first three are then closed, the next three kept. */
+static void fake_gpsd(int lfd)
+{
+    int conn;
+
+    for (conn = 0; conn < 6; conn++) {
+        char buf[256];
+        int fd = accept(lfd, NULL, NULL);
+        ssize_t n;
+        int len;
+
+        if (0 > fd) {
+            _exit(EXIT_FAILURE);
+        }
+        n = read(fd, buf, sizeof(buf) - 1);
+        if (0 >= n ||
+            0 != strncmp(buf, "?WATCH=", 7)) {
+            (void)close(fd);
+            continue;
+        }
+        len = tpv(buf, sizeof(buf), conn);
+        (void)write(fd, buf, len);
+        (void)write(fd, buf, 20);
+        (void)usleep(5000);
+        (void)write(fd, buf + 20, len - 20);
+        if (3 > conn) {
+            (void)close(fd);
+        }
+    }
+    (void)pause();
+    _exit(EXIT_SUCCESS);
+}
+
+#define TMEMBERS        3
+static struct {
+    int lines;
+    int lat[4];
+    bool whole;
+    double when[4];
+} got[TMEMBERS + 1];
+
+static void record(void *arg, struct gps_fleet_t *fleet, int member,
+                   char *line, size_t len)
+{
+    struct gps_data_t *data;
+    char tag[8];
+    int n;
+
+    (void)snprintf(tag, sizeof(tag), "m%d", member);
+    if (0 > member ||
+        TMEMBERS <= member) {
+        *(bool *)arg = false;
+        return;
+    }
+    n = got[member].lines++;
+    if (0 != strcmp(tag, gps_fleet_tag(fleet, member)) ||
+        4 <= n) {
+        *(bool *)arg = false;
+        return;
+    }
+    got[member].whole = strlen(line) == len &&
+                        '}' == line[len - 1];
+    got[member].when[n] = wall_now();
+    data = gps_fleet_unpack(fleet, line);
+    got[member].lat[n] = MODE_3D == data->fix.mode ?
+                         (int)floor(data->fix.latitude) : -1;
+}
+
+static void fleet_test(void)
+{
+    struct gps_fleet_stats_t stats;
+    struct gps_fleet_t *fleet;
+    char port[16], closed[16];
+    int lfd = listener(port, sizeof(port), 8);
+    pid_t pid;
+    double start;
+    bool ok = true, paired = true, whole = true, waited = true;
+    int i, refused, status;
+
+    check(NULL == gps_fleet_open(NULL, 0, 10, record, &ok) &&
+          EINVAL == errno &&
+          NULL == gps_fleet_open(NULL, 20, 10, record, &ok),
+          "a fleet needs a retry delay, least no more than most");
+
+    pid = fork();
+    if (0 == pid) {
+        fake_gpsd(lfd);
+    }
+    (void)close(lfd);
+
+    fleet = gps_fleet_open("?WATCH={\"enable\":true,\"json\":true};\n",
+                           20, 40, record, &ok);
+    for (i = 0; i < TMEMBERS; i++) {
+        char tag[8];
+
+        (void)snprintf(tag, sizeof(tag), "m%d", i);
+        ok &= i == gps_fleet_add(fleet, "127.0.0.1", port, tag);
+    }
+    start = wall_now();
+    for (;;) {
+        bool all = true;
+
+        for (i = 0; i < TMEMBERS; i++) {
+            all &= 4 <= got[i].lines;
+        }
+        if (all ||
+            5.0 < wall_now() - start) {
+            break;
+        }
+        (void)gps_fleet_poll(fleet, 100);
+    }
+
+    for (i = 0; i < TMEMBERS; i++) {
+        paired &= 4 == got[i].lines &&
+                  0 <= got[i].lat[0] &&
+                  got[i].lat[0] == got[i].lat[1] &&
+                  got[i].lat[2] == got[i].lat[3] &&
+                  3 > got[i].lat[0] &&
+                  3 <= got[i].lat[2];
+        whole &= got[i].whole;
+        // jitter takes the 20 ms to between 10 and 20
+        waited &= 0.010 <= got[i].when[2] - got[i].when[1];
+    }
+    gps_fleet_stats(fleet, &stats);
+    check(ok, "members are added, and their lines tagged with them");
+    check(whole, "lines come whole, split reads or not");
+    check(paired, "each member its own connection's lines, "
+                  "unpacked in the fleet's gps_data_t");
+    check(3 == stats.members && 3 == stats.up &&
+          6 == stats.connects && 3 == stats.drops,
+          "lost members come back");
+    check(waited, "after a jittered wait");
+
+    // nobody listens on this one
+    lfd = listener(closed, sizeof(closed), 1);
+    (void)close(lfd);
+    refused = gps_fleet_add(fleet, "127.0.0.1", closed, NULL);
+    start = wall_now();
+    while (0.2 > wall_now() - start) {
+        (void)gps_fleet_poll(fleet, 50);
+    }
+    gps_fleet_stats(fleet, &stats);
+    check(!gps_fleet_up(fleet, refused) &&
+          3 == stats.up &&
+          5 <= stats.drops,
+          "a refused member is retried");
+    check(0 == strncmp(gps_fleet_tag(fleet, refused), "127.0.0.1:", 10),
+          "and tagged host:port");
+    gps_fleet_close(fleet);
+    (void)kill(pid, SIGTERM);
+    (void)waitpid(pid, &status, 0);
+}
+
+/* The fake gpsd of the overflow test: a line too long for any report,
+ * in three reads, then a TPV. */
+static void long_gpsd(int lfd)
+{
+    static char junk[GPS_JSON_RESPONSE_MAX * 2];
+    char buf[256];
+    int fd = accept(lfd, NULL, NULL);
+    int len;
+
+    if (0 > fd) {
+        _exit(EXIT_FAILURE);
+    }
+    (void)memset(junk, 'x', sizeof(junk));
+    junk[0] = '{';
+    (void)write(fd, junk, sizeof(junk));
+    (void)usleep(20000);
+    (void)write(fd, junk, sizeof(junk));
+    (void)usleep(20000);
+    (void)write(fd, "}\r\n", 3);
+    len = tpv(buf, sizeof(buf), 7);
+    (void)write(fd, buf, len);
+    (void)pause();
+    _exit(EXIT_SUCCESS);
+}
+
+static int long_lines;
+static bool long_tpv;
+
+static void long_record(void *arg UNUSED, struct gps_fleet_t *fleet UNUSED,
+                        int member UNUSED, char *line, size_t len UNUSED)
+{
+    long_lines++;
+    long_tpv = 0 == strncmp(line, "{\"class\":\"TPV\"", 14);
+}
+
+static void overflow_test(void)
+{
+    struct gps_fleet_stats_t stats;
+    struct gps_fleet_t *fleet;
+    char port[16];
+    int lfd = listener(port, sizeof(port), 1);
+    double start;
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (0 == pid) {
+        long_gpsd(lfd);
+    }
+    (void)close(lfd);
+
+    fleet = gps_fleet_open(NULL, 20, 40, long_record, NULL);
+    (void)gps_fleet_add(fleet, "127.0.0.1", port, NULL);
+    start = wall_now();
+    while (0 == long_lines &&
+           5.0 > wall_now() - start) {
+        (void)gps_fleet_poll(fleet, 100);
+    }
+    // anything that would follow it
+    start = wall_now();
+    while (0.1 > wall_now() - start) {
+        (void)gps_fleet_poll(fleet, 20);
+    }
+    gps_fleet_stats(fleet, &stats);
+    check(1 == long_lines && long_tpv,
+          "a line too long is dropped whole, up to its end");
+    check(1 == stats.overflows, "and counted once");
+    gps_fleet_close(fleet);
+    (void)kill(pid, SIGTERM);
+    (void)waitpid(pid, &status, 0);
+}
+
+// what the adopt test's hooks saw
+static int adopt_lines, adopt_ups, adopt_downs;
+static bool adopt_remove;
+
+static void adopt_record(void *arg UNUSED, struct gps_fleet_t *fleet,
+                         int member, char *line UNUSED, size_t len UNUSED)
+{
+    adopt_lines++;
+    if (adopt_remove) {
+        gps_fleet_remove(fleet, member);
+    }
+}
+
+static void adopt_notice(void *arg UNUSED, struct gps_fleet_t *fleet UNUSED,
+                         int member UNUSED, bool up)
+{
+    if (up) {
+        adopt_ups++;
+    } else {
+        adopt_downs++;
+    }
+}
+
+static void adopt_test(void)
+{
+    struct gps_fleet_stats_t stats;
+    struct gps_fleet_t *fleet;
+    char buf[64];
+    int sv[2], tv[2], member, again;
+    ssize_t n;
+
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sv) ||
+        0 != socketpair(AF_UNIX, SOCK_STREAM, 0, tv)) {
+        (void)printf("FAILED: socketpair: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    fleet = gps_fleet_open(NULL, 20, 40, adopt_record, NULL);
+    gps_fleet_notices(fleet, adopt_notice);
+    member = gps_fleet_adopt(fleet, sv[0], NULL);
+    check(0 == member &&
+          gps_fleet_up(fleet, member) &&
+          0 == strncmp(gps_fleet_tag(fleet, member), "fd:", 3),
+          "an adopted socket is a member, up, and tagged fd:N");
+    check(!gps_fleet_retry(fleet, member, 20, 40) &&
+          EINVAL == errno,
+          "and cannot be retried");
+
+    (void)write(sv[1], "{\"class\":\"VERSION\"}\n", 20);
+    (void)gps_fleet_poll(fleet, 100);
+    n = gps_fleet_send(fleet, member, "?POLL;\n") ?
+        read(sv[1], buf, sizeof(buf)) : -1;
+    check(1 == adopt_lines && 7 == n,
+          "its lines are read, and it is written to");
+    (void)close(sv[1]);
+    (void)gps_fleet_poll(fleet, 100);
+    (void)gps_fleet_poll(fleet, 50);
+    check(!gps_fleet_up(fleet, member) &&
+          1 == adopt_downs &&
+          0 == adopt_ups,
+          "lost, it is told of, and not retried");
+
+    gps_fleet_remove(fleet, member);
+    again = gps_fleet_adopt(fleet, tv[0], "again");
+    gps_fleet_stats(fleet, &stats);
+    check(member == again &&
+          1 == stats.members &&
+          0 == strcmp("again", gps_fleet_tag(fleet, again)),
+          "a removed member's number is reused");
+
+    // a hook may remove the member whose lines it is handed
+    adopt_lines = 0;
+    adopt_remove = true;
+    (void)write(tv[1], "{}\n{}\n{}\n", 9);
+    (void)gps_fleet_poll(fleet, 100);
+    gps_fleet_stats(fleet, &stats);
+    check(1 == adopt_lines &&
+          0 == stats.members &&
+          0 == stats.up,
+          "and none of its lines is handed on after it is removed");
+    (void)close(tv[1]);
+    gps_fleet_close(fleet);
+}
+
+// the timed fleet's lines, passed on or unpacked
+static unsigned long lines;
+static bool unpack;
+static double lat_sum;
+
+static void count(void *arg UNUSED, struct gps_fleet_t *fleet,
+                  int member UNUSED, char *line, size_t len UNUSED)
+{
+    lines++;
+    if (unpack) {
+        lat_sum += gps_fleet_unpack(fleet, line)->fix.latitude;
+    }
+}
+
+/* The fake gpsd of the timed fleet: accepts MEMBERS connections, then
+ * a pass for every byte from the parent, ROUNDS TPVs to each. */
+static void bench_gpsd(int lfd, int go)
+{
+    static int fds[MEMBERS];
+    char buf[256], byte;
+    int i, r, len = tpv(buf, sizeof(buf), 44);
+
+    for (i = 0; i < MEMBERS; i++) {
+        fds[i] = accept(lfd, NULL, NULL);
+    }
+    while (1 == read(go, &byte, 1)) {
+        for (r = 0; r < ROUNDS; r++) {
+            for (i = 0; i < MEMBERS; i++) {
+                (void)write(fds[i], buf, len);
+            }
+        }
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+// a pass of the timed fleet, until every line is in
+static void bench_pass(struct gps_fleet_t *fleet, int go, bool unpacked)
+{
+    unsigned long want = lines + (unsigned long)MEMBERS * ROUNDS;
+    double wall, cpu, start = wall_now();
+
+    unpack = unpacked;
+    wall = wall_now();
+    cpu = cpu_now();
+    (void)write(go, "x", 1);
+    while (lines < want &&
+           30.0 > wall_now() - start) {
+        (void)gps_fleet_poll(fleet, 100);
+    }
+    wall = wall_now() - wall;
+    cpu = cpu_now() - cpu;
+    check(lines == want, unpacked ? "every line is unpacked"
+                                  : "every line is passed on");
+    if (!quiet) {
+        (void)printf("    %s: %.0f lines/s, CPU %.2f us a line\n",
+                     unpacked ? "unpacked" : "passed on",
+                     MEMBERS * ROUNDS / wall, cpu * 1e6 / (MEMBERS * ROUNDS));
+    }
+}
+
+static void bench(void)
+{
+    struct gps_fleet_stats_t stats;
+    struct gps_fleet_t *fleet;
+    struct rlimit rl;
+    char port[16];
+    int lfd, go[2], i, status;
+    double start;
+    pid_t pid;
+
+    // the members, and the fake gpsd's ends of them, and some to spare
+    if (0 == getrlimit(RLIMIT_NOFILE, &rl) &&
+        rl.rlim_cur < 2 * MEMBERS + 16 &&
+        rl.rlim_max > rl.rlim_cur) {
+        rl.rlim_cur = rl.rlim_max < 2 * MEMBERS + 16 ? rl.rlim_max
+                                                     : 2 * MEMBERS + 16;
+        (void)setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    lfd = listener(port, sizeof(port), MEMBERS);
+    if (0 != pipe(go)) {
+        (void)printf("FAILED: pipe: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    pid = fork();
+    if (0 == pid) {
+        (void)close(go[1]);
+        bench_gpsd(lfd, go[0]);
+    }
+    (void)close(lfd);
+    (void)close(go[0]);
+
+    fleet = gps_fleet_open("?WATCH={\"enable\":true,\"json\":true};\n",
+                           1000, 60000, count, NULL);
+    start = wall_now();
+    for (i = 0; i < MEMBERS; i++) {
+        char tag[16];
+
+        (void)snprintf(tag, sizeof(tag), "vehicle%d", i);
+        if (0 > gps_fleet_add(fleet, "127.0.0.1", port, tag)) {
+            break;
+        }
+    }
+    do {
+        (void)gps_fleet_poll(fleet, 100);
+        gps_fleet_stats(fleet, &stats);
+    } while (MEMBERS > stats.up &&
+             0 == stats.drops &&
+             10.0 > wall_now() - start);
+    check(MEMBERS == stats.up, "every member of the timed fleet connects");
+    if (!quiet) {
+        (void)printf("    %d members: connected in %.0f ms, %zu bytes a "
+                     "member, where a gps_data_t alone is %zu\n",
+                     stats.members, (wall_now() - start) * 1e3,
+                     stats.bytes / MEMBERS, sizeof(struct gps_data_t));
+    }
+    if (MEMBERS == stats.up) {
+        bench_pass(fleet, go[1], false);
+        bench_pass(fleet, go[1], true);
+        check(fabs(lat_sum - 44.5 * MEMBERS * ROUNDS) < 1.0,
+              "and unpacks right");
+    }
+    (void)close(go[1]);
+    (void)waitpid(pid, &status, 0);
+    gps_fleet_close(fleet);
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_fleet [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+    (void)signal(SIGPIPE, SIG_IGN);
+
+    fleet_test();
+    overflow_test();
+    adopt_test();
+    bench();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("fleet: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
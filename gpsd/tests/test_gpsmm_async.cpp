@@ -0,0 +1,332 @@
+/* test harness for libgpsmm_async.h, awaitable gpsd sessions
+ *
+ * Against a fake gpsd: connects, awaits reports by class, skipping the
+ * others, reconnects when the connection is lost, and gives up when
+ * told not to.  Then times 1000 sessions on one thread, each awaiting
+ * the TPVs of its own fake receiver, and counts the memory a session
+ * takes.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"  // must be before all includes
+
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "../include/libgpsmm_async.h"
+
+using namespace gpsmm_async;
+
+#define SESSIONS        1000            // sessions on the one thread
+#define ROUNDS          100             // reports each is sent
+
+static bool quiet = false;
+static int failures = 0;
+
+static const char version[] =
+    "{\"class\":\"VERSION\",\"release\":\"3.23.2~dev\","
+    "\"proto_major\":3,\"proto_minor\":15}\n";
+static const char tpv1[] =
+    "{\"class\":\"TPV\",\"device\":\"/dev/ttyS0\",\"mode\":3,"
+    "\"time\":\"2026-10-17T12:00:00.000Z\",\"lat\":44.5,\"lon\":-123.25,"
+    "\"altHAE\":100.0,\"speed\":0.1,\"track\":12.0}\n";
+static const char tpv2[] =
+    "{\"class\":\"TPV\",\"device\":\"/dev/ttyS0\",\"mode\":2,"
+    "\"lat\":45.5,\"lon\":-122.75}\n";
+static const char sky[] =
+    "{\"class\":\"SKY\",\"device\":\"/dev/ttyS0\",\"hdop\":1.2,"
+    "\"nSat\":2,\"uSat\":1,"
+    "\"satellites\":[{\"PRN\":5,\"el\":45.0,\"az\":90.0,\"ss\":40.0,"
+    "\"used\":true},{\"PRN\":7,\"el\":10.0,\"az\":270.0,\"ss\":30.0,"
+    "\"used\":false}]}\n";
+static const char gst[] =
+    "{\"class\":\"GST\",\"device\":\"/dev/ttyS0\",\"rms\":2.5,"
+    "\"lat\":1.5,\"lon\":1.25,\"alt\":3.0}\n";
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static double cpu_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double wall_now(void)
+{
+    return loop::now() * 1e-9;
+}
+
+// a TCP listener on the loopback, its port in port
+static int listener(char *port, size_t len)
+{
+    struct sockaddr_in sin;
+    socklen_t sinlen = sizeof(sin);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    (void)memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 > fd ||
+        0 != bind(fd, (struct sockaddr *)&sin, sizeof(sin)) ||
+        0 != listen(fd, 4) ||
+        0 != getsockname(fd, (struct sockaddr *)&sin, &sinlen)) {
+        (void)printf("FAILED: listener: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    (void)snprintf(port, len, "%u", ntohs(sin.sin_port));
+    return fd;
+}
+
+/* The fake gpsd: the first connection is sent a VERSION, then a TPV,
+ * SKY and GST once it asks to watch, and is closed; the second a TPV. */
+static void fake_gpsd(int lfd)
+{
+    const char *sends[] = {tpv1, sky, gst};
+    char request[128];
+    int conn, fd;
+
+    for (conn = 0; conn < 2; conn++) {
+        ssize_t n;
+
+        fd = accept(lfd, NULL, NULL);
+        if (0 > fd) {
+            _exit(EXIT_FAILURE);
+        }
+        (void)write(fd, version, sizeof(version) - 1);
+        n = read(fd, request, sizeof(request) - 1);
+        if (0 < n &&
+            0 == strncmp(request, "?WATCH=", 7)) {
+            if (0 == conn) {
+                for (const char *s : sends) {
+                    (void)write(fd, s, strlen(s));
+                }
+            } else {
+                (void)write(fd, tpv2, sizeof(tpv2) - 1);
+            }
+        }
+        (void)close(fd);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+struct outcome {
+    bool connected = false, done = false;
+    double lat1 = NAN, lat2 = NAN, rms = NAN;
+    int nsats = -1;
+    unsigned long skipped = 0;
+    bool lost = false;
+};
+
+static task watch(loop &lp, session &s, outcome &o)
+{
+    o.connected = co_await s.connect();
+    if (auto tpv = co_await s.next<TPV>()) {
+        o.lat1 = tpv->fix.latitude;
+    }
+    if (auto sky = co_await s.next<SKY>()) {
+        o.nsats = sky->nsats;
+    }
+    if (auto g = co_await s.next<GST>()) {
+        o.rms = g->gst.rms_deviation;
+    }
+    o.skipped = s.skipped();
+    // the fake gpsd hangs up, and is called back
+    s.reconnect(10, 100);
+    if (auto tpv = co_await s.next<TPV>()) {
+        o.lat2 = tpv->fix.latitude;
+    }
+    // the fake gpsd hangs up again, and is let be
+    s.reconnect(0, 0);
+    o.lost = nullptr == co_await s.next<TPV>();
+    co_await lp.sleep(1);
+    o.done = true;
+}
+
+static task refused(session &s, int &connected)
+{
+    connected = co_await s.connect() ? 1 : 0;
+}
+
+static void session_test(void)
+{
+    char port[16];
+    int lfd = listener(port, sizeof(port));
+    pid_t pid = fork();
+    int status, connected = -1;
+    double start;
+    loop lp;
+    outcome o;
+
+    if (0 == pid) {
+        fake_gpsd(lfd);
+    }
+    (void)close(lfd);
+
+    {
+        session s(lp, "127.0.0.1", port);
+
+        s.watch("?WATCH={\"enable\":true,\"json\":true};\n");
+        watch(lp, s, o);
+        lp.run();
+    }
+    (void)waitpid(pid, &status, 0);
+    check(o.connected, "connects without blocking");
+    check(44.5 == o.lat1, "awaits a TPV, as a record");
+    check(2 == o.nsats, "then a SKY");
+    check(2.5 == o.rms, "then a GST");
+    check(1 == o.skipped, "skipping, undecoded, the VERSION");
+    check(45.5 == o.lat2, "reconnects, asks again, and gets the next TPV");
+    check(o.lost && o.done, "a lost connection, not retried, ends the wait");
+
+    // a port nobody listens on
+    lfd = listener(port, sizeof(port));
+    (void)close(lfd);
+    {
+        session s(lp, "127.0.0.1", port);
+
+        refused(s, connected);
+        lp.run();
+    }
+    check(0 == connected, "a refused connection is not connected");
+
+    start = wall_now();
+    [](loop &l) -> task { co_await l.sleep(20); }(lp);
+    lp.run();
+    check(0.02 <= wall_now() - start, "the loop sleeps");
+}
+
+static task count(session &s, unsigned long &n)
+{
+    for (;;) {
+        auto tpv = co_await s.next<TPV>();
+
+        if (nullptr == tpv) {
+            break;
+        }
+        n++;
+    }
+}
+
+/* SESSIONS sessions, each on one end of a socketpair, on one thread.
+ * A child is their receivers: ROUNDS times it sends each a TPV and a
+ * SKY, which the sessions skip, then hangs up. */
+static void bench(void)
+{
+    loop lp;                    // before the sessions, to outlive them
+    std::vector<std::unique_ptr<session>> sessions;
+    std::vector<int> wfds;
+    double wall, cpu;
+    unsigned long tpvs = 0, skipped = 0;
+    size_t bytes = 0;
+    struct rlimit rl;
+    int i, status;
+    pid_t pid;
+
+    // two descriptors a session, and some to spare
+    if (0 == getrlimit(RLIMIT_NOFILE, &rl) &&
+        rl.rlim_cur < 2 * SESSIONS + 16 &&
+        rl.rlim_max > rl.rlim_cur) {
+        rl.rlim_cur = std::min<rlim_t>(rl.rlim_max, 2 * SESSIONS + 16);
+        (void)setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    for (i = 0; i < SESSIONS; i++) {
+        int sv[2];
+
+        if (0 > socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+            break;
+        }
+        sessions.push_back(std::make_unique<session>(lp, sv[0]));
+        wfds.push_back(sv[1]);
+    }
+    pid = fork();
+    if (0 == pid) {
+        int r;
+
+        // the loop's epoll is shared with the parent, so leave it be
+        for (r = 0; r < ROUNDS; r++) {
+            for (int fd : wfds) {
+                (void)write(fd, tpv1, sizeof(tpv1) - 1);
+                (void)write(fd, sky, sizeof(sky) - 1);
+            }
+        }
+        _exit(EXIT_SUCCESS);
+    }
+    for (int fd : wfds) {
+        (void)close(fd);
+    }
+
+    wall = wall_now();
+    cpu = cpu_now();
+    for (auto &s : sessions) {
+        count(*s, tpvs);
+    }
+    lp.run();
+    wall = wall_now() - wall;
+    cpu = cpu_now() - cpu;
+    (void)waitpid(pid, &status, 0);
+
+    for (auto &s : sessions) {
+        skipped += s->skipped();
+        bytes += s->footprint();
+    }
+    check(sessions.size() * ROUNDS == tpvs &&
+          sessions.size() * ROUNDS == skipped,
+          "every session gets every TPV, and skips every SKY");
+    if (!quiet) {
+        (void)printf("    %zu sessions on one thread: %.0f TPVs/s, "
+                     "CPU %.2f us a TPV, %zu bytes a session\n",
+                     sessions.size(), tpvs / wall, cpu * 1e6 / tpvs,
+                     bytes / sessions.size());
+        (void)printf("    and the loop %zu bytes, %zu a session, where a "
+                     "gps_data_t a session would be %zu more\n",
+                     lp.footprint(), lp.footprint() / sessions.size(),
+                     sizeof(struct gps_data_t));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_gpsmm_async [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+    (void)signal(SIGPIPE, SIG_IGN);
+
+    session_test();
+    bench();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("gpsmm_async: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,421 @@
+/* test harness for IMU batches, the IMU ring and json_imubatch_emit()
+ *
+ * Checks when batches go out and what is in them, that interleaved
+ * messages each get their own, that overwritten samples are skipped,
+ * and that libgps reads a batch back, then times a 200 Hz IMU sent a
+ * sample an object, as class IMU, against 100 ms batches.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/gps_json.h"
+
+#define RATE            200             // samples a second
+#define SECONDS         60              // of them to time
+
+static bool quiet = false;
+static int failures = 0;
+
+static struct gps_context_t context;
+static struct gps_device_t session;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// the bytes of chain, flattened, in a buffer to be freed
+static char *flatten(const struct gps_chain_t *chain)
+{
+    char *buf = malloc(chain->len + 1);
+
+    if (NULL != buf) {
+        (void)gpsd_chain_copy(chain, buf, chain->len + 1);
+    }
+    return buf;
+}
+
+// times needle is in haystack
+static int count(const char *haystack, const char *needle)
+{
+    int n = 0;
+
+    while (NULL != (haystack = strstr(haystack, needle))) {
+        n++;
+        haystack++;
+    }
+    return n;
+}
+
+/* Fill att as a driver would, sample n of msg, tagged tag, gyro only
+ * unless acc. */
+static void sample(struct attitude_t *att, const char *msg, int n,
+                   unsigned long tag, bool acc)
+{
+    gps_clear_att(att);
+    (void)strlcpy(att->msg, msg, sizeof(att->msg));
+    att->timeTag = tag;
+    if (acc) {
+        att->acc_x = n / 1024.0;
+        att->acc_y = -n / 1024.0;
+        att->acc_z = 9.80665;
+    }
+    att->gyro_x = n / 4096.0;
+    att->gyro_y = 0.0;
+    att->gyro_z = -n / 4096.0;
+    att->gyro_temp = 25.5;
+}
+
+// push sample n of msg, as if its packet came at ms
+static void push(const char *msg, int n, unsigned long tag, bool acc,
+                 long ms)
+{
+    struct attitude_t att;
+
+    session.lexer.pkt_time.tv_sec = 1600000000 + ms / 1000;
+    session.lexer.pkt_time.tv_nsec = (ms % 1000) * 1000000;
+    sample(&att, msg, n, tag, acc);
+    gpsd_imu_push(&session, &att);
+}
+
+static void window_test(void)
+{
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    unsigned long next = session.imu.head;
+    char *flat = NULL;
+    bool early = false;
+    int i;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.imu_batch = 100;
+    gpsd_chain_init(&chain);
+    // 200 Hz, a sample each 5 ms
+    for (i = 0; i <= 20; i++) {
+        push("UBX-ESF-RAW", i, 1000 + i * 5, true, i * 5);
+        json_imubatch_emit(&session, &policy, &next, &chain);
+        early |= 20 > i && 0 < chain.len;
+    }
+    check(!early, "nothing goes out before the window is full");
+    flat = flatten(&chain);
+    check(NULL != flat &&
+          1 == count(flat, "{\"class\":\"IMUBATCH\"") &&
+          NULL != strstr(flat, ",\"msg\":\"UBX-ESF-RAW\",\"timeTag\":1000,"
+                               "\"count\":21,\"dt\":[0,5,10,") &&
+          NULL != strstr(flat, ",95,100],\"acc_x\":[0.00000,0.00098,") &&
+          NULL != strstr(flat, "\"gyro_temp\":[25.50,") &&
+          NULL != strstr(flat, "\"time\":\"2020-09-13T12:26:40.000Z\"") &&
+          0 == strcmp(flat + chain.len - 4, "]}\r\n") &&
+          next == session.imu.head,
+          "then the 21 samples of 100 ms go in one, by time tag");
+    free(flat);
+    gpsd_chain_release(&chain);
+
+    // no more samples, nothing more
+    gpsd_chain_init(&chain);
+    json_imubatch_emit(&session, &policy, &next, &chain);
+    check(0 == chain.len, "and nothing is sent twice");
+    gpsd_chain_release(&chain);
+}
+
+static void interleave_test(void)
+{
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    unsigned long next = session.imu.head;
+    char *flat, *meas;
+    int i, batches;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.imu_batch = 50;
+    gpsd_chain_init(&chain);
+    // ten ESF-RAW samples a packet, an ESF-MEAS of gyro between them
+    for (i = 0; i < 6; i++) {
+        int j;
+
+        for (j = 0; j < 10; j++) {
+            push("UBX-ESF-RAW", i * 10 + j, i * 100 + j * 10, true,
+                 i * 20);
+        }
+        push("UBX-ESF-MEAS", i, 7000 + i * 20, false, i * 20 + 10);
+        json_imubatch_emit(&session, &policy, &next, &chain);
+    }
+    flat = flatten(&chain);
+    batches = NULL == flat ? 0 : count(flat, "{\"class\":\"IMUBATCH\"");
+    meas = NULL == flat ? NULL : strstr(flat, "\"msg\":\"UBX-ESF-MEAS\"");
+    if (NULL != meas &&
+        NULL != strstr(meas, "}\r\n")) {
+        // just the first ESF-MEAS batch
+        *strstr(meas, "}\r\n") = '\0';
+    }
+    // 50 ms from the first sample, at 0 ms, is the third MEAS
+    check(4 == batches &&
+          NULL != strstr(flat, "\"msg\":\"UBX-ESF-RAW\",\"timeTag\":0,"
+                               "\"count\":30,") &&
+          NULL != meas &&
+          NULL != strstr(meas, "\"timeTag\":7000,\"count\":3,"
+                               "\"dt\":[0,20,40]") &&
+          NULL == strstr(meas, "acc_x") &&
+          NULL != strstr(meas, "\"gyro_z\":[0.00000,-0.00024,"),
+          "interleaved messages each get a batch, with only their columns");
+    free(flat);
+    gpsd_chain_release(&chain);
+}
+
+static void wrap_test(void)
+{
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    unsigned long next = session.imu.head;
+    char *flat;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.imu_batch = 10;
+    gpsd_chain_init(&chain);
+    push("UBX-ESF-RAW", 0, 0xfffffff0UL, true, 0);
+    push("UBX-ESF-RAW", 1, 0x0000000bUL, true, 10);
+    json_imubatch_emit(&session, &policy, &next, &chain);
+    flat = flatten(&chain);
+    check(NULL != flat &&
+          NULL != strstr(flat, "\"timeTag\":4294967280,\"count\":2,"
+                               "\"dt\":[0,27]"),
+          "a time tag that wraps in a batch counts on");
+    free(flat);
+    gpsd_chain_release(&chain);
+}
+
+static void overrun_test(void)
+{
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    unsigned long next = session.imu.head;
+    char want[64];
+    char *flat;
+    int i;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.imu_batch = 1000;
+    for (i = 0; i < IMU_RING + 10; i++) {
+        push("UBX-ESF-RAW", i, 100000 + i, true, i);
+    }
+    gpsd_chain_init(&chain);
+    json_imubatch_emit(&session, &policy, &next, &chain);
+    flat = flatten(&chain);
+    (void)snprintf(want, sizeof(want), "\"timeTag\":%d,\"count\":%d,",
+                   100010, IMUBATCH_MAX);
+    check(NULL != flat &&
+          (IMU_RING + IMUBATCH_MAX - 1) / IMUBATCH_MAX ==
+              count(flat, "{\"class\":\"IMUBATCH\"") &&
+          NULL != strstr(flat, want) &&
+          next == session.imu.head,
+          "samples overwritten before they were sent are skipped, "
+          "the rest go in batches of at most IMUBATCH_MAX");
+    free(flat);
+    gpsd_chain_release(&chain);
+
+    // a new device in the slot starts over
+    next = session.imu.head + 5;
+    gpsd_chain_init(&chain);
+    json_imubatch_emit(&session, &policy, &next, &chain);
+    check(0 == chain.len && next == session.imu.head,
+          "a watcher ahead of a new device's ring starts at its head");
+    gpsd_chain_release(&chain);
+
+    // a sample with nothing to batch is not kept
+    next = session.imu.head;
+    {
+        struct attitude_t att;
+
+        gps_clear_att(&att);
+        (void)strlcpy(att.msg, "UBX-ESF-MEAS", sizeof(att.msg));
+        gpsd_imu_push(&session, &att);
+    }
+    check(next == session.imu.head, "an empty sample is not kept");
+}
+
+static void libgps_test(void)
+{
+    static struct gps_data_t back;
+    struct gps_policy_t policy;
+    struct gps_chain_t chain;
+    unsigned long next = session.imu.head;
+    char *flat, *line;
+    bool same = true;
+    int status, i;
+
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.imu_batch = 1;
+    gpsd_chain_init(&chain);
+    for (i = 0; i < 8; i++) {
+        push("UBX-ESF-MEAS", i, 5000 + i * 5, false, i);
+    }
+    json_imubatch_emit(&session, &policy, &next, &chain);
+    flat = flatten(&chain);
+    line = NULL == flat ? NULL : strstr(flat, "{\"class\":\"IMUBATCH\"");
+    // a stale acc_x column must not survive
+    back.imubatch.acc_x[0] = 1.0;
+    status = NULL == line ? -1 : libgps_json_unpack(line, &back, NULL);
+    for (i = 0; i < 8; i++) {
+        same &= i * 5 == back.imubatch.dt[i] &&
+                1e-5 > fabs(i / 4096.0 - back.imubatch.gyro_x[i]) &&
+                1e-5 > fabs(-i / 4096.0 - back.imubatch.gyro_z[i]) &&
+                0 == isfinite(back.imubatch.acc_x[i]);
+    }
+    check(0 == status &&
+          0 != (back.set & IMUBATCH_SET) &&
+          8 == back.imubatch.count &&
+          5000 == back.imubatch.timeTag &&
+          0 == strcmp(back.imubatch.msg, "UBX-ESF-MEAS") &&
+          1600000000 == back.imubatch.mtime.tv_sec &&
+          same,
+          "libgps reads a batch back, columns not sent are NaN");
+    free(flat);
+    gpsd_chain_release(&chain);
+    check(sizeof(struct imubatch_t) <= sizeof(struct rawdata_t),
+          "a batch does not grow the union of gps_data_t");
+}
+
+/* Send SECONDS of a RATE Hz IMU, perpacket samples a packet, to a
+ * socket drained as it goes, as class IMU or in batches of window ms,
+ * and say what that costs a second. */
+static void bench1(int perpacket, int window)
+{
+    struct gps_policy_t policy;
+    timespec_t start, stop;
+    unsigned long next = session.imu.head;
+    unsigned long bytes = 0, objects = 0, writes = 0;
+    int packets = RATE * SECONDS / perpacket;
+    char sink[65536];
+    double cpu;
+    int sv[2], p;
+
+    if (0 > socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+        (void)printf("FAILED: socketpair: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.imu_batch = window;
+    (void)memset(session.gpsdata.imu, 0, sizeof(session.gpsdata.imu));
+
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (p = 0; p < packets; p++) {
+        struct gps_chain_t chain;
+        ssize_t sent;
+        int i;
+
+        // what a driver does for a packet: imu[], and the IMU ring
+        session.lexer.pkt_time.tv_sec = 1600000000 + p * perpacket / RATE;
+        session.lexer.pkt_time.tv_nsec = (p * perpacket % RATE) *
+                                         (1000000000 / RATE);
+        for (i = 0; i < perpacket; i++) {
+            struct attitude_t *att = &session.gpsdata.imu[i];
+
+            sample(att, "UBX-ESF-RAW", p * perpacket + i,
+                   (unsigned long)(p * perpacket + i) * 5, true);
+            gpsd_imu_push(&session, att);
+        }
+
+        gpsd_chain_init(&chain);
+        if (0 == window) {
+            json_data_emit(IMU_SET, &session, &policy, &chain);
+        } else {
+            json_imubatch_emit(&session, &policy, &next, &chain);
+        }
+        if (0 < chain.len) {
+            char *flat = flatten(&chain);
+
+            if (NULL != flat) {
+                objects += count(flat, "\"class\":");
+                free(flat);
+            }
+            sent = gpsd_chain_write(&chain, sv[0], NULL, 0);
+            writes++;
+            bytes += chain.len;
+            while (0 < sent) {
+                ssize_t n = read(sv[1], sink, sizeof(sink));
+
+                if (0 >= n) {
+                    break;
+                }
+                sent -= n;
+            }
+        }
+        gpsd_chain_release(&chain);
+    }
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+    cpu = TS_SUB_D(&stop, &start);
+    (void)printf("    %2d a packet, %-10s %5lu objects/s %5lu writes/s "
+                 "%7lu bytes/s  CPU %6.1f us/s\n",
+                 perpacket, 0 == window ? "IMU" :
+                 100 == window ? "IMUBATCH" : "?",
+                 objects / SECONDS, writes / SECONDS, bytes / SECONDS,
+                 cpu * 1e6 / SECONDS);
+    (void)close(sv[0]);
+    (void)close(sv[1]);
+}
+
+static void bench(void)
+{
+    (void)printf("    %d Hz IMU, %d s\n", RATE, SECONDS);
+    bench1(1, 0);
+    bench1(1, 100);
+    bench1(10, 0);
+    bench1(10, 100);
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_imubatch [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    gps_context_init(&context, "test_imubatch");
+    gpsd_init(&session, &context, "/dev/ttyACM0");
+    gpsd_clear(&session);
+
+    check(NULL == session.imu.sample, "no IMU ring before the first sample");
+    window_test();
+    check(NULL != session.imu.sample, "an IMU ring after it");
+    interleave_test();
+    wrap_test();
+    overrun_test();
+    libgps_test();
+    if (!quiet) {
+        bench();
+    }
+
+    if (!quiet || 0 < failures) {
+        (void)printf("imubatch: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,526 @@
+/* test harness for the JSON structural scanner
+ *
+ * json_scan() is checked against a byte-at-a-time scan at every
+ * alignment, and up to the end of a readable page, the parser where
+ * strings, tokens and attribute names become too long, and libgps's
+ * class dispatch on classes alike in their first letters.  Then lines
+ * are streamed to libgps from a stand-in daemon, to check it frames
+ * them whole.  Any .chk files named on the command line are decoded at
+ * every alignment, to check that changes nothing, streamed the same
+ * way, and timed.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gps.h"
+#include "../include/gps_json.h"
+#include "../include/os_compat.h"
+#include "../include/timespec.h"
+
+#define MAXLINES        20000           // lines kept from .chk files
+#define PASSES          20              // decodes of each, timed
+
+static bool quiet = false;
+static int failures = 0;
+
+static const int kinds[] = {JSON_SCAN_ATTR, JSON_SCAN_STRING,
+                            JSON_SCAN_TOKEN};
+
+// a stream of each class libgps knows, for when no .chk file is named
+static const char *sample[] = {
+    "{\"class\":\"VERSION\",\"release\":\"test\",\"rev\":\"test\","
+    "\"proto_major\":3,\"proto_minor\":14}",
+    "{\"class\":\"DEVICES\",\"devices\":[{\"class\":\"DEVICE\","
+    "\"path\":\"/dev/ttyACM0\",\"driver\":\"u-blox\",\"activated\":"
+    "\"2021-09-21T10:00:00.000Z\",\"native\":1,\"bps\":9600,"
+    "\"parity\":\"N\",\"stopbits\":1,\"cycle\":1.00,\"mincycle\":0.02}]}",
+    "{\"class\":\"WATCH\",\"enable\":true,\"json\":true,\"nmea\":false,"
+    "\"raw\":0,\"scaled\":false,\"timing\":false,\"split24\":false,"
+    "\"pps\":false}",
+    "{\"class\":\"DEVICE\",\"path\":\"/dev/ttyACM0\",\"driver\":\"u-blox\","
+    "\"subtype\":\"SW ROM CORE 3.01 (107888),HW 00080000\","
+    "\"subtype1\":\"FWVER=SPG 3.01,PROTVER=18.00,GPS;GLO;GAL;BDS\"}",
+    "{\"class\":\"TPV\",\"device\":\"/dev/ttyACM0\",\"mode\":3,"
+    "\"time\":\"2021-09-21T10:00:00.000Z\",\"ept\":0.005,"
+    "\"lat\":40.035093060,\"lon\":-75.519748733,\"altHAE\":31.1230,"
+    "\"altMSL\":64.1230,\"epx\":9.497,\"epy\":9.651,\"epv\":22.448,"
+    "\"track\":0.0000,\"magtrack\":348.1234,\"magvar\":-11.8,"
+    "\"speed\":0.011,\"climb\":-0.006,\"eps\":0.25,\"epc\":0.40}",
+    "{\"class\":\"SKY\",\"device\":\"/dev/ttyACM0\",\"xdop\":0.54,"
+    "\"ydop\":0.77,\"vdop\":0.85,\"tdop\":0.79,\"hdop\":0.94,"
+    "\"gdop\":1.52,\"pdop\":1.27,\"satellites\":["
+    "{\"PRN\":5,\"el\":31.0,\"az\":86.0,\"ss\":45.0,\"used\":true,"
+    "\"gnssid\":0,\"svid\":5},"
+    "{\"PRN\":13,\"el\":44.0,\"az\":59.0,\"ss\":47.0,\"used\":true,"
+    "\"gnssid\":0,\"svid\":13},"
+    "{\"PRN\":75,\"el\":12.0,\"az\":312.0,\"ss\":0.0,\"used\":false,"
+    "\"gnssid\":6,\"svid\":11,\"freqid\":7}]}",
+    "{\"class\":\"GST\",\"device\":\"/dev/ttyACM0\","
+    "\"time\":\"2021-09-21T10:00:00.000Z\",\"rms\":2.440,\"major\":1.660,"
+    "\"minor\":1.120,\"orient\":68.9880,\"lat\":1.614,\"lon\":1.264,"
+    "\"alt\":2.197}",
+    "{\"class\":\"IMU\",\"device\":\"/dev/ttyACM0\","
+    "\"time\":\"2021-09-21T10:00:00.000Z\",\"timeTag\":4012,"
+    "\"acc_x\":0.0123,\"acc_y\":-0.0456,\"acc_z\":9.8012,"
+    "\"gyro_x\":0.0012,\"gyro_y\":-0.0021,\"gyro_z\":0.0003,"
+    "\"gyro_temp\":31.5}",
+    "{\"class\":\"AIS\",\"device\":\"stdin\",\"type\":1,\"repeat\":0,"
+    "\"mmsi\":371798000,\"scaled\":true,\"status\":0,"
+    "\"status_text\":\"Under way using engine\",\"turn\":\"fastleft\","
+    "\"speed\":12.3,\"accuracy\":true,\"lon\":-123.395383,"
+    "\"lat\":48.381633,\"course\":224.0,\"heading\":215,\"second\":33,"
+    "\"maneuver\":0,\"raim\":false,\"radio\":34017}",
+    "{\"class\":\"ERROR\",\"message\":\"Unrecognized request \\\"?XYZ\\\"\"}",
+};
+
+static const char *lines[MAXLINES];
+static int nlines;
+static size_t nbytes;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// json_scan(), a byte at a time, as the parser was
+static size_t scan_ref(const char *cp, int kind)
+{
+    const char *p;
+
+    for (p = cp; '\0' != *p; p++) {
+        if (JSON_SCAN_TOKEN == kind) {
+            if (isspace((unsigned char)*p) ||
+                ',' == *p ||
+                '}' == *p) {
+                break;
+            }
+        } else if ('"' == *p ||
+                   (JSON_SCAN_STRING == kind && '\\' == *p)) {
+            break;
+        }
+    }
+    return (size_t)(p - cp);
+}
+
+// random runs at every alignment, and up to a page that cannot be read
+static void scan_test(void)
+{
+    static const char chars[] = "aaaaaaaaaaaaZ09.-:[]{\"\\ ,}\t\n\r\v\f\x80\xff";
+    static char buf[256] __attribute__((aligned(16)));
+    long pagesize = sysconf(_SC_PAGESIZE);
+    bool same = true, fits = true;
+    char *page;
+    int off, len, i, k, round;
+
+    srandom(1);
+    for (round = 0; round < 8; round++) {
+        for (off = 0; off < 32; off++) {
+            for (len = 0; len < 80; len++) {
+                // past the NUL, characters that would stop a run
+                (void)memset(buf, 0 == round % 2 ? 'x' : '"', sizeof(buf));
+                for (i = 0; i < len; i++) {
+                    buf[off + i] = chars[random() % (sizeof(chars) - 1)];
+                }
+                buf[off + len] = '\0';
+                for (i = 0; i <= len; i++) {
+                    for (k = 0; k < 3; k++) {
+                        same &= json_scan(buf + off + i, kinds[k]) ==
+                                scan_ref(buf + off + i, kinds[k]);
+                    }
+                }
+            }
+        }
+    }
+    check(same, "runs end where a byte-at-a-time scan ends them");
+
+    page = mmap(NULL, 2 * pagesize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == page ||
+        0 != mprotect(page + pagesize, pagesize, PROT_NONE)) {
+        (void)printf("FAILED: guard page: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    (void)memset(page, 'a', pagesize);
+    page[pagesize - 1] = '\0';
+    for (i = 1; i <= 48; i++) {
+        for (k = 0; k < 3; k++) {
+            fits &= (size_t)(i - 1) == json_scan(page + pagesize - i,
+                                                 kinds[k]);
+        }
+    }
+    (void)munmap(page, 2 * pagesize);
+    check(fits, "and never read off the page holding the NUL");
+}
+
+// the parser, where runs are copied whole
+static void parse_test(void)
+{
+    static char str[JSON_VAL_MAX + 1], shortstr[8];
+    static int ival;
+    static double dval;
+    static bool bval;
+    static const struct json_attr_t attrs[] = {
+        {"s", t_string, .addr.string = str, .len = sizeof(str)},
+        {"short", t_string, .addr.string = shortstr,
+                            .len = sizeof(shortstr)},
+        {"i", t_integer, .addr.integer = &ival},
+        {"d", t_real, .addr.real = &dval},
+        {"b", t_boolean, .addr.boolean = &bval},
+        {NULL},
+    };
+    static char buf[JSON_VAL_MAX * 2] __attribute__((aligned(16)));
+    char name[JSON_ATTR_MAX + 2];
+    bool escaped = true;
+    int off, status;
+
+    // escapes on either side of 16-byte boundaries
+    for (off = 0; off < 16; off++) {
+        (void)strlcpy(buf + off,
+                      "{\"s\":\"0123456789abcd\\\"ef\\\\0123456789abcdef"
+                      "\\n\\u0041BCDEF0123456789\\t\"}", sizeof(buf) - off);
+        status = json_read_object(buf + off, attrs, NULL);
+        escaped &= 0 == status &&
+                   0 == strcmp(str, "0123456789abcd\"ef\\0123456789abcdef"
+                                    "\nABCDEF0123456789\t");
+    }
+    check(escaped, "strings with escapes at every alignment");
+
+    status = json_read_object("{\"short\":\"1234567\"}", attrs, NULL);
+    check(0 == status && 0 == strcmp(shortstr, "1234567"),
+          "a string as long as its buffer holds");
+    status = json_read_object("{\"short\":\"12345678\"}", attrs, NULL);
+    check(JSON_ERR_STRLONG == status, "one longer is too long");
+
+    (void)strlcpy(buf, "{\"s\":\"", sizeof(buf));
+    (void)memset(buf + 6, 'z', JSON_VAL_MAX);
+    (void)strlcpy(buf + 6 + JSON_VAL_MAX, "\"}", 3);
+    status = json_read_object(buf, attrs, NULL);
+    check(0 == status && JSON_VAL_MAX == strlen(str),
+          "a string of JSON_VAL_MAX characters");
+    (void)strlcpy(buf + 6 + JSON_VAL_MAX, "z\"}", 4);
+    check(JSON_ERR_STRLONG == json_read_object(buf, attrs, NULL),
+          "one longer is too long");
+
+    (void)strlcpy(buf, "{\"d\":1.", sizeof(buf));
+    (void)memset(buf + 7, '0', JSON_VAL_MAX - 2);
+    (void)strlcpy(buf + 5 + JSON_VAL_MAX, "}", 2);
+    status = json_read_object(buf, attrs, NULL);
+    check(0 == status && 1.0 == dval, "a token of JSON_VAL_MAX characters");
+    (void)strlcpy(buf + 5 + JSON_VAL_MAX, "0}", 3);
+    check(JSON_ERR_TOKLONG == json_read_object(buf, attrs, NULL),
+          "one longer is too long");
+
+    (void)memset(name, 'n', sizeof(name));
+    name[JSON_ATTR_MAX - 1] = '\0';
+    (void)snprintf(buf, sizeof(buf), "{\"%s\":1}", name);
+    check(JSON_ERR_BADATTR == json_read_object(buf, attrs, NULL),
+          "an attribute name of JSON_ATTR_MAX - 1 characters is looked up");
+    name[JSON_ATTR_MAX - 1] = 'n';
+    name[JSON_ATTR_MAX] = '\0';
+    (void)snprintf(buf, sizeof(buf), "{\"%s\":1}", name);
+    check(JSON_ERR_ATTRLEN == json_read_object(buf, attrs, NULL),
+          "one longer is too long");
+
+    status = json_read_object("{\"i\":42 ,\"b\":true\t,\"d\":-0.5\r\n}",
+                              attrs, NULL);
+    check(0 == status && 42 == ival && bval && -0.5 == dval,
+          "tokens end at white space, commas and braces");
+}
+
+// libgps's class dispatch
+static void class_test(void)
+{
+    static struct gps_data_t gpsdata;
+    const char *end;
+
+    gpsdata.set = 0;
+    check(0 == libgps_json_unpack("{\"class\":\"DEVICES\",\"devices\":[]}",
+                                  &gpsdata, &end) &&
+          0 != (gpsdata.set & DEVICELIST_SET) &&
+          0 == (gpsdata.set & DEVICE_SET),
+          "DEVICES is not DEVICE");
+    gpsdata.set = 0;
+    check(0 == libgps_json_unpack("{\"class\":\"DEVICE\","
+                                  "\"path\":\"/dev/ttyS0\"}",
+                                  &gpsdata, &end) &&
+          0 != (gpsdata.set & DEVICE_SET) &&
+          0 == strcmp(gpsdata.dev.path, "/dev/ttyS0"),
+          "nor DEVICE DEVICES");
+    gpsdata.set = 0;
+    check(0 == libgps_json_unpack("{\"class\":\"IMUBATCH\","
+                                  "\"device\":\"/dev/ttyS0\",\"count\":0}",
+                                  &gpsdata, &end) &&
+          0 != (gpsdata.set & IMUBATCH_SET) &&
+          0 == (gpsdata.set & IMU_SET),
+          "IMUBATCH is not IMU");
+    gpsdata.set = 0;
+    check(0 == libgps_json_unpack("{\"device\":\"/dev/ttyS0\","
+                                  "\"class\":\"TPV\",\"mode\":3}",
+                                  &gpsdata, &end) &&
+          0 != (gpsdata.set & MODE_SET) &&
+          MODE_3D == gpsdata.fix.mode,
+          "a class that does not come first is found");
+    check(-1 == libgps_json_unpack("{\"class\":\"TPVX\",\"mode\":3}",
+                                   &gpsdata, &end) &&
+          -1 == libgps_json_unpack("{\"class\":\"TP\",\"mode\":3}",
+                                   &gpsdata, &end) &&
+          -1 == libgps_json_unpack("{\"class\":3,\"mode\":3}",
+                                   &gpsdata, &end) &&
+          -1 == libgps_json_unpack("{\"mode\":3}", &gpsdata, &end),
+          "unknown, mistyped and missing classes are not");
+}
+
+/* the stand-in daemon: every line, in pieces of odd sizes, then
+ * hang up */
+static void serve(int lsock)
+{
+    static const size_t pieces[] = {1, 3, 17, 100, 4093, 9, 1500, 64};
+    size_t len = 0, off = 0, piece;
+    char *stream;
+    int i, fd = accept(lsock, NULL, NULL);
+
+    if (0 > fd) {
+        exit(EXIT_FAILURE);
+    }
+    stream = malloc(nbytes + nlines);
+    if (NULL == stream) {
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nlines; i++) {
+        size_t n = strlen(lines[i]);
+
+        (void)memcpy(stream + len, lines[i], n);
+        len += n;
+        stream[len++] = '\n';
+    }
+    for (i = 0; off < len; i++) {
+        piece = pieces[i % (sizeof(pieces) / sizeof(pieces[0]))];
+        if (piece > len - off) {
+            piece = len - off;
+        }
+        if (0 >= write(fd, stream + off, piece)) {
+            break;
+        }
+        off += piece;
+    }
+    free(stream);
+    exit(EXIT_SUCCESS);
+}
+
+// stream the lines through gps_read(), return seconds taken
+static double stream_test(const char *name)
+{
+    static struct gps_data_t gpsdata;
+    char message[GPS_JSON_RESPONSE_MAX * 2];
+    struct sockaddr_in sin;
+    socklen_t sinlen = (socklen_t)sizeof(sin);
+    char port[8], what[80];
+    timespec_t start, stop;
+    int lsock, status, got = 0;
+    bool whole = true;
+    pid_t pid;
+
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    (void)memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 > lsock ||
+        0 > bind(lsock, (struct sockaddr *)&sin, sizeof(sin)) ||
+        0 > listen(lsock, 1) ||
+        0 > getsockname(lsock, (struct sockaddr *)&sin, &sinlen)) {
+        (void)printf("FAILED: TCP listen: %s\n", strerror(errno));
+        failures++;
+        return 0;
+    }
+    (void)snprintf(port, sizeof(port), "%u", ntohs(sin.sin_port));
+
+    (void)fflush(stdout);       // or the child's exit() prints it again
+    pid = fork();
+    if (0 == pid) {
+        serve(lsock);
+    }
+    (void)close(lsock);
+
+    if (0 != gps_open("127.0.0.1", port, &gpsdata)) {
+        (void)printf("FAILED: %s: cannot open 127.0.0.1\n", name);
+        failures++;
+        (void)kill(pid, SIGTERM);
+        (void)waitpid(pid, &status, 0);
+        return 0;
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    while (got < nlines &&
+           gps_waiting(&gpsdata, 5000000)) {
+        // drain what is buffered before waiting again
+        do {
+            gpsdata.set = 0;
+            status = gps_read(&gpsdata, message, sizeof(message));
+            if (0 < status) {
+                whole &= 0 == strcmp(message, lines[got]);
+                got++;
+            }
+        } while (0 < status &&
+                 got < nlines);
+        if (0 > status) {
+            break;
+        }
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+    (void)gps_close(&gpsdata);
+    (void)waitpid(pid, &status, 0);
+
+    (void)snprintf(what, sizeof(what),
+                   "%s: every line comes whole, however it is read", name);
+    check(whole && got == nlines, what);
+    return TS_SUB_D(&stop, &start);
+}
+
+// read the lines of a .chk file
+static bool load(const char *path)
+{
+    char line[GPS_JSON_RESPONSE_MAX * 2];
+    FILE *fp;
+
+    if (NULL == (fp = fopen(path, "r"))) {
+        (void)printf("FAILED: cannot open %s\n", path);
+        failures++;
+        return false;
+    }
+    nlines = 0;
+    nbytes = 0;
+    while (nlines < MAXLINES &&
+           NULL != fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\n")] = '\0';
+        if ('{' != line[0]) {
+            continue;
+        }
+        lines[nlines++] = strdup(line);
+        nbytes += strlen(line) + 1;
+    }
+    (void)fclose(fp);
+    return 0 < nlines;
+}
+
+static void unload(void)
+{
+    int i;
+
+    for (i = 0; i < nlines; i++) {
+        free((void *)lines[i]);
+    }
+    nlines = 0;
+}
+
+/* decode a captured stream at each alignment, stream it, and time
+ * decoding it */
+static void log_test(const char *path)
+{
+    static struct gps_data_t a, b;
+    static char buf[GPS_JSON_RESPONSE_MAX * 2 + 16]
+        __attribute__((aligned(16)));
+    timespec_t start, stop;
+    bool same = true;
+    double secs;
+    int i, pass;
+
+    if (!load(path)) {
+        return;
+    }
+    for (i = 0; i < nlines; i++) {
+        int off = 1 + i % 15;
+
+        (void)memset(&a, 0, sizeof(a));
+        (void)memset(&b, 0, sizeof(b));
+        (void)strlcpy(buf, lines[i], sizeof(buf));
+        (void)gps_unpack(buf, &a);
+        (void)strlcpy(buf + off, lines[i], sizeof(buf) - off);
+        (void)gps_unpack(buf + off, &b);
+        same &= 0 == memcmp(&a, &b, sizeof(a));
+    }
+    check(same, "a logged line decodes the same at any alignment");
+
+    secs = stream_test(path);
+    if (!quiet &&
+        0 < secs) {
+        (void)printf("    %s: streamed %d lines, %.1f MB/s\n",
+                     path, nlines, nbytes / secs / 1e6);
+    }
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (pass = 0; pass < PASSES; pass++) {
+        for (i = 0; i < nlines; i++) {
+            (void)strlcpy(buf, lines[i], sizeof(buf));
+            (void)gps_unpack(buf, &a);
+        }
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+    secs = TS_SUB_D(&stop, &start);
+    if (!quiet) {
+        (void)printf("    %s: decoded %.0f ns a line, %.1f MB/s\n",
+                     path, secs * 1e9 / PASSES / nlines,
+                     nbytes * (double)PASSES / secs / 1e6);
+    }
+    unload();
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_jsonscan [-q] [chk-file...]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    scan_test();
+    parse_test();
+    class_test();
+
+    for (nlines = 0; nlines < (int)(sizeof(sample) / sizeof(sample[0]));
+         nlines++) {
+        lines[nlines] = sample[nlines];
+        nbytes += strlen(sample[nlines]) + 1;
+    }
+    (void)stream_test("a line of each class");
+    nlines = 0;
+
+    for (; optind < argc; optind++) {
+        log_test(argv[optind]);
+    }
+
+    if (!quiet || 0 < failures) {
+        (void)printf("jsonscan: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,212 @@
+/* test harness for gpsmon's link statistics
+ *
+ * A receiver on a 9600 baud link is played through the statistics one
+ * packet at a time, with made-up arrival times, and what they say about
+ * its message rates, link load and epochs is checked against what was
+ * played.  Then a pipe is fed noise and a bad sentence to check the
+ * lexer counts them.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/gpsmon.h"
+
+#define START           1632218400      // 2021-09-21T10:00:00Z
+#define EPOCHS          5
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static bool near(double a, double b)
+{
+    return 1e-6 > fabs(a - b);
+}
+
+// play a packet of len bytes, arriving at START + t seconds
+static void play(struct linkstats_t *ls, struct gps_lexer_t *lexer, int type,
+                 const char *start, size_t len, double t)
+{
+    (void)memset(lexer->outbuffer, ' ', len);
+    (void)memcpy(lexer->outbuffer, start, strlen(start));
+    lexer->outbuflen = len;
+    lexer->type = type;
+    lexer->out_time.tv_sec = START + (time_t)t;
+    lexer->out_time.tv_nsec = (long)((t - (time_t)t) * 1e9 + 0.5);
+    lexer->char_counter += len;
+    linkstats_packet(ls, lexer);
+}
+
+static const struct linkstat_class_t *find(const struct linkstats_t *ls,
+                                           const char *name)
+{
+    int i;
+
+    for (i = 0; i < ls->nclasses; i++) {
+        if (0 == strcmp(ls->classes[i].name, name)) {
+            return &ls->classes[i];
+        }
+    }
+    return NULL;
+}
+
+static void stats_test(void)
+{
+    static struct gps_lexer_t lexer;
+    static struct linkstats_t ls;
+    const struct linkstat_class_t *gga, *rmc, *ubx;
+    timespec_t now = {START, 0};
+    timespec_t cycle = {1, 0};
+    char buf[BUFSIZ];
+    int i;
+
+    linkstats_init(&ls, &now);
+    linkstats_link(&ls, 9600, 1, 'N', &cycle);
+    /* GGA on the second, then RMC, then a UBX NAV-PVT: the epoch ends
+     * when the last byte of that is out, 100 bytes at 960 a second */
+    for (i = 0; i < EPOCHS; i++) {
+        play(&ls, &lexer, NMEA_PACKET, "$GPGGA,", 72, i);
+        play(&ls, &lexer, NMEA_PACKET, "$GPRMC,", 70, i + 0.080);
+        play(&ls, &lexer, UBX_PACKET, "\xb5\x62\x01\x07", 100, i + 0.160);
+    }
+    gga = find(&ls, "GPGGA");
+    rmc = find(&ls, "GPRMC");
+    ubx = find(&ls, "UBX-01-07");
+    check(3 == ls.nclasses && NULL != gga && NULL != rmc && NULL != ubx,
+          "message classes named");
+    if (NULL == gga || NULL == rmc || NULL == ubx) {
+        return;
+    }
+    check(EPOCHS == gga->count && EPOCHS * 100 == ubx->bytes,
+          "counts and bytes");
+    check(near(1.0, gga->interval) && near(0.0, gga->jitter),
+          "steady interval, no jitter");
+    check(near(0.160 + 100 * 10 / 9600.0, ls.epoch) &&
+          near(ls.epoch, ls.epoch_max),
+          "epoch runs to the last byte of the last packet");
+
+    lexer.discard_counter = 7;
+    lexer.bad_counter = 2;
+    now.tv_sec = START + EPOCHS - 1;
+    now.tv_nsec = 500000000;
+    check(linkstats_tick(&ls, &lexer, &now), "rates after a second");
+    check(near(EPOCHS / (EPOCHS - 0.5), gga->hz) &&
+          near(EPOCHS * 242 / (EPOCHS - 0.5), ls.bps) &&
+          near(EPOCHS * 72 / (EPOCHS - 0.5), gga->bps),
+          "message and link rates");
+    check(7 == ls.discards && 2 == ls.bad &&
+          EPOCHS * 242 == ls.chars,
+          "lexer counters");
+    now.tv_nsec = 900000000;
+    check(!linkstats_tick(&ls, &lexer, &now),
+          "no rates before the next second");
+
+    (void)linkstats_panel(&ls, buf, sizeof(buf));
+    check(NULL != strstr(buf, "Link 9600 8N1") &&
+          NULL != strstr(buf, "UBX-01-07"),
+          "panel");
+    (void)linkstats_json(&ls, buf, sizeof(buf));
+    check(NULL != strstr(buf, "{\"class\":\"LINKSTATS\",") &&
+          NULL != strstr(buf, "\"baudrate\":9600,\"framing\":\"8N1\"") &&
+          NULL != strstr(buf, "{\"name\":\"GPGGA\",\"count\":5,") &&
+          '\n' == buf[strlen(buf) - 1],
+          "JSON dump");
+
+    // a wobbly GGA gets jitter, a full table an "other"
+    for (i = 0; i < 40; i++) {
+        play(&ls, &lexer, NMEA_PACKET, "$GPGGA,", 72,
+             EPOCHS + i + (i % 2 ? 0.1 : -0.1));
+    }
+    check(0.1 < gga->jitter && 0.3 > gga->jitter, "jitter");
+    for (i = 0; i < 30; i++) {
+        char tag[12];
+
+        (void)snprintf(tag, sizeof(tag), "$PX%03d,", i);
+        play(&ls, &lexer, NMEA_PACKET, tag, 20, 100 + i);
+    }
+    check(LINKSTAT_CLASSES == ls.nclasses &&
+          0 == strcmp("other", ls.classes[LINKSTAT_CLASSES - 1].name) &&
+          30 - (LINKSTAT_CLASSES - 4) ==
+              (int)ls.classes[LINKSTAT_CLASSES - 1].count,
+          "classes past the table lumped together");
+
+    linkstats_link(&ls, 38400, 2, 'E', NULL);
+    check(12 == ls.charbits && 0 == strcmp("8E2", ls.framing) &&
+          near(1.0, ls.cycle),
+          "link framing");
+}
+
+// the lexer counts the noise it throws away, and the bad packets
+static void lexer_test(void)
+{
+    static const char input[] =
+        "noise"
+        "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*48\r\n"
+        "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+    struct gps_lexer_t lexer;
+    int fds[2];
+    int good = 0;
+
+    if (0 != pipe(fds)) {
+        check(false, "pipe");
+        return;
+    }
+    (void)fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    lexer_init(&lexer);
+    (void)write(fds[1], input, sizeof(input) - 1);
+    while (0 < packet_get(fds[0], &lexer)) {
+        if (NMEA_PACKET == lexer.type) {
+            good++;
+        }
+    }
+    check(1 == good && 5 <= lexer.discard_counter && 1 == lexer.bad_counter,
+          "lexer counts discards and bad packets");
+    (void)close(fds[0]);
+    (void)close(fds[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_linkstats [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    stats_test();
+    lexer_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("linkstats: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,421 @@
+/* test harness for the device output queues
+ *
+ * A pipe stands in for a slow serial link: it is filled until it will
+ * take no more, then commands and RTCM are written to it the way the
+ * daemon does, to check that no write waits for the link, and that
+ * the RTCM policies rework only what has not gone out yet.  Then the
+ * pipe is read, to check what the link finally got, and in what order.
+ * The drain is also run against a pty read slowly by a child process,
+ * the way a real serial port takes its output.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+#define QUICK           0.050           // seconds a queued write may take
+
+static bool quiet = false;
+static int failures = 0;
+
+static struct gps_context_t context;
+static struct gps_device_t session;
+static int link_rx = -1;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+// a fresh device on a pipe with no room left in it
+static bool open_link(int policy)
+{
+    char fill[BUFSIZ];
+    int fds[2];
+
+    if (0 <= link_rx) {
+        (void)close(link_rx);
+        (void)close(session.gpsdata.gps_fd);
+    }
+    if (0 != pipe(fds)) {
+        return false;
+    }
+    (void)fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    (void)fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    (void)memset(fill, '.', sizeof(fill));
+    while (0 < write(fds[1], fill, sizeof(fill))) {
+        continue;
+    }
+    while (0 < write(fds[1], fill, 1)) {
+        continue;
+    }
+    free(session.outq.buf);             // the last test's
+    gpsd_init(&session, &context, "/dev/test");
+    session.gpsdata.gps_fd = fds[1];
+    context.outq_policy = policy;
+    link_rx = fds[0];
+    return true;
+}
+
+// write a message the way all_reports() relays RTCM
+static ssize_t rtcm(const char *msg, unsigned type, unsigned long epoch)
+{
+    ssize_t status;
+
+    session.outq.kind = OUTQ_RTCM;
+    session.outq.type = type;
+    session.outq.epoch = epoch;
+    status = context.serial_write(&session, msg, strlen(msg));
+    session.outq.kind = OUTQ_CONFIG;
+    return status;
+}
+
+static ssize_t command(const char *msg)
+{
+    return context.serial_write(&session, msg, strlen(msg));
+}
+
+/* empty the pipe, flushing the queue into it, and return what came
+ * after the filler */
+static const char *link_output(void)
+{
+    static char out[OUTQ_SIZE + 1];
+    char buf[BUFSIZ];
+    size_t len = 0;
+    ssize_t got;
+    int tries;
+
+    for (tries = 0; tries < 1000; tries++) {
+        while (0 < (got = read(link_rx, buf, sizeof(buf)))) {
+            ssize_t i;
+
+            for (i = 0; i < got; i++) {
+                if ('.' != buf[i] && sizeof(out) - 1 > len) {
+                    out[len++] = buf[i];
+                }
+            }
+        }
+        if (0 == session.outq.nmsgs) {
+            break;
+        }
+        (void)gpsd_outq_flush(&session);
+    }
+    out[len] = '\0';
+    return out;
+}
+
+static void nowait_test(void)
+{
+    timespec_t before, after;
+    ssize_t status;
+    int i;
+
+    if (!open_link(0)) {
+        check(false, "pipe");
+        return;
+    }
+    check(NULL == session.outq.buf, "no queue buffer before a write waits");
+    (void)clock_gettime(CLOCK_REALTIME, &before);
+    status = command("A");
+    for (i = 0; i < 10; i++) {
+        (void)rtcm("r", 1005, i);
+    }
+    (void)clock_gettime(CLOCK_REALTIME, &after);
+    check(1 == status && 11 == session.outq.nmsgs,
+          "writes to a full link are queued");
+    check(QUICK > TS_SUB_D(&after, &before), "and do not wait for it");
+    check(0 == gpsd_outq_flush(&session) && 11 == session.outq.nmsgs,
+          "a flush with no room writes nothing");
+    check(0 == strcmp("Arrrrrrrrrr", link_output()) &&
+          0 == session.outq.nmsgs && 0 == session.outq.len,
+          "the queue goes out in order once there is room");
+    check(3 == command("now") && 0 == session.outq.nmsgs &&
+          0 == strcmp("now", link_output()),
+          "an empty queue writes straight through");
+}
+
+static void policy_test(void)
+{
+    if (!open_link(OUTQ_COALESCE)) {
+        check(false, "pipe");
+        return;
+    }
+    (void)rtcm("a1", 1005, 1);
+    (void)rtcm("b1", 1077, 1);
+    (void)rtcm("a2", 1005, 2);
+    check(0 == strcmp("b1a2", link_output()) && 1 == session.outq.dropped,
+          "coalesce replaces an older message of the type");
+
+    (void)open_link(OUTQ_STALE);
+    (void)rtcm("a1", 1005, 1);
+    (void)rtcm("b1", 1077, 1);
+    (void)rtcm("a2", 1005, 2);
+    (void)rtcm("b2", 1077, 2);
+    check(0 == strcmp("a2b2", link_output()) && 2 == session.outq.dropped,
+          "a new epoch drops the stale one");
+
+    (void)open_link(OUTQ_PRIORITY);
+    (void)rtcm("a1", 1005, 1);
+    (void)command("X");
+    (void)rtcm("b1", 1077, 1);
+    (void)command("Y");
+    check(0 == strcmp("XYa1b1", link_output()),
+          "commands go ahead of RTCM, in their own order");
+
+    (void)open_link(0);
+    (void)rtcm("a1", 1005, 1);
+    (void)command("X");
+    (void)rtcm("a2", 1005, 2);
+    check(0 == strcmp("a1Xa2", link_output()) && 0 == session.outq.dropped,
+          "no policy, no reordering");
+}
+
+// a message half out is never dropped or overtaken
+static void partial_test(void)
+{
+    char big[OUTQ_SIZE / 2];
+    char buf[4096];
+    const char *out;
+    ssize_t got;
+
+    if (!open_link(OUTQ_STALE | OUTQ_PRIORITY)) {
+        check(false, "pipe");
+        return;
+    }
+    // make room for part of the message
+    got = read(link_rx, buf, sizeof(buf));
+    (void)memset(big, 'o', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    (void)rtcm(big, 1005, 1);
+    check(0 < got && 1 == session.outq.nmsgs &&
+          0 < session.outq.sent && sizeof(big) - 1 > session.outq.sent,
+          "what fits goes straight out, the rest is queued");
+    (void)rtcm("b2", 1077, 2);
+    (void)command("X");
+    out = link_output();
+    check(sizeof(big) + 2 == strlen(out) &&
+          0 == strcmp("Xb2", out + sizeof(big) - 1),
+          "the message being sent is kept whole, and first");
+}
+
+static void room_test(void)
+{
+    char msg[OUTQ_SIZE / 4];
+    ssize_t status;
+    int i;
+
+    if (!open_link(0)) {
+        check(false, "pipe");
+        return;
+    }
+    (void)memset(msg, 'r', sizeof(msg) - 1);
+    msg[sizeof(msg) - 1] = '\0';
+    for (i = 0; i < 4; i++) {
+        msg[0] = (char)('0' + i);
+        (void)rtcm(msg, 1005, 0);
+    }
+    check(4 == session.outq.nmsgs && 0 == session.outq.dropped,
+          "queue full");
+    msg[0] = 'C';
+    status = command(msg);
+    check(0 < status && 4 == session.outq.nmsgs &&
+          1 == session.outq.dropped &&
+          '1' == session.outq.buf[0],
+          "a full queue drops the oldest RTCM to make room");
+
+    (void)open_link(0);
+    for (i = 0; i < 4; i++) {
+        (void)command(msg);
+    }
+    check(-1 == command(msg) && 4 == session.outq.nmsgs,
+          "a full queue of commands refuses more");
+    (void)open_link(0);
+    for (i = 0; i < OUTQ_MSGS; i++) {
+        (void)rtcm("r", 1005, 0);
+    }
+    check(0 < rtcm("s", 1005, 0) && OUTQ_MSGS == session.outq.nmsgs &&
+          1 == session.outq.dropped,
+          "so does a full message table");
+}
+
+static void drain_test(void)
+{
+    char buf[BUFSIZ];
+    ssize_t got;
+
+    if (!open_link(0)) {
+        check(false, "pipe");
+        return;
+    }
+    (void)command("abc");
+    (void)rtcm("def", 1005, 0);
+    while (0 < (got = read(link_rx, buf, sizeof(buf)))) {
+        continue;
+    }
+    gpsd_outq_drain(&session);
+    got = read(link_rx, buf, sizeof(buf));
+    check(0 == session.outq.nmsgs && 6 == got &&
+          0 == memcmp("abcdef", buf, 6),
+          "drain sends the queue");
+}
+
+// a link gone dead drops its queue
+static void error_test(void)
+{
+    if (!open_link(0)) {
+        check(false, "pipe");
+        return;
+    }
+    (void)command("abc");
+    (void)close(link_rx);
+    link_rx = -1;
+    // the errors are expected, keep them out of the output
+    context.errout.debug = LOG_ERROR - 1;
+    check(-1 == gpsd_outq_flush(&session) &&
+          0 == session.outq.nmsgs && 0 == session.outq.len,
+          "a write error drops the queue");
+    check(-1 == command("def") && 0 == session.outq.nmsgs,
+          "and a direct write is refused");
+    context.errout.debug = LOG_ERROR;
+    (void)close(session.gpsdata.gps_fd);
+    session.gpsdata.gps_fd = -1;
+}
+
+// the child takes what the pty gets, a little at a time, into out
+static void slow_reader(int master, int out)
+{
+    struct timespec pause = {0, 1000000};
+    char buf[64];
+    ssize_t got;
+
+    while (0 < (got = read(master, buf, sizeof(buf)))) {
+        if (got != write(out, buf, (size_t)got)) {
+            _exit(EXIT_FAILURE);
+        }
+        (void)nanosleep(&pause, NULL);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+static void pty_test(void)
+{
+    char fill[BUFSIZ], out[64], buf[BUFSIZ];
+    struct termios t;
+    size_t len = 0;
+    ssize_t got;
+    int master, slave, back[2], status;
+    pid_t pid;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (0 > master ||
+        0 != grantpt(master) ||
+        0 != unlockpt(master) ||
+        0 > (slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK)) ||
+        0 != tcgetattr(slave, &t) ||
+        0 != pipe(back)) {
+        check(false, "pty");
+        return;
+    }
+    cfmakeraw(&t);
+    (void)cfsetospeed(&t, B9600);
+    (void)tcsetattr(slave, TCSANOW, &t);
+    (void)memset(fill, '.', sizeof(fill));
+    while (0 < write(slave, fill, sizeof(fill))) {
+        continue;
+    }
+    free(session.outq.buf);
+    gpsd_init(&session, &context, ptsname(master));
+    session.gpsdata.gps_fd = slave;
+    context.outq_policy = 0;
+    (void)command("abc");
+    (void)rtcm("def", 1005, 0);
+    check(2 == session.outq.nmsgs, "writes to a full pty are queued");
+
+    pid = fork();
+    if (0 > pid) {
+        check(false, "fork");
+        return;
+    }
+    if (0 == pid) {
+        (void)close(slave);
+        (void)close(back[0]);
+        slow_reader(master, back[1]);
+    }
+    (void)close(back[1]);
+    gpsd_outq_drain(&session);
+    check(0 == session.outq.nmsgs, "drain waits for a slow pty");
+    // hang up, so the reader sees the end
+    (void)close(slave);
+    session.gpsdata.gps_fd = -1;
+    while (0 < (got = read(back[0], buf, sizeof(buf)))) {
+        ssize_t i;
+
+        for (i = 0; i < got; i++) {
+            if ('.' != buf[i] && sizeof(out) - 1 > len) {
+                out[len++] = buf[i];
+            }
+        }
+    }
+    out[len] = '\0';
+    (void)close(back[0]);
+    (void)close(master);
+    (void)waitpid(pid, &status, 0);
+    check(0 == strcmp("abcdef", out) &&
+          WIFEXITED(status) && EXIT_SUCCESS == WEXITSTATUS(status),
+          "and the pty gets all of the queue, in order");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_outq [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    gps_context_init(&context, "test_outq");
+    context.errout.debug = LOG_ERROR;
+    context.serial_write = gpsd_queue_write;
+    // a write to a closed pipe must fail, not kill the test
+    (void)signal(SIGPIPE, SIG_IGN);
+
+    nowait_test();
+    policy_test();
+    partial_test();
+    room_test();
+    drain_test();
+    error_test();
+    pty_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("outq: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
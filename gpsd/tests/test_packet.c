@@ -323,6 +323,66 @@ static void runon_test(struct map *mp)
     (void)close(nullfd);
 }
 
+/* lines from another gpsd, some arriving split across reads, must
+ * come out whole, CR-LF and all; other packets still get lexed */
+static int relay_test(void)
+{
+    static const char *reads[] = {
+        "{\"class\":\"TPV\",\"mode\":3}\r\n"
+            "$GPVTG,308.74,T,,M,0.00,N,0.0,K*68\r\n{\"class\":\"SK",
+        "Y\",\"nSat\":0}\r\n",
+    };
+    static const struct {
+        int type;
+        const char *packet;
+    } expect[] = {
+        {JSON_PACKET, "{\"class\":\"TPV\",\"mode\":3}\r\n"},
+        {NMEA_PACKET, "$GPVTG,308.74,T,,M,0.00,N,0.0,K*68\r\n"},
+        {JSON_PACKET, "{\"class\":\"SKY\",\"nSat\":0}\r\n"},
+    };
+    struct gps_lexer_t lexer;
+    int fds[2];
+    size_t i, n = 0;
+    int failure = 0;
+
+    if (0 != pipe(fds)) {
+        (void)fprintf(stderr, "pipe() failed! errno %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    (void)fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    lexer_init(&lexer);
+    lexer.errout.debug = verbose;
+    for (i = 0; i < sizeof(reads) / sizeof(reads[0]); i++) {
+        if (0 > write(fds[1], reads[i], strlen(reads[i]))) {
+            exit(EXIT_FAILURE);
+        }
+        while (0 < packet_get_json(fds[0], &lexer)) {
+            if (sizeof(expect) / sizeof(expect[0]) <= n ||
+                lexer.type != expect[n].type ||
+                lexer.outbuflen != strlen(expect[n].packet) ||
+                0 != memcmp(lexer.outbuffer, expect[n].packet,
+                            lexer.outbuflen)) {
+                printf("relayed packet %zu FAILED: type %d %s\n",
+                       n + 1, lexer.type, lexer.outbuffer);
+                ++failure;
+            } else {
+                // less its CR-LF
+                printf("relayed packet %zu, type %d: %.*s\n",
+                       n + 1, lexer.type, (int)lexer.outbuflen - 2,
+                       lexer.outbuffer);
+            }
+            n++;
+        }
+    }
+    if (sizeof(expect) / sizeof(expect[0]) != n) {
+        printf("relay test FAILED, %zu packets\n", n);
+        ++failure;
+    }
+    (void)close(fds[0]);
+    (void)close(fds[1]);
+    return failure;
+}
+
 static int property_check(void)
 {
     const struct gps_type_t **dp;
@@ -415,6 +475,8 @@ int main(int argc, char *argv[])
             failcount += packet_test(mp);
         (void)fputs("=== EOF with buffer nonempty test ===\n", stdout);
         runon_test(&runontests[0]);
+        (void)fputs("=== JSON relay framing test ===\n", stdout);
+        failcount += relay_test();
     }
     exit(failcount > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
 }
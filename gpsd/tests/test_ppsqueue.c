@@ -0,0 +1,152 @@
+/* test harness for ppsqueue.c, PPS messages handed to the main loop
+ *
+ * Checks that messages come out in the order they went in, that a full
+ * ring drops, and that a producer thread racing the consumer loses
+ * nothing it was not told it lost.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+#define MESSAGES        200000          // the producer thread puts
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void queue_test(void)
+{
+    static struct gps_ppsq_t q;
+    char buf[PPSQ_MSG_MAX], want[16], big[PPSQ_MSG_MAX * 2];
+    bool ok = true;
+    int i;
+
+    gpsd_ppsq_init(&q);
+    check(!gpsd_ppsq_get(&q, buf, sizeof(buf)), "a new queue is empty");
+
+    for (i = 0; i < PPSQ_SIZE; i++) {
+        (void)snprintf(want, sizeof(want), "PPS%d", i);
+        ok &= gpsd_ppsq_put(&q, want);
+    }
+    check(ok, "it holds PPSQ_SIZE messages");
+    check(!gpsd_ppsq_put(&q, "late") && 1 == q.dropped,
+          "a full queue drops, and counts it");
+    for (i = 0; i < PPSQ_SIZE; i++) {
+        (void)snprintf(want, sizeof(want), "PPS%d", i);
+        ok &= gpsd_ppsq_get(&q, buf, sizeof(buf)) &&
+              0 == strcmp(buf, want);
+    }
+    check(ok && !gpsd_ppsq_get(&q, buf, sizeof(buf)),
+          "they come out in order, then none");
+
+    (void)memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    check(gpsd_ppsq_put(&q, big) &&
+          gpsd_ppsq_get(&q, buf, sizeof(buf)) &&
+          PPSQ_MSG_MAX - 1 == strlen(buf),
+          "a long message is cut to fit");
+}
+
+static struct gps_ppsq_t raced;
+static atomic_bool finished;
+
+static void *producer(void *arg UNUSED)
+{
+    char msg[16];
+    int i;
+
+    for (i = 0; i < MESSAGES; i++) {
+        (void)snprintf(msg, sizeof(msg), "%d", i);
+        if (!gpsd_ppsq_put(&raced, msg)) {
+            // give the consumer a turn, on one CPU too
+            (void)sched_yield();
+        }
+    }
+    atomic_store(&finished, true);
+    return NULL;
+}
+
+static void race_test(void)
+{
+    pthread_t thread;
+    char buf[PPSQ_MSG_MAX];
+    long last = -1, got = 0;
+    bool ordered = true;
+
+    gpsd_ppsq_init(&raced);
+    atomic_init(&finished, false);
+    if (0 != pthread_create(&thread, NULL, producer, NULL)) {
+        (void)printf("FAILED: pthread_create()\n");
+        failures++;
+        return;
+    }
+    for (;;) {
+        // read before the get, so the last messages are not missed
+        bool over = atomic_load(&finished);
+        long n;
+
+        if (!gpsd_ppsq_get(&raced, buf, sizeof(buf))) {
+            if (over) {
+                break;
+            }
+            continue;
+        }
+        n = atol(buf);
+        ordered &= last < n;
+        last = n;
+        got++;
+    }
+    (void)pthread_join(thread, NULL);
+    if (!quiet) {
+        (void)printf("    %ld of %d taken, %lu dropped\n",
+                     got, MESSAGES, raced.dropped);
+    }
+    check(ordered && MESSAGES == got + (long)raced.dropped,
+          "with a racing producer, in order, each taken or counted dropped");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_ppsqueue [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    queue_test();
+    race_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("ppsqueue: %d failures\n", failures);
+    }
+    return 0 < failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+// vim: set expandtab shiftwidth=4
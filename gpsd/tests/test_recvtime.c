@@ -0,0 +1,214 @@
+/* test harness for the lexer's input arrival times
+ *
+ * A local UDP sender stands in for a network source, and a pipe for a
+ * tty.  Each packet is left waiting a while before it is read, the
+ * way it is when gpsd is busy with other devices, to check that it is
+ * still timed by when it arrived.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+#define BUSY_NS         50000000L       // how long a packet waits, 50 ms
+#define ACCURACY        0.010           // seconds a kernel stamp may be off
+
+static bool quiet = false;
+static int failures = 0;
+
+static const char gga[] =
+    "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void busy(void)
+{
+    struct timespec delay = {0, BUSY_NS};
+
+    (void)nanosleep(&delay, NULL);
+}
+
+// seconds from sent to when the lexer says the packet arrived
+static double latency(const timespec_t *sent, struct gps_lexer_t *lexer)
+{
+    double late = TS_SUB_D(&lexer->out_time, sent);
+
+    if (!quiet) {
+        (void)printf("    packet type %d arrived %.6f s after sending\n",
+                     lexer->type, late);
+    }
+    return late;
+}
+
+// gpsd reads with O_NONBLOCK, so packet_get() never waits
+static void nonblock(int fd)
+{
+    (void)fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// a connected pair of loopback UDP sockets
+static bool udp_pair(int *rx, int *tx)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    *rx = socket(AF_INET, SOCK_DGRAM, 0);
+    *tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (0 > *rx || 0 > *tx) {
+        return false;
+    }
+    nonblock(*rx);
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    return 0 == bind(*rx, (struct sockaddr *)&addr, sizeof(addr)) &&
+           0 == getsockname(*rx, (struct sockaddr *)&addr, &len) &&
+           0 == connect(*tx, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+static void udp_test(void)
+{
+    struct gps_lexer_t lexer;
+    timespec_t sent, first;
+    char two[2 * sizeof(gga)];
+    double late;
+    int rx, tx;
+
+    if (!udp_pair(&rx, &tx)) {
+        check(false, "loopback UDP sockets");
+        return;
+    }
+    lexer_init(&lexer);
+    if (!packet_kernel_time(rx, &lexer)) {
+        if (!quiet) {
+            (void)printf("skipped: no kernel stamps here\n");
+        }
+        (void)close(rx);
+        (void)close(tx);
+        return;
+    }
+
+    (void)clock_gettime(CLOCK_REALTIME, &sent);
+    (void)send(tx, gga, sizeof(gga) - 1, 0);
+    busy();
+    late = 0 < packet_get(rx, &lexer) ? latency(&sent, &lexer) : -1;
+    check(0 <= late && ACCURACY > late,
+          "datagram timed by the kernel, not by the late read");
+
+    // a packet split across datagrams is timed by its first byte
+    (void)clock_gettime(CLOCK_REALTIME, &first);
+    (void)send(tx, gga, 20, 0);
+    busy();
+    (void)packet_get(rx, &lexer);
+    (void)clock_gettime(CLOCK_REALTIME, &sent);
+    (void)send(tx, gga + 20, sizeof(gga) - 21, 0);
+    busy();
+    late = 0 < packet_get(rx, &lexer) ? latency(&first, &lexer) : -1;
+    check(0 <= late && ACCURACY > late,
+          "split packet timed by its first datagram");
+
+    // a packet starting in the tail of a datagram is timed by that one
+    (void)memcpy(two, gga, sizeof(gga) - 1);
+    (void)memcpy(two + sizeof(gga) - 1, gga, 20);
+    (void)clock_gettime(CLOCK_REALTIME, &first);
+    (void)send(tx, two, sizeof(gga) + 19, 0);
+    busy();
+    (void)packet_get(rx, &lexer);
+    (void)send(tx, gga + 20, sizeof(gga) - 21, 0);
+    busy();
+    late = 0 < packet_get(rx, &lexer) ? latency(&first, &lexer) : -1;
+    check(0 <= late && ACCURACY > late,
+          "packet begun in an earlier datagram timed by it");
+
+    // and one starting after the tail of another by the later datagram
+    (void)send(tx, gga, 20, 0);
+    busy();
+    (void)packet_get(rx, &lexer);
+    (void)memcpy(two, gga + 20, sizeof(gga) - 21);
+    (void)memcpy(two + sizeof(gga) - 21, gga, sizeof(gga) - 1);
+    (void)clock_gettime(CLOCK_REALTIME, &sent);
+    (void)send(tx, two, 2 * sizeof(gga) - 22, 0);
+    busy();
+    (void)packet_get(rx, &lexer);
+    late = 0 < packet_get(rx, &lexer) ? latency(&sent, &lexer) : -1;
+    check(0 <= late && ACCURACY > late,
+          "packet begun in a later datagram timed by it");
+
+    (void)close(rx);
+    (void)close(tx);
+}
+
+// a pipe has no kernel stamps, so the read is stamped
+static void pipe_test(void)
+{
+    struct gps_lexer_t lexer;
+    timespec_t sent;
+    double late;
+    int fds[2];
+
+    if (0 != pipe(fds)) {
+        check(false, "pipe");
+        return;
+    }
+    nonblock(fds[0]);
+    lexer_init(&lexer);
+    check(!packet_kernel_time(fds[0], &lexer), "no kernel stamps on a pipe");
+
+    (void)clock_gettime(CLOCK_REALTIME, &sent);
+    (void)write(fds[1], gga, sizeof(gga) - 1);
+    busy();
+    late = 0 < packet_get(fds[0], &lexer) ? latency(&sent, &lexer) : -1;
+    check(BUSY_NS / 1e9 <= late && BUSY_NS / 1e9 + 1.0 > late,
+          "pipe packet timed by its read");
+
+    (void)close(fds[0]);
+    (void)close(fds[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_recvtime [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    udp_test();
+    pipe_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("recvtime: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,280 @@
+/* test harness for rtsched.c, real-time controls for PPS threads
+ *
+ * Checks CPU lists, pinning, SCHED_FIFO where we may have it, and the
+ * edge latency distribution, then times how late a thread wakes for
+ * a deadline, as a PPS thread does for an edge, at the default policy
+ * and pinned under SCHED_FIFO with its memory locked.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/rtsched.h"
+#include "../include/timespec.h"
+
+#define WAKES           200             // deadlines to time
+#define PERIOD_NS       1000000         // between them, 1 ms
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void cpus_test(void)
+{
+    static const char *bad[] = {"", "a", "2-1", "1024", "0,", ",0", "-1",
+                                "1,,2", "0 ", "1-", "3x"};
+    struct rt_cpus_t cpus;
+    bool ok = true;
+    size_t i;
+
+    check(rt_cpus_parse("0", &cpus) &&
+          1 == cpus.count && rt_cpus_isset(&cpus, 0) &&
+          !rt_cpus_isset(&cpus, 1),
+          "a CPU parses");
+    check(rt_cpus_parse("0,2-3", &cpus) &&
+          3 == cpus.count && rt_cpus_isset(&cpus, 0) &&
+          !rt_cpus_isset(&cpus, 1) && rt_cpus_isset(&cpus, 2) &&
+          rt_cpus_isset(&cpus, 3) && !rt_cpus_isset(&cpus, 4),
+          "CPUs and ranges parse");
+    check(rt_cpus_parse("1-2,2,1", &cpus) &&
+          2 == cpus.count,
+          "a CPU named twice counts once");
+    check(rt_cpus_parse("1023", &cpus) &&
+          rt_cpus_isset(&cpus, RT_CPUS_MAX - 1) &&
+          !rt_cpus_isset(&cpus, RT_CPUS_MAX) &&
+          !rt_cpus_isset(&cpus, -1),
+          "the highest CPU parses, and no higher is set");
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        if (rt_cpus_parse(bad[i], &cpus) ||
+            0 != cpus.count) {
+            (void)printf("FAILED: \"%s\" parsed\n", bad[i]);
+            ok = false;
+        }
+    }
+    check(ok, "what is not a CPU list does not parse, and sets none");
+
+    check(!rt_prio_valid(0) && rt_prio_valid(1) &&
+          rt_prio_valid(sched_get_priority_max(SCHED_FIFO)) &&
+          !rt_prio_valid(sched_get_priority_max(SCHED_FIFO) + 1),
+          "SCHED_FIFO priorities are checked");
+}
+
+static void pin_test(void)
+{
+#ifdef __linux__
+    cpu_set_t was, now;
+    struct rt_cpus_t cpus;
+    char list[16];
+    int cpu;
+
+    if (0 != sched_getaffinity(0, sizeof(was), &was)) {
+        (void)printf("FAILED: sched_getaffinity: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    for (cpu = 0; cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &was); cpu++) {
+        continue;
+    }
+    (void)snprintf(list, sizeof(list), "%d", cpu);
+    check(rt_cpus_parse(list, &cpus) && 0 == rt_pin(&cpus),
+          "the thread pins to a CPU it may run on");
+    (void)sched_getaffinity(0, sizeof(now), &now);
+    check(1 == CPU_COUNT(&now) && CPU_ISSET(cpu, &now),
+          "and runs there alone");
+    (void)sched_setaffinity(0, sizeof(was), &was);
+#else
+    if (!quiet) {
+        (void)puts("ok: no CPU pinning here");
+    }
+#endif  // __linux__
+}
+
+static void fifo_test(void)
+{
+    struct sched_param param;
+    int policy = -1;
+    int err = rt_fifo(1);
+
+    if (EPERM == err) {
+        if (!quiet) {
+            (void)puts("ok: not permitted SCHED_FIFO, and told so");
+        }
+        return;
+    }
+    check(0 == err, "the thread goes SCHED_FIFO");
+    (void)pthread_getschedparam(pthread_self(), &policy, &param);
+    check(SCHED_FIFO == policy && 1 == param.sched_priority,
+          "at the priority asked");
+    memset(&param, 0, sizeof(param));
+    (void)pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+}
+
+static void latency_test(void)
+{
+    static long ns[1000];
+    static long few[10];
+    struct rt_latency_t lat;
+    char *text = NULL;
+    size_t textlen = 0;
+    FILE *fp;
+    long i;
+
+    rt_latency_init(&lat, ns, 1000);
+    check(0 == rt_latency_percentile(&lat, 50.0),
+          "no samples have a percentile of 0");
+    // 1 us to 1 ms, backwards
+    for (i = 1000; 0 < i; i--) {
+        rt_latency_add(&lat, i * 1000);
+    }
+    check(1000 == lat.n && 0 == lat.dropped, "samples are kept");
+    check(1000 == rt_latency_percentile(&lat, 0.0) &&
+          500000 == rt_latency_percentile(&lat, 50.0) &&
+          990000 == rt_latency_percentile(&lat, 99.0) &&
+          999000 == rt_latency_percentile(&lat, 99.9) &&
+          1000000 == rt_latency_percentile(&lat, 100.0),
+          "percentiles are by nearest rank");
+
+    fp = open_memstream(&text, &textlen);
+    if (NULL == fp) {
+        (void)printf("FAILED: open_memstream: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    rt_latency_report(&lat, fp, "test latency");
+    (void)fclose(fp);
+    check(NULL != strstr(text, "# test latency: 1000 edges\n") &&
+          NULL != strstr(text, "     1000   500000   900000   990000"
+                               "   999000  1000000\n"),
+          "the report gives count and percentiles");
+    // 1 us in [1, 2), 1000 us in [512, 1024), 489 of them
+    check(NULL != strstr(text, "#   <       2 us          1\n") &&
+          NULL != strstr(text, "#   <    1024 us        489\n") &&
+          NULL == strstr(text, "#   <    2048 us"),
+          "and a histogram in powers of two microseconds");
+    free(text);
+
+    rt_latency_init(&lat, few, 10);
+    for (i = 0; i < 15; i++) {
+        rt_latency_add(&lat, -i);
+    }
+    check(10 == lat.n && 5 == lat.dropped &&
+          -9 == rt_latency_percentile(&lat, 0.0),
+          "samples past the room are counted, not kept");
+}
+
+/* Wake for WAKES deadlines PERIOD_NS apart, as a PPS thread wakes for
+ * an edge, and show how late. */
+static void wakes(const char *what)
+{
+    static long ns[WAKES];
+    struct rt_latency_t lat;
+    struct timespec deadline;
+    int i;
+
+    rt_latency_init(&lat, ns, WAKES);
+    (void)clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (i = 0; i < WAKES; i++) {
+        struct timespec woke;
+
+        deadline.tv_nsec += PERIOD_NS;
+        TS_NORM(&deadline);
+        (void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                              NULL);
+        (void)clock_gettime(CLOCK_MONOTONIC, &woke);
+        rt_latency_add(&lat, (long)timespec_diff_ns(woke, deadline));
+    }
+    (void)printf("    %-32s p50 %7ld ns  p99 %7ld ns  max %7ld ns\n", what,
+                 rt_latency_percentile(&lat, 50.0),
+                 rt_latency_percentile(&lat, 99.0),
+                 rt_latency_percentile(&lat, 100.0));
+}
+
+static void bench(void)
+{
+#ifdef __linux__
+    cpu_set_t was;
+    struct rt_cpus_t cpus;
+    char list[16];
+    int cpu;
+#endif  // __linux__
+    struct sched_param param;
+
+    wakes("default policy");
+#ifdef __linux__
+    (void)sched_getaffinity(0, sizeof(was), &was);
+    for (cpu = CPU_SETSIZE - 1; 0 < cpu && !CPU_ISSET(cpu, &was); cpu--) {
+        continue;
+    }
+    (void)snprintf(list, sizeof(list), "%d", cpu);
+    if (rt_cpus_parse(list, &cpus) &&
+        0 == rt_pin(&cpus)) {
+        wakes("pinned");
+    }
+#endif  // __linux__
+    if (0 != rt_fifo(sched_get_priority_max(SCHED_FIFO) / 2)) {
+        (void)puts("    SCHED_FIFO not permitted");
+    } else if (0 != rt_memlock()) {
+        wakes("pinned, SCHED_FIFO");
+    } else {
+        wakes("pinned, SCHED_FIFO, locked");
+        (void)munlockall();
+    }
+    memset(&param, 0, sizeof(param));
+    (void)pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+#ifdef __linux__
+    (void)sched_setaffinity(0, sizeof(was), &was);
+#endif  // __linux__
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_rtsched [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    cpus_test();
+    pin_test();
+    fifo_test();
+    latency_test();
+    rt_prefault_stack();
+    if (!quiet) {
+        bench();
+    }
+
+    if (!quiet || 0 < failures) {
+        (void)printf("rtsched: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,254 @@
+/* test harness for local SOCK_SEQPACKET client sockets
+ *
+ * "unix:" source specs are parsed, then libgps talks to a stand-in
+ * daemon, forked off, over a SOCK_SEQPACKET socket and over TCP
+ * loopback.  That checks messages of several lines, and one too long
+ * for the client, and times round trips and CPU over each.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gps.h"
+#include "../include/gpsdclient.h"
+#include "../include/gps_json.h"
+#include "../include/os_compat.h"
+#include "../include/timespec.h"
+
+#define LOOPS           20000           // round trips to time
+
+static bool quiet = false;
+static int failures = 0;
+
+static const char version[] =
+    "{\"class\":\"VERSION\",\"release\":\"test\",\"rev\":\"test\","
+    "\"proto_major\":3,\"proto_minor\":14}\r\n";
+static const char tpv[] =
+    "{\"class\":\"TPV\",\"device\":\"/dev/ttyS0\",\"mode\":3,"
+    "\"time\":\"2021-09-21T10:00:00.000Z\",\"ept\":0.005,"
+    "\"lat\":40.035093060,\"lon\":-75.519748733,\"altHAE\":31.1230,"
+    "\"epx\":9.497,\"epy\":9.651,\"epv\":22.448,\"track\":0.0000,"
+    "\"speed\":0.011,\"climb\":-0.006,\"eps\":0.25,\"epc\":0.40}\r\n";
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void spec_test(void)
+{
+    struct fixsource_t source;
+    char spec[GPS_PATH_MAX];
+
+    (void)strlcpy(spec, "unix:/run/gpsd.seqpacket", sizeof(spec));
+    gpsd_source_spec(spec, &source);
+    check(0 == strcmp(source.server, "unix:/run/gpsd.seqpacket") &&
+          NULL == source.device,
+          "a unix: spec names the socket");
+
+    (void)strlcpy(spec, "unix:/run/gpsd.seqpacket:/dev/ttyUSB0",
+                  sizeof(spec));
+    gpsd_source_spec(spec, &source);
+    check(0 == strcmp(source.server, "unix:/run/gpsd.seqpacket") &&
+          NULL != source.device &&
+          0 == strcmp(source.device, "/dev/ttyUSB0"),
+          "and may name a device");
+
+    (void)strlcpy(spec, "localhost:2948:/dev/ttyUSB0", sizeof(spec));
+    gpsd_source_spec(spec, &source);
+    check(0 == strcmp(source.server, "localhost") &&
+          0 == strcmp(source.port, "2948") &&
+          0 == strcmp(source.device, "/dev/ttyUSB0"),
+          "other specs are as they were");
+}
+
+/* the stand-in daemon: a TPV for every request, two in one message
+ * for "?TWO;", and a message longer than any report for "?LONG;" */
+static void serve(int lsock)
+{
+    char buf[GPS_JSON_RESPONSE_MAX * 4];
+    int fd = accept(lsock, NULL, NULL);
+    ssize_t len;
+
+    if (0 > fd) {
+        exit(EXIT_FAILURE);
+    }
+    (void)write(fd, version, sizeof(version) - 1);
+    while (0 < (len = read(fd, buf, sizeof(buf) - 1))) {
+        buf[len] = '\0';
+        if (NULL != strstr(buf, "?TWO;")) {
+            (void)strlcpy(buf, tpv, sizeof(buf));
+            (void)strlcat(buf, tpv, sizeof(buf));
+            (void)write(fd, buf, strlen(buf));
+        } else if (NULL != strstr(buf, "?LONG;")) {
+            (void)memset(buf, ' ', sizeof(buf));
+            buf[sizeof(buf) - 1] = '\n';
+            (void)write(fd, buf, sizeof(buf));
+        } else {
+            (void)write(fd, tpv, sizeof(tpv) - 1);
+        }
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// read until a TPV comes, or the link fails
+static bool read_tpv(struct gps_data_t *gpsdata)
+{
+    int status;
+
+    do {
+        gpsdata->set = 0;
+        status = gps_read(gpsdata, NULL, 0);
+    } while (0 <= status &&
+             0 == (gpsdata->set & TIME_SET));
+    return 0 <= status;
+}
+
+/* time LOOPS round trips to a stand-in daemon on lsock, with the
+ * client's and daemon's CPU a message */
+static void link_test(const char *name, int lsock, const char *host,
+                      const char *port, bool seqpacket)
+{
+    struct gps_data_t gpsdata;
+    struct rusage before, after, child;
+    timespec_t start, stop;
+    double cpu_us, server_us, rtt_us;
+    bool ok = true;
+    pid_t pid;
+    int i, status;
+
+    (void)fflush(stdout);       // or the child's exit() prints it again
+    pid = fork();
+    if (0 == pid) {
+        serve(lsock);
+    }
+    (void)close(lsock);
+
+    if (0 != gps_open(host, port, &gpsdata)) {
+        (void)printf("FAILED: %s: cannot open %s\n", name, host);
+        failures++;
+        (void)kill(pid, SIGTERM);
+        (void)waitpid(pid, &status, 0);
+        return;
+    }
+
+    (void)getrusage(RUSAGE_SELF, &before);
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; ok && i < LOOPS; i++) {
+        ok = 0 <= gps_send(&gpsdata, "?POLL;\n") &&
+             read_tpv(&gpsdata);
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+    (void)getrusage(RUSAGE_SELF, &after);
+    check(ok, seqpacket ? "every TPV comes over SOCK_SEQPACKET"
+                        : "every TPV comes over TCP");
+
+    if (ok &&
+        seqpacket) {
+        (void)gps_send(&gpsdata, "?TWO;\n");
+        check(read_tpv(&gpsdata) && read_tpv(&gpsdata),
+              "two reports in a message are two reads");
+        (void)gps_send(&gpsdata, "?LONG;\n");
+        check(0 > gps_read(&gpsdata, NULL, 0) && EMSGSIZE == errno,
+              "a message too long for the client is an error");
+    }
+    (void)gps_close(&gpsdata);
+    (void)wait4(pid, &status, 0, &child);
+
+    rtt_us = TS_SUB_D(&stop, &start) * 1e6 / LOOPS;
+    cpu_us = ((after.ru_utime.tv_sec - before.ru_utime.tv_sec) * 1e6 +
+              (after.ru_utime.tv_usec - before.ru_utime.tv_usec) +
+              (after.ru_stime.tv_sec - before.ru_stime.tv_sec) * 1e6 +
+              (after.ru_stime.tv_usec - before.ru_stime.tv_usec)) / LOOPS;
+    server_us = (child.ru_utime.tv_sec * 1e6 + child.ru_utime.tv_usec +
+                 child.ru_stime.tv_sec * 1e6 + child.ru_stime.tv_usec) /
+                LOOPS;
+    if (!quiet) {
+        (void)printf("    %s: round trip %.1f us, CPU client %.1f us, "
+                     "daemon %.1f us\n", name, rtt_us, cpu_us, server_us);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_un sun;
+    struct sockaddr_in sin;
+    socklen_t sinlen = (socklen_t)sizeof(sin);
+    char host[GPS_PATH_MAX], port[8];
+    int option, lsock;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_seqpacket [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    spec_test();
+
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    (void)memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 > lsock ||
+        0 > bind(lsock, (struct sockaddr *)&sin, sizeof(sin)) ||
+        0 > listen(lsock, 1) ||
+        0 > getsockname(lsock, (struct sockaddr *)&sin, &sinlen)) {
+        (void)printf("FAILED: TCP listen: %s\n", strerror(errno));
+        failures++;
+    } else {
+        (void)snprintf(port, sizeof(port), "%u", ntohs(sin.sin_port));
+        link_test("TCP loopback", lsock, "127.0.0.1", port, false);
+    }
+
+    (void)memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    (void)snprintf(sun.sun_path, sizeof(sun.sun_path),
+                   "/tmp/test_seqpacket.%d", (int)getpid());
+    (void)unlink(sun.sun_path);
+    lsock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (0 > lsock ||
+        0 > bind(lsock, (struct sockaddr *)&sun, sizeof(sun)) ||
+        0 > listen(lsock, 1)) {
+        (void)printf("FAILED: SOCK_SEQPACKET listen: %s\n",
+                     strerror(errno));
+        failures++;
+    } else {
+        (void)snprintf(host, sizeof(host), "%s%s",
+                       GPSD_LOCAL_PREFIX, sun.sun_path);
+        link_test("SOCK_SEQPACKET", lsock, host, NULL, true);
+    }
+    (void)unlink(sun.sun_path);
+
+    if (!quiet || 0 < failures) {
+        (void)printf("seqpacket: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
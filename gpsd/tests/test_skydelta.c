@@ -0,0 +1,366 @@
+/* test harness for SKY deltas
+ *
+ * A skyview is dumped as deltas while satellites come, go and change,
+ * to check each delta carries just those, that keyframes come when
+ * asked for, and that libgps merges the deltas back into the skyview
+ * it was sent.  Then the SKY reports of any logged .chk files named on
+ * the command line are replayed as full SKY and as deltas, for the
+ * bytes each costs, and to check the merged skyview never differs.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/gps_json.h"
+
+#define START           1632218400      // 2021-09-21T10:00:00Z
+#define SATS            40
+#define KEYFRAME        10              // ?WATCH skydelta of the tests
+
+static bool quiet = false;
+static int failures = 0;
+
+static struct gps_data_t sky;           // what the daemon has
+static struct gps_data_t client;        // what libgps made of it
+static struct gps_policy_t policy;
+static struct sky_delta_t sent;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static bool same_real(double a, double b)
+{
+    return a == b || (0 == isfinite(a) && 0 == isfinite(b));
+}
+
+// is satellite sp in the skyview of gpsdata, with the same attributes?
+static bool has(const struct gps_data_t *gpsdata,
+                const struct satellite_t *sp)
+{
+    int i;
+
+    for (i = 0; i < gpsdata->satellites_visible; i++) {
+        const struct satellite_t *cp = &gpsdata->skyview[i];
+
+        if (sp->PRN == cp->PRN &&
+            sp->gnssid == cp->gnssid &&
+            sp->svid == cp->svid &&
+            sp->sigid == cp->sigid &&
+            same_real(sp->elevation, cp->elevation) &&
+            same_real(sp->azimuth, cp->azimuth) &&
+            same_real(sp->ss, cp->ss) &&
+            sp->used == cp->used &&
+            sp->health == cp->health) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// does the client have the daemon's skyview, in any order?
+static bool merged(void)
+{
+    int i;
+
+    for (i = 0; i < sky.satellites_visible; i++) {
+        if (0 != sky.skyview[i].PRN &&
+            !has(&client, &sky.skyview[i])) {
+            return false;
+        }
+    }
+    for (i = 0; i < client.satellites_visible; i++) {
+        if (!has(&sky, &client.skyview[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// dump the skyview as a delta, and have the client read it
+static const char *delta(void)
+{
+    static char buf[GPS_JSON_RESPONSE_MAX * 4];
+    const char *end;
+
+    json_sky_delta_dump(&sky, &policy, &sent, buf, sizeof(buf));
+    if (0 != libgps_json_unpack(buf, &client, &end)) {
+        (void)printf("    unparsed: %s", buf);
+    }
+    return buf;
+}
+
+static void satellite(int i, short PRN, unsigned char gnssid,
+                      unsigned char svid, unsigned char sigid)
+{
+    struct satellite_t *sp = &sky.skyview[i];
+
+    sp->PRN = PRN;
+    sp->elevation = 10.0 + i;
+    sp->azimuth = 7.0 * i;
+    sp->ss = 30.0 + i % 15;
+    sp->used = 0 == i % 3;
+    sp->gnssid = gnssid;
+    sp->svid = svid;
+    sp->sigid = sigid;
+    sp->freqid = -1;
+    sp->health = SAT_HEALTH_OK;
+}
+
+// GPS L1 and L2 of each of SATS / 2 satellites
+static void populate(void)
+{
+    int i;
+
+    (void)memset(&sky, 0, sizeof(sky));
+    (void)strlcpy(sky.dev.path, "/dev/test", sizeof(sky.dev.path));
+    sky.skyview_time.tv_sec = START;
+    gps_clear_dop(&sky.dop);
+    sky.dop.hdop = 0.9;
+    sky.dop.pdop = 1.7;
+    sky.set = SATELLITE_SET;
+    sky.satellites_visible = SATS;
+    for (i = 0; i < SATS; i++) {
+        satellite(i, (short)(i / 2 + 1), GNSSID_GPS,
+                  (unsigned char)(i / 2 + 1), (unsigned char)(i % 2 * 3));
+    }
+}
+
+static void delta_test(void)
+{
+    char full[GPS_JSON_RESPONSE_MAX * 4];
+    const char *buf;
+
+    populate();
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.sky_delta = KEYFRAME;
+    (void)memset(&client, 0, sizeof(client));
+    sent.nsats = -1;
+
+    json_sky_dump(&sky, &policy, full, sizeof(full));
+    buf = delta();
+    check(0 == strcmp(full, buf) && SATS == sent.nsats,
+          "the first SKY is a full one");
+    check(merged(), "which the client reads as before");
+
+    buf = delta();
+    check(NULL != strstr(buf, ",\"nSat\":40,\"uSat\":14,\"delta\":true}") &&
+          NULL == strstr(buf, "satellites"),
+          "nothing changed, no satellites");
+    if (!quiet) {
+        (void)printf("    %s", buf);
+    }
+
+    sky.skyview[5].ss = 45.0;
+    sky.skyview[8].used = !sky.skyview[8].used;
+    buf = delta();
+    check(NULL != strstr(buf, "\"satellites\":[{\"PRN\":3,\"el\":15.0,"
+                              "\"az\":35.0,\"ss\":45.0,\"used\":false,"
+                              "\"gnssid\":0,\"svid\":3,\"sigid\":3,"
+                              "\"health\":1},{\"PRN\":5,") &&
+          NULL == strstr(buf, "\"PRN\":6") &&
+          NULL == strstr(buf, "removed"),
+          "just the satellites changed");
+    check(merged(), "merged");
+
+    // L2 of PRN 1 lost, PRN 21 risen
+    (void)memmove(&sky.skyview[1], &sky.skyview[2],
+                  (SATS - 2) * sizeof(sky.skyview[0]));
+    satellite(SATS - 1, 21, GNSSID_GPS, 21, 0);
+    buf = delta();
+    check(NULL != strstr(buf, "\"satellites\":[{\"PRN\":21,") &&
+          NULL != strstr(buf, ",\"removed\":[{\"PRN\":1,\"gnssid\":0,"
+                              "\"svid\":1,\"sigid\":3}]}"),
+          "satellites added and removed, keyed by signal");
+    check(merged(), "merged");
+    if (!quiet) {
+        (void)printf("    %s", buf);
+    }
+
+    // satellites with no svid go by PRN
+    sky.skyview[0].svid = 0;
+    sky.skyview[0].PRN = 120;
+    buf = delta();
+    check(NULL != strstr(buf, "\"removed\":[{\"PRN\":1,\"gnssid\":0,"
+                              "\"svid\":1}]") &&
+          NULL != strstr(buf, "\"satellites\":[{\"PRN\":120,") &&
+          merged(),
+          "and with no svid by PRN");
+
+    while (KEYFRAME > sent.reports) {
+        (void)delta();
+    }
+    sky.satellites_visible = 2;
+    buf = delta();
+    check(NULL == strstr(buf, "delta") && 1 == sent.reports &&
+          2 == sent.nsats && merged(),
+          "every skydelta'th a full one");
+
+    sky.set &= ~SATELLITE_SET;
+    buf = delta();
+    check(NULL != strstr(buf, ",\"pdop\":1.70,\"delta\":true}") &&
+          2 == sent.nsats && 2 == client.satellites_visible,
+          "a SKY of just DOPs leaves the skyview be");
+    sent.nsats = -1;
+    buf = delta();
+    check(NULL == strstr(buf, "delta") && -1 == sent.nsats &&
+          0 == client.satellites_visible,
+          "unless no satellites have been sent");
+}
+
+// deltas are of one device, and the client keeps devices apart
+static void device_test(void)
+{
+    const char *buf, *end;
+    int visible;
+
+    populate();
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.sky_delta = KEYFRAME;
+    (void)strlcpy(policy.fields, "nSat,satellites", sizeof(policy.fields));
+    json_watch_fields(&policy);
+    (void)memset(&client, 0, sizeof(client));
+    sent.nsats = -1;
+    (void)delta();
+    sky.skyview[5].ss = 45.0;
+    buf = delta();
+    check(NULL != strstr(buf, "{\"class\":\"SKY\",\"device\":\"/dev/test\"") &&
+          NULL != strstr(buf, "\"delta\":true") && merged(),
+          "deltas name their device, whatever the fields");
+
+    visible = client.satellites_visible;
+    (void)strlcpy(sky.dev.path, "/dev/other", sizeof(sky.dev.path));
+    sky.skyview[6].ss = 46.0;
+    buf = delta();
+    check(NULL != strstr(buf, "\"delta\":true") &&
+          0 == (client.set & SATELLITE_SET) &&
+          visible == client.satellites_visible &&
+          0 == strcmp(client.skyview_device, "/dev/test"),
+          "the client drops a delta of another device");
+
+    (void)libgps_json_unpack("{\"class\":\"SKY\",\"nSat\":41,"
+                             "\"delta\":true,\"satellites\":"
+                             "[{\"PRN\":99,\"svid\":99}]}\r\n",
+                             &client, &end);
+    check(0 == (client.set & SATELLITE_SET) &&
+          visible == client.satellites_visible,
+          "and one of no device");
+}
+
+static void watch_test(void)
+{
+    struct gps_policy_t ccp;
+    char buf[GPS_JSON_RESPONSE_MAX];
+    const char *end;
+    int status;
+
+    (void)memset(&ccp, 0, sizeof(ccp));
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true,"
+                             "\"skydelta\":30}", &ccp, &end);
+    check(0 == status && 30 == ccp.sky_delta, "?WATCH asks for deltas");
+    json_watch_dump(&ccp, buf, sizeof(buf));
+    check(NULL != strstr(buf, ",\"skydelta\":30}"), "WATCH reports it");
+    status = json_watch_read("{\"class\":\"WATCH\",\"json\":true}",
+                             &ccp, &end);
+    json_watch_dump(&ccp, buf, sizeof(buf));
+    check(0 == status && 0 == ccp.sky_delta &&
+          NULL == strstr(buf, "skydelta"),
+          "and resets it like the other options");
+}
+
+// replay the SKY reports of a regression log, full and as deltas
+static void log_test(const char *path)
+{
+    char line[GPS_JSON_RESPONSE_MAX * 4];
+    char full[GPS_JSON_RESPONSE_MAX * 4];
+    unsigned long full_bytes = 0, delta_bytes = 0;
+    int reports = 0;
+    bool same = true;
+    FILE *fp;
+
+    if (NULL == (fp = fopen(path, "r"))) {
+        (void)printf("FAILED: cannot open %s\n", path);
+        failures++;
+        return;
+    }
+    (void)memset(&sky, 0, sizeof(sky));
+    (void)memset(&client, 0, sizeof(client));
+    (void)memset(&policy, 0, sizeof(policy));
+    policy.sky_delta = KEYFRAME;
+    sent.nsats = -1;
+    sent.reports = 0;
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        const char *end;
+
+        if (0 != strncmp(line, "{\"class\":\"SKY\"", 14) ||
+            0 != libgps_json_unpack(line, &sky, &end)) {
+            continue;
+        }
+        // the logs have no device, the daemon always has one
+        (void)strlcpy(sky.dev.path, path, sizeof(sky.dev.path));
+        json_sky_dump(&sky, &policy, full, sizeof(full));
+        full_bytes += strlen(full);
+        delta_bytes += strlen(delta());
+        if (0 != (sky.set & SATELLITE_SET) &&
+            !merged()) {
+            same = false;
+        }
+        reports++;
+    }
+    (void)fclose(fp);
+
+    if (!quiet) {
+        (void)printf("    %s: %d SKY, full %lu bytes, delta %lu (%.0f%%)\n",
+                     path, reports, full_bytes, delta_bytes,
+                     0 < full_bytes ? 100.0 * delta_bytes / full_bytes : 0);
+    }
+    check(same, "the client has every skyview of the log");
+    check(0 < reports && delta_bytes < full_bytes,
+          "deltas cost less than full SKY");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_skydelta [-q] [chk-file...]\n",
+                        stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    delta_test();
+    device_test();
+    watch_test();
+    for (; optind < argc; optind++) {
+        log_test(argv[optind]);
+    }
+
+    if (!quiet || 0 < failures) {
+        (void)printf("skydelta: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,261 @@
+/* test harness for report snapshots, their arenas and rings
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/gps.h"
+
+#define READERS         3
+#define RECORDS         20000           // put by the threaded writer
+
+static bool quiet = false;
+static int failures = 0;
+
+static char tpv[] = "{\"class\":\"TPV\",\"device\":\"/dev/ttyS0\","
+    "\"mode\":3,\"time\":\"2021-09-21T10:00:00.000Z\","
+    "\"lat\":46.5,\"lon\":7.5,\"altHAE\":500.0}";
+static char sky[] = "{\"class\":\"SKY\",\"device\":\"/dev/ttyS1\","
+    "\"hdop\":1.2,\"nSat\":3,\"uSat\":2,\"satellites\":["
+    "{\"PRN\":10,\"el\":45,\"az\":196,\"ss\":34,\"used\":true},"
+    "{\"PRN\":29,\"el\":67,\"az\":310,\"ss\":40,\"used\":true},"
+    "{\"PRN\":8,\"el\":12,\"az\":40,\"ss\":20,\"used\":false}]}";
+static char gst[] = "{\"class\":\"GST\",\"device\":\"/dev/ttyS0\","
+    "\"time\":\"2021-09-21T10:00:00.000Z\",\"rms\":2.5,\"major\":1.5,"
+    "\"minor\":1.0,\"orient\":30.0,\"lat\":1.2,\"lon\":1.1,\"alt\":2.0}";
+static char version[] = "{\"class\":\"VERSION\",\"release\":\"3.23.2\","
+    "\"rev\":\"3.23.2\",\"proto_major\":3,\"proto_minor\":14}";
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void arena_test(void)
+{
+    static struct gps_data_t gpsdata;
+    static double mem[4096];            // 32 kB, aligned for a double
+    struct gps_arena_t arena;
+    struct gps_snap_t *t, *s, *g;
+
+    gps_arena_init(&arena, mem, sizeof(mem));
+    (void)gps_unpack(tpv, &gpsdata);
+    t = gps_snap_arena(&gpsdata, tpv, &arena);
+    (void)gps_unpack(sky, &gpsdata);
+    s = gps_snap_arena(&gpsdata, sky, &arena);
+    (void)gps_unpack(gst, &gpsdata);
+    g = gps_snap_arena(&gpsdata, gst, &arena);
+    check(NULL != t && NULL != s && NULL != g, "records from the arena");
+    if (NULL == t || NULL == s || NULL == g) {
+        return;
+    }
+
+    // each record keeps its own report, whatever was unpacked after it
+    check(GPS_SNAP_TPV == t->type &&
+          0 == strcmp(t->device, "/dev/ttyS0") &&
+          MODE_3D == ((struct gps_snap_tpv_t *)t)->fix.mode &&
+          46.5 == ((struct gps_snap_tpv_t *)t)->fix.latitude &&
+          500.0 == ((struct gps_snap_tpv_t *)t)->fix.altHAE,
+          "TPV record");
+    check(GPS_SNAP_SKY == s->type &&
+          0 == strcmp(s->device, "/dev/ttyS1") &&
+          3 == ((struct gps_snap_sky_t *)s)->nsats &&
+          2 == ((struct gps_snap_sky_t *)s)->satellites_used &&
+          29 == ((struct gps_snap_sky_t *)s)->skyview[1].PRN &&
+          1.2 == ((struct gps_snap_sky_t *)s)->dop.hdop,
+          "SKY record");
+    check(s->size < sizeof(struct gps_snap_sky_t) &&
+          s->size < sizeof(gpsdata) / 10,
+          "SKY record holds only the satellites seen");
+    check(GPS_SNAP_GST == g->type &&
+          2.5 == ((struct gps_snap_gst_t *)g)->gst.rms_deviation,
+          "GST record");
+    check((char *)s >= (char *)t + t->size &&
+          (char *)g >= (char *)s + s->size &&
+          arena.used <= sizeof(mem),
+          "records laid out in the arena");
+
+    (void)gps_unpack(version, &gpsdata);
+    check(NULL == gps_snap_arena(&gpsdata, version, &arena),
+          "no record of a VERSION");
+    (void)gps_unpack(tpv, &gpsdata);
+    gps_arena_init(&arena, mem, sizeof(struct gps_snap_tpv_t) - 1);
+    check(NULL == gps_snap_arena(&gpsdata, tpv, &arena),
+          "no record from a full arena");
+}
+
+static void ring_test(void)
+{
+    static struct gps_data_t gpsdata;
+    static double mem[4 * 1024];
+    static double buf[1024];
+    struct gps_ring_t ring, small;
+    struct gps_snap_t *snap;
+    unsigned long a = 0, b = 0;
+    int i, n;
+
+    n = gps_ring_init(&ring, mem, sizeof(mem),
+                      sizeof(struct gps_snap_tpv_t));
+    check(0 < n, "ring of TPV slots");
+    (void)gps_unpack(tpv, &gpsdata);
+    for (i = 1; i <= 3; i++) {
+        gpsdata.fix.latitude = i;
+        (void)gps_ring_put(&ring, &gpsdata, tpv);
+    }
+    for (i = 1; i <= 3; i++) {
+        snap = gps_ring_get(&ring, &a, buf, sizeof(buf));
+        if (NULL == snap ||
+            i != ((struct gps_snap_tpv_t *)snap)->fix.latitude) {
+            break;
+        }
+    }
+    check(4 == i && NULL == gps_ring_get(&ring, &a, buf, sizeof(buf)) &&
+          EAGAIN == errno,
+          "reader gets each record once, in order");
+
+    gpsdata.fix.latitude = 4;
+    (void)gps_ring_put(&ring, &gpsdata, tpv);
+    b = a;
+    snap = gps_ring_get(&ring, &a, buf, sizeof(struct gps_snap_t));
+    check(NULL == snap && E2BIG == errno && b == a,
+          "a record too big for the reader's buffer is left, not lost");
+    snap = gps_ring_get(&ring, &a, buf, sizeof(buf));
+    check(NULL != snap && 4 == ((struct gps_snap_tpv_t *)snap)->fix.latitude,
+          "and got with a bigger one");
+    b = 0;
+
+    for (i = 5; i <= n + 5; i++) {
+        gpsdata.fix.latitude = i;
+        (void)gps_ring_put(&ring, &gpsdata, tpv);
+    }
+    snap = gps_ring_get(&ring, &b, buf, sizeof(buf));
+    check(NULL != snap &&
+          ring.head - n + 1 == ((struct gps_snap_tpv_t *)snap)->fix.latitude &&
+          ring.head - n + 1 == b,
+          "lapped reader skips to the oldest record kept");
+
+    /* the writer starting over the oldest slot, as a reader copies it:
+     * the slot's first bookend already has the new sequence number */
+    n = gps_ring_init(&ring, mem, sizeof(mem),
+                      sizeof(struct gps_snap_tpv_t));
+    for (i = 1; i <= 2; i++) {
+        gpsdata.fix.latitude = i;
+        (void)gps_ring_put(&ring, &gpsdata, tpv);
+    }
+    *(volatile unsigned long *)ring.slots = n + 1;
+    a = 0;
+    snap = gps_ring_get(&ring, &a, buf, sizeof(buf));
+    check(NULL != snap && 2 == ((struct gps_snap_tpv_t *)snap)->fix.latitude,
+          "reader skips a slot being rewritten");
+
+    (void)gps_ring_init(&small, mem, sizeof(mem),
+                        sizeof(struct gps_snap_gst_t));
+    check(NULL == gps_ring_put(&small, &gpsdata, tpv) && 0 == small.head,
+          "record too big for a slot is not put");
+}
+
+static struct gps_ring_t shared;
+static volatile bool writing;
+
+// check each record is whole, and the records come in order
+static void *reader(void *arg)
+{
+    double buf[256];
+    unsigned long cursor = 0;
+    double last = 0;
+    long *bad = (long *)arg;
+
+    for (;;) {
+        struct gps_snap_t *snap = gps_ring_get(&shared, &cursor, buf,
+                                               sizeof(buf));
+        struct gps_fix_t *fix;
+
+        if (NULL == snap) {
+            if (!writing && cursor == shared.head) {
+                break;
+            }
+            continue;
+        }
+        fix = &((struct gps_snap_tpv_t *)snap)->fix;
+        if (fix->longitude != -fix->latitude ||
+            fix->altHAE != 2 * fix->latitude ||
+            fix->latitude <= last) {
+            (*bad)++;
+        }
+        last = fix->latitude;
+    }
+    return NULL;
+}
+
+static void thread_test(void)
+{
+    static struct gps_data_t gpsdata;
+    static double mem[16 * 1024];
+    pthread_t threads[READERS];
+    long bad[READERS];
+    long total = 0;
+    int i;
+
+    (void)gps_ring_init(&shared, mem, sizeof(mem),
+                        sizeof(struct gps_snap_tpv_t));
+    writing = true;
+    for (i = 0; i < READERS; i++) {
+        bad[i] = 0;
+        (void)pthread_create(&threads[i], NULL, reader, &bad[i]);
+    }
+    (void)gps_unpack(tpv, &gpsdata);
+    for (i = 1; i <= RECORDS; i++) {
+        gpsdata.fix.latitude = i;
+        gpsdata.fix.longitude = -i;
+        gpsdata.fix.altHAE = 2 * i;
+        (void)gps_ring_put(&shared, &gpsdata, tpv);
+    }
+    writing = false;
+    for (i = 0; i < READERS; i++) {
+        (void)pthread_join(threads[i], NULL);
+        total += bad[i];
+    }
+    check(0 == total, "readers racing the writer get no torn records");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_snap [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    arena_test();
+    ring_test();
+    thread_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("snap: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,263 @@
+/* test harness for stage.c, client output staging
+ *
+ * Checks what gpsd_stage_put() takes and gpsd_stage_flush() sends, and
+ * what a write cut short leaves held, then times a 10 Hz receiver's
+ * reporting cycles out to many watchers, a write a report, as gpsd
+ * was, against a write a watcher a cycle.
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+#define WATCHERS        200             // clients in the fan-out
+#define CYCLES          500             // reporting cycles to time
+#define RATE            10              // cycles a second, a 10 Hz GNSS
+
+static bool quiet = false;
+static int failures = 0;
+
+/* one cycle of a watcher that asked for JSON and NMEA: three sentences,
+ * their TPV, SKY and GST, sizes as a multi-GNSS receiver makes them */
+static const size_t pieces[] = {82, 72, 68, 350, 1480, 210};
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void stage_test(void)
+{
+    static struct gps_stage_t stage;
+    static char big[STAGE_SIZE];
+    const unsigned char hdr[] = {0x81, 0x05};
+    char buf[64];
+    int sv[2];
+    ssize_t got;
+
+    if (0 > socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+        (void)printf("FAILED: socketpair: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    stage.len = 0;
+    stage.pieces = 0;
+    check(0 == gpsd_stage_flush(&stage, sv[0]),
+          "an empty stage writes nothing");
+    check(gpsd_stage_put(&stage, NULL, 0, "one,", 4) &&
+          gpsd_stage_put(&stage, hdr, sizeof(hdr), "two,", 4) &&
+          gpsd_stage_put(&stage, NULL, 0, "three", 5),
+          "pieces stage");
+    check(3 == stage.pieces && 15 == stage.len, "and are counted");
+    check(15 == gpsd_stage_flush(&stage, sv[0]) &&
+          0 == stage.len && 0 == stage.pieces,
+          "a flush is one write, and empties the stage");
+    got = read(sv[1], buf, sizeof(buf));
+    check(15 == got &&
+          0 == memcmp(buf, "one,\x81\x05two,three", 15),
+          "headers go ahead of their pieces, pieces in order");
+
+    check(gpsd_stage_put(&stage, NULL, 0, big, sizeof(big)),
+          "a full stage's worth stages");
+    check(!gpsd_stage_put(&stage, NULL, 0, "x", 1) &&
+          sizeof(big) == stage.len && 1 == stage.pieces,
+          "and then nothing more");
+    stage.len = 0;
+    stage.pieces = 0;
+    check(!gpsd_stage_put(&stage, hdr, sizeof(hdr), big, sizeof(big)) &&
+          0 == stage.len,
+          "a piece too big for the stage does not stage");
+    (void)close(sv[0]);
+    (void)close(sv[1]);
+}
+
+// a write cut short keeps the rest, and it goes first
+static void held_test(void)
+{
+    static struct gps_stage_t stage;
+    static char big[STAGE_SIZE / 2], buf[STAGE_SIZE];
+    char fill[BUFSIZ];
+    size_t len = 0, rest;
+    ssize_t got;
+    int fds[2];
+
+    if (0 != pipe(fds)) {
+        (void)printf("FAILED: pipe: %s\n", strerror(errno));
+        failures++;
+        return;
+    }
+    (void)fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    (void)fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    (void)memset(fill, '.', sizeof(fill));
+    while (0 < write(fds[1], fill, sizeof(fill))) {
+        continue;
+    }
+    while (0 < write(fds[1], fill, 1)) {
+        continue;
+    }
+    (void)memset(big, 'b', sizeof(big));
+    (void)gpsd_stage_put(&stage, NULL, 0, big, sizeof(big));
+    check(0 > gpsd_stage_flush(&stage, fds[1]) && 0 == stage.len,
+          "a flush that sends nothing drops the stage");
+
+    (void)gpsd_stage_put(&stage, NULL, 0, big, sizeof(big));
+    // room for half of it
+    got = read(fds[0], fill, sizeof(big) / 2);
+    check(0 < got && got == gpsd_stage_flush(&stage, fds[1]) &&
+          sizeof(big) - (size_t)got == stage.len &&
+          0 < stage.held && stage.len == stage.held,
+          "a short write holds the rest");
+    rest = stage.held;
+    (void)gpsd_stage_put(&stage, NULL, 0, "cc", 2);
+    check(gpsd_stage_hold(&stage, "HH", 2) && rest + 2 == stage.held,
+          "a hold goes behind what is held");
+    check(0 > gpsd_stage_flush_held(&stage, fds[1]) &&
+          stage.held + 2 == stage.len,
+          "a held flush with no room keeps it all");
+    check(0 > gpsd_stage_flush(&stage, fds[1]) &&
+          stage.held == stage.len,
+          "a flush with no room keeps what is held");
+    (void)gpsd_stage_put(&stage, NULL, 0, "cc", 2);
+    while (0 < read(fds[0], fill, sizeof(fill))) {
+        continue;
+    }
+    check((ssize_t)stage.len == gpsd_stage_flush(&stage, fds[1]) &&
+          0 == stage.len && 0 == stage.held,
+          "then all of it goes");
+    while (0 < (got = read(fds[0], buf + len, sizeof(buf) - len))) {
+        len += (size_t)got;
+    }
+    check(rest + 4 == len &&
+          0 == memcmp("bHHcc", buf + len - 5, 5),
+          "held first, then what was staged");
+    (void)close(fds[0]);
+    (void)close(fds[1]);
+}
+
+// empty what the watchers were sent, untimed
+static void drain(int *fds)
+{
+    char buf[BUFSIZ];
+    int i;
+
+    for (i = 0; i < WATCHERS; i++) {
+        while (0 < read(fds[i], buf, sizeof(buf))) {
+            continue;
+        }
+    }
+}
+
+/* send CYCLES reporting cycles to WATCHERS clients, staged or not;
+ * count writes and the CPU they take */
+static void fanout(const char *name, int *wfds, int *rfds, bool staged)
+{
+    static struct gps_stage_t stages[WATCHERS];
+    static char report[2048];
+    unsigned long writes = 0, bytes = 0;
+    timespec_t start, stop;
+    double cpu = 0.0;
+    ssize_t status;
+    bool ok = true;
+    int c, i;
+    size_t p;
+
+    (void)memset(report, 'x', sizeof(report));
+    for (c = 0; c < CYCLES; c++) {
+        (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+        for (i = 0; i < WATCHERS; i++) {
+            for (p = 0; p < NITEMS(pieces); p++) {
+                if (staged) {
+                    ok &= gpsd_stage_put(&stages[i], NULL, 0,
+                                         report, pieces[p]);
+                    continue;
+                }
+                status = write(wfds[i], report, pieces[p]);
+                ok &= (ssize_t)pieces[p] == status;
+                writes++;
+                bytes += pieces[p];
+            }
+            if (staged) {
+                size_t len = stages[i].len;
+
+                status = gpsd_stage_flush(&stages[i], wfds[i]);
+                ok &= (ssize_t)len == status;
+                writes++;
+                bytes += len;
+            }
+        }
+        (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
+        cpu += TS_SUB_D(&stop, &start);
+        drain(rfds);
+    }
+    check(ok, staged ? "every staged cycle is sent whole"
+                     : "every report is sent whole");
+    if (!quiet) {
+        (void)printf("    %s: %lu bytes a cycle, %lu writes/s, "
+                     "CPU %.1f us a cycle, %.2f%% of a core at %d Hz\n",
+                     name, bytes / CYCLES, writes * RATE / CYCLES,
+                     cpu * 1e6 / CYCLES, cpu * RATE * 100.0 / CYCLES,
+                     RATE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int wfds[WATCHERS], rfds[WATCHERS];
+    int option, i;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_stage [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    stage_test();
+    held_test();
+
+    for (i = 0; i < WATCHERS; i++) {
+        int sv[2];
+
+        if (0 > socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+            (void)printf("FAILED: socketpair %d: %s\n", i, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        wfds[i] = sv[0];
+        rfds[i] = sv[1];
+        (void)fcntl(rfds[i], F_SETFL, O_NONBLOCK);
+    }
+    fanout("a write a report", wfds, rfds, false);
+    fanout("a write a cycle", wfds, rfds, true);
+    for (i = 0; i < WATCHERS; i++) {
+        (void)close(wfds[i]);
+        (void)close(rfds[i]);
+    }
+
+    if (!quiet || 0 < failures) {
+        (void)printf("stage: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
@@ -0,0 +1,110 @@
+/* test harness for the binary trace rings
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+#include "../include/strfuncs.h"
+
+static bool quiet = false;
+static int failures = 0;
+
+static char last[BUFSIZ];               // the last line seen
+static char first[BUFSIZ];              // the first line of a dump
+static int lines;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void report(const char *buf)
+{
+    (void)strlcpy(last, buf, sizeof(last));
+}
+
+static void collect(const char *line, void *arg)
+{
+    (void)arg;
+    if (0 == lines++) {
+        (void)strlcpy(first, line, sizeof(first));
+    }
+    (void)strlcpy(last, line, sizeof(last));
+}
+
+int main(int argc, char *argv[])
+{
+    struct gpsd_errout_t errout;
+    static const char nmea[] =
+        "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47";
+    int option, i, count;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_trace [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    (void)memset(&errout, 0, sizeof(errout));
+    errout.debug = LOG_RAW1;
+    errout.report = report;
+    errout.label = "test";
+
+    // not deferred, a trace site logs at once, the way GPSD_LOG() did
+    GPSD_TRACE(LOG_RAW1, &errout, TRACE_PACKET_ACCEPT, 1, 4, 0, "$GPG", 4);
+    check(0 == strcmp(last, "test:RAW1: Packet type 1 accepted 4 = $GPG\n"),
+          "immediate message");
+    last[0] = '\0';
+    GPSD_TRACE(LOG_RAW2, &errout, TRACE_PACKET_NOTREADY, 0, 0, 0, NULL, 0);
+    check('\0' == last[0], "site above the debug level is quiet");
+
+    trace_defer(true);
+    GPSD_TRACE(LOG_SPIN, &errout, TRACE_PACKET_GET, 3, -1, 11, NULL, 0);
+    check('\0' == last[0], "deferred site logs nothing");
+    count = trace_dump(collect, NULL);
+    check(1 == count && 1 == lines &&
+          NULL != strstr(last, "packet_get() fd 3 -> -1 ") &&
+          NULL != strstr(last, "(11)"),
+          "dump formats the recorded event");
+
+    // long packets keep only their start, and the ring wraps
+    for (i = 0; i < 1000; i++) {
+        GPSD_TRACE(LOG_RAW1, &errout, TRACE_PACKET_ACCEPT, 1, i, 0,
+                   nmea, sizeof(nmea) - 1);
+    }
+    lines = 0;
+    count = trace_dump(collect, NULL);
+    check(0 < count && count < 1000 && count == lines,
+          "ring keeps only the latest events");
+    check(NULL != strstr(last, "accepted 999 = $GPGGA,123519,") &&
+          NULL == strstr(last, "*47") &&
+          NULL != strstr(last, "..."),
+          "newest event last, its packet cut short");
+    (void)snprintf(last, sizeof(last), "accepted %d = ", 1000 - count);
+    check(NULL != strstr(first, last), "oldest kept event first");
+
+    if (!quiet || 0 < failures) {
+        (void)printf("trace: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4
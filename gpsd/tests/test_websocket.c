@@ -0,0 +1,187 @@
+/* test harness for the WebSocket handshake and frame coding
+ *
+ * This file is Copyright 2010 by the GPSD project
+ * SPDX-License-Identifier: BSD-2-clause
+ */
+
+#include "../include/gpsd_config.h"   // must be before all includes
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/gpsd.h"
+
+static bool quiet = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        (void)printf("FAILED: %s\n", what);
+        failures++;
+    } else if (!quiet) {
+        (void)printf("ok: %s\n", what);
+    }
+}
+
+static void handshake_test(void)
+{
+    // the sample handshake of RFC 6455 section 1.3
+    static const char good[] =
+        "GET /chat HTTP/1.1\r\n"
+        "Host: server.example.com\r\n"
+        "upgrade: WebSocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Origin: http://example.com\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n"
+        "\x81";
+    static const char oldversion[] =
+        "GET / HTTP/1.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 8\r\n"
+        "\r\n";
+    static const char noupgrade[] =
+        "GET / HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "\r\n";
+    char reply[512];
+    ssize_t used;
+
+    (void)strlcpy(reply, "untouched", sizeof(reply));
+    check(0 == ws_handshake(good, strlen(good) - 3, reply, sizeof(reply)) &&
+          0 == strcmp(reply, "untouched"),
+          "incomplete request waits");
+
+    used = ws_handshake(good, strlen(good), reply, sizeof(reply));
+    check((ssize_t)strlen(good) - 1 == used,
+          "request length excludes the frame after it");
+    check(NULL != strstr(reply, "HTTP/1.1 101 ") &&
+          NULL != strstr(reply, "\r\nSec-WebSocket-Accept: "
+                                "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"),
+          "accept key of the RFC 6455 sample");
+
+    check(-1 == ws_handshake(oldversion, strlen(oldversion),
+                             reply, sizeof(reply)) &&
+          NULL != strstr(reply, "HTTP/1.1 400 "),
+          "old protocol version refused");
+    check(-1 == ws_handshake(noupgrade, strlen(noupgrade),
+                             reply, sizeof(reply)),
+          "plain HTTP GET refused");
+}
+
+static void frame_test(void)
+{
+    // masked "Hello", from RFC 6455 section 5.7
+    static const unsigned char hello[] = {
+        0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d,
+        0x7f, 0x9f, 0x4d, 0x51, 0x58};
+    static const size_t lens[] = {0, 125, 126, 65535, 65536};
+    unsigned char buf[400];
+    unsigned char *payload;
+    size_t paylen, n;
+    int opcode;
+    bool fin;
+
+    for (n = 0; n < (size_t)NITEMS(lens); n++) {
+        unsigned char hdr[WS_HEADER_MAX];
+        size_t hdrlen = ws_frame_header(hdr, WS_OP_TEXT, lens[n]);
+        size_t want = 126 > lens[n] ? 2 : (65536 > lens[n] ? 4 : 10);
+        char what[80];
+
+        (void)snprintf(what, sizeof(what),
+                       "header for %zu byte frame", lens[n]);
+        check(want == hdrlen && 0x81 == hdr[0] &&
+              (2 != hdrlen || lens[n] == hdr[1]) &&
+              (4 != hdrlen || (126 == hdr[1] &&
+                               lens[n] == (size_t)(hdr[2] << 8 | hdr[3]))) &&
+              (10 != hdrlen || (127 == hdr[1] && 0x01 == hdr[7])),
+              what);
+    }
+
+    (void)memcpy(buf, hello, sizeof(hello));
+    check(0 == ws_unframe(buf, sizeof(hello) - 1, &opcode, &fin,
+                          &payload, &paylen),
+          "partial frame waits");
+    check((ssize_t)sizeof(hello) == ws_unframe(buf, sizeof(hello), &opcode,
+                                               &fin, &payload, &paylen) &&
+          WS_OP_TEXT == opcode && fin && 5 == paylen &&
+          0 == memcmp(payload, "Hello", 5),
+          "RFC 6455 masked text frame");
+
+    // the same text, fragmented, as RFC 6455 5.7 does unmasked
+    (void)memcpy(buf, hello, 2 + 4 + 3);
+    buf[0] = 0x01;
+    buf[1] = 0x83;
+    check(9 == ws_unframe(buf, 9, &opcode, &fin, &payload, &paylen) &&
+          WS_OP_TEXT == opcode && !fin && 3 == paylen &&
+          0 == memcmp(payload, "Hel", 3),
+          "first fragment has no FIN");
+    (void)memcpy(buf, hello, 2 + 4);
+    buf[0] = 0x80;
+    buf[1] = 0x82;
+    buf[6] = 'l' ^ hello[2];
+    buf[7] = 'o' ^ hello[3];
+    check(8 == ws_unframe(buf, 8, &opcode, &fin, &payload, &paylen) &&
+          WS_OP_CONT == opcode && fin && 2 == paylen &&
+          0 == memcmp(payload, "lo", 2),
+          "continuation with FIN");
+
+    // a 300 byte binary frame, with a 16 bit length
+    buf[0] = 0x82;
+    buf[1] = 0x80 | 126;
+    buf[2] = 300 >> 8;
+    buf[3] = 300 & 0xff;
+    (void)memcpy(buf + 4, "\x01\x02\x03\x04", 4);
+    for (n = 0; n < 300; n++) {
+        buf[8 + n] = (unsigned char)(n ^ (n % 4 + 1));
+    }
+    check(0 == ws_unframe(buf, 3, &opcode, &fin, &payload, &paylen),
+          "partial extended length waits");
+    check(308 == ws_unframe(buf, sizeof(buf), &opcode, &fin,
+                            &payload, &paylen) &&
+          WS_OP_BINARY == opcode && 300 == paylen &&
+          0 == payload[0] && 99 == payload[99] && 255 == payload[255],
+          "16 bit length binary frame");
+
+    (void)memcpy(buf, hello, sizeof(hello));
+    buf[1] &= 0x7f;
+    check(-1 == ws_unframe(buf, sizeof(hello), &opcode, &fin,
+                           &payload, &paylen),
+          "unmasked client frame refused");
+    (void)memcpy(buf, hello, sizeof(hello));
+    buf[0] |= 0x40;
+    check(-1 == ws_unframe(buf, sizeof(hello), &opcode, &fin,
+                           &payload, &paylen),
+          "reserved bit refused");
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "q")) != -1) {
+        switch (option) {
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            (void)fputs("usage: test_websocket [-q]\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    handshake_test();
+    frame_test();
+
+    if (!quiet || 0 < failures) {
+        (void)printf("WebSocket: %d failures\n", failures);
+    }
+    exit(0 < failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+// vim: set expandtab shiftwidth=4